@@ -0,0 +1,707 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Micro-benchmarks of the public entry points of vtkIECTransformLogic.
+//
+// Usage: vtkIECTransformLogicBenchmark [--filter=<substring>] [--min-time=<seconds>] [--csv]
+//
+// For each benchmark the operation is repeated until it ran for at least the minimum time, then the
+// time per operation (ns/op) and the number of heap allocations per operation (allocs/op) are reported.
+// Allocations are counted by replacing the global operator new of this executable, including the overloads for
+// over-aligned types. On Windows each DLL binds to the operator new of its own C++ runtime, so allocations made
+// inside a shared vtkIECTransformLogic or VTK library are not counted there; build static libraries to count them.
+
+// IEC Logic includes
+#include "vtkIECTransformLogic.h"
+#include "vtkIECTrajectoryLogReplay.h"
+
+// VTK includes
+#include <vtkGeneralTransform.h>
+#include <vtkMatrix4x4.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+#if defined(_MSC_VER)
+#include <malloc.h> // _aligned_malloc
+#endif
+
+//----------------------------------------------------------------------------
+// Allocation counting
+//----------------------------------------------------------------------------
+namespace
+{
+std::atomic<std::uint64_t> NumberOfAllocations(0);
+}
+
+void* operator new(std::size_t size)
+{
+  NumberOfAllocations.fetch_add(1, std::memory_order_relaxed);
+  if (void* pointer = std::malloc(size ? size : 1))
+  {
+    return pointer;
+  }
+  throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+  return ::operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+  NumberOfAllocations.fetch_add(1, std::memory_order_relaxed);
+  return std::malloc(size ? size : 1);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+  return ::operator new(size, std::nothrow);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+  NumberOfAllocations.fetch_add(1, std::memory_order_relaxed);
+  const std::size_t alignmentBytes = static_cast<std::size_t>(alignment);
+#if defined(_MSC_VER)
+  void* pointer = _aligned_malloc(size ? size : 1, alignmentBytes);
+#else
+  // std::aligned_alloc requires the size to be a multiple of the alignment
+  void* pointer = std::aligned_alloc(alignmentBytes, ((size ? size : 1) + alignmentBytes - 1) / alignmentBytes * alignmentBytes);
+#endif
+  if (pointer)
+  {
+    return pointer;
+  }
+  throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+  return ::operator new(size, alignment);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+  try
+  {
+    return ::operator new(size, alignment);
+  }
+  catch (const std::bad_alloc&)
+  {
+    return nullptr;
+  }
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+  return ::operator new(size, alignment, std::nothrow);
+}
+
+void operator delete(void* pointer) noexcept
+{
+  std::free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+  std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept
+{
+  std::free(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept
+{
+  std::free(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept
+{
+  std::free(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept
+{
+  std::free(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept
+{
+#if defined(_MSC_VER)
+  _aligned_free(pointer);
+#else
+  std::free(pointer);
+#endif
+}
+
+void operator delete[](void* pointer, std::align_val_t alignment) noexcept
+{
+  ::operator delete(pointer, alignment);
+}
+
+void operator delete(void* pointer, std::size_t, std::align_val_t alignment) noexcept
+{
+  ::operator delete(pointer, alignment);
+}
+
+void operator delete[](void* pointer, std::size_t, std::align_val_t alignment) noexcept
+{
+  ::operator delete(pointer, alignment);
+}
+
+void operator delete(void* pointer, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+  ::operator delete(pointer, alignment);
+}
+
+void operator delete[](void* pointer, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+  ::operator delete(pointer, alignment);
+}
+
+namespace
+{
+//----------------------------------------------------------------------------
+// Benchmark harness
+//----------------------------------------------------------------------------
+
+/// Results are accumulated here so that the compiler cannot remove the benchmarked calls
+volatile double Sink = 0.0;
+
+struct BenchmarkOptions
+{
+  std::string Filter;
+  double MinimumTimeSeconds = 0.2;
+  bool Csv = false;
+};
+
+struct BenchmarkResult
+{
+  std::string Name;
+  std::uint64_t Iterations;
+  double NanosecondsPerOperation;
+  double AllocationsPerOperation;
+};
+
+//----------------------------------------------------------------------------
+/// Run the operation (taking the iteration number) in batches of growing size until the minimum time is reached
+BenchmarkResult RunBenchmark(const std::string& name, const BenchmarkOptions& options, const std::function<void(std::uint64_t)>& operation)
+{
+  using Clock = std::chrono::steady_clock;
+
+  // Warm up (first-call allocations, caches)
+  operation(0);
+
+  std::uint64_t iterations = 1;
+  while (true)
+  {
+    const std::uint64_t allocationsBefore = NumberOfAllocations.load(std::memory_order_relaxed);
+    const Clock::time_point start = Clock::now();
+    for (std::uint64_t iteration = 0; iteration < iterations; ++iteration)
+    {
+      operation(iteration);
+    }
+    const double elapsedSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+    const std::uint64_t allocations = NumberOfAllocations.load(std::memory_order_relaxed) - allocationsBefore;
+
+    if (elapsedSeconds >= options.MinimumTimeSeconds || iterations >= (std::uint64_t(1) << 40))
+    {
+      BenchmarkResult result;
+      result.Name = name;
+      result.Iterations = iterations;
+      result.NanosecondsPerOperation = elapsedSeconds * 1e9 / static_cast<double>(iterations);
+      result.AllocationsPerOperation = static_cast<double>(allocations) / static_cast<double>(iterations);
+      return result;
+    }
+
+    // Aim for the minimum time in the next round, but grow at least 2x and at most 10x
+    double factor = (elapsedSeconds > 0.0 ? 1.4 * options.MinimumTimeSeconds / elapsedSeconds : 10.0);
+    factor = std::max(2.0, std::min(10.0, factor));
+    iterations = static_cast<std::uint64_t>(static_cast<double>(iterations) * factor);
+  }
+}
+
+//----------------------------------------------------------------------------
+class BenchmarkSuite
+{
+public:
+  explicit BenchmarkSuite(const BenchmarkOptions& options)
+    : Options(options)
+  {
+  }
+
+  void Add(const std::string& name, const std::function<void(std::uint64_t)>& operation)
+  {
+    if (!this->Options.Filter.empty() && name.find(this->Options.Filter) == std::string::npos)
+    {
+      return;
+    }
+    this->Report(RunBenchmark(name, this->Options, operation));
+  }
+
+  void PrintHeader()
+  {
+    if (this->Options.Csv)
+    {
+      std::cout << "name,iterations,ns_per_op,allocs_per_op" << std::endl;
+    }
+    else
+    {
+      std::printf("%-88s %14s %12s %12s\n", "Benchmark", "Iterations", "ns/op", "allocs/op");
+      std::printf("%s\n", std::string(129, '-').c_str());
+    }
+  }
+
+private:
+  void Report(const BenchmarkResult& result)
+  {
+    if (this->Options.Csv)
+    {
+      std::cout << result.Name << "," << result.Iterations << "," << result.NanosecondsPerOperation << ","
+        << result.AllocationsPerOperation << std::endl;
+    }
+    else
+    {
+      std::printf("%-88s %14llu %12.1f %12.2f\n", result.Name.c_str(), static_cast<unsigned long long>(result.Iterations),
+        result.NanosecondsPerOperation, result.AllocationsPerOperation);
+      std::fflush(stdout);
+    }
+  }
+
+  BenchmarkOptions Options;
+};
+
+//----------------------------------------------------------------------------
+/// Angle that changes with every iteration, so that no result can be reused between iterations
+double AngleDeg(std::uint64_t iteration)
+{
+  return static_cast<double>(iteration % 360);
+}
+
+//----------------------------------------------------------------------------
+/// Frames connected by the elementary transforms of the logic
+std::vector<vtkIECTransformLogic::CoordinateSystemIdentifier> GetHierarchyFrames(vtkIECTransformLogic* logic)
+{
+  std::vector<vtkIECTransformLogic::CoordinateSystemIdentifier> frames;
+  for (auto& framePair : logic->GetIECTransforms())
+  {
+    for (vtkIECTransformLogic::CoordinateSystemIdentifier frame : { framePair.first, framePair.second })
+    {
+      if (std::find(frames.begin(), frames.end(), frame) == frames.end())
+      {
+        frames.push_back(frame);
+      }
+    }
+  }
+  std::sort(frames.begin(), frames.end());
+  return frames;
+}
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  BenchmarkOptions options;
+  for (int i = 1; i < argc; ++i)
+  {
+    if (std::strncmp(argv[i], "--filter=", 9) == 0)
+    {
+      options.Filter = argv[i] + 9;
+    }
+    else if (std::strncmp(argv[i], "--min-time=", 11) == 0)
+    {
+      options.MinimumTimeSeconds = std::atof(argv[i] + 11);
+    }
+    else if (std::strcmp(argv[i], "--csv") == 0)
+    {
+      options.Csv = true;
+    }
+    else
+    {
+      std::cerr << "Usage: " << argv[0] << " [--filter=<substring>] [--min-time=<seconds>] [--csv]" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  BenchmarkSuite suite(options);
+  suite.PrintHeader();
+
+  // Construction
+  suite.Add("New", [](std::uint64_t)
+  {
+    vtkIECTransformLogic* logic = vtkIECTransformLogic::New();
+    Sink = Sink + static_cast<double>(logic->GetTransformCacheHits());
+    logic->Delete();
+  });
+
+  vtkSmartPointer<vtkIECTransformLogic> logic = vtkSmartPointer<vtkIECTransformLogic>::New();
+  suite.Add("Clone", [&](std::uint64_t iteration)
+  {
+    logic->UpdateGantryToFixedReferenceTransform(AngleDeg(iteration));
+    vtkIECTransformLogic* clone = logic->Clone();
+    Sink = Sink + static_cast<double>(clone->GetTransformCacheHits());
+    clone->Delete();
+  });
+
+  // Binary machine state record
+  std::vector<unsigned char> machineStateRecord(vtkIECTransformLogic::GetMachineStateRecordSize());
+  suite.Add("SaveMachineState", [&](std::uint64_t iteration)
+  {
+    logic->UpdateGantryToFixedReferenceTransform(AngleDeg(iteration));
+    logic->SaveMachineState(machineStateRecord.data());
+  });
+  vtkSmartPointer<vtkIECTransformLogic> restoredLogic = vtkSmartPointer<vtkIECTransformLogic>::New();
+  suite.Add("RestoreMachineState", [&](std::uint64_t)
+  {
+    restoredLogic->RestoreMachineState(machineStateRecord.data());
+    Sink = Sink + restoredLogic->GetSourceAxisDistance();
+  });
+
+  // Elementary transform updates
+  suite.Add("UpdateGantryToFixedReferenceTransform", [&](std::uint64_t iteration)
+  {
+    logic->UpdateGantryToFixedReferenceTransform(AngleDeg(iteration));
+  });
+  suite.Add("UpdateCollimatorToGantryTransform", [&](std::uint64_t iteration)
+  {
+    logic->UpdateCollimatorToGantryTransform(AngleDeg(iteration));
+  });
+  suite.Add("UpdateWedgeFilterToCollimatorTransform", [&](std::uint64_t iteration)
+  {
+    logic->UpdateWedgeFilterToCollimatorTransform(AngleDeg(iteration), 10.0);
+  });
+  suite.Add("UpdatePatientSupportRotationToFixedReferenceTransform", [&](std::uint64_t iteration)
+  {
+    logic->UpdatePatientSupportRotationToFixedReferenceTransform(AngleDeg(iteration));
+  });
+  suite.Add("UpdateTableTopEccentricRotationToPatientSupportRotationTransform", [&](std::uint64_t iteration)
+  {
+    logic->UpdateTableTopEccentricRotationToPatientSupportRotationTransform(AngleDeg(iteration), 100.0);
+  });
+  suite.Add("UpdateTableTopToTableTopEccentricRotationTransform", [&](std::uint64_t iteration)
+  {
+    logic->UpdateTableTopToTableTopEccentricRotationTransform(1.0, 2.0, AngleDeg(iteration), 1.0, 2.0);
+  });
+  suite.Add("UpdatePatientToTableTopTransform", [&](std::uint64_t iteration)
+  {
+    logic->UpdatePatientToTableTopTransform(1.0, 2.0, 3.0, AngleDeg(iteration), 1.0, 2.0);
+  });
+  suite.Add("UpdatePatientImageRegularGridToDICOMTransform", [&](std::uint64_t iteration)
+  {
+    logic->UpdatePatientImageRegularGridToDICOMTransform(0.5, 0.5, 2.0, -250.0, -250.0, AngleDeg(iteration),
+      1.0, 0.0, 0.0, 0.0, 1.0, 0.0);
+  });
+
+  // Transform queries between every pair of frames, timed apart from the updates above: the machine state does not
+  // change between the queries. Without the cache every query composes the path (the cost of a query after an update
+  // on its path), with the cache every query is answered from the cache.
+  std::vector<vtkIECTransformLogic::CoordinateSystemIdentifier> frames = GetHierarchyFrames(logic);
+  for (bool cacheEnabled : { false, true })
+  {
+    logic->SetTransformCacheEnabled(cacheEnabled);
+    for (vtkIECTransformLogic::CoordinateSystemIdentifier fromFrame : frames)
+    {
+      for (vtkIECTransformLogic::CoordinateSystemIdentifier toFrame : frames)
+      {
+        std::string name = std::string("GetTransformBetween/") + (cacheEnabled ? "Cached/" : "Uncached/")
+          + logic->GetTransformNameBetween(fromFrame, toFrame);
+        suite.Add(name, [&, fromFrame, toFrame](std::uint64_t)
+        {
+          double matrix[16];
+          logic->GetTransformBetween(fromFrame, toFrame, matrix);
+          Sink = Sink + matrix[3];
+        });
+      }
+    }
+
+    // Entry points filling VTK objects, for a path through the gantry
+    const std::string cacheName = (cacheEnabled ? "Cached/" : "Uncached/");
+    vtkSmartPointer<vtkMatrix4x4> outputMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    suite.Add("GetTransformBetween/vtkMatrix4x4/" + cacheName + "PatientImageRegularGridToCollimator", [&](std::uint64_t)
+    {
+      logic->GetTransformBetween(vtkIECTransformLogic::PatientImageRegularGrid, vtkIECTransformLogic::Collimator, outputMatrix);
+      Sink = Sink + outputMatrix->GetElement(0, 3);
+    });
+    vtkSmartPointer<vtkGeneralTransform> outputTransform = vtkSmartPointer<vtkGeneralTransform>::New();
+    suite.Add("GetTransformBetween/vtkGeneralTransform/" + cacheName + "PatientImageRegularGridToCollimator", [&](std::uint64_t)
+    {
+      logic->GetTransformBetween(vtkIECTransformLogic::PatientImageRegularGrid, vtkIECTransformLogic::Collimator, outputTransform);
+      Sink = Sink + static_cast<double>(outputTransform->GetNumberOfConcatenatedTransforms());
+    });
+  }
+  logic->SetTransformCacheEnabled(true);
+
+  // Concatenated transforms. A gantry update leaves the patient side of the tree up to date, a patient support
+  // update makes the whole path from the image grid to the root out of date.
+  suite.Add("GetConcatenatedTransform/PatientImageRegularGrid/AfterGantryUpdate", [&](std::uint64_t iteration)
+  {
+    logic->UpdateGantryToFixedReferenceTransform(AngleDeg(iteration));
+    double matrix[16];
+    logic->GetConcatenatedTransform(vtkIECTransformLogic::PatientImageRegularGrid, matrix);
+    Sink = Sink + matrix[3];
+  });
+  suite.Add("GetConcatenatedTransform/PatientImageRegularGrid/AfterPatientSupportUpdate", [&](std::uint64_t iteration)
+  {
+    logic->UpdatePatientSupportRotationToFixedReferenceTransform(AngleDeg(iteration));
+    double matrix[16];
+    logic->GetConcatenatedTransform(vtkIECTransformLogic::PatientImageRegularGrid, matrix);
+    Sink = Sink + matrix[3];
+  });
+
+  // Couch tracking: all axes set every sample, only the table top moves
+  IEC::MachineParameters machineState;
+  machineState.Gantry.RotationAngleDeg = 30.0;
+  machineState.PatientSupportRotation.RotationAngleDeg = 10.0;
+  suite.Add("SetMachineState/TableTopOnly/PatientToCollimator", [&](std::uint64_t iteration)
+  {
+    machineState.TableTop.Tz = 0.01 * static_cast<double>(iteration % 100);
+    logic->SetMachineState(machineState);
+    double matrix[16];
+    logic->GetTransformBetween(vtkIECTransformLogic::Patient, vtkIECTransformLogic::Collimator, matrix);
+    Sink = Sink + matrix[3];
+  });
+
+  // Frames added at runtime: 60 MLC leaf frames below the collimator, paths through them cost the same as IEC paths
+  vtkSmartPointer<vtkIECTransformLogic> extendedLogic = vtkSmartPointer<vtkIECTransformLogic>::New();
+  extendedLogic->SetTransformCacheEnabled(false);
+  int leafFrame = -1;
+  for (int leaf = 0; leaf < 60; ++leaf)
+  {
+    const double leafMatrix[16] = { 1, 0, 0, 0.5 * leaf, 0, 1, 0, 0, 0, 0, 1, -500, 0, 0, 0, 1 };
+    leafFrame = extendedLogic->AddFrame(vtkIECTransformLogic::Collimator, "MLCLeaf" + std::to_string(leaf), leafMatrix);
+  }
+  suite.Add("GetTransformBetween/Uncached/AddedFrameToPatient", [&](std::uint64_t iteration)
+  {
+    extendedLogic->UpdateGantryToFixedReferenceTransform(AngleDeg(iteration));
+    double matrix[16];
+    extendedLogic->GetTransformBetween(static_cast<vtkIECTransformLogic::CoordinateSystemIdentifier>(leafFrame), vtkIECTransformLogic::Patient, matrix);
+    Sink = Sink + matrix[3];
+  });
+  suite.Add("GetFrameIdentifier", [&](std::uint64_t)
+  {
+    Sink = Sink + extendedLogic->GetFrameIdentifier("MLCLeaf42");
+  });
+
+  // Full gantry arc in 0.5 degree steps (per arc, 720 steps)
+  std::vector<double> gantryArcMatrices(16 * 720);
+  suite.Add("GetTransformsAlongGantryArc/CollimatorToPatient/720", [&](std::uint64_t)
+  {
+    logic->GetTransformsAlongGantryArc(vtkIECTransformLogic::Collimator, vtkIECTransformLogic::Patient, 0.0, 0.5, 720, gantryArcMatrices.data(),
+      static_cast<vtkIdType>(gantryArcMatrices.size()));
+    Sink = Sink + gantryArcMatrices.back();
+  });
+
+  // Sub-control-point sampling of a 10 degree gantry arc in 0.5 degree steps (per arc segment, 21 samples)
+  logic->UpdateGantryToFixedReferenceTransform(0);
+  logic->PublishSnapshot();
+  std::shared_ptr<const vtkIECTransformLogic::MachineStateSnapshot> arcStart = logic->GetSnapshot();
+  logic->UpdateGantryToFixedReferenceTransform(10);
+  logic->PublishSnapshot();
+  std::shared_ptr<const vtkIECTransformLogic::MachineStateSnapshot> arcEnd = logic->GetSnapshot();
+  std::vector<double> arcFractions(21);
+  for (std::size_t i = 0; i < arcFractions.size(); ++i)
+  {
+    arcFractions[i] = static_cast<double>(i) / static_cast<double>(arcFractions.size() - 1);
+  }
+  std::vector<double> arcMatrices(16 * arcFractions.size());
+  suite.Add("GetTransformsBetweenStates/PatientImageRegularGridToCollimator/21", [&](std::uint64_t)
+  {
+    logic->GetTransformsBetweenStates(*arcStart, *arcEnd, vtkIECTransformLogic::PatientImageRegularGrid, vtkIECTransformLogic::Collimator,
+      static_cast<vtkIdType>(arcFractions.size()), arcFractions.data(), arcMatrices.data());
+    Sink = Sink + arcMatrices.back();
+  });
+
+  // Treatment log replay, one N x 6 parameter array (per log, 10000 control points)
+  const vtkIdType numberOfLogControlPoints = 10000;
+  std::vector<double> logParameters(6 * numberOfLogControlPoints);
+  for (vtkIdType controlPoint = 0; controlPoint < numberOfLogControlPoints; ++controlPoint)
+  {
+    double* parameters = logParameters.data() + 6 * controlPoint;
+    parameters[0] = AngleDeg(controlPoint);
+    parameters[1] = AngleDeg(controlPoint / 10);
+    parameters[2] = AngleDeg(controlPoint / 100);
+    parameters[3] = 1.0;
+    parameters[4] = 2.0;
+    parameters[5] = static_cast<double>(controlPoint % 100);
+  }
+  std::vector<double> logMatrices(16 * numberOfLogControlPoints);
+  suite.Add("GetTransformsForMachineParameters/RasToCollimator/10000x6", [&](std::uint64_t)
+  {
+    logic->GetTransformsForMachineParameters(vtkIECTransformLogic::RAS, vtkIECTransformLogic::Collimator, numberOfLogControlPoints, 6,
+      logParameters.data(), static_cast<vtkIdType>(logParameters.size()), logMatrices.data(), static_cast<vtkIdType>(logMatrices.size()));
+    Sink = Sink + logMatrices.back();
+  });
+
+  // Points between room frames (per batch, 100000 points)
+  std::vector<double> roomPoints(3 * 100000, 1.0);
+  std::vector<double> transformedRoomPoints(roomPoints.size());
+  suite.Add("TransformPointsBetween/RasToCollimator/100000", [&](std::uint64_t iteration)
+  {
+    logic->UpdateGantryToFixedReferenceTransform(AngleDeg(iteration));
+    logic->TransformPointsBetween(vtkIECTransformLogic::RAS, vtkIECTransformLogic::Collimator, 100000, roomPoints.data(),
+      static_cast<vtkIdType>(roomPoints.size()), transformedRoomPoints.data(), static_cast<vtkIdType>(transformedRoomPoints.size()));
+    Sink = Sink + transformedRoomPoints.back();
+  });
+
+  // Voxel index conversions
+  const std::array<uint16_t, 3> gridSize = { 200, 512, 512 };
+  suite.Add("VectorizedToLinearizedIndex", [&](std::uint64_t iteration)
+  {
+    std::array<uint16_t, 3> index = { static_cast<uint16_t>(iteration % 200), static_cast<uint16_t>(iteration % 512),
+      static_cast<uint16_t>((iteration / 7) % 512) };
+    Sink = Sink + static_cast<double>(vtkIECTransformLogic::VectorizedToLinearizedIndex(index, gridSize));
+  });
+  suite.Add("LinearizedToVectorizedIndex", [&](std::uint64_t iteration)
+  {
+    std::array<uint16_t, 3> index = vtkIECTransformLogic::LinearizedToVectorizedIndex(iteration % (200ull * 512 * 512), gridSize);
+    Sink = Sink + index[0] + index[1] + index[2];
+  });
+
+  suite.Add("VectorizedToMortonIndex", [&](std::uint64_t iteration)
+  {
+    std::array<uint16_t, 3> index = { static_cast<uint16_t>(iteration % 200), static_cast<uint16_t>(iteration % 512),
+      static_cast<uint16_t>((iteration / 7) % 512) };
+    Sink = Sink + static_cast<double>(vtkIECTransformLogic::VectorizedToMortonIndex(index, gridSize));
+  });
+
+  // Batch index conversions (per index, in batches of 64k)
+  const size_t numberOfBatchIndices = 65536;
+  std::vector<uint64_t> linearizedIndices(numberOfBatchIndices);
+  std::vector<std::array<uint16_t, 3>> vectorizedIndices(numberOfBatchIndices);
+  for (size_t i = 0; i < numberOfBatchIndices; ++i)
+  {
+    linearizedIndices[i] = (i * 2654435761ull) % (200ull * 512 * 512);
+  }
+  suite.Add("LinearizedToVectorizedIndices/PerIndex", [&](std::uint64_t iteration)
+  {
+    const size_t i = iteration % numberOfBatchIndices;
+    if (i == 0)
+    {
+      vtkIECTransformLogic::LinearizedToVectorizedIndices(linearizedIndices.data(), numberOfBatchIndices, gridSize, vectorizedIndices.data());
+    }
+    Sink = Sink + vectorizedIndices[i][2];
+  });
+  suite.Add("LinearizedToVectorizedIndices/PerIndex/Portable", [&](std::uint64_t iteration)
+  {
+    const size_t i = iteration % numberOfBatchIndices;
+    if (i == 0)
+    {
+      IEC::SetAVX2Enabled(false);
+      vtkIECTransformLogic::LinearizedToVectorizedIndices(linearizedIndices.data(), numberOfBatchIndices, gridSize, vectorizedIndices.data());
+      IEC::SetAVX2Enabled(true);
+    }
+    Sink = Sink + vectorizedIndices[i][2];
+  });
+  suite.Add("VectorizedToLinearizedIndices/PerIndex", [&](std::uint64_t iteration)
+  {
+    const size_t i = iteration % numberOfBatchIndices;
+    if (i == 0)
+    {
+      vtkIECTransformLogic::VectorizedToLinearizedIndices(vectorizedIndices.data(), numberOfBatchIndices, gridSize, linearizedIndices.data());
+    }
+    Sink = Sink + static_cast<double>(linearizedIndices[i]);
+  });
+
+  // Voxel centers of a whole grid in a room frame (per grid, 64x256x256 voxels)
+  const std::array<uint16_t, 3> voxelGridSize = { 64, 256, 256 };
+  std::vector<float> voxelCenters(3ull * voxelGridSize[0] * voxelGridSize[1] * voxelGridSize[2]);
+  suite.Add("GetVoxelCentersInFrame/Collimator/64x256x256", [&](std::uint64_t iteration)
+  {
+    logic->UpdateGantryToFixedReferenceTransform(AngleDeg(iteration));
+    logic->GetVoxelCentersInFrame(vtkIECTransformLogic::Collimator, voxelGridSize, voxelCenters.data());
+    Sink = Sink + voxelCenters.back();
+  });
+  // Same without the AVX2 variant of the row loop
+  suite.Add("GetVoxelCentersInFrame/Collimator/64x256x256/Portable", [&](std::uint64_t iteration)
+  {
+    IEC::SetAVX2Enabled(false);
+    logic->UpdateGantryToFixedReferenceTransform(AngleDeg(iteration));
+    logic->GetVoxelCentersInFrame(vtkIECTransformLogic::Collimator, voxelGridSize, voxelCenters.data());
+    Sink = Sink + voxelCenters.back();
+    IEC::SetAVX2Enabled(true);
+  });
+
+  // Divergent projection of the same grid onto the isocenter plane of the beam's eye view
+  suite.Add("ProjectVoxelCentersToImagerPlane/64x256x256", [&](std::uint64_t iteration)
+  {
+    logic->UpdateImagerToFixedReferenceTransform(AngleDeg(iteration));
+    logic->ProjectVoxelCentersToImagerPlane(voxelGridSize, logic->GetSourceAxisDistance(), voxelCenters.data());
+    Sink = Sink + voxelCenters.back();
+  });
+
+  // DRR of a uniform volume on the same grid (per image, 256x256 detector pixels)
+  std::vector<float> volume(voxelCenters.size() / 3, 0.02f);
+  const std::array<uint16_t, 2> detectorSize = { 256, 256 };
+  const std::array<double, 2> pixelSpacing = { 1.6, 1.6 };
+  std::vector<float> radiograph(static_cast<std::size_t>(detectorSize[0]) * detectorSize[1]);
+  suite.Add("ComputeDigitallyReconstructedRadiograph/64x256x256/256x256", [&](std::uint64_t iteration)
+  {
+    logic->UpdateGantryToFixedReferenceTransform(AngleDeg(iteration));
+    logic->UpdateImagerToFixedReferenceTransform(AngleDeg(iteration));
+    logic->ComputeDigitallyReconstructedRadiograph(vtkIECTransformLogic::FlatPanel, volume.data(), voxelGridSize, detectorSize, pixelSpacing,
+      radiograph.data());
+    Sink = Sink + radiograph.back();
+  });
+
+  // Replay of a trajectory log file (per log, 100000 records of 4 float axis values)
+  const char* logFileName = "vtkIECTrajectoryLogReplayBenchmark.bin";
+  const vtkIdType numberOfLogRecords = 100000;
+  if (FILE* logFile = std::fopen(logFileName, "wb"))
+  {
+    for (vtkIdType record = 0; record < numberOfLogRecords; ++record)
+    {
+      const float values[4] = { static_cast<float>(AngleDeg(record)), static_cast<float>(AngleDeg(record / 10)),
+        static_cast<float>(AngleDeg(record / 100)), 0.0f };
+      std::fwrite(values, sizeof(values), 1, logFile);
+    }
+    std::fclose(logFile);
+
+    vtkSmartPointer<vtkIECTrajectoryLogReplay> replay = vtkSmartPointer<vtkIECTrajectoryLogReplay>::New();
+    replay->SetFileName(logFileName);
+    replay->SetRecordSize(4 * sizeof(float));
+    replay->SetAxisOffset(vtkIECTrajectoryLogReplay::GantryRotationAngle, 0);
+    replay->SetAxisOffset(vtkIECTrajectoryLogReplay::CollimatorRotationAngle, sizeof(float));
+    replay->SetAxisOffset(vtkIECTrajectoryLogReplay::PatientSupportRotationAngle, 2 * sizeof(float));
+    replay->SetLogic(logic);
+    suite.Add("vtkIECTrajectoryLogReplay/Replay/PatientToCollimator/100000", [&](std::uint64_t)
+    {
+      replay->Replay([](vtkIdType, vtkIdType numberOfRecords, const double* matrices)
+      {
+        Sink = Sink + matrices[16 * numberOfRecords - 1];
+        return true;
+      });
+    });
+    std::remove(logFileName);
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,91 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Gantry arcs of the VTK-free core: IEC::ArcIterator against the directly composed transforms, over many turns in small
+// steps, so that the drift of the rotation recurrence stays bounded.
+
+// IEC Logic includes
+#include "IECTransformCore.h"
+#include "IECTransformTestingUtilities.h"
+
+// STD includes
+#include <cstdlib>
+#include <string>
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+/// The arc iterator stays on the directly computed transforms over many turns in small steps
+bool TestArcIteratorDrift(IEC::MachineState state)
+{
+  const IEC::CoordinateSystemIdentifier fromFrame = IEC::PatientImageRegularGrid;
+  const IEC::CoordinateSystemIdentifier toFrame = IEC::Collimator;
+  const double gantryPitchAngleDeg = 2.5;
+
+  // Transform as a function of the gantry angle a: ConstantTerm + cos(a) * CosineTerm + sin(a) * SineTerm
+  IEC::Matrix4 matrices[3];
+  for (int i = 0; i < 3; ++i)
+  {
+    state.GetMatrix(IEC::Gantry, IEC::FixedReference) = IEC::GantryToFixedReferenceMatrix(90.0 * i, gantryPitchAngleDeg);
+    state.GetTransformBetween(fromFrame, toFrame, matrices[i]);
+  }
+  IEC::Matrix4 constantTerm;
+  IEC::Matrix4 cosineTerm;
+  IEC::Matrix4 sineTerm;
+  for (int i = 0; i < 16; ++i)
+  {
+    constantTerm[i] = 0.5 * (matrices[0][i] + matrices[2][i]);
+    cosineTerm[i] = 0.5 * (matrices[0][i] - matrices[2][i]);
+    sineTerm[i] = matrices[1][i] - constantTerm[i];
+  }
+
+  const double startAngleDeg = -180.0;
+  const double angleStepDeg = 0.1;
+  const std::size_t numberOfSteps = 36000; // 10 turns
+  bool success = true;
+  IEC::ArcIterator arc(constantTerm, cosineTerm, sineTerm, startAngleDeg, angleStepDeg);
+  for (; arc.GetStep() <= numberOfSteps; arc.Next())
+  {
+    if (arc.GetStep() % 97 != 0 && arc.GetStep() != numberOfSteps)
+    {
+      continue;
+    }
+    double matrix[16];
+    arc.GetMatrix(matrix);
+    IEC::Matrix4 expected;
+    state.GetMatrix(IEC::Gantry, IEC::FixedReference) = IEC::GantryToFixedReferenceMatrix(arc.GetAngleDeg(), gantryPitchAngleDeg);
+    state.GetTransformBetween(fromFrame, toFrame, expected);
+    if (!IECTesting::CheckMatrix(matrix, expected.data(), 1e-9, "ArcIterator step " + std::to_string(arc.GetStep())))
+    {
+      success = false;
+      break;
+    }
+  }
+  return success;
+}
+
+} // namespace
+
+//----------------------------------------------------------------------------
+int main()
+{
+  IEC::MachineState state;
+  IECTesting::SetNonTrivialMachineState(state);
+
+  bool success = TestArcIteratorDrift(state);
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,88 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Paths resolved at compile time in the VTK-free core: GetTransform<FromFrame, ToFrame> for all frame pairs against
+// the runtime path composition, and the compile-time path tables of the standard hierarchy.
+
+// IEC Logic includes
+#include "IECTransformCore.h"
+#include "IECTransformTestingUtilities.h"
+
+// STD includes
+#include <cstdlib>
+#include <string>
+#include <utility>
+
+namespace
+{
+
+// Path tables of a few frame pairs
+using GridToCollimatorPath = IEC::StandardPath<IEC::PatientImageRegularGrid, IEC::Collimator>;
+static_assert(GridToCollimatorPath::Ancestor == IEC::FixedReference, "PatientImageRegularGrid -> Collimator ancestor");
+static_assert(GridToCollimatorPath::NumberOfUpwardTransforms == 6 && GridToCollimatorPath::NumberOfDownwardTransforms == 2,
+  "PatientImageRegularGrid -> Collimator number of transforms");
+static_assert(GridToCollimatorPath::DownwardRigid, "Collimator -> FixedReference is rigid");
+static_assert(!IEC::StandardPath<IEC::Collimator, IEC::PatientImageRegularGrid>::DownwardRigid, "PatientImageRegularGrid -> DICOM is not rigid");
+using WedgeFilterToGantryPath = IEC::StandardPath<IEC::WedgeFilter, IEC::Gantry>;
+static_assert(WedgeFilterToGantryPath::Ancestor == IEC::Gantry && WedgeFilterToGantryPath::NumberOfUpwardTransforms == 2
+  && WedgeFilterToGantryPath::NumberOfDownwardTransforms == 0, "WedgeFilter -> Gantry stays below the gantry");
+
+//----------------------------------------------------------------------------
+std::string GetPairName(int fromFrame, int toFrame)
+{
+  return std::string(IEC::CoordinateSystemNames[fromFrame]) + " -> " + IEC::CoordinateSystemNames[toFrame];
+}
+
+//----------------------------------------------------------------------------
+/// GetTransform<FromFrame, ToFrame> gives the same matrix as the runtime path composition
+template <int FromFrame, int ToFrame>
+bool TestStandardPath(const IEC::MachineState& state)
+{
+  constexpr IEC::CoordinateSystemIdentifier fromFrame = static_cast<IEC::CoordinateSystemIdentifier>(FromFrame);
+  constexpr IEC::CoordinateSystemIdentifier toFrame = static_cast<IEC::CoordinateSystemIdentifier>(ToFrame);
+  IEC::Matrix4 matrix;
+  IEC::Matrix4 expected;
+  const std::string name = "GetTransform<> " + GetPairName(FromFrame, ToFrame);
+  if (!IECTesting::Check(state.GetTransform<fromFrame, toFrame>(matrix) && state.GetTransformBetween(fromFrame, toFrame, expected),
+    name + " succeeds"))
+  {
+    return false;
+  }
+  return IECTesting::CheckMatrix(matrix.data(), expected.data(), 1e-9, name);
+}
+
+//----------------------------------------------------------------------------
+template <std::size_t... PairIndex>
+bool TestStandardPaths(const IEC::MachineState& state, std::index_sequence<PairIndex...>)
+{
+  constexpr int numberOfFrames = IEC::LastIECCoordinateFrame;
+  bool success = true;
+  // Run all pairs, also after a failure
+  ((success &= TestStandardPath<static_cast<int>(PairIndex) / numberOfFrames, static_cast<int>(PairIndex) % numberOfFrames>(state)), ...);
+  return success;
+}
+
+} // namespace
+
+//----------------------------------------------------------------------------
+int main()
+{
+  IEC::MachineState state;
+  IECTesting::SetNonTrivialMachineState(state);
+
+  bool success = TestStandardPaths(state, std::make_index_sequence<IEC::LastIECCoordinateFrame * IEC::LastIECCoordinateFrame>());
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,186 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Digitally reconstructed radiographs of the VTK-free core: IEC::ComputeRegularGridDRR against a brute-force sum over
+// all voxels of the length of the ray inside each voxel, and the AVX2 ray set-up (when the CPU supports it) against the
+// portable code.
+
+// IEC Logic includes
+#include "IECTransformCore.h"
+#include "IECTransformTestingUtilities.h"
+
+// STD includes
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+const std::array<std::uint16_t, 3> GridElems = { 6, 7, 9 };
+const std::array<std::uint16_t, 2> DetectorSize = { 13, 70 };
+const std::array<double, 2> PixelSpacing = { 2.5, 0.5 };
+
+//----------------------------------------------------------------------------
+/// Parameter length of the ray start + alpha * direction, alpha >= 0, inside the box [lower, upper]
+double GetRayLengthInBox(const double start[3], const double direction[3], const double lower[3], const double upper[3])
+{
+  double alphaMin = 0.0;
+  double alphaMax = std::numeric_limits<double>::infinity();
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    if (direction[axis] == 0.0)
+    {
+      if (start[axis] < lower[axis] || start[axis] > upper[axis])
+      {
+        return 0.0;
+      }
+      continue;
+    }
+    const double alpha1 = (lower[axis] - start[axis]) / direction[axis];
+    const double alpha2 = (upper[axis] - start[axis]) / direction[axis];
+    alphaMin = std::max(alphaMin, std::min(alpha1, alpha2));
+    alphaMax = std::min(alphaMax, std::max(alpha1, alpha2));
+  }
+  return std::max(0.0, alphaMax - alphaMin);
+}
+
+//----------------------------------------------------------------------------
+/// Brute-force DRR: every ray is intersected with every voxel
+std::vector<double> ComputeReferenceDRR(const std::vector<double>& volume, const IEC::Matrix4& detectorToGrid, const double source[3])
+{
+  const double* m = detectorToGrid.data();
+  double start[3];
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    start[axis] = m[4 * axis] * source[0] + m[4 * axis + 1] * source[1] + m[4 * axis + 2] * source[2] + m[4 * axis + 3];
+  }
+
+  std::vector<double> image(static_cast<std::size_t>(DetectorSize[0]) * DetectorSize[1]);
+  for (std::size_t row = 0; row < DetectorSize[0]; ++row)
+  {
+    for (std::size_t column = 0; column < DetectorSize[1]; ++column)
+    {
+      // Ray from the source through the pixel center, in the detector frame and in grid index coordinates
+      const double delta[3] = { (column - 0.5 * (DetectorSize[1] - 1.0)) * PixelSpacing[1] - source[0],
+        (row - 0.5 * (DetectorSize[0] - 1.0)) * PixelSpacing[0] - source[1], -source[2] };
+      double direction[3];
+      for (int axis = 0; axis < 3; ++axis)
+      {
+        direction[axis] = m[4 * axis] * delta[0] + m[4 * axis + 1] * delta[1] + m[4 * axis + 2] * delta[2];
+      }
+
+      double sum = 0.0;
+      for (std::size_t slice = 0; slice < GridElems[0]; ++slice)
+      {
+        for (std::size_t gridRow = 0; gridRow < GridElems[1]; ++gridRow)
+        {
+          for (std::size_t gridColumn = 0; gridColumn < GridElems[2]; ++gridColumn)
+          {
+            // Grid index coordinates are (column, row, slice)
+            const double lower[3] = { gridColumn - 0.5, gridRow - 0.5, slice - 0.5 };
+            const double upper[3] = { gridColumn + 0.5, gridRow + 0.5, slice + 0.5 };
+            sum += GetRayLengthInBox(start, direction, lower, upper) * volume[(slice * GridElems[1] + gridRow) * GridElems[2] + gridColumn];
+          }
+        }
+      }
+      image[row * DetectorSize[1] + column] = std::sqrt(delta[0] * delta[0] + delta[1] * delta[1] + delta[2] * delta[2]) * sum;
+    }
+  }
+  return image;
+}
+
+//----------------------------------------------------------------------------
+bool TestDRR(const std::vector<double>& volume, const IEC::Matrix4& gridToDetector, const double source[3], const std::string& name)
+{
+  IEC::Matrix4 detectorToGrid;
+  IEC::Invert(gridToDetector, detectorToGrid);
+
+  std::vector<double> image(static_cast<std::size_t>(DetectorSize[0]) * DetectorSize[1]);
+  IEC::ComputeRegularGridDRR(volume.data(), GridElems, detectorToGrid, source, DetectorSize, PixelSpacing, 0, DetectorSize[0], image.data());
+  const std::vector<double> expected = ComputeReferenceDRR(volume, detectorToGrid, source);
+
+  bool success = true;
+  int numberOfHits = 0;
+  for (std::size_t i = 0; i < image.size(); ++i)
+  {
+    numberOfHits += (expected[i] > 0.0 ? 1 : 0);
+    if (!(std::fabs(image[i] - expected[i]) <= 1e-9 * (1.0 + expected[i])))
+    {
+      std::cerr << "Check failed: " << name << " pixel " << i << " is " << image[i] << " instead of " << expected[i] << std::endl;
+      success = false;
+    }
+  }
+  // The detector is larger than the shadow of the volume
+  success &= IECTesting::Check(numberOfHits > 0 && numberOfHits < static_cast<int>(image.size()), name + " has rays through and beside the volume");
+
+  if (IEC::CPUSupportsAVX2())
+  {
+    std::vector<double> portableImage(image.size());
+    std::vector<double> avx2Image(image.size());
+    IEC::SetAVX2Enabled(false);
+    IEC::ComputeRegularGridDRR(volume.data(), GridElems, detectorToGrid, source, DetectorSize, PixelSpacing, 0, DetectorSize[0], portableImage.data());
+    IEC::SetAVX2Enabled(true);
+    IEC::ComputeRegularGridDRR(volume.data(), GridElems, detectorToGrid, source, DetectorSize, PixelSpacing, 0, DetectorSize[0], avx2Image.data());
+    success &= IECTesting::Check(std::memcmp(avx2Image.data(), portableImage.data(), image.size() * sizeof(double)) == 0,
+      name + " with AVX2 matches the portable code");
+  }
+  return success;
+}
+
+} // namespace
+
+//----------------------------------------------------------------------------
+int main()
+{
+  std::vector<double> volume(static_cast<std::size_t>(GridElems[0]) * GridElems[1] * GridElems[2]);
+  for (std::size_t i = 0; i < volume.size(); ++i)
+  {
+    volume[i] = 0.1 * static_cast<double>(1 + (i * 7) % 11);
+  }
+
+  // Voxel spacing 2 x 1.5 x 3 mm (columns, rows, slices)
+  IEC::Matrix4 spacing = IEC::IdentityMatrix();
+  spacing[0] = 2.0;
+  spacing[5] = 1.5;
+  spacing[10] = 3.0;
+
+  bool success = true;
+
+  // Axis-aligned grid: the central detector column gives rays parallel to the grid slices
+  const IEC::Matrix4 alignedGridToDetector = IEC::Multiply(IEC::TranslationRotationXYZMatrix(-8.3, -4.1, 20.0, 1, 0, 1, 0, 1, 0), spacing);
+  const double alignedSource[3] = { 0.0, 0.0, 60.0 };
+  success &= TestDRR(volume, alignedGridToDetector, alignedSource, "Axis-aligned DRR");
+
+  // Oblique grid and source off the detector axis
+  const double angleX = IEC::DegreesToRadians(20.0);
+  const double angleY = IEC::DegreesToRadians(-35.0);
+  const double angleZ = IEC::DegreesToRadians(50.0);
+  const IEC::Matrix4 obliqueGridToDetector = IEC::Multiply(IEC::TranslationRotationXYZMatrix(-3.0, -6.0, 15.0, std::cos(angleX), std::sin(angleX),
+    std::cos(angleY), std::sin(angleY), std::cos(angleZ), std::sin(angleZ)), spacing);
+  const double obliqueSource[3] = { 4.0, -3.0, 70.0 };
+  success &= TestDRR(volume, obliqueGridToDetector, obliqueSource, "Oblique DRR");
+
+  IEC::SetAVX2Enabled(IEC::CPUSupportsAVX2());
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,170 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Grid index conversions of the VTK-free core: round-trips of the linear index conversions over odd, flat and large grid
+// shapes with 16-, 32- and 64-bit indices, the reporting of the first index out of range and of grids too large for
+// linear indices, and the AVX2 conversion (when the CPU supports it) against the portable code.
+
+// IEC Logic includes
+#include "IECTransformCore.h"
+#include "IECTransformTestingUtilities.h"
+
+// STD includes
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+/// Linear indices are the positions in C order, and converting them back gives the grid indices
+template <typename IndexType, typename ShapeType>
+bool TestLinearizedIndices(const std::array<ShapeType, 3>& shape)
+{
+  const std::array<IndexType, 3> nElems = { shape[0], shape[1], shape[2] };
+  const std::string name = IECTesting::GetShapeName(shape) + " (" + std::to_string(sizeof(IndexType) * 8) + "-bit)";
+  const std::vector<std::array<IndexType, 3>> vectorizedIndices = IECTesting::GetAllVectorizedIndices<IndexType>(shape);
+  const std::size_t numberOfIndices = vectorizedIndices.size();
+
+  std::vector<std::uint64_t> linearizedIndices(numberOfIndices);
+  if (!IECTesting::Check(IEC::VectorizedToLinearizedIndices(vectorizedIndices.data(), numberOfIndices, nElems, linearizedIndices.data()) == -1,
+    "VectorizedToLinearizedIndices " + name + " converts all indices"))
+  {
+    return false;
+  }
+  for (std::size_t i = 0; i < numberOfIndices; ++i)
+  {
+    if (linearizedIndices[i] != i)
+    {
+      return IECTesting::Check(false, "VectorizedToLinearizedIndices " + name + " position " + std::to_string(i));
+    }
+  }
+
+  std::vector<std::array<IndexType, 3>> roundTripIndices(numberOfIndices);
+  if (!IECTesting::Check(IEC::LinearizedToVectorizedIndices(linearizedIndices.data(), numberOfIndices, nElems, roundTripIndices.data()) == -1,
+    "LinearizedToVectorizedIndices " + name + " converts all indices"))
+  {
+    return false;
+  }
+  if (!IECTesting::Check(roundTripIndices == vectorizedIndices, "LinearizedToVectorizedIndices " + name + " round-trip"))
+  {
+    return false;
+  }
+
+  // The first index out of range is reported
+  if (numberOfIndices > 2)
+  {
+    const std::size_t badPosition = numberOfIndices / 2 + 1;
+    linearizedIndices[badPosition] = numberOfIndices;
+    if (!IECTesting::Check(IEC::LinearizedToVectorizedIndices(linearizedIndices.data(), numberOfIndices, nElems, roundTripIndices.data())
+      == static_cast<std::int64_t>(badPosition), "LinearizedToVectorizedIndices " + name + " reports the index out of range"))
+    {
+      return false;
+    }
+    std::array<IndexType, 3> badIndex = vectorizedIndices[badPosition];
+    badIndex[1] = nElems[1];
+    std::vector<std::array<IndexType, 3>> badIndices = vectorizedIndices;
+    badIndices[badPosition] = badIndex;
+    if (!IECTesting::Check(IEC::VectorizedToLinearizedIndices(badIndices.data(), numberOfIndices, nElems, linearizedIndices.data())
+      == static_cast<std::int64_t>(badPosition), "VectorizedToLinearizedIndices " + name + " reports the index out of range"))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+/// Grids whose number of elements does not fit in 64 bits cannot be addressed by linear indices, all indices are reported
+bool TestGridTooLarge()
+{
+  const std::array<std::uint64_t, 3> nElems = { std::uint64_t(1) << 32, std::uint64_t(1) << 32, 2 };
+  const std::array<std::uint64_t, 3> vectorizedIndex = { 0, 0, 1 };
+  const std::uint64_t linearizedIndex = 1;
+  std::uint64_t linearizedOutput = 0;
+  std::array<std::uint64_t, 3> vectorizedOutput = { 0, 0, 0 };
+  bool success = true;
+  success &= IECTesting::Check(IEC::VectorizedToLinearizedIndices(&vectorizedIndex, 1, nElems, &linearizedOutput) == 0,
+    "VectorizedToLinearizedIndices reports a grid of more than 2^64 elements");
+  success &= IECTesting::Check(IEC::LinearizedToVectorizedIndices(&linearizedIndex, 1, nElems, &vectorizedOutput) == 0,
+    "LinearizedToVectorizedIndices reports a grid of more than 2^64 elements");
+  return success;
+}
+
+//----------------------------------------------------------------------------
+/// The AVX2 index conversion gives the same results as the portable code, bit for bit
+bool TestAVX2Kernel()
+{
+  if (!IEC::CPUSupportsAVX2())
+  {
+    std::cout << "AVX2 not supported by the CPU or the build, kernel not compared" << std::endl;
+    return true;
+  }
+  bool success = true;
+
+  // Indices in random order, so that neighboring lanes differ in all dimensions
+  const std::array<std::uint16_t, 3> nElems = { 37, 251, 1021 };
+  const std::uint64_t numberOfElements = static_cast<std::uint64_t>(nElems[0]) * nElems[1] * nElems[2];
+  std::vector<std::uint64_t> linearizedIndices(100003);
+  std::uint64_t state = 12345;
+  for (std::uint64_t& linearizedIndex : linearizedIndices)
+  {
+    state = state * 6364136223846793005ull + 1442695040888963407ull;
+    linearizedIndex = (state >> 16) % numberOfElements;
+  }
+  linearizedIndices[0] = 0;
+  linearizedIndices[1] = numberOfElements - 1;
+  std::vector<std::array<std::uint16_t, 3>> portableIndices(linearizedIndices.size());
+  std::vector<std::array<std::uint16_t, 3>> avx2Indices(linearizedIndices.size());
+  IEC::SetAVX2Enabled(false);
+  success &= IECTesting::Check(IEC::LinearizedToVectorizedIndices(linearizedIndices.data(), linearizedIndices.size(), nElems, portableIndices.data()) == -1,
+    "Portable LinearizedToVectorizedIndices converts all indices");
+  IEC::SetAVX2Enabled(true);
+  success &= IECTesting::Check(IEC::LinearizedToVectorizedIndices(linearizedIndices.data(), linearizedIndices.size(), nElems, avx2Indices.data()) == -1,
+    "AVX2 LinearizedToVectorizedIndices converts all indices");
+  success &= IECTesting::Check(avx2Indices == portableIndices, "AVX2 LinearizedToVectorizedIndices matches the portable code");
+
+  IEC::SetAVX2Enabled(IEC::CPUSupportsAVX2());
+  return success;
+}
+
+} // namespace
+
+//----------------------------------------------------------------------------
+int main()
+{
+  bool success = true;
+  for (const std::array<std::uint16_t, 3>& nElems : IECTesting::GetGridShapes())
+  {
+    success &= TestLinearizedIndices<std::uint16_t>(nElems);
+    success &= TestLinearizedIndices<std::uint32_t>(nElems);
+    success &= TestLinearizedIndices<std::uint64_t>(nElems);
+  }
+  // Dimensions beyond 2^16, which need the wider index types
+  const std::vector<std::array<std::uint32_t, 3>> wideGridShapes = { { 2, 3, 70001 }, { 1, 65537, 2 }, { 100000, 1, 3 } };
+  for (const std::array<std::uint32_t, 3>& nElems : wideGridShapes)
+  {
+    success &= TestLinearizedIndices<std::uint32_t>(nElems);
+    success &= TestLinearizedIndices<std::uint64_t>(nElems);
+  }
+  success &= TestGridTooLarge();
+  success &= TestAVX2Kernel();
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
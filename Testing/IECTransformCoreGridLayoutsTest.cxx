@@ -0,0 +1,124 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Grid layouts of the VTK-free core: round-trips of the Morton and brick index conversions and of the whole grid
+// conversions over odd, flat and large grid shapes, the padding of the Morton layout, and the Morton bit order.
+
+// IEC Logic includes
+#include "IECTransformCore.h"
+#include "IECTransformTestingUtilities.h"
+
+// STD includes
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+/// Every voxel has its own position in the layout, and the position converts back to the voxel
+template <typename Layout>
+bool TestLayout(const Layout& layout, const std::array<std::uint16_t, 3>& nElems, const std::string& name)
+{
+  const std::vector<std::array<std::uint16_t, 3>> vectorizedIndices = IECTesting::GetAllVectorizedIndices<std::uint16_t>(nElems);
+  const std::uint64_t numberOfElements = layout.GetNumberOfElements();
+  if (!IECTesting::Check(numberOfElements >= vectorizedIndices.size(), name + " has room for all voxels"))
+  {
+    return false;
+  }
+
+  std::vector<bool> used(numberOfElements, false);
+  for (const std::array<std::uint16_t, 3>& vectorizedIndex : vectorizedIndices)
+  {
+    const std::uint64_t index = layout.GetIndex(vectorizedIndex);
+    if (index >= numberOfElements || used[index] || layout.GetVectorizedIndex(index) != vectorizedIndex)
+    {
+      return IECTesting::Check(false, name + " round-trip of voxel (" + std::to_string(vectorizedIndex[0]) + ","
+        + std::to_string(vectorizedIndex[1]) + "," + std::to_string(vectorizedIndex[2]) + ")");
+    }
+    used[index] = true;
+  }
+
+  // Whole grid conversion
+  std::vector<double> rowMajorValues(vectorizedIndices.size());
+  for (std::size_t i = 0; i < rowMajorValues.size(); ++i)
+  {
+    rowMajorValues[i] = static_cast<double>(i);
+  }
+  std::vector<double> layoutValues(numberOfElements, -1.0);
+  std::vector<double> roundTripValues(rowMajorValues.size(), -1.0);
+  IEC::ConvertRowMajorToLayout(layout, nElems, rowMajorValues.data(), layoutValues.data());
+  IEC::ConvertLayoutToRowMajor(layout, nElems, layoutValues.data(), roundTripValues.data());
+  return IECTesting::Check(roundTripValues == rowMajorValues, name + " whole grid round-trip");
+}
+
+//----------------------------------------------------------------------------
+bool TestLayouts(const std::array<std::uint16_t, 3>& nElems)
+{
+  const std::string name = IECTesting::GetShapeName(nElems);
+  bool success = true;
+
+  const IEC::MortonLayout mortonLayout(nElems);
+  success &= TestLayout(mortonLayout, nElems, "MortonLayout " + name);
+  // Blocks are as large as the smallest dimension allows, so the padding stays below a factor of two per axis
+  const std::uint16_t minElems = std::min(nElems[0], std::min(nElems[1], nElems[2]));
+  const unsigned int k = mortonLayout.GetBlockSizeExponent();
+  success &= IECTesting::Check((1u << k) <= minElems && minElems < (2u << k), "MortonLayout " + name + " block size");
+  success &= IECTesting::Check(mortonLayout.GetNumberOfElements() < 8 * static_cast<std::uint64_t>(nElems[0]) * nElems[1] * nElems[2],
+    "MortonLayout " + name + " padding");
+
+  for (unsigned int brickSizeExponent = 0; brickSizeExponent <= 3; ++brickSizeExponent)
+  {
+    success &= TestLayout(IEC::BrickLayout(nElems, brickSizeExponent), nElems, "BrickLayout(" + std::to_string(brickSizeExponent) + ") " + name);
+  }
+  return success;
+}
+
+//----------------------------------------------------------------------------
+bool TestMortonCodes()
+{
+  for (std::uint32_t value = 0; value <= 0xffff; value += 7)
+  {
+    const std::array<std::uint16_t, 3> vectorizedIndex = { static_cast<std::uint16_t>(value), static_cast<std::uint16_t>(0xffff - value),
+      static_cast<std::uint16_t>(value * 31) };
+    if (!IECTesting::Check(IEC::MortonLayout::Decode(IEC::MortonLayout::Encode(vectorizedIndex)) == vectorizedIndex,
+      "Morton code round-trip of " + std::to_string(value)))
+    {
+      return false;
+    }
+  }
+  // Bit interleaving order: e2 gets the lowest bit
+  return IECTesting::Check(IEC::MortonLayout::Encode({ 1, 0, 0 }) == 4 && IEC::MortonLayout::Encode({ 0, 1, 0 }) == 2
+    && IEC::MortonLayout::Encode({ 0, 0, 1 }) == 1 && IEC::MortonLayout::Encode({ 0, 0, 2 }) == 8, "Morton code bit order");
+}
+
+} // namespace
+
+//----------------------------------------------------------------------------
+int main()
+{
+  bool success = true;
+  for (const std::array<std::uint16_t, 3>& nElems : IECTesting::GetGridShapes())
+  {
+    success &= TestLayouts(nElems);
+  }
+  success &= TestMortonCodes();
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
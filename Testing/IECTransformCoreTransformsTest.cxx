@@ -0,0 +1,95 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Transforms of the VTK-free core: path composition between all frame pairs against a composition of the elementary
+// transforms up to the root.
+
+// IEC Logic includes
+#include "IECTransformCore.h"
+#include "IECTransformTestingUtilities.h"
+
+// STD includes
+#include <cstdlib>
+#include <string>
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+/// Reference transform frame -> FixedReference, multiplying the elementary transforms one by one up to the root
+IEC::Matrix4 GetReferenceTransformToRoot(const IEC::MachineState& state, int frame)
+{
+  IEC::Matrix4 matrix = IEC::IdentityMatrix();
+  while (frame != IEC::FixedReference)
+  {
+    const int parent = IEC::StandardHierarchy::GetParent(frame);
+    matrix = IEC::Multiply(state.GetMatrix(static_cast<IEC::CoordinateSystemIdentifier>(frame),
+      static_cast<IEC::CoordinateSystemIdentifier>(parent)), matrix);
+    frame = parent;
+  }
+  return matrix;
+}
+
+//----------------------------------------------------------------------------
+/// Reference transform fromFrame -> toFrame through the root, with a general matrix inversion
+IEC::Matrix4 GetReferenceTransform(const IEC::MachineState& state, int fromFrame, int toFrame)
+{
+  IEC::Matrix4 rootToToFrame;
+  IEC::Invert(GetReferenceTransformToRoot(state, toFrame), rootToToFrame);
+  return IEC::Multiply(rootToToFrame, GetReferenceTransformToRoot(state, fromFrame));
+}
+
+//----------------------------------------------------------------------------
+std::string GetPairName(int fromFrame, int toFrame)
+{
+  return std::string(IEC::CoordinateSystemNames[fromFrame]) + " -> " + IEC::CoordinateSystemNames[toFrame];
+}
+
+//----------------------------------------------------------------------------
+bool TestTransformBetweenAllFrames(const IEC::MachineState& state)
+{
+  bool success = true;
+  for (int fromFrame = 0; fromFrame < IEC::LastIECCoordinateFrame; ++fromFrame)
+  {
+    for (int toFrame = 0; toFrame < IEC::LastIECCoordinateFrame; ++toFrame)
+    {
+      IEC::Matrix4 matrix;
+      const std::string name = "GetTransformBetween " + GetPairName(fromFrame, toFrame);
+      if (!IECTesting::Check(state.GetTransformBetween(static_cast<IEC::CoordinateSystemIdentifier>(fromFrame),
+        static_cast<IEC::CoordinateSystemIdentifier>(toFrame), matrix), name + " succeeds"))
+      {
+        success = false;
+        continue;
+      }
+      const IEC::Matrix4 expected = GetReferenceTransform(state, fromFrame, toFrame);
+      success &= IECTesting::CheckMatrix(matrix.data(), expected.data(), 1e-9, name);
+    }
+  }
+  return success;
+}
+
+} // namespace
+
+//----------------------------------------------------------------------------
+int main()
+{
+  IEC::MachineState state;
+  IECTesting::SetNonTrivialMachineState(state);
+
+  bool success = true;
+  success &= TestTransformBetweenAllFrames(state);
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
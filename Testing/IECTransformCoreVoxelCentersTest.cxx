@@ -0,0 +1,132 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Voxel centers of a regular grid in the VTK-free core: IEC::TransformRegularGridPoints against the grid index ->
+// frame matrix applied to every voxel, for ranges of slices, and the AVX2 row kernel (when the CPU supports it)
+// against the portable code.
+
+// IEC Logic includes
+#include "IECTransformCore.h"
+#include "IECTransformTestingUtilities.h"
+
+// STD includes
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+/// Every written point is the matrix applied to (column, row, slice), and the slices outside the range are not written
+template <typename PointType>
+bool TestVoxelCenters(const IEC::Matrix4& gridToFrame, const std::array<std::uint16_t, 3>& nElems, std::size_t beginSlice, std::size_t endSlice,
+  double tolerance, const std::string& name)
+{
+  const std::size_t sliceSize = 3 * static_cast<std::size_t>(nElems[1]) * nElems[2];
+  std::vector<PointType> points(sliceSize * nElems[0], PointType(-12345));
+  IEC::TransformRegularGridPoints(gridToFrame, nElems, beginSlice, endSlice, points.data());
+
+  const double* m = gridToFrame.data();
+  for (std::size_t slice = 0; slice < nElems[0]; ++slice)
+  {
+    for (std::size_t row = 0; row < nElems[1]; ++row)
+    {
+      for (std::size_t column = 0; column < nElems[2]; ++column)
+      {
+        const PointType* point = points.data() + slice * sliceSize + 3 * (row * nElems[2] + column);
+        const std::string voxelName = name + " voxel (" + std::to_string(slice) + "," + std::to_string(row) + "," + std::to_string(column) + ")";
+        if (slice < beginSlice || slice >= endSlice)
+        {
+          if (!IECTesting::Check(point[0] == PointType(-12345) && point[1] == PointType(-12345) && point[2] == PointType(-12345),
+            voxelName + " is not written"))
+          {
+            return false;
+          }
+          continue;
+        }
+        for (int i = 0; i < 3; ++i)
+        {
+          const double expected = m[4 * i] * column + m[4 * i + 1] * row + m[4 * i + 2] * slice + m[4 * i + 3];
+          if (!IECTesting::Check(std::fabs(point[i] - expected) <= tolerance * (1.0 + std::fabs(expected)),
+            voxelName + " coordinate " + std::to_string(i) + " is " + std::to_string(point[i]) + " instead of " + std::to_string(expected)))
+          {
+            return false;
+          }
+        }
+      }
+    }
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+/// The AVX2 row kernel gives the same results as the portable code, bit for bit
+bool TestAVX2Kernel(const IEC::Matrix4& gridToFrame)
+{
+  if (!IEC::CPUSupportsAVX2())
+  {
+    std::cout << "AVX2 not supported by the CPU or the build, kernel not compared" << std::endl;
+    return true;
+  }
+
+  // Row lengths that are not a multiple of the vector width
+  const std::array<std::uint16_t, 3> gridElems = { 3, 5, 23 };
+  const std::size_t numberOfCoordinates = 3 * static_cast<std::size_t>(gridElems[0]) * gridElems[1] * gridElems[2];
+  std::vector<double> portablePoints(numberOfCoordinates);
+  std::vector<double> avx2Points(numberOfCoordinates);
+  std::vector<float> portableFloatPoints(numberOfCoordinates);
+  std::vector<float> avx2FloatPoints(numberOfCoordinates);
+  IEC::SetAVX2Enabled(false);
+  IEC::TransformRegularGridPoints(gridToFrame, gridElems, 0, gridElems[0], portablePoints.data());
+  IEC::TransformRegularGridPoints(gridToFrame, gridElems, 0, gridElems[0], portableFloatPoints.data());
+  IEC::SetAVX2Enabled(true);
+  IEC::TransformRegularGridPoints(gridToFrame, gridElems, 0, gridElems[0], avx2Points.data());
+  IEC::TransformRegularGridPoints(gridToFrame, gridElems, 0, gridElems[0], avx2FloatPoints.data());
+  IEC::SetAVX2Enabled(IEC::CPUSupportsAVX2());
+
+  bool success = true;
+  success &= IECTesting::Check(std::memcmp(avx2Points.data(), portablePoints.data(), numberOfCoordinates * sizeof(double)) == 0,
+    "AVX2 TransformRegularGridPoints matches the portable code");
+  success &= IECTesting::Check(std::memcmp(avx2FloatPoints.data(), portableFloatPoints.data(), numberOfCoordinates * sizeof(float)) == 0,
+    "AVX2 TransformRegularGridPoints (float) matches the portable code");
+  return success;
+}
+
+} // namespace
+
+//----------------------------------------------------------------------------
+int main()
+{
+  IEC::MachineState state;
+  IECTesting::SetNonTrivialMachineState(state);
+  IEC::Matrix4 gridToCollimator;
+  state.GetTransformBetween(IEC::PatientImageRegularGrid, IEC::Collimator, gridToCollimator);
+
+  bool success = true;
+  const std::array<std::uint16_t, 3> nElems = { 4, 6, 37 };
+  success &= TestVoxelCenters<double>(gridToCollimator, nElems, 0, nElems[0], 1e-12, "TransformRegularGridPoints");
+  success &= TestVoxelCenters<double>(gridToCollimator, nElems, 1, 3, 1e-12, "TransformRegularGridPoints slices 1-2");
+  success &= TestVoxelCenters<float>(gridToCollimator, nElems, 0, nElems[0], 1e-6, "TransformRegularGridPoints (float)");
+  success &= TestVoxelCenters<double>(gridToCollimator, { 1, 1, 1 }, 0, 1, 1e-12, "TransformRegularGridPoints single voxel");
+  success &= TestAVX2Kernel(gridToCollimator);
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
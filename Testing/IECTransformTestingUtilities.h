@@ -0,0 +1,135 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+#ifndef __IECTransformTestingUtilities_h
+#define __IECTransformTestingUtilities_h
+
+// IEC Logic includes
+#include "IECTransformCore.h"
+
+// STD includes
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/// @brief Helpers shared by the tests: comparisons that report the first mismatch on std::cerr
+namespace IECTesting
+{
+
+/// @brief Check a condition, report the description if it does not hold
+inline bool Check(bool condition, const std::string& description)
+{
+  if (!condition)
+  {
+    std::cerr << "Check failed: " << description << std::endl;
+  }
+  return condition;
+}
+
+/// @brief Compare two row-major 4x4 matrices element by element
+/// @param tolerance Largest allowed absolute difference of an element
+inline bool CheckMatrix(const double actual[16], const double expected[16], double tolerance, const std::string& description)
+{
+  for (int i = 0; i < 16; ++i)
+  {
+    // Written so that NaN elements fail
+    if (!(std::fabs(actual[i] - expected[i]) <= tolerance))
+    {
+      std::cerr << "Check failed: " << description << ", element " << i << " is " << actual[i] << " instead of " << expected[i] << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+/// @brief Set all elementary transforms of a machine state to non-trivial values, so that every frame pair gives a different matrix
+inline void SetNonTrivialMachineState(IEC::MachineState& state)
+{
+  state.GetMatrix(IEC::Gantry, IEC::FixedReference) = IEC::GantryToFixedReferenceMatrix(37.0, 2.5);
+  state.GetMatrix(IEC::Collimator, IEC::Gantry) = IEC::CollimatorToGantryMatrix(-12.0, 3.0);
+  state.GetMatrix(IEC::WedgeFilter, IEC::Collimator) = IEC::WedgeFilterToCollimatorMatrix(90.0, -1.5);
+  state.GetMatrix(IEC::PatientSupportRotation, IEC::FixedReference) = IEC::PatientSupportRotationToFixedReferenceMatrix(15.0);
+  state.GetMatrix(IEC::TableTopEccentricRotation, IEC::PatientSupportRotation) = IEC::TableTopEccentricRotationToPatientSupportRotationMatrix(-7.0, 120.0);
+  state.GetMatrix(IEC::TableTop, IEC::TableTopEccentricRotation) = IEC::TableTopToTableTopEccentricRotationMatrix(10.0, -250.0, 80.0, 1.5, -2.0);
+  state.GetMatrix(IEC::Patient, IEC::TableTop) = IEC::PatientToTableTopMatrix(5.0, 40.0, -12.0, 3.0, -1.0, 180.0);
+  state.GetMatrix(IEC::PatientImageRegularGrid, IEC::DICOM) = IEC::PatientImageRegularGridToDICOMMatrix(0.9, 1.1, 2.5, -200.0, -180.0, -95.0);
+  state.GetMatrix(IEC::Imager, IEC::FixedReference) = IEC::ImagerToFixedReferenceMatrix(127.0, -1.0);
+  state.GetMatrix(IEC::Focus, IEC::Imager) = IEC::FocusToImagerMatrix(1100.0);
+  state.GetMatrix(IEC::LeftImagingPanel, IEC::Gantry) = IEC::TranslationRotationXYZMatrix(-500.0, 0.0, 20.0, 1, 0, 0, 1, 1, 0);
+  state.GetMatrix(IEC::RightImagingPanel, IEC::Gantry) = IEC::TranslationRotationXYZMatrix(500.0, 0.0, 20.0, 1, 0, 0, -1, 1, 0);
+  state.GetMatrix(IEC::FlatPanel, IEC::Gantry) = IEC::TranslationRotationXYZMatrix(0.0, 0.0, -400.0, 1, 0, 1, 0, 1, 0);
+  IEC::Matrix4& patientSupport = state.GetMatrix(IEC::PatientSupport, IEC::PatientSupportRotation);
+  patientSupport[0] = 1.5; // Scaling component
+}
+
+/// @brief Set the elementary transforms of a vtkIECTransformLogic through its Update methods, with the parameters of
+/// \sa SetNonTrivialMachineState. A template, so that the core tests do not depend on VTK.
+template <typename Logic>
+void UpdateNonTrivialTransforms(Logic* logic)
+{
+  logic->UpdateGantryToFixedReferenceTransform(37.0, 2.5);
+  logic->UpdateCollimatorToGantryTransform(-12.0, 3.0);
+  logic->UpdateWedgeFilterToCollimatorTransform(90.0, -1.5);
+  logic->UpdatePatientSupportRotationToFixedReferenceTransform(15.0);
+  logic->UpdateTableTopEccentricRotationToPatientSupportRotationTransform(-7.0, 120.0);
+  logic->UpdateTableTopToTableTopEccentricRotationTransform(10.0, -250.0, 80.0, 1.5, -2.0);
+  logic->UpdatePatientToTableTopTransform(5.0, 40.0, -12.0, 3.0, -1.0, 180.0);
+  logic->UpdatePatientImageRegularGridToDICOMTransform(0.9, 1.1, 2.5, -200.0, -180.0, -95.0);
+  logic->UpdateImagerToFixedReferenceTransform(127.0, -1.0);
+  logic->UpdateFocusToImagerTransform(1100.0);
+}
+
+/// @brief Grid shapes (slices, rows, columns): odd sizes, flat grids, powers of two and dimensions beyond 2^15
+inline const std::vector<std::array<std::uint16_t, 3>>& GetGridShapes()
+{
+  static const std::vector<std::array<std::uint16_t, 3>> gridShapes = {
+    { 1, 1, 1 }, { 5, 7, 9 }, { 3, 130, 17 }, { 16, 16, 16 }, { 512, 512, 1 }, { 1, 64, 1000 }, { 2, 3, 40000 }, { 40000, 2, 3 }
+  };
+  return gridShapes;
+}
+
+/// @brief Grid shape as slices x rows x columns
+template <typename ShapeType>
+std::string GetShapeName(const std::array<ShapeType, 3>& nElems)
+{
+  return std::to_string(nElems[0]) + "x" + std::to_string(nElems[1]) + "x" + std::to_string(nElems[2]);
+}
+
+/// @brief All indices of the grid in C order
+template <typename IndexType, typename ShapeType>
+std::vector<std::array<IndexType, 3>> GetAllVectorizedIndices(const std::array<ShapeType, 3>& nElems)
+{
+  std::vector<std::array<IndexType, 3>> vectorizedIndices;
+  vectorizedIndices.reserve(static_cast<std::size_t>(nElems[0]) * nElems[1] * nElems[2]);
+  for (IndexType e0 = 0; e0 < nElems[0]; ++e0)
+  {
+    for (IndexType e1 = 0; e1 < nElems[1]; ++e1)
+    {
+      for (IndexType e2 = 0; e2 < nElems[2]; ++e2)
+      {
+        vectorizedIndices.push_back({ e0, e1, e2 });
+      }
+    }
+  }
+  return vectorizedIndices;
+}
+
+} // namespace IECTesting
+
+#endif
@@ -0,0 +1,216 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Replay of a small synthetic trajectory log through vtkIECTrajectoryLogReplay, against the Update calls of the logic
+// with the same axis values, and the rejection of record layouts changed after Open.
+
+// IEC Logic includes
+#include "vtkIECTrajectoryLogReplay.h"
+#include "vtkIECTransformLogic.h"
+#include "IECTransformTestingUtilities.h"
+
+// VTK includes
+#include <vtkNew.h>
+#include <vtkSmartPointer.h>
+#include <vtkType.h>
+
+// STD includes
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+/// Written into the working directory of the test
+const char* LogFileName = "vtkIECTrajectoryLogReplayTest.log";
+
+const vtkIdType HeaderSize = 12;
+const vtkIdType RecordSize = 28; // 2 bytes of other data, 6 floats, 2 bytes of other data
+const vtkIdType NumberOfRecords = 2500;
+const int NumberOfLoggedAxes = vtkIECTrajectoryLogReplay::NumberOfAxes;
+
+//----------------------------------------------------------------------------
+/// Value of an axis in a record, exactly representable as float
+float GetAxisValue(vtkIdType record, int axis)
+{
+  switch (axis)
+  {
+    case vtkIECTrajectoryLogReplay::GantryRotationAngle: return 0.25f * static_cast<float>(record % 1440);
+    case vtkIECTrajectoryLogReplay::CollimatorRotationAngle: return 0.5f * static_cast<float>(record % 90) - 20.0f;
+    case vtkIECTrajectoryLogReplay::PatientSupportRotationAngle: return 0.125f * static_cast<float>(record % 80);
+    case vtkIECTrajectoryLogReplay::TableTopX: return 0.0625f * static_cast<float>(record % 100);
+    case vtkIECTrajectoryLogReplay::TableTopY: return -250.0f + 0.5f * static_cast<float>(record % 7);
+    default: return 80.0f - 0.25f * static_cast<float>(record % 13);
+  }
+}
+
+//----------------------------------------------------------------------------
+vtkIdType GetAxisOffset(int axis)
+{
+  return 2 + 4 * axis;
+}
+
+//----------------------------------------------------------------------------
+/// Header, all records, and an incomplete record at the end
+bool WriteLog()
+{
+  FILE* file = std::fopen(LogFileName, "wb");
+  if (!file)
+  {
+    return false;
+  }
+  std::vector<unsigned char> bytes(HeaderSize, 0xab);
+  for (vtkIdType record = 0; record < NumberOfRecords; ++record)
+  {
+    unsigned char recordBytes[RecordSize] = { 0 };
+    for (int axis = 0; axis < NumberOfLoggedAxes; ++axis)
+    {
+      const float value = GetAxisValue(record, axis);
+      std::memcpy(recordBytes + GetAxisOffset(axis), &value, sizeof(float));
+    }
+    bytes.insert(bytes.end(), recordBytes, recordBytes + RecordSize);
+  }
+  bytes.insert(bytes.end(), RecordSize / 2, 0xcd);
+  const bool success = (std::fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size());
+  return (std::fclose(file) == 0 && success);
+}
+
+//----------------------------------------------------------------------------
+/// Transform of a record with the Update calls of the logic
+void GetExpectedTransform(vtkIECTransformLogic* logic, vtkIdType record, double outputMatrix[16])
+{
+  const IEC::MachineParameters& parameters = logic->GetMachineState();
+  logic->UpdateGantryToFixedReferenceTransform(GetAxisValue(record, vtkIECTrajectoryLogReplay::GantryRotationAngle),
+    parameters.Gantry.PitchAngleDeg);
+  logic->UpdateCollimatorToGantryTransform(GetAxisValue(record, vtkIECTrajectoryLogReplay::CollimatorRotationAngle), parameters.Collimator.Bz);
+  logic->UpdatePatientSupportRotationToFixedReferenceTransform(GetAxisValue(record, vtkIECTrajectoryLogReplay::PatientSupportRotationAngle));
+  logic->UpdateTableTopToTableTopEccentricRotationTransform(GetAxisValue(record, vtkIECTrajectoryLogReplay::TableTopX),
+    GetAxisValue(record, vtkIECTrajectoryLogReplay::TableTopY), GetAxisValue(record, vtkIECTrajectoryLogReplay::TableTopZ),
+    parameters.TableTop.PitchAngleDeg, parameters.TableTop.RollAngleDeg);
+  logic->GetTransformBetween(vtkIECTransformLogic::Patient, vtkIECTransformLogic::Collimator, outputMatrix);
+}
+
+//----------------------------------------------------------------------------
+bool TestReplay(vtkIECTrajectoryLogReplay* replay, vtkIECTransformLogic* logic)
+{
+  if (!IECTesting::Check(replay->Open(), "Open succeeds")
+    || !IECTesting::Check(replay->GetNumberOfRecords() == NumberOfRecords, "The incomplete record at the end is not counted"))
+  {
+    return false;
+  }
+
+  vtkSmartPointer<vtkIECTransformLogic> updatedLogic = vtkSmartPointer<vtkIECTransformLogic>::Take(logic->Clone());
+  bool success = true;
+  vtkIdType nextRecord = 0;
+  const bool replayed = replay->Replay([&](vtkIdType firstRecord, vtkIdType numberOfRecords, const double* matrices)
+  {
+    success &= IECTesting::Check(firstRecord == nextRecord && numberOfRecords > 0, "Chunks are in order");
+    for (vtkIdType i = 0; i < numberOfRecords; ++i)
+    {
+      double expected[16];
+      GetExpectedTransform(updatedLogic, firstRecord + i, expected);
+      if (!IECTesting::CheckMatrix(matrices + 16 * i, expected, 1e-9, "Replay record " + std::to_string(firstRecord + i)))
+      {
+        success = false;
+        return false;
+      }
+    }
+    nextRecord = firstRecord + numberOfRecords;
+    return true;
+  });
+  success &= IECTesting::Check(replayed, "Replay succeeds");
+  success &= IECTesting::Check(nextRecord == NumberOfRecords, "Replay covers all records");
+
+  // Range of records crossing a chunk boundary
+  const vtkIdType firstRecord = 990;
+  const vtkIdType numberOfRecords = 25;
+  std::vector<double> matrices(16 * numberOfRecords);
+  success &= IECTesting::Check(replay->ReadRecords(firstRecord, numberOfRecords, matrices.data()), "ReadRecords succeeds");
+  for (vtkIdType i = 0; i < numberOfRecords; ++i)
+  {
+    double expected[16];
+    GetExpectedTransform(updatedLogic, firstRecord + i, expected);
+    success &= IECTesting::CheckMatrix(matrices.data() + 16 * i, expected, 1e-9, "ReadRecords record " + std::to_string(firstRecord + i));
+  }
+  success &= IECTesting::Check(!replay->ReadRecords(NumberOfRecords - 5, 10, matrices.data()), "ReadRecords rejects records past the end");
+  return success;
+}
+
+//----------------------------------------------------------------------------
+/// A layout changed after Open would read past the mapped records, so it is rejected until it is valid again
+bool TestLayoutChangedAfterOpen(vtkIECTrajectoryLogReplay* replay)
+{
+  std::vector<double> matrices(16 * 10);
+  const vtkIECTrajectoryLogReplay::ChunkCallback callback = [](vtkIdType, vtkIdType, const double*) { return true; };
+  bool success = true;
+
+  replay->SetRecordSize(8);
+  success &= IECTesting::Check(!replay->ReadRecords(0, 10, matrices.data()), "ReadRecords rejects a record size changed after Open");
+  success &= IECTesting::Check(!replay->Replay(callback), "Replay rejects a record size changed after Open");
+  replay->SetRecordSize(2 * RecordSize);
+  success &= IECTesting::Check(replay->GetNumberOfRecords() == NumberOfRecords / 2
+    && !replay->ReadRecords(NumberOfRecords - 10, 10, matrices.data()), "ReadRecords stays within the mapped log after a record size change");
+  replay->SetRecordSize(RecordSize);
+
+  replay->SetAxisOffset(vtkIECTrajectoryLogReplay::TableTopZ, RecordSize - 2);
+  success &= IECTesting::Check(!replay->ReadRecords(0, 10, matrices.data()), "ReadRecords rejects an axis offset past the record");
+  success &= IECTesting::Check(!replay->Replay(callback), "Replay rejects an axis offset past the record");
+  replay->SetAxisOffset(vtkIECTrajectoryLogReplay::TableTopZ, GetAxisOffset(vtkIECTrajectoryLogReplay::TableTopZ));
+
+  replay->SetScalarType(VTK_DOUBLE);
+  success &= IECTesting::Check(!replay->ReadRecords(0, 10, matrices.data()), "ReadRecords rejects a scalar type that does not fit the record");
+  replay->SetScalarType(VTK_FLOAT);
+
+  success &= IECTesting::Check(replay->ReadRecords(0, 10, matrices.data()) && replay->Replay(callback), "The restored layout is accepted");
+  return success;
+}
+
+} // namespace
+
+//----------------------------------------------------------------------------
+int main()
+{
+  if (!IECTesting::Check(WriteLog(), "Writing the log succeeds"))
+  {
+    return EXIT_FAILURE;
+  }
+
+  vtkNew<vtkIECTransformLogic> logic;
+  IECTesting::UpdateNonTrivialTransforms(logic.GetPointer());
+
+  vtkNew<vtkIECTrajectoryLogReplay> replay;
+  replay->SetFileName(LogFileName);
+  replay->SetHeaderSize(HeaderSize);
+  replay->SetRecordSize(RecordSize);
+  replay->SetScalarType(VTK_FLOAT);
+  for (int axis = 0; axis < NumberOfLoggedAxes; ++axis)
+  {
+    replay->SetAxisOffset(axis, GetAxisOffset(axis));
+  }
+  replay->SetChunkSize(1000);
+  replay->SetLogic(logic);
+
+  bool success = true;
+  success &= TestReplay(replay, logic);
+  success &= TestLayoutChangedAfterOpen(replay);
+
+  replay->Close();
+  std::remove(LogFileName);
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,127 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Buffer sizes of the batch methods of vtkIECTransformLogic that take arrays without copying: buffers one value too
+// small for the number of items (also when the number of values would overflow) are rejected without writing the
+// output, buffers of exactly the needed size are accepted, and TransformPointsBetween works in place.
+
+// IEC Logic includes
+#include "vtkIECTransformLogic.h"
+#include "IECTransformTestingUtilities.h"
+
+// VTK includes
+#include <vtkNew.h>
+
+// STD includes
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+const vtkIdType NumberOfItems = 5;
+const double Untouched = -12345.0;
+
+/// Call of a batch method with the number of items and the sizes of the input and output buffers
+typedef std::function<bool(vtkIdType numberOfItems, vtkIdType inputSize, vtkIdType outputSize)> BatchCall;
+
+//----------------------------------------------------------------------------
+/// The call succeeds with buffers of exactly the needed size, and fails without touching the output if either buffer
+/// is one value short or the number of items is so large that the number of values overflows
+bool TestBufferSizes(const BatchCall& call, vtkIdType inputSize, vtkIdType outputSize, std::vector<double>& output, const std::string& name)
+{
+  bool success = true;
+  const vtkIdType hugeNumberOfItems = std::numeric_limits<vtkIdType>::max() / 2;
+
+  std::fill(output.begin(), output.end(), Untouched);
+  success &= IECTesting::Check(!call(hugeNumberOfItems, inputSize, outputSize), name + " rejects a number of items that overflows the buffers");
+  if (inputSize > 0)
+  {
+    success &= IECTesting::Check(!call(NumberOfItems, inputSize - 1, outputSize), name + " rejects a too small input buffer");
+  }
+  success &= IECTesting::Check(!call(NumberOfItems, inputSize, outputSize - 1), name + " rejects a too small output buffer");
+  success &= IECTesting::Check(!call(NumberOfItems, -1, -1), name + " rejects negative buffer sizes");
+  success &= IECTesting::Check(std::all_of(output.begin(), output.end(), [](double value) { return value == Untouched; }),
+    name + " does not write the output of rejected calls");
+
+  success &= IECTesting::Check(call(NumberOfItems, inputSize, outputSize), name + " accepts buffers of the needed size");
+  success &= IECTesting::Check(std::none_of(output.begin(), output.end(), [](double value) { return value == Untouched; }),
+    name + " writes the whole output");
+  success &= IECTesting::Check(call(0, 0, 0), name + " accepts empty buffers for no items");
+  return success;
+}
+
+} // namespace
+
+//----------------------------------------------------------------------------
+int main()
+{
+  vtkNew<vtkIECTransformLogic> logic;
+  IECTesting::UpdateNonTrivialTransforms(logic.GetPointer());
+
+  std::vector<double> points(3 * NumberOfItems);
+  for (std::size_t i = 0; i < points.size(); ++i)
+  {
+    points[i] = 10.0 * static_cast<double>(i) - 50.0;
+  }
+  std::vector<double> parameters(6 * NumberOfItems);
+  for (std::size_t i = 0; i < parameters.size(); ++i)
+  {
+    parameters[i] = static_cast<double>(i);
+  }
+  std::vector<double> outputPoints(points.size());
+  std::vector<double> outputMatrices(16 * NumberOfItems);
+  const vtkIdType pointsSize = static_cast<vtkIdType>(points.size());
+  const vtkIdType matricesSize = static_cast<vtkIdType>(outputMatrices.size());
+
+  bool success = true;
+  success &= TestBufferSizes([&](vtkIdType numberOfItems, vtkIdType inputSize, vtkIdType outputSize)
+  {
+    return logic->GetTransformsForMachineParameters(vtkIECTransformLogic::RAS, vtkIECTransformLogic::Collimator, numberOfItems, 6,
+      parameters.data(), inputSize, outputMatrices.data(), outputSize);
+  }, static_cast<vtkIdType>(parameters.size()), matricesSize, outputMatrices, "GetTransformsForMachineParameters");
+
+  success &= TestBufferSizes([&](vtkIdType numberOfItems, vtkIdType, vtkIdType outputSize)
+  {
+    return logic->GetTransformsAlongGantryArc(vtkIECTransformLogic::RAS, vtkIECTransformLogic::Collimator, 10.0, 1.0, numberOfItems,
+      outputMatrices.data(), outputSize);
+  }, 0, matricesSize, outputMatrices, "GetTransformsAlongGantryArc");
+
+  success &= TestBufferSizes([&](vtkIdType numberOfItems, vtkIdType inputSize, vtkIdType outputSize)
+  {
+    return logic->TransformPointsBetween(vtkIECTransformLogic::RAS, vtkIECTransformLogic::Collimator, numberOfItems, points.data(), inputSize,
+      outputPoints.data(), outputSize);
+  }, pointsSize, pointsSize, outputPoints, "TransformPointsBetween");
+
+  success &= TestBufferSizes([&](vtkIdType numberOfItems, vtkIdType inputSize, vtkIdType outputSize)
+  {
+    return logic->ProjectPointsToImagerPlane(vtkIECTransformLogic::Focus, numberOfItems, points.data(), inputSize, 1000.0, outputPoints.data(),
+      outputSize);
+  }, pointsSize, pointsSize, outputPoints, "ProjectPointsToImagerPlane");
+
+  // In place: the output array is the input array
+  logic->TransformPointsBetween(vtkIECTransformLogic::RAS, vtkIECTransformLogic::Collimator, NumberOfItems, points.data(), pointsSize,
+    outputPoints.data(), pointsSize);
+  std::vector<double> inPlacePoints = points;
+  success &= IECTesting::Check(logic->TransformPointsBetween(vtkIECTransformLogic::RAS, vtkIECTransformLogic::Collimator, NumberOfItems,
+    inPlacePoints.data(), pointsSize, inPlacePoints.data(), pointsSize), "TransformPointsBetween in place succeeds");
+  success &= IECTesting::Check(inPlacePoints == outputPoints, "TransformPointsBetween in place gives the same points");
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
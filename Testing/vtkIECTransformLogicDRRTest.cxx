@@ -0,0 +1,129 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Digitally reconstructed radiographs of vtkIECTransformLogic: ComputeDigitallyReconstructedRadiograph in a non-trivial
+// machine state against IEC::ComputeRegularGridDRR with the grid -> detector transform and the source position taken
+// from an IEC::MachineState with the same elementary transforms, for a detector at the isocenter (the Imager frame) and
+// a detector frame added below the imager at the source-imager distance.
+
+// IEC Logic includes
+#include "vtkIECTransformLogic.h"
+#include "IECTransformTestingUtilities.h"
+
+// VTK includes
+#include <vtkNew.h>
+
+// STD includes
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+const std::array<uint16_t, 3> GridElems = { 20, 24, 28 };
+const std::array<double, 3> GridSpacing = { 2.0, 1.5, 3.0 }; // Columns, rows, slices
+const std::array<uint16_t, 2> DetectorSize = { 40, 50 };
+const std::array<double, 2> PixelSpacing = { 2.5, 2.5 };
+const double SourceImagerDistance = 1600.0;
+
+//----------------------------------------------------------------------------
+/// The logic against the core DRR with the detector -> grid transform and the source position computed from the machine state
+bool TestDRR(vtkIECTransformLogic* logic, vtkIECTransformLogic::CoordinateSystemIdentifier detectorFrame, const IEC::MachineState& state,
+  const IEC::Matrix4& detectorToImager, double expectedSourceDistance, const std::vector<float>& volume, const std::string& name)
+{
+  IEC::Matrix4 gridToImager;
+  IEC::Matrix4 imagerToGrid;
+  state.GetTransformBetween(IEC::PatientImageRegularGrid, IEC::Imager, gridToImager);
+  IEC::Invert(gridToImager, imagerToGrid);
+  const IEC::Matrix4 detectorToGrid = IEC::Multiply(imagerToGrid, detectorToImager);
+
+  // The source is the origin of the Focus frame
+  IEC::Matrix4 imagerToDetector;
+  IEC::Invert(detectorToImager, imagerToDetector);
+  const IEC::Matrix4 focusToDetector = IEC::Multiply(imagerToDetector, state.GetMatrix(IEC::Focus, IEC::Imager));
+  const double source[3] = { focusToDetector[3], focusToDetector[7], focusToDetector[11] };
+  bool success = IECTesting::Check(std::fabs(source[0]) < 1e-9 && std::fabs(source[1]) < 1e-9 && std::fabs(source[2] - expectedSourceDistance) < 1e-9,
+    name + ": the source is on the detector axis at " + std::to_string(expectedSourceDistance) + " mm");
+
+  const std::size_t numberOfPixels = static_cast<std::size_t>(DetectorSize[0]) * DetectorSize[1];
+  std::vector<float> expected(numberOfPixels);
+  IEC::ComputeRegularGridDRR(volume.data(), GridElems, detectorToGrid, source, DetectorSize, PixelSpacing, 0, DetectorSize[0], expected.data());
+
+  std::vector<float> image(numberOfPixels, -1.0f);
+  success &= IECTesting::Check(logic->ComputeDigitallyReconstructedRadiograph(detectorFrame, volume.data(), GridElems, DetectorSize, PixelSpacing,
+    image.data()), name + ": ComputeDigitallyReconstructedRadiograph succeeds");
+  int numberOfHits = 0;
+  for (std::size_t i = 0; i < numberOfPixels; ++i)
+  {
+    numberOfHits += (expected[i] > 0.0f ? 1 : 0);
+    if (!(std::fabs(image[i] - expected[i]) <= 1e-4f * (1.0f + expected[i])))
+    {
+      return IECTesting::Check(false, name + ", pixel " + std::to_string(i) + " is " + std::to_string(image[i]) + " instead of "
+        + std::to_string(expected[i]));
+    }
+  }
+  // The detector is larger than the shadow of the volume
+  success &= IECTesting::Check(numberOfHits > 0 && numberOfHits < static_cast<int>(numberOfPixels), name + " has rays through and beside the volume");
+  return success;
+}
+
+} // namespace
+
+//----------------------------------------------------------------------------
+int main()
+{
+  vtkNew<vtkIECTransformLogic> logic;
+  IECTesting::UpdateNonTrivialTransforms(logic.GetPointer());
+  IEC::MachineState state;
+  IECTesting::SetNonTrivialMachineState(state);
+
+  // Grid centered on the isocenter, so that the beam goes through it
+  IEC::Matrix4 fixedReferenceToDICOM;
+  state.GetTransformBetween(IEC::FixedReference, IEC::DICOM, fixedReferenceToDICOM);
+  double gridOrigin[3];
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    const int numberOfElements = GridElems[2 - axis];
+    gridOrigin[axis] = fixedReferenceToDICOM[4 * axis + 3] - 0.5 * (numberOfElements - 1) * GridSpacing[axis];
+  }
+  logic->UpdatePatientImageRegularGridToDICOMTransform(GridSpacing[0], GridSpacing[1], GridSpacing[2], gridOrigin[0], gridOrigin[1], gridOrigin[2]);
+  state.GetMatrix(IEC::PatientImageRegularGrid, IEC::DICOM) = IEC::PatientImageRegularGridToDICOMMatrix(GridSpacing[0], GridSpacing[1],
+    GridSpacing[2], gridOrigin[0], gridOrigin[1], gridOrigin[2]);
+
+  std::vector<float> volume(static_cast<std::size_t>(GridElems[0]) * GridElems[1] * GridElems[2]);
+  for (std::size_t i = 0; i < volume.size(); ++i)
+  {
+    volume[i] = 0.01f * static_cast<float>(1 + (i * 7) % 11);
+  }
+
+  bool success = true;
+
+  // Detector in the isocenter plane
+  const double sourceAxisDistance = logic->GetSourceAxisDistance();
+  success &= TestDRR(logic, vtkIECTransformLogic::Imager, state, IEC::IdentityMatrix(), sourceAxisDistance, volume, "Imager detector");
+
+  // Detector below the isocenter at the source-imager distance, its columns along the Y axis of the imager
+  const IEC::Matrix4 detectorToImager = IEC::TranslationRotationXYZMatrix(0.0, 0.0, sourceAxisDistance - SourceImagerDistance, 1, 0, 1, 0, 0, 1);
+  const int detector = logic->AddFrame(vtkIECTransformLogic::Imager, "KVDetector", detectorToImager.data());
+  success &= IECTesting::Check(detector >= 0, "AddFrame of the detector succeeds");
+  success &= TestDRR(logic, static_cast<vtkIECTransformLogic::CoordinateSystemIdentifier>(detector), state, detectorToImager, SourceImagerDistance,
+    volume, "Detector at the source-imager distance");
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
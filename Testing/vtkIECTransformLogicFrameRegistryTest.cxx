@@ -0,0 +1,236 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Frames added to vtkIECTransformLogic at runtime: identifiers and names of the frame registry, rejected frames, paths
+// through the added frames against the composition of their matrices, the rejection of non-rigid matrices for the
+// rigid IEC transforms, and deep copies between logics with different frames, which are independent of their source.
+
+// IEC Logic includes
+#include "vtkIECTransformLogic.h"
+#include "IECTransformTestingUtilities.h"
+
+// VTK includes
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtkSmartPointer.h>
+#include <vtkTransform.h>
+
+// STD includes
+#include <cstdlib>
+#include <string>
+
+namespace
+{
+
+typedef vtkIECTransformLogic::CoordinateSystemIdentifier Frame;
+
+const int FirstAddedFrame = vtkIECTransformLogic::LastIECCoordinateFrame;
+
+//----------------------------------------------------------------------------
+/// MLC bank below the collimator, a leaf below the bank, and a couch extension with scaling below the table top
+bool TestAddFrames(vtkIECTransformLogic* logic, const IEC::Matrix4& bankMatrix, const IEC::Matrix4& leafMatrix, const IEC::Matrix4& extensionMatrix)
+{
+  bool success = true;
+  const int bank = logic->AddFrame(vtkIECTransformLogic::Collimator, "MLCBankA", bankMatrix.data());
+  const int leaf = logic->AddFrame(static_cast<Frame>(bank), "MLCLeaf1", leafMatrix.data());
+  const int extension = logic->AddFrame(vtkIECTransformLogic::TableTop, "CouchExtension", extensionMatrix.data());
+  success &= IECTesting::Check(bank == FirstAddedFrame && leaf == FirstAddedFrame + 1 && extension == FirstAddedFrame + 2,
+    "Added frames get consecutive identifiers from LastIECCoordinateFrame on");
+  success &= IECTesting::Check(logic->GetNumberOfFrames() == FirstAddedFrame + 3, "GetNumberOfFrames counts the added frames");
+
+  // Rejected frames
+  success &= IECTesting::Check(logic->AddFrame(vtkIECTransformLogic::Collimator, "MLCBankA") == -1, "AddFrame rejects a duplicate name");
+  success &= IECTesting::Check(logic->AddFrame(vtkIECTransformLogic::Collimator, "Gantry") == -1, "AddFrame rejects the name of an IEC frame");
+  success &= IECTesting::Check(logic->AddFrame(vtkIECTransformLogic::Collimator, "") == -1, "AddFrame rejects an empty name");
+  success &= IECTesting::Check(logic->AddFrame(static_cast<Frame>(FirstAddedFrame + 10), "Orphan") == -1, "AddFrame rejects an unknown parent");
+  success &= IECTesting::Check(logic->GetNumberOfFrames() == FirstAddedFrame + 3, "Rejected frames are not added");
+
+  // Frame registry
+  success &= IECTesting::Check(logic->GetFrameIdentifier("MLCLeaf1") == leaf && logic->GetFrameIdentifier("CouchExtension") == extension,
+    "GetFrameIdentifier finds the added frames");
+  success &= IECTesting::Check(logic->GetFrameIdentifier("Gantry") == vtkIECTransformLogic::Gantry, "GetFrameIdentifier finds the IEC frames");
+  success &= IECTesting::Check(logic->GetFrameIdentifier("Orphan") == -1, "GetFrameIdentifier of an unknown name is -1");
+  success &= IECTesting::Check(logic->GetFrameName(static_cast<Frame>(bank)) == "MLCBankA"
+    && logic->GetFrameName(static_cast<Frame>(FirstAddedFrame + 10)).empty(), "GetFrameName of added and unknown frames");
+  success &= IECTesting::Check(logic->GetTransformNameBetween(static_cast<Frame>(leaf), static_cast<Frame>(bank)) == "MLCLeaf1ToMLCBankATransform",
+    "GetTransformNameBetween of an added transform");
+  success &= IECTesting::Check(logic->GetElementaryTransformBetween(static_cast<Frame>(leaf), static_cast<Frame>(bank)) != nullptr,
+    "GetElementaryTransformBetween of an added transform");
+  return success;
+}
+
+//----------------------------------------------------------------------------
+/// Paths through the added frames equal the composition of the matrices of the added transforms with the IEC path
+bool TestPaths(vtkIECTransformLogic* logic, const IEC::Matrix4& bankMatrix, const IEC::Matrix4& leafMatrix, const IEC::Matrix4& extensionMatrix)
+{
+  const Frame leaf = static_cast<Frame>(logic->GetFrameIdentifier("MLCLeaf1"));
+  const Frame extension = static_cast<Frame>(logic->GetFrameIdentifier("CouchExtension"));
+  bool success = true;
+
+  IEC::Matrix4 collimatorToPatient;
+  IEC::Matrix4 matrix;
+  logic->GetTransformBetween(vtkIECTransformLogic::Collimator, vtkIECTransformLogic::Patient, collimatorToPatient.data());
+  success &= IECTesting::Check(logic->GetTransformBetween(leaf, vtkIECTransformLogic::Patient, matrix.data()), "GetTransformBetween MLCLeaf1 -> Patient succeeds");
+  IEC::Matrix4 expected = IEC::Multiply(collimatorToPatient, IEC::Multiply(bankMatrix, leafMatrix));
+  success &= IECTesting::CheckMatrix(matrix.data(), expected.data(), 1e-9, "MLCLeaf1 -> Patient");
+
+  // Downward through the added frames, and through the scaled couch extension in both directions
+  IEC::Matrix4 inverse;
+  success &= IECTesting::Check(logic->GetTransformBetween(vtkIECTransformLogic::Patient, leaf, inverse.data()), "GetTransformBetween Patient -> MLCLeaf1 succeeds");
+  const IEC::Matrix4 identity = IEC::IdentityMatrix();
+  success &= IECTesting::CheckMatrix(IEC::Multiply(matrix, inverse).data(), identity.data(), 1e-9, "Patient -> MLCLeaf1 is the inverse of MLCLeaf1 -> Patient");
+
+  IEC::Matrix4 tableTopToPatient;
+  logic->GetTransformBetween(vtkIECTransformLogic::TableTop, vtkIECTransformLogic::Patient, tableTopToPatient.data());
+  logic->GetTransformBetween(extension, vtkIECTransformLogic::Patient, matrix.data());
+  expected = IEC::Multiply(tableTopToPatient, extensionMatrix);
+  success &= IECTesting::CheckMatrix(matrix.data(), expected.data(), 1e-9, "CouchExtension -> Patient");
+  logic->GetTransformBetween(leaf, extension, matrix.data());
+  logic->GetTransformBetween(extension, leaf, inverse.data());
+  success &= IECTesting::CheckMatrix(IEC::Multiply(matrix, inverse).data(), identity.data(), 1e-9, "MLCLeaf1 -> CouchExtension -> MLCLeaf1");
+
+  // An update of an added transform invalidates the cached paths through it
+  const IEC::Matrix4 movedLeafMatrix = IEC::TranslationRotationXYZMatrix(12.5, 0.0, 0.0, 1, 0, 1, 0, 1, 0);
+  success &= IECTesting::Check(logic->UpdateFrameToParentTransform(leaf, movedLeafMatrix.data()), "UpdateFrameToParentTransform of an added frame succeeds");
+  logic->GetTransformBetween(leaf, vtkIECTransformLogic::Patient, matrix.data());
+  expected = IEC::Multiply(collimatorToPatient, IEC::Multiply(bankMatrix, movedLeafMatrix));
+  success &= IECTesting::CheckMatrix(matrix.data(), expected.data(), 1e-9, "MLCLeaf1 -> Patient after moving the leaf");
+  return success;
+}
+
+//----------------------------------------------------------------------------
+/// Rigid IEC transforms are inverted in closed form, so matrices with scaling are rejected for them
+bool TestRigidTransforms(vtkIECTransformLogic* logic)
+{
+  IEC::Matrix4 scaled = IEC::TranslationRotationXYZMatrix(0.0, 0.0, -400.0, 1, 0, 1, 0, 1, 0);
+  scaled[0] = 2.0;
+  bool success = true;
+
+  IEC::Matrix4 collimatorToGantry;
+  logic->GetTransformBetween(vtkIECTransformLogic::Collimator, vtkIECTransformLogic::Gantry, collimatorToGantry.data());
+  success &= IECTesting::Check(!logic->UpdateFrameToParentTransform(vtkIECTransformLogic::Collimator, scaled.data()),
+    "UpdateFrameToParentTransform rejects a scaled matrix for a rigid transform");
+  success &= IECTesting::Check(!logic->UpdateFlatPanelToGantryTransform(scaled.data()), "UpdateFlatPanelToGantryTransform rejects a scaled matrix");
+  success &= IECTesting::Check(logic->UpdatePatientSupportToPatientSupportRotationTransform(scaled.data()),
+    "UpdatePatientSupportToPatientSupportRotationTransform accepts a scaled matrix");
+
+  // A scaled matrix set directly on the vtkTransform is reverted
+  vtkTransform* collimatorTransform = logic->GetElementaryTransformBetween(vtkIECTransformLogic::Collimator, vtkIECTransformLogic::Gantry);
+  collimatorTransform->SetMatrix(scaled.data());
+  IEC::Matrix4 matrix;
+  logic->GetTransformBetween(vtkIECTransformLogic::Collimator, vtkIECTransformLogic::Gantry, matrix.data());
+  success &= IECTesting::CheckMatrix(matrix.data(), collimatorToGantry.data(), 0.0, "Collimator -> Gantry after the rejected matrices");
+  success &= IECTesting::CheckMatrix(collimatorTransform->GetMatrix()->GetData(), collimatorToGantry.data(), 0.0,
+    "The rejected change of the vtkTransform is reverted");
+  return success;
+}
+
+//----------------------------------------------------------------------------
+/// Deep copy into a logic with other added frames and created vtkTransforms: the vtkTransforms of the transforms that
+/// both logics have are kept, the others are released. The copy is independent of its source afterwards.
+bool TestDeepCopy(vtkIECTransformLogic* logic)
+{
+  vtkNew<vtkIECTransformLogic> copy;
+  const int other = copy->AddFrame(vtkIECTransformLogic::Gantry, "Other");
+  const int otherChild = copy->AddFrame(static_cast<Frame>(other), "OtherChild");
+  vtkSmartPointer<vtkTransform> gantryTransform = copy->GetElementaryTransformBetween(vtkIECTransformLogic::Gantry, vtkIECTransformLogic::FixedReference);
+  vtkSmartPointer<vtkTransform> otherChildTransform = copy->GetElementaryTransformBetween(static_cast<Frame>(otherChild), static_cast<Frame>(other));
+
+  copy->DeepCopy(logic);
+  const Frame bank = static_cast<Frame>(logic->GetFrameIdentifier("MLCBankA"));
+  const Frame leaf = static_cast<Frame>(logic->GetFrameIdentifier("MLCLeaf1"));
+  bool success = true;
+  success &= IECTesting::Check(copy->GetNumberOfFrames() == logic->GetNumberOfFrames() && copy->GetFrameIdentifier("MLCLeaf1") == leaf
+    && copy->GetFrameIdentifier("Other") == -1, "The deep copy has the frames of the source");
+
+  // The frame identifiers of OtherChild -> Other are those of MLCLeaf1 -> MLCBankA in the source
+  vtkTransform* leafTransform = copy->GetElementaryTransformBetween(leaf, bank);
+  success &= IECTesting::Check(leafTransform && leafTransform != otherChildTransform && leafTransform->GetObjectName() == "MLCLeaf1ToMLCBankATransform",
+    "The vtkTransform of an added transform that is not in the source is released");
+  success &= IECTesting::Check(copy->GetElementaryTransformBetween(vtkIECTransformLogic::Gantry, vtkIECTransformLogic::FixedReference) == gantryTransform,
+    "The vtkTransform of an IEC transform is kept");
+
+  // Copied matrices, also in the kept vtkTransform
+  IEC::Matrix4 leafToPatient;
+  IEC::Matrix4 copiedLeafToPatient;
+  logic->GetTransformBetween(leaf, vtkIECTransformLogic::Patient, leafToPatient.data());
+  copy->GetTransformBetween(leaf, vtkIECTransformLogic::Patient, copiedLeafToPatient.data());
+  success &= IECTesting::CheckMatrix(copiedLeafToPatient.data(), leafToPatient.data(), 0.0, "Copied MLCLeaf1 -> Patient");
+  IEC::Matrix4 gantryToFixedReference;
+  logic->GetTransformBetween(vtkIECTransformLogic::Gantry, vtkIECTransformLogic::FixedReference, gantryToFixedReference.data());
+  success &= IECTesting::CheckMatrix(gantryTransform->GetMatrix()->GetData(), gantryToFixedReference.data(), 0.0, "The kept vtkTransform has the copied matrix");
+
+  // The released vtkTransform does not affect the copy, the kept one does
+  const IEC::Matrix4 otherMatrix = IEC::TranslationRotationXYZMatrix(1.0, 2.0, 3.0, 1, 0, 1, 0, 1, 0);
+  otherChildTransform->SetMatrix(otherMatrix.data());
+  copy->GetTransformBetween(leaf, vtkIECTransformLogic::Patient, copiedLeafToPatient.data());
+  success &= IECTesting::CheckMatrix(copiedLeafToPatient.data(), leafToPatient.data(), 0.0, "MLCLeaf1 -> Patient after modifying the released vtkTransform");
+  const IEC::Matrix4 gantryMatrix = IEC::GantryToFixedReferenceMatrix(200.0, 0.0);
+  gantryTransform->SetMatrix(gantryMatrix.data());
+  IEC::Matrix4 matrix;
+  copy->GetTransformBetween(vtkIECTransformLogic::Gantry, vtkIECTransformLogic::FixedReference, matrix.data());
+  success &= IECTesting::CheckMatrix(matrix.data(), gantryMatrix.data(), 1e-12, "Gantry -> FixedReference after modifying the kept vtkTransform");
+
+  // Updates of the source after the copy, through the Update methods and its vtkTransforms, do not change the copy
+  IEC::Matrix4 copiedGridToLeaf;
+  copy->GetTransformBetween(vtkIECTransformLogic::PatientImageRegularGrid, leaf, copiedGridToLeaf.data());
+  logic->UpdateCollimatorToGantryTransform(77.0);
+  const IEC::Matrix4 movedLeafMatrix = IEC::TranslationRotationXYZMatrix(-30.0, 0.0, 0.0, 1, 0, 1, 0, 1, 0);
+  logic->UpdateFrameToParentTransform(leaf, movedLeafMatrix.data());
+  const IEC::Matrix4 tableTopMatrix = IEC::TableTopToTableTopEccentricRotationMatrix(40.0, -30.0, 20.0, 0.0, 0.0);
+  logic->GetElementaryTransformBetween(vtkIECTransformLogic::TableTop, vtkIECTransformLogic::TableTopEccentricRotation)->SetMatrix(tableTopMatrix.data());
+  logic->GetTransformBetween(vtkIECTransformLogic::PatientImageRegularGrid, leaf, matrix.data());
+  success &= IECTesting::Check(matrix != copiedGridToLeaf, "The source changed");
+  copy->GetTransformBetween(vtkIECTransformLogic::PatientImageRegularGrid, leaf, matrix.data());
+  success &= IECTesting::CheckMatrix(matrix.data(), copiedGridToLeaf.data(), 0.0, "The copy is independent of later updates of the source");
+
+  // And the other way around
+  IEC::Matrix4 gridToLeaf;
+  logic->GetTransformBetween(vtkIECTransformLogic::PatientImageRegularGrid, leaf, gridToLeaf.data());
+  copy->UpdateFrameToParentTransform(leaf, IEC::IdentityMatrix().data());
+  copy->UpdateTableTopToTableTopEccentricRotationTransform(0.0, 0.0, 0.0);
+  logic->GetTransformBetween(vtkIECTransformLogic::PatientImageRegularGrid, leaf, matrix.data());
+  success &= IECTesting::CheckMatrix(matrix.data(), gridToLeaf.data(), 0.0, "The source is independent of updates of the copy");
+  return success;
+}
+
+} // namespace
+
+//----------------------------------------------------------------------------
+int main()
+{
+  vtkNew<vtkIECTransformLogic> logic;
+  IECTesting::UpdateNonTrivialTransforms(logic.GetPointer());
+  vtkNew<vtkIECTransformLogic> otherLogic;
+
+  const IEC::Matrix4 bankMatrix = IEC::TranslationRotationXYZMatrix(0.0, 20.0, -500.0, 1, 0, 1, 0, 0, 1);
+  const IEC::Matrix4 leafMatrix = IEC::TranslationRotationXYZMatrix(5.0, 0.0, 0.0, 1, 0, 1, 0, 1, 0);
+  IEC::Matrix4 extensionMatrix = IEC::TranslationRotationXYZMatrix(0.0, 600.0, 0.0, 1, 0, 1, 0, 1, 0);
+  extensionMatrix[5] = 1.2; // Scaling along the table top
+
+  bool success = true;
+  success &= TestAddFrames(logic, bankMatrix, leafMatrix, extensionMatrix);
+  success &= TestPaths(logic, bankMatrix, leafMatrix, extensionMatrix);
+  success &= TestRigidTransforms(logic);
+
+  // The frames are added to this logic only, copies of it have them too
+  success &= IECTesting::Check(otherLogic->GetNumberOfFrames() == FirstAddedFrame && otherLogic->GetFrameIdentifier("MLCLeaf1") == -1,
+    "Other logics do not get the added frames");
+  vtkSmartPointer<vtkIECTransformLogic> clone = vtkSmartPointer<vtkIECTransformLogic>::Take(logic->Clone());
+  success &= IECTesting::Check(clone->GetFrameIdentifier("MLCLeaf1") == FirstAddedFrame + 1, "A clone has the added frames");
+  success &= TestDeepCopy(logic);
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
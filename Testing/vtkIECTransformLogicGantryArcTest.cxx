@@ -0,0 +1,109 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Gantry arcs of vtkIECTransformLogic: step i of GetTransformsAlongGantryArc and of GetGantryArcIterator against
+// updating the gantry angle to the angle of step i.
+
+// IEC Logic includes
+#include "vtkIECTransformLogic.h"
+#include "IECTransformTestingUtilities.h"
+
+// VTK includes
+#include <vtkNew.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+typedef vtkIECTransformLogic::CoordinateSystemIdentifier Frame;
+
+//----------------------------------------------------------------------------
+/// Step i of GetTransformsAlongGantryArc is the transform after updating the gantry angle to the angle of step i
+bool TestTransformsAlongGantryArc(vtkIECTransformLogic* logic)
+{
+  const Frame fromFrame = vtkIECTransformLogic::RAS;
+  const Frame toFrame = vtkIECTransformLogic::Collimator;
+  const double startAngleDeg = 181.0;
+  const double angleStepDeg = 2.0;
+  const vtkIdType numberOfSteps = 179;
+
+  std::vector<double> matrices(16 * numberOfSteps);
+  if (!IECTesting::Check(logic->GetTransformsAlongGantryArc(fromFrame, toFrame, startAngleDeg, angleStepDeg, numberOfSteps, matrices.data(),
+    static_cast<vtkIdType>(matrices.size())),
+    "GetTransformsAlongGantryArc succeeds"))
+  {
+    return false;
+  }
+
+  vtkSmartPointer<vtkIECTransformLogic> updatedLogic = vtkSmartPointer<vtkIECTransformLogic>::Take(logic->Clone());
+  bool success = true;
+  for (vtkIdType step = 0; step < numberOfSteps; ++step)
+  {
+    updatedLogic->UpdateGantryToFixedReferenceTransform(startAngleDeg + step * angleStepDeg, logic->GetGantryParameters().PitchAngleDeg);
+    double expected[16];
+    updatedLogic->GetTransformBetween(fromFrame, toFrame, expected);
+    success &= IECTesting::CheckMatrix(matrices.data() + 16 * step, expected, 1e-9, "GetTransformsAlongGantryArc step " + std::to_string(step));
+  }
+  return success;
+}
+
+//----------------------------------------------------------------------------
+/// The iterator continues past a full turn, and does not depend on the stored gantry angle
+bool TestGantryArcIterator(vtkIECTransformLogic* logic)
+{
+  const Frame fromFrame = vtkIECTransformLogic::PatientImageRegularGrid;
+  const Frame toFrame = vtkIECTransformLogic::Focus;
+  const double startAngleDeg = -30.0;
+  const double angleStepDeg = 7.5;
+  const IEC::GantryParameters gantryParameters = logic->GetGantryParameters();
+
+  IEC::ArcIterator arc;
+  if (!IECTesting::Check(logic->GetGantryArcIterator(fromFrame, toFrame, startAngleDeg, angleStepDeg, arc), "GetGantryArcIterator succeeds"))
+  {
+    return false;
+  }
+  vtkSmartPointer<vtkIECTransformLogic> updatedLogic = vtkSmartPointer<vtkIECTransformLogic>::Take(logic->Clone());
+  bool success = true;
+  for (; arc.GetStep() < 100; arc.Next())
+  {
+    double matrix[16];
+    arc.GetMatrix(matrix);
+    updatedLogic->UpdateGantryToFixedReferenceTransform(startAngleDeg + arc.GetStep() * angleStepDeg, gantryParameters.PitchAngleDeg);
+    double expected[16];
+    updatedLogic->GetTransformBetween(fromFrame, toFrame, expected);
+    success &= IECTesting::CheckMatrix(matrix, expected, 1e-9, "GetGantryArcIterator step " + std::to_string(arc.GetStep()));
+  }
+  return success;
+}
+
+} // namespace
+
+//----------------------------------------------------------------------------
+int main()
+{
+  vtkNew<vtkIECTransformLogic> logic;
+  IECTesting::UpdateNonTrivialTransforms(logic.GetPointer());
+
+  bool success = true;
+  success &= TestTransformsAlongGantryArc(logic);
+  success &= TestGantryArcIterator(logic);
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
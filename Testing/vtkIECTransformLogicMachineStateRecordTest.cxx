@@ -0,0 +1,195 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Binary machine state records of vtkIECTransformLogic: save -> restore round-trip of the elementary transforms and the
+// machine parameters, in memory and through a file, and the rejection of records with a corrupted header.
+
+// IEC Logic includes
+#include "vtkIECTransformLogic.h"
+#include "IECTransformTestingUtilities.h"
+
+// VTK includes
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtkTransform.h>
+
+// STD includes
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+typedef vtkIECTransformLogic::CoordinateSystemIdentifier Frame;
+
+/// Written into the working directory of the test
+const char* StateFileName = "vtkIECTransformLogicMachineStateRecordTest.bin";
+
+//----------------------------------------------------------------------------
+/// All elementary transforms and machine parameters of the two logics are the same
+bool CheckSameState(vtkIECTransformLogic* logic, vtkIECTransformLogic* expectedLogic, const std::string& name)
+{
+  bool success = true;
+  for (const std::pair<Frame, Frame>& frames : expectedLogic->GetIECTransforms())
+  {
+    vtkTransform* transform = logic->GetElementaryTransformBetween(frames.first, frames.second);
+    vtkTransform* expectedTransform = expectedLogic->GetElementaryTransformBetween(frames.first, frames.second);
+    success &= IECTesting::CheckMatrix(transform->GetMatrix()->GetData(), expectedTransform->GetMatrix()->GetData(), 0.0,
+      name + " " + IEC::CoordinateSystemNames[frames.first] + " -> " + IEC::CoordinateSystemNames[frames.second]);
+  }
+
+  const IEC::MachineParameters& parameters = logic->GetMachineState();
+  const IEC::MachineParameters& expectedParameters = expectedLogic->GetMachineState();
+  success &= IECTesting::Check(parameters.Gantry == expectedParameters.Gantry && parameters.Collimator == expectedParameters.Collimator
+    && parameters.WedgeFilter == expectedParameters.WedgeFilter && parameters.PatientSupportRotation == expectedParameters.PatientSupportRotation
+    && parameters.TableTopEccentricRotation == expectedParameters.TableTopEccentricRotation && parameters.TableTop == expectedParameters.TableTop
+    && parameters.Patient == expectedParameters.Patient && parameters.PatientImageRegularGrid == expectedParameters.PatientImageRegularGrid
+    && parameters.Imager == expectedParameters.Imager && parameters.Focus == expectedParameters.Focus, name + " machine parameters");
+  success &= IECTesting::Check(logic->GetSourceAxisDistance() == expectedLogic->GetSourceAxisDistance(), name + " source-axis distance");
+
+  // Composed transforms are recomputed from the restored elementary transforms
+  double matrix[16];
+  double expectedMatrix[16];
+  logic->GetTransformBetween(vtkIECTransformLogic::PatientImageRegularGrid, vtkIECTransformLogic::Collimator, matrix);
+  expectedLogic->GetTransformBetween(vtkIECTransformLogic::PatientImageRegularGrid, vtkIECTransformLogic::Collimator, expectedMatrix);
+  success &= IECTesting::CheckMatrix(matrix, expectedMatrix, 0.0, name + " PatientImageRegularGrid -> Collimator");
+  return success;
+}
+
+//----------------------------------------------------------------------------
+bool TestRoundTrip(vtkIECTransformLogic* logic)
+{
+  std::vector<unsigned char> record(vtkIECTransformLogic::GetMachineStateRecordSize());
+  if (!IECTesting::Check(logic->SaveMachineState(record.data()), "SaveMachineState succeeds"))
+  {
+    return false;
+  }
+
+  // Restored into a logic with an other state, which is also queried before, so that it has composed transforms to invalidate
+  vtkNew<vtkIECTransformLogic> restoredLogic;
+  restoredLogic->UpdateGantryToFixedReferenceTransform(90.0);
+  double matrix[16];
+  restoredLogic->GetTransformBetween(vtkIECTransformLogic::PatientImageRegularGrid, vtkIECTransformLogic::Collimator, matrix);
+  if (!IECTesting::Check(restoredLogic->RestoreMachineState(record.data()), "RestoreMachineState succeeds"))
+  {
+    return false;
+  }
+  bool success = CheckSameState(restoredLogic, logic, "Restored");
+
+  // Update calls after the restore skip the transforms whose parameters are unchanged
+  IEC::MachineParameters parameters = logic->GetMachineState();
+  success &= IECTesting::Check(restoredLogic->SetMachineState(parameters) == 0, "SetMachineState with the restored parameters rebuilds nothing");
+  parameters.Gantry.RotationAngleDeg += 1.0;
+  success &= IECTesting::Check(restoredLogic->SetMachineState(parameters) == 1, "SetMachineState with a new gantry angle rebuilds one transform");
+
+  // Through a file
+  vtkNew<vtkIECTransformLogic> fileLogic;
+  success &= IECTesting::Check(logic->WriteMachineStateFile(StateFileName) && fileLogic->ReadMachineStateFile(StateFileName),
+    "Writing and reading the machine state file succeeds");
+  success &= CheckSameState(fileLogic, logic, "Read from file");
+  return success;
+}
+
+//----------------------------------------------------------------------------
+/// A record with a corrupted header is rejected and the logic is not changed
+bool TestRejectedRecord(vtkIECTransformLogic* logic, const IEC::MachineStateRecord& header, const std::string& name)
+{
+  std::vector<unsigned char> record(vtkIECTransformLogic::GetMachineStateRecordSize());
+  logic->SaveMachineState(record.data());
+  std::memcpy(record.data(), &header, offsetof(IEC::MachineStateRecord, ElementaryTransformMatrices));
+
+  vtkNew<vtkIECTransformLogic> restoredLogic;
+  restoredLogic->UpdateGantryToFixedReferenceTransform(90.0);
+  vtkNew<vtkIECTransformLogic> expectedLogic;
+  expectedLogic->UpdateGantryToFixedReferenceTransform(90.0);
+  return IECTesting::Check(!restoredLogic->RestoreMachineState(record.data()), "RestoreMachineState rejects a record with " + name)
+    && CheckSameState(restoredLogic, expectedLogic, "Rejected record with " + name);
+}
+
+//----------------------------------------------------------------------------
+uint32_t SwapBytes(uint32_t value)
+{
+  return (value >> 24) | ((value >> 8) & 0xff00u) | ((value << 8) & 0xff0000u) | (value << 24);
+}
+
+//----------------------------------------------------------------------------
+bool TestRejectedRecords(vtkIECTransformLogic* logic)
+{
+  std::vector<unsigned char> record(vtkIECTransformLogic::GetMachineStateRecordSize());
+  logic->SaveMachineState(record.data());
+  IEC::MachineStateRecord validHeader;
+  std::memcpy(static_cast<void*>(&validHeader), record.data(), offsetof(IEC::MachineStateRecord, ElementaryTransformMatrices));
+
+  bool success = true;
+  IEC::MachineStateRecord header = validHeader;
+  header.Magic ^= 0x100u;
+  success &= TestRejectedRecord(logic, header, "a corrupted magic number");
+
+  // Written on a machine with the other byte order
+  header = validHeader;
+  header.Magic = SwapBytes(header.Magic);
+  header.FormatVersion = SwapBytes(header.FormatVersion);
+  header.NumberOfElementaryTransforms = SwapBytes(header.NumberOfElementaryTransforms);
+  success &= TestRejectedRecord(logic, header, "the other byte order");
+
+  header = validHeader;
+  header.FormatVersion = 1;
+  success &= TestRejectedRecord(logic, header, "format version 1");
+  header.FormatVersion = IEC::MachineStateRecord::CurrentFormatVersion + 1;
+  success &= TestRejectedRecord(logic, header, "a newer format version");
+
+  header = validHeader;
+  header.NumberOfElementaryTransforms -= 1;
+  success &= TestRejectedRecord(logic, header, "a different number of elementary transforms");
+
+  // A version 1 file is shorter: the header, the matrices, and no machine parameters
+  header = validHeader;
+  header.FormatVersion = 1;
+  std::memcpy(record.data(), &header, offsetof(IEC::MachineStateRecord, ElementaryTransformMatrices));
+  FILE* file = std::fopen(StateFileName, "wb");
+  const bool written = (file && std::fwrite(record.data(), 1, offsetof(IEC::MachineStateRecord, Parameters), file)
+    == offsetof(IEC::MachineStateRecord, Parameters));
+  if (file)
+  {
+    std::fclose(file);
+  }
+  vtkNew<vtkIECTransformLogic> fileLogic;
+  success &= IECTesting::Check(written && !fileLogic->ReadMachineStateFile(StateFileName), "ReadMachineStateFile rejects a version 1 file");
+  return success;
+}
+
+} // namespace
+
+//----------------------------------------------------------------------------
+int main()
+{
+  vtkNew<vtkIECTransformLogic> logic;
+  IECTesting::UpdateNonTrivialTransforms(logic.GetPointer());
+  // A matrix set directly, not built from machine parameters
+  const IEC::Matrix4 flatPanelToGantry = IEC::TranslationRotationXYZMatrix(0.0, 10.0, -450.0, 1, 0, 1, 0, 0, 1);
+  logic->UpdateFrameToParentTransform(vtkIECTransformLogic::FlatPanel, flatPanelToGantry.data());
+
+  bool success = true;
+  success &= TestRoundTrip(logic);
+  success &= TestRejectedRecords(logic);
+
+  std::remove(StateFileName);
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,196 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Divergent projection of vtkIECTransformLogic: ProjectPointsToImagerPlane of known points through the focus (plane
+// coordinates, depth, NaN at and behind the focus), and ProjectPointsToImagerPlane and ProjectVoxelCentersToImagerPlane
+// in a non-trivial machine state against the points transformed into the Focus frame and projected by hand.
+
+// IEC Logic includes
+#include "vtkIECTransformLogic.h"
+#include "IECTransformTestingUtilities.h"
+
+// VTK includes
+#include <vtkNew.h>
+
+// STD includes
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+/// Compare projected points, NaN only where NaN is expected
+/// @param relativeTolerance Largest allowed difference relative to the expected value, on top of the absolute tolerance
+template <typename PointType>
+bool CheckProjectedPoints(const std::vector<PointType>& actual, const std::vector<double>& expected, double tolerance, double relativeTolerance,
+  const std::string& name)
+{
+  for (std::size_t i = 0; i < expected.size(); ++i)
+  {
+    const double value = static_cast<double>(actual[i]);
+    const bool matches = (std::isnan(expected[i]) ? std::isnan(value)
+      : std::fabs(value - expected[i]) <= tolerance + relativeTolerance * std::fabs(expected[i]));
+    if (!matches)
+    {
+      return IECTesting::Check(false, name + ", value " + std::to_string(i) + " is " + std::to_string(value) + " instead of "
+        + std::to_string(expected[i]));
+    }
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+/// Project points given in the Focus frame by hand: the beam leaves the focus along -Z
+std::vector<double> ProjectFocusPoints(const std::vector<double>& focusPoints, double planeDistance)
+{
+  std::vector<double> projectedPoints(focusPoints.size());
+  for (std::size_t i = 0; i < focusPoints.size(); i += 3)
+  {
+    const double depth = -focusPoints[i + 2];
+    const double nan = std::nan("");
+    projectedPoints[i] = (depth > 0.0 ? focusPoints[i] * planeDistance / depth : nan);
+    projectedPoints[i + 1] = (depth > 0.0 ? focusPoints[i + 1] * planeDistance / depth : nan);
+    projectedPoints[i + 2] = (depth > 0.0 ? depth : nan);
+  }
+  return projectedPoints;
+}
+
+//----------------------------------------------------------------------------
+/// Default machine with a source-axis distance of 1000 mm: the focus is at z = 1000 in the FixedReference frame and the
+/// central axis points down, so the projections of these points are known
+bool TestKnownPoints()
+{
+  vtkNew<vtkIECTransformLogic> logic;
+  logic->UpdateFocusToImagerTransform(1000.0);
+  const double planeDistance = 1500.0;
+
+  const std::vector<double> points = {
+    0.0, 0.0, 0.0,       // Isocenter: on the central axis at the source-axis distance
+    10.0, 20.0, 0.0,     // Isocenter plane: magnified by 1500 / 1000
+    10.0, 20.0, 500.0,   // Halfway to the focus: magnified by 1500 / 500
+    -40.0, 8.0, -500.0,  // Beyond the isocenter: magnified by 1500 / 1500
+    3.0, 4.0, 1000.0,    // In the plane of the focus
+    5.0, 5.0, 1200.0     // Behind the focus
+  };
+  const double nan = std::nan("");
+  const std::vector<double> expected = {
+    0.0, 0.0, 1000.0,
+    15.0, 30.0, 1000.0,
+    30.0, 60.0, 500.0,
+    -40.0, 8.0, 1500.0,
+    nan, nan, nan,
+    nan, nan, nan
+  };
+
+  const vtkIdType numberOfPoints = static_cast<vtkIdType>(points.size() / 3);
+  std::vector<double> projectedPoints(points.size());
+  bool success = IECTesting::Check(logic->ProjectPointsToImagerPlane(vtkIECTransformLogic::FixedReference, numberOfPoints, points.data(),
+    static_cast<vtkIdType>(points.size()), planeDistance, projectedPoints.data(), static_cast<vtkIdType>(projectedPoints.size())),
+    "ProjectPointsToImagerPlane of known points succeeds");
+  success &= CheckProjectedPoints(projectedPoints, expected, 1e-9, 0.0, "ProjectPointsToImagerPlane of known points");
+
+  success &= IECTesting::Check(!logic->ProjectPointsToImagerPlane(vtkIECTransformLogic::FixedReference, numberOfPoints, points.data(),
+    static_cast<vtkIdType>(points.size()), 0.0, projectedPoints.data(), static_cast<vtkIdType>(projectedPoints.size())),
+    "ProjectPointsToImagerPlane rejects a plane at the focus");
+  const std::array<uint16_t, 3> nElems = { 1, 1, 1 };
+  success &= IECTesting::Check(!logic->ProjectVoxelCentersToImagerPlane(nElems, -1.0, projectedPoints.data()),
+    "ProjectVoxelCentersToImagerPlane rejects a plane behind the focus");
+  return success;
+}
+
+//----------------------------------------------------------------------------
+/// Points of a non-trivial machine state against the Patient -> Focus transform and the projection by hand
+bool TestPoints(vtkIECTransformLogic* logic, double planeDistance)
+{
+  std::vector<double> points;
+  for (int i = 0; i < 50; ++i)
+  {
+    points.insert(points.end(), { 7.0 * i - 150.0, 300.0 - 11.0 * i, 5.0 * i - 120.0 });
+  }
+  const vtkIdType numberOfPoints = static_cast<vtkIdType>(points.size() / 3);
+
+  IEC::Matrix4 patientToFocus;
+  logic->GetTransformBetween(vtkIECTransformLogic::Patient, vtkIECTransformLogic::Focus, patientToFocus.data());
+  std::vector<double> focusPoints(points.size());
+  IEC::TransformPoints(patientToFocus, points.data(), 0, static_cast<std::size_t>(numberOfPoints), focusPoints.data());
+
+  std::vector<double> projectedPoints(points.size());
+  bool success = IECTesting::Check(logic->ProjectPointsToImagerPlane(vtkIECTransformLogic::Patient, numberOfPoints, points.data(),
+    static_cast<vtkIdType>(points.size()), planeDistance, projectedPoints.data(), static_cast<vtkIdType>(projectedPoints.size())),
+    "ProjectPointsToImagerPlane succeeds");
+  success &= CheckProjectedPoints(projectedPoints, ProjectFocusPoints(focusPoints, planeDistance), 1e-9, 0.0, "ProjectPointsToImagerPlane");
+  return success;
+}
+
+//----------------------------------------------------------------------------
+/// Voxel centers of the regular grid against GetVoxelCentersInFrame(Focus) projected by hand, in double and single
+/// precision. The focus is placed inside the grid, so that part of the voxels are behind it.
+bool TestVoxelCenters(vtkIECTransformLogic* logic, double planeDistance)
+{
+  const std::array<uint16_t, 3> nElems = { 6, 40, 90 };
+  const std::size_t numberOfValues = 3 * static_cast<std::size_t>(nElems[0]) * nElems[1] * nElems[2];
+
+  std::vector<double> focusPoints(numberOfValues);
+  bool success = IECTesting::Check(logic->GetVoxelCentersInFrame(vtkIECTransformLogic::Focus, nElems, focusPoints.data()),
+    "GetVoxelCentersInFrame(Focus) succeeds");
+  const std::vector<double> expected = ProjectFocusPoints(focusPoints, planeDistance);
+  std::size_t numberOfBehindFocus = 0;
+  for (std::size_t i = 2; i < expected.size(); i += 3)
+  {
+    numberOfBehindFocus += (std::isnan(expected[i]) ? 1 : 0);
+  }
+  success &= IECTesting::Check(numberOfBehindFocus > 0 && numberOfBehindFocus < numberOfValues / 3, "The grid is on both sides of the focus");
+
+  std::vector<double> projectedPoints(numberOfValues);
+  success &= IECTesting::Check(logic->ProjectVoxelCentersToImagerPlane(nElems, planeDistance, projectedPoints.data()),
+    "ProjectVoxelCentersToImagerPlane succeeds");
+  success &= CheckProjectedPoints(projectedPoints, expected, 1e-9, 1e-9, "ProjectVoxelCentersToImagerPlane");
+
+  // Single precision: the relative error of the magnified coordinates grows towards the focus
+  std::vector<float> projectedPointsFloat(numberOfValues);
+  success &= IECTesting::Check(logic->ProjectVoxelCentersToImagerPlane(nElems, planeDistance, projectedPointsFloat.data()),
+    "Single precision ProjectVoxelCentersToImagerPlane succeeds");
+  success &= CheckProjectedPoints(projectedPointsFloat, expected, 1e-3, 1e-5, "Single precision ProjectVoxelCentersToImagerPlane");
+  return success;
+}
+
+} // namespace
+
+//----------------------------------------------------------------------------
+int main()
+{
+  bool success = true;
+  success &= TestKnownPoints();
+
+  vtkNew<vtkIECTransformLogic> logic;
+  IECTesting::UpdateNonTrivialTransforms(logic.GetPointer());
+  success &= TestPoints(logic, logic->GetSourceAxisDistance());
+  success &= TestPoints(logic, 1500.0);
+
+  // A source-axis distance that puts the focus inside the grid
+  IEC::Matrix4 gridToImager;
+  logic->GetTransformBetween(vtkIECTransformLogic::PatientImageRegularGrid, vtkIECTransformLogic::Imager, gridToImager.data());
+  const double gridCenter[3] = { 45.0, 20.0, 3.0 };
+  logic->UpdateFocusToImagerTransform(gridToImager[8] * gridCenter[0] + gridToImager[9] * gridCenter[1] + gridToImager[10] * gridCenter[2]
+    + gridToImager[11]);
+  success &= TestVoxelCenters(logic, 1500.0);
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
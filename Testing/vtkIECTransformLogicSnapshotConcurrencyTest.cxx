@@ -0,0 +1,149 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Snapshots of vtkIECTransformLogic under concurrency: one writer thread updates several axes and publishes a snapshot
+// after each complete parameter set, while reader threads get the published snapshot and query it. Every snapshot must
+// match exactly one complete parameter set, and a reader never sees an older set after a newer one.
+
+// IEC Logic includes
+#include "vtkIECTransformLogic.h"
+#include "IECTransformTestingUtilities.h"
+
+// VTK includes
+#include <vtkNew.h>
+
+// STD includes
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+const int NumberOfParameterSets = 3000;
+const int NumberOfReaders = 3;
+
+//----------------------------------------------------------------------------
+/// Parameter set i moves three axes at once. The table top lateral displacement is i, so that a snapshot tells which
+/// set it was taken from.
+void UpdateParameterSet(vtkIECTransformLogic* logic, int parameterSet)
+{
+  logic->UpdateGantryToFixedReferenceTransform(std::fmod(0.7 * parameterSet, 360.0));
+  logic->UpdateCollimatorToGantryTransform(std::fmod(1.3 * parameterSet, 360.0));
+  logic->UpdateTableTopToTableTopEccentricRotationTransform(static_cast<double>(parameterSet), -250.0, 80.0);
+}
+
+//----------------------------------------------------------------------------
+/// Query snapshots until the writer is done, check each against the parameter set it was taken from
+void ReadSnapshots(const vtkIECTransformLogic* logic, const std::vector<IEC::Matrix4>& expectedMatrices, const std::atomic<bool>& writerDone,
+  std::atomic<int>& numberOfFailures, std::atomic<int>& numberOfChecks)
+{
+  int lastParameterSet = -1;
+  vtkTypeUInt64 lastVersion = 0;
+  bool done = false;
+  while (!done)
+  {
+    // Read once more after the writer finished, so that the last snapshot is checked too
+    done = writerDone.load();
+    std::shared_ptr<const vtkIECTransformLogic::MachineStateSnapshot> snapshot = logic->GetSnapshot();
+    double tableTopMatrix[16];
+    double matrix[16];
+    if (!snapshot
+      || !snapshot->GetTransformBetween(vtkIECTransformLogic::TableTop, vtkIECTransformLogic::TableTopEccentricRotation, tableTopMatrix)
+      || !snapshot->GetTransformBetween(vtkIECTransformLogic::Patient, vtkIECTransformLogic::Collimator, matrix))
+    {
+      ++numberOfFailures;
+      continue;
+    }
+
+    const int parameterSet = static_cast<int>(std::lround(tableTopMatrix[3]));
+    if (parameterSet < 0 || parameterSet >= NumberOfParameterSets || parameterSet < lastParameterSet || snapshot->GetVersion() < lastVersion
+      || !IECTesting::CheckMatrix(matrix, expectedMatrices[parameterSet].data(), 1e-9,
+        "Snapshot of parameter set " + std::to_string(parameterSet) + " Patient -> Collimator"))
+    {
+      ++numberOfFailures;
+      continue;
+    }
+    lastParameterSet = parameterSet;
+    lastVersion = snapshot->GetVersion();
+    ++numberOfChecks;
+  }
+  if (lastParameterSet != NumberOfParameterSets - 1)
+  {
+    ++numberOfFailures;
+  }
+}
+
+} // namespace
+
+//----------------------------------------------------------------------------
+int main()
+{
+  vtkNew<vtkIECTransformLogic> logic;
+  IECTesting::UpdateNonTrivialTransforms(logic.GetPointer());
+
+  // Patient -> Collimator of every parameter set, computed beforehand on a copy of the logic
+  std::vector<IEC::Matrix4> expectedMatrices(NumberOfParameterSets);
+  {
+    vtkNew<vtkIECTransformLogic> expectedLogic;
+    expectedLogic->DeepCopy(logic);
+    for (int parameterSet = 0; parameterSet < NumberOfParameterSets; ++parameterSet)
+    {
+      UpdateParameterSet(expectedLogic, parameterSet);
+      expectedLogic->GetTransformBetween(vtkIECTransformLogic::Patient, vtkIECTransformLogic::Collimator, expectedMatrices[parameterSet].data());
+    }
+  }
+
+  UpdateParameterSet(logic, 0);
+  logic->PublishSnapshot();
+
+  std::atomic<bool> writerDone(false);
+  std::atomic<int> numberOfFailures(0);
+  std::atomic<int> numberOfChecks(0);
+  std::vector<std::thread> readers;
+  for (int reader = 0; reader < NumberOfReaders; ++reader)
+  {
+    readers.emplace_back(ReadSnapshots, logic.GetPointer(), std::cref(expectedMatrices), std::cref(writerDone), std::ref(numberOfFailures),
+      std::ref(numberOfChecks));
+  }
+
+  // Writer: the snapshot is published only after all axes of a set are updated. Queries on the logic in between
+  // (as a tracking loop would do) must not publish partial sets.
+  for (int parameterSet = 1; parameterSet < NumberOfParameterSets; ++parameterSet)
+  {
+    UpdateParameterSet(logic, parameterSet);
+    double matrix[16];
+    logic->GetTransformBetween(vtkIECTransformLogic::Patient, vtkIECTransformLogic::Collimator, matrix);
+    logic->PublishSnapshot();
+    // Let the readers run between the sets also on machines with few cores
+    std::this_thread::yield();
+  }
+  writerDone = true;
+  for (std::thread& reader : readers)
+  {
+    reader.join();
+  }
+
+  bool success = true;
+  success &= IECTesting::Check(numberOfFailures == 0, std::to_string(numberOfFailures.load()) + " snapshots do not match a complete parameter set");
+  success &= IECTesting::Check(numberOfChecks >= NumberOfReaders, "Every reader checked snapshots");
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
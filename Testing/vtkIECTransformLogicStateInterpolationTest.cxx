@@ -0,0 +1,176 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Interpolation between machine states: GetTransformsBetweenStates between two published snapshots that differ by one
+// axis, at several fractions including the end points, against the Update call with the interpolated parameter,
+// for rotations up to just under 180 degrees, and IEC::TransformInterpolator along a general screw motion.
+
+// IEC Logic includes
+#include "vtkIECTransformLogic.h"
+#include "IECTransformTestingUtilities.h"
+
+// VTK includes
+#include <vtkNew.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+typedef vtkIECTransformLogic::CoordinateSystemIdentifier Frame;
+typedef std::function<void(vtkIECTransformLogic*, double)> AxisUpdate;
+
+const std::vector<double> Fractions = { 0.0, 0.1, 0.25, 0.5, 0.75, 0.999, 1.0 };
+
+//----------------------------------------------------------------------------
+/// Interpolate between the states with the axis at startValue and endValue, and compare each fraction with the
+/// logic updated to the interpolated value of the axis
+bool TestAxis(vtkIECTransformLogic* logic, const AxisUpdate& updateAxis, double startValue, double endValue, Frame fromFrame, Frame toFrame,
+  const std::string& name)
+{
+  updateAxis(logic, startValue);
+  logic->PublishSnapshot();
+  std::shared_ptr<const vtkIECTransformLogic::MachineStateSnapshot> startState = logic->GetSnapshot();
+  updateAxis(logic, endValue);
+  logic->PublishSnapshot();
+  std::shared_ptr<const vtkIECTransformLogic::MachineStateSnapshot> endState = logic->GetSnapshot();
+
+  const vtkIdType numberOfFractions = static_cast<vtkIdType>(Fractions.size());
+  std::vector<double> matrices(16 * Fractions.size());
+  if (!IECTesting::Check(logic->GetTransformsBetweenStates(*startState, *endState, fromFrame, toFrame, numberOfFractions, Fractions.data(),
+    matrices.data()), name + ": GetTransformsBetweenStates succeeds"))
+  {
+    return false;
+  }
+
+  vtkSmartPointer<vtkIECTransformLogic> updatedLogic = vtkSmartPointer<vtkIECTransformLogic>::Take(logic->Clone());
+  bool success = true;
+  for (std::size_t i = 0; i < Fractions.size(); ++i)
+  {
+    updateAxis(updatedLogic, startValue + Fractions[i] * (endValue - startValue));
+    double expected[16];
+    updatedLogic->GetTransformBetween(fromFrame, toFrame, expected);
+    success &= IECTesting::CheckMatrix(matrices.data() + 16 * i, expected, 1e-9, name + " at fraction " + std::to_string(Fractions[i]));
+  }
+  return success;
+}
+
+//----------------------------------------------------------------------------
+/// A screw motion about a tilted axis through a point away from the origin, by just under 180 degrees
+bool TestTransformInterpolator()
+{
+  const double axis[3] = { 1.0 / std::sqrt(3.0), 1.0 / std::sqrt(3.0), 1.0 / std::sqrt(3.0) };
+  const double axisPoint[3] = { 100.0, -50.0, 20.0 };
+  const double totalAngle = IEC::DegreesToRadians(179.5);
+  const double totalTranslation = 30.0;
+
+  // Rotation about the axis by angle (Rodrigues), about axisPoint, followed by a translation along the axis
+  auto screw = [&](double fraction)
+  {
+    const double angle = fraction * totalAngle;
+    const double c = std::cos(angle);
+    const double s = std::sin(angle);
+    const double t = 1.0 - c;
+    const double x = axis[0];
+    const double y = axis[1];
+    const double z = axis[2];
+    IEC::Matrix4 m = { t * x * x + c, t * x * y - s * z, t * x * z + s * y, 0,
+                       t * x * y + s * z, t * y * y + c, t * y * z - s * x, 0,
+                       t * x * z - s * y, t * y * z + s * x, t * z * z + c, 0,
+                       0, 0, 0, 1 };
+    for (int row = 0; row < 3; ++row)
+    {
+      const double rotatedPoint = m[4 * row] * axisPoint[0] + m[4 * row + 1] * axisPoint[1] + m[4 * row + 2] * axisPoint[2];
+      m[4 * row + 3] = axisPoint[row] - rotatedPoint + fraction * totalTranslation * axis[row];
+    }
+    return m;
+  };
+
+  const IEC::Matrix4 start = IEC::TranslationRotationXYZMatrix(5.0, 6.0, 7.0, std::cos(0.3), std::sin(0.3), 1, 0, std::cos(-0.2), std::sin(-0.2));
+  IEC::TransformInterpolator interpolator;
+  if (!IECTesting::Check(interpolator.Initialize(start, IEC::Multiply(screw(1.0), start)), "TransformInterpolator::Initialize succeeds"))
+  {
+    return false;
+  }
+  bool success = true;
+  for (double fraction : Fractions)
+  {
+    double matrix[16];
+    interpolator.Evaluate(fraction, matrix);
+    const IEC::Matrix4 expected = IEC::Multiply(screw(fraction), start);
+    success &= IECTesting::CheckMatrix(matrix, expected.data(), 1e-9, "TransformInterpolator at fraction " + std::to_string(fraction));
+  }
+  return success;
+}
+
+} // namespace
+
+//----------------------------------------------------------------------------
+int main()
+{
+  vtkNew<vtkIECTransformLogic> logic;
+  IECTesting::UpdateNonTrivialTransforms(logic.GetPointer());
+  const IEC::MachineParameters parameters = logic->GetMachineState();
+
+  const AxisUpdate gantry = [&parameters](vtkIECTransformLogic* l, double angleDeg)
+  {
+    l->UpdateGantryToFixedReferenceTransform(angleDeg, parameters.Gantry.PitchAngleDeg);
+  };
+  const AxisUpdate collimator = [&parameters](vtkIECTransformLogic* l, double angleDeg)
+  {
+    l->UpdateCollimatorToGantryTransform(angleDeg, parameters.Collimator.Bz);
+  };
+  const AxisUpdate patientSupport = [](vtkIECTransformLogic* l, double angleDeg)
+  {
+    l->UpdatePatientSupportRotationToFixedReferenceTransform(angleDeg);
+  };
+  const AxisUpdate tableTopLateral = [&parameters](vtkIECTransformLogic* l, double tx)
+  {
+    l->UpdateTableTopToTableTopEccentricRotationTransform(tx, parameters.TableTop.Ty, parameters.TableTop.Tz,
+      parameters.TableTop.PitchAngleDeg, parameters.TableTop.RollAngleDeg);
+  };
+
+  bool success = true;
+  success &= TestAxis(logic, gantry, 30.0, 120.0, vtkIECTransformLogic::PatientImageRegularGrid, vtkIECTransformLogic::Collimator,
+    "Gantry 30 -> 120");
+  success &= TestAxis(logic, gantry, 0.0, 179.5, vtkIECTransformLogic::Collimator, vtkIECTransformLogic::PatientImageRegularGrid,
+    "Gantry 0 -> 179.5");
+  success &= TestAxis(logic, gantry, 350.0, 190.5, vtkIECTransformLogic::RAS, vtkIECTransformLogic::WedgeFilter, "Gantry 350 -> 190.5");
+  success &= TestAxis(logic, collimator, 10.0, 100.0, vtkIECTransformLogic::RAS, vtkIECTransformLogic::WedgeFilter, "Collimator 10 -> 100");
+  success &= TestAxis(logic, patientSupport, -45.0, 90.0, vtkIECTransformLogic::Patient, vtkIECTransformLogic::Gantry,
+    "Patient support -45 -> 90");
+  success &= TestAxis(logic, tableTopLateral, -20.0, 35.0, vtkIECTransformLogic::Focus, vtkIECTransformLogic::Patient, "Table top lateral -20 -> 35");
+
+  // States whose transforms differ by a scaling cannot be interpolated
+  logic->PublishSnapshot();
+  std::shared_ptr<const vtkIECTransformLogic::MachineStateSnapshot> startState = logic->GetSnapshot();
+  logic->UpdatePatientImageRegularGridToDICOMTransform(1.8, 1.1, 2.5, -200.0, -180.0, -95.0);
+  logic->PublishSnapshot();
+  double matrix[16];
+  const double fraction = 0.5;
+  success &= IECTesting::Check(!logic->GetTransformsBetweenStates(*startState, *logic->GetSnapshot(), vtkIECTransformLogic::PatientImageRegularGrid,
+    vtkIECTransformLogic::Collimator, 1, &fraction, matrix), "GetTransformsBetweenStates rejects states that differ by a scaling");
+
+  success &= TestTransformInterpolator();
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
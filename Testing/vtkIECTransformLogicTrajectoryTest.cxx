@@ -0,0 +1,163 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Trajectories of vtkIECTransformLogic: control point i of GetTransformsAlongTrajectory and
+// GetTransformsForMachineParameters against the Update calls with the parameters of control point i, also when the
+// elementary matrices were set directly so that the machine parameters of the logic are not valid.
+
+// IEC Logic includes
+#include "vtkIECTransformLogic.h"
+#include "IECTransformTestingUtilities.h"
+
+// VTK includes
+#include <vtkNew.h>
+#include <vtkSmartPointer.h>
+#include <vtkTransform.h>
+
+// STD includes
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+typedef vtkIECTransformLogic::CoordinateSystemIdentifier Frame;
+
+/// Machine parameters of the control points of a trajectory
+struct Trajectory
+{
+  std::vector<double> GantryRotationAnglesDeg = { 181.0, 200.5, 250.0, 300.25, 359.0, 10.0, 45.0 };
+  std::vector<double> CollimatorRotationAnglesDeg = { 0.0, 5.0, 10.0, 15.0, 20.0, 25.0, 30.0 };
+  std::vector<double> PatientSupportRotationAnglesDeg = { 0.0, 0.0, 10.0, 10.0, 350.0, 350.0, 0.0 };
+  std::vector<double> TableTopTx = { 0.0, 1.0, 2.0, 3.0, 4.0, 5.0, 6.0 };
+  std::vector<double> TableTopTy = { -250.0, -251.0, -252.0, -253.0, -254.0, -255.0, -256.0 };
+  std::vector<double> TableTopTz = { 80.0, 79.0, 78.0, 77.0, 76.0, 75.0, 74.0 };
+
+  vtkIdType GetNumberOfControlPoints() const { return static_cast<vtkIdType>(this->GantryRotationAnglesDeg.size()); }
+};
+
+//----------------------------------------------------------------------------
+/// Compare the matrices of the control points with the Update calls on a copy of the logic, using the given fixed axes
+bool CheckControlPoints(vtkIECTransformLogic* logic, Frame fromFrame, Frame toFrame, const Trajectory& trajectory, const std::vector<double>& matrices,
+  double gantryPitchAngleDeg, double collimatorBz, double tableTopPitchAngleDeg, double tableTopRollAngleDeg, const std::string& name)
+{
+  vtkSmartPointer<vtkIECTransformLogic> updatedLogic = vtkSmartPointer<vtkIECTransformLogic>::Take(logic->Clone());
+  bool success = true;
+  for (vtkIdType controlPoint = 0; controlPoint < trajectory.GetNumberOfControlPoints(); ++controlPoint)
+  {
+    updatedLogic->UpdateGantryToFixedReferenceTransform(trajectory.GantryRotationAnglesDeg[controlPoint], gantryPitchAngleDeg);
+    updatedLogic->UpdateCollimatorToGantryTransform(trajectory.CollimatorRotationAnglesDeg[controlPoint], collimatorBz);
+    updatedLogic->UpdatePatientSupportRotationToFixedReferenceTransform(trajectory.PatientSupportRotationAnglesDeg[controlPoint]);
+    updatedLogic->UpdateTableTopToTableTopEccentricRotationTransform(trajectory.TableTopTx[controlPoint], trajectory.TableTopTy[controlPoint],
+      trajectory.TableTopTz[controlPoint], tableTopPitchAngleDeg, tableTopRollAngleDeg);
+    double expected[16];
+    updatedLogic->GetTransformBetween(fromFrame, toFrame, expected);
+    success &= IECTesting::CheckMatrix(matrices.data() + 16 * controlPoint, expected, 1e-9, name + " control point " + std::to_string(controlPoint));
+  }
+  return success;
+}
+
+//----------------------------------------------------------------------------
+/// Control point i of GetTransformsAlongTrajectory is the transform after updating the axes to the values of control point i
+bool TestTransformsAlongTrajectory(vtkIECTransformLogic* logic)
+{
+  const Frame fromFrame = vtkIECTransformLogic::PatientImageRegularGrid;
+  const Frame toFrame = vtkIECTransformLogic::Collimator;
+  const Trajectory trajectory;
+
+  double stateBefore[16];
+  logic->GetTransformBetween(fromFrame, toFrame, stateBefore);
+  std::vector<double> matrices(16 * trajectory.GetNumberOfControlPoints());
+  if (!IECTesting::Check(logic->GetTransformsAlongTrajectory(fromFrame, toFrame, trajectory.GetNumberOfControlPoints(),
+    trajectory.GantryRotationAnglesDeg.data(), trajectory.CollimatorRotationAnglesDeg.data(), trajectory.PatientSupportRotationAnglesDeg.data(),
+    trajectory.TableTopTx.data(), trajectory.TableTopTy.data(), trajectory.TableTopTz.data(), matrices.data()), "GetTransformsAlongTrajectory succeeds"))
+  {
+    return false;
+  }
+  double stateAfter[16];
+  logic->GetTransformBetween(fromFrame, toFrame, stateAfter);
+  bool success = IECTesting::CheckMatrix(stateAfter, stateBefore, 0.0, "GetTransformsAlongTrajectory keeps the stored transforms");
+
+  const IEC::MachineParameters& parameters = logic->GetMachineState();
+  success &= CheckControlPoints(logic, fromFrame, toFrame, trajectory, matrices, parameters.Gantry.PitchAngleDeg, parameters.Collimator.Bz,
+    parameters.TableTop.PitchAngleDeg, parameters.TableTop.RollAngleDeg, "GetTransformsAlongTrajectory");
+
+  // The same control points as one N x 6 array
+  std::vector<double> parameterRows;
+  for (vtkIdType controlPoint = 0; controlPoint < trajectory.GetNumberOfControlPoints(); ++controlPoint)
+  {
+    parameterRows.insert(parameterRows.end(), { trajectory.GantryRotationAnglesDeg[controlPoint], trajectory.CollimatorRotationAnglesDeg[controlPoint],
+      trajectory.PatientSupportRotationAnglesDeg[controlPoint], trajectory.TableTopTx[controlPoint], trajectory.TableTopTy[controlPoint],
+      trajectory.TableTopTz[controlPoint] });
+  }
+  std::vector<double> rowMatrices(matrices.size());
+  success &= IECTesting::Check(logic->GetTransformsForMachineParameters(fromFrame, toFrame, trajectory.GetNumberOfControlPoints(), 6,
+    parameterRows.data(), static_cast<vtkIdType>(parameterRows.size()), rowMatrices.data(), static_cast<vtkIdType>(rowMatrices.size())),
+    "GetTransformsForMachineParameters succeeds");
+  for (vtkIdType controlPoint = 0; controlPoint < trajectory.GetNumberOfControlPoints(); ++controlPoint)
+  {
+    success &= IECTesting::CheckMatrix(rowMatrices.data() + 16 * controlPoint, matrices.data() + 16 * controlPoint, 0.0,
+      "GetTransformsForMachineParameters control point " + std::to_string(controlPoint));
+  }
+  return success;
+}
+
+//----------------------------------------------------------------------------
+/// The gantry pitch, collimator bz and table top pitch and roll of the control points are those of the current matrices,
+/// also when these were set on the vtkTransforms instead of by the Update methods
+bool TestTransformsAlongTrajectoryAfterSetMatrix(vtkIECTransformLogic* logic)
+{
+  const Frame fromFrame = vtkIECTransformLogic::Patient;
+  const Frame toFrame = vtkIECTransformLogic::Collimator;
+  const Trajectory trajectory;
+  const double gantryPitchAngleDeg = -7.0;
+  const double collimatorBz = -35.0;
+  const double tableTopPitchAngleDeg = 3.5;
+  const double tableTopRollAngleDeg = -2.0;
+
+  const IEC::Matrix4 gantryMatrix = IEC::GantryToFixedReferenceMatrix(90.0, gantryPitchAngleDeg);
+  const IEC::Matrix4 collimatorMatrix = IEC::CollimatorToGantryMatrix(45.0, collimatorBz);
+  const IEC::Matrix4 tableTopMatrix = IEC::TableTopToTableTopEccentricRotationMatrix(10.0, 20.0, 30.0, tableTopPitchAngleDeg, tableTopRollAngleDeg);
+  logic->GetElementaryTransformBetween(vtkIECTransformLogic::Gantry, vtkIECTransformLogic::FixedReference)->SetMatrix(gantryMatrix.data());
+  logic->GetElementaryTransformBetween(vtkIECTransformLogic::Collimator, vtkIECTransformLogic::Gantry)->SetMatrix(collimatorMatrix.data());
+  logic->GetElementaryTransformBetween(vtkIECTransformLogic::TableTop, vtkIECTransformLogic::TableTopEccentricRotation)->SetMatrix(tableTopMatrix.data());
+
+  std::vector<double> matrices(16 * trajectory.GetNumberOfControlPoints());
+  if (!IECTesting::Check(logic->GetTransformsAlongTrajectory(fromFrame, toFrame, trajectory.GetNumberOfControlPoints(),
+    trajectory.GantryRotationAnglesDeg.data(), trajectory.CollimatorRotationAnglesDeg.data(), trajectory.PatientSupportRotationAnglesDeg.data(),
+    trajectory.TableTopTx.data(), trajectory.TableTopTy.data(), trajectory.TableTopTz.data(), matrices.data()),
+    "GetTransformsAlongTrajectory succeeds after setting the matrices"))
+  {
+    return false;
+  }
+  return CheckControlPoints(logic, fromFrame, toFrame, trajectory, matrices, gantryPitchAngleDeg, collimatorBz, tableTopPitchAngleDeg,
+    tableTopRollAngleDeg, "GetTransformsAlongTrajectory after setting the matrices");
+}
+
+} // namespace
+
+//----------------------------------------------------------------------------
+int main()
+{
+  vtkNew<vtkIECTransformLogic> logic;
+  IECTesting::UpdateNonTrivialTransforms(logic.GetPointer());
+
+  bool success = true;
+  success &= TestTransformsAlongTrajectory(logic);
+  success &= TestTransformsAlongTrajectoryAfterSetMatrix(logic);
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,221 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Transform cache of vtkIECTransformLogic: a cached transform is reused after updates of elementary transforms off its
+// path, and recomposed after updates on its path, including changes made directly to the vtkTransform of an elementary
+// transform, which set the parameters of the transform to NaN. SetMachineState rebuilds only the transforms whose
+// parameters changed. Results are compared with a logic in the same state that has the cache disabled.
+
+// IEC Logic includes
+#include "vtkIECTransformLogic.h"
+#include "IECTransformTestingUtilities.h"
+
+// VTK includes
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtkTransform.h>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <string>
+
+namespace
+{
+
+typedef vtkIECTransformLogic::CoordinateSystemIdentifier Frame;
+
+//----------------------------------------------------------------------------
+/// Query the transform, check that it was answered from the cache or composed as expected, and that it equals the
+/// transform of the reference logic
+bool CheckQuery(vtkIECTransformLogic* logic, vtkIECTransformLogic* referenceLogic, Frame fromFrame, Frame toFrame, bool expectCacheHit,
+  const std::string& name)
+{
+  const vtkTypeUInt64 hits = logic->GetTransformCacheHits();
+  const vtkTypeUInt64 misses = logic->GetTransformCacheMisses();
+  double matrix[16];
+  double expectedMatrix[16];
+  if (!IECTesting::Check(logic->GetTransformBetween(fromFrame, toFrame, matrix)
+    && referenceLogic->GetTransformBetween(fromFrame, toFrame, expectedMatrix), name + ": GetTransformBetween succeeds"))
+  {
+    return false;
+  }
+  bool success = IECTesting::Check(logic->GetTransformCacheHits() == hits + (expectCacheHit ? 1 : 0)
+    && logic->GetTransformCacheMisses() == misses + (expectCacheHit ? 0 : 1),
+    name + (expectCacheHit ? ": answered from the cache" : ": composed again"));
+  success &= IECTesting::CheckMatrix(matrix, expectedMatrix, 1e-9, name + ": " + logic->GetTransformNameBetween(fromFrame, toFrame));
+  return success;
+}
+
+//----------------------------------------------------------------------------
+/// Updates of elementary transforms on and off the path of a cached transform
+bool TestUpdates(vtkIECTransformLogic* logic, vtkIECTransformLogic* referenceLogic)
+{
+  auto update = [&](const std::function<void(vtkIECTransformLogic*)>& updateLogic)
+  {
+    updateLogic(logic);
+    updateLogic(referenceLogic);
+  };
+
+  const Frame from = vtkIECTransformLogic::PatientImageRegularGrid;
+  const Frame to = vtkIECTransformLogic::Collimator;
+  bool success = true;
+  success &= CheckQuery(logic, referenceLogic, from, to, false, "First query");
+  success &= CheckQuery(logic, referenceLogic, from, to, true, "Repeated query");
+
+  update([](vtkIECTransformLogic* l) { l->UpdateImagerToFixedReferenceTransform(45.0); });
+  success &= CheckQuery(logic, referenceLogic, from, to, true, "Query after an update off the path");
+
+  update([](vtkIECTransformLogic* l) { l->UpdateGantryToFixedReferenceTransform(50.0); });
+  success &= CheckQuery(logic, referenceLogic, from, to, false, "Query after an update on the path");
+
+  // Same parameters: the transform is not rebuilt, so the cached transform stays valid
+  update([](vtkIECTransformLogic* l) { l->UpdateGantryToFixedReferenceTransform(50.0); });
+  success &= CheckQuery(logic, referenceLogic, from, to, true, "Query after an update with unchanged parameters");
+
+  update([](vtkIECTransformLogic* l) { l->UpdatePatientToTableTopTransform(1.0, 2.0, 3.0, 4.0, 5.0, 6.0); });
+  success &= CheckQuery(logic, referenceLogic, from, to, false, "Query after an update on the patient side of the path");
+
+  // Transforms set from matrices
+  const IEC::Matrix4 panelMatrix = IEC::TranslationRotationXYZMatrix(-450.0, 10.0, 30.0, 1, 0, 0, 1, 1, 0);
+  update([&](vtkIECTransformLogic* l) { l->UpdateLeftImagingPanelToGantryTransform(panelMatrix.data()); });
+  success &= CheckQuery(logic, referenceLogic, from, to, true, "Query after setting a panel transform off the path");
+  success &= CheckQuery(logic, referenceLogic, vtkIECTransformLogic::LeftImagingPanel, vtkIECTransformLogic::Patient, false,
+    "First query through the panel");
+  const IEC::Matrix4 otherPanelMatrix = IEC::TranslationRotationXYZMatrix(-500.0, 0.0, 20.0, 1, 0, 0, 1, 1, 0);
+  update([&](vtkIECTransformLogic* l) { l->UpdateLeftImagingPanelToGantryTransform(otherPanelMatrix.data()); });
+  success &= CheckQuery(logic, referenceLogic, vtkIECTransformLogic::LeftImagingPanel, vtkIECTransformLogic::Patient, false,
+    "Query after setting the panel transform on the path");
+  return success;
+}
+
+//----------------------------------------------------------------------------
+/// Changes made directly to the vtkTransform of an elementary transform are taken over by the next query
+bool TestExternalModification(vtkIECTransformLogic* logic, vtkIECTransformLogic* referenceLogic)
+{
+  const Frame from = vtkIECTransformLogic::PatientImageRegularGrid;
+  const Frame to = vtkIECTransformLogic::Collimator;
+  bool success = true;
+
+  vtkTransform* gantryTransform = logic->GetElementaryTransformBetween(vtkIECTransformLogic::Gantry, vtkIECTransformLogic::FixedReference);
+  vtkTransform* imagerTransform = logic->GetElementaryTransformBetween(vtkIECTransformLogic::Imager, vtkIECTransformLogic::FixedReference);
+  if (!IECTesting::Check(gantryTransform && imagerTransform, "GetElementaryTransformBetween succeeds"))
+  {
+    return false;
+  }
+  success &= CheckQuery(logic, referenceLogic, from, to, true, "Query after creating the vtkTransforms");
+
+  // Off the path
+  const IEC::Matrix4 imagerMatrix = IEC::ImagerToFixedReferenceMatrix(-30.0, 0.0);
+  imagerTransform->SetMatrix(imagerMatrix.data());
+  referenceLogic->UpdateImagerToFixedReferenceTransform(-30.0);
+  success &= CheckQuery(logic, referenceLogic, from, to, true, "Query after modifying a vtkTransform off the path");
+  success &= CheckQuery(logic, referenceLogic, vtkIECTransformLogic::Focus, vtkIECTransformLogic::Patient, false,
+    "Query through the modified vtkTransform");
+
+  // On the path
+  const IEC::Matrix4 gantryMatrix = IEC::GantryToFixedReferenceMatrix(80.0, 0.0);
+  gantryTransform->SetMatrix(gantryMatrix.data());
+  referenceLogic->UpdateGantryToFixedReferenceTransform(80.0);
+  success &= CheckQuery(logic, referenceLogic, from, to, false, "Query after modifying a vtkTransform on the path");
+  success &= CheckQuery(logic, referenceLogic, from, to, true, "Repeated query after modifying a vtkTransform");
+
+  // Modified through the vtkTransform API
+  gantryTransform->RotateY(10.0);
+  double expectedGantryMatrix[16];
+  std::copy(gantryTransform->GetMatrix()->GetData(), gantryTransform->GetMatrix()->GetData() + 16, expectedGantryMatrix);
+  referenceLogic->UpdateGantryToFixedReferenceTransform(0.0);
+  referenceLogic->GetElementaryTransformBetween(vtkIECTransformLogic::Gantry, vtkIECTransformLogic::FixedReference)->SetMatrix(expectedGantryMatrix);
+  success &= CheckQuery(logic, referenceLogic, from, to, false, "Query after rotating a vtkTransform on the path");
+  const IEC::GantryParameters& gantryParameters = logic->GetGantryParameters();
+  success &= IECTesting::Check(std::isnan(gantryParameters.RotationAngleDeg) && std::isnan(gantryParameters.PitchAngleDeg),
+    "The gantry parameters are NaN after modifying the vtkTransform");
+
+  // The parameters no longer describe the matrix, so updating with the earlier parameters rebuilds the transform
+  logic->UpdateGantryToFixedReferenceTransform(80.0);
+  referenceLogic->UpdateGantryToFixedReferenceTransform(80.0);
+  success &= CheckQuery(logic, referenceLogic, from, to, false, "Query after updating with the parameters before the modification");
+  success &= IECTesting::CheckMatrix(gantryTransform->GetMatrix()->GetData(), gantryMatrix.data(), 1e-12,
+    "The vtkTransform follows the Update method");
+  success &= IECTesting::Check(logic->GetGantryParameters().RotationAngleDeg == 80.0, "The gantry parameters are set by the Update method");
+  return success;
+}
+
+//----------------------------------------------------------------------------
+/// SetMachineState rebuilds the transforms whose parameters changed and keeps the ones with NaN parameters, so that the
+/// transforms cached through the other axes stay valid. Runs after \sa TestExternalModification, which leaves the imager
+/// parameters of the logic NaN.
+bool TestSetMachineState(vtkIECTransformLogic* logic, vtkIECTransformLogic* referenceLogic)
+{
+  const Frame from = vtkIECTransformLogic::PatientImageRegularGrid;
+  const Frame to = vtkIECTransformLogic::Collimator;
+  const Frame imagerFrom = vtkIECTransformLogic::Focus;
+  const Frame imagerTo = vtkIECTransformLogic::FixedReference;
+  bool success = true;
+  success &= IECTesting::Check(std::isnan(logic->GetImagerParameters().RotationAngleDeg), "The imager parameters are NaN");
+  success &= CheckQuery(logic, referenceLogic, from, to, true, "Query before SetMachineState");
+  success &= CheckQuery(logic, referenceLogic, imagerFrom, imagerTo, false, "First imager query");
+
+  // The parameters of the logic itself, including the NaN ones
+  success &= IECTesting::Check(logic->SetMachineState(logic->GetMachineState()) == 0, "SetMachineState with the current parameters rebuilds nothing");
+  success &= CheckQuery(logic, referenceLogic, from, to, true, "Query after SetMachineState with the current parameters");
+  success &= CheckQuery(logic, referenceLogic, imagerFrom, imagerTo, true, "Imager query after SetMachineState with the current parameters");
+
+  // Two axes on the path
+  IEC::MachineParameters state = logic->GetMachineState();
+  state.Gantry.RotationAngleDeg = 120.0;
+  state.TableTop.Tx += 5.0;
+  referenceLogic->UpdateGantryToFixedReferenceTransform(state.Gantry.RotationAngleDeg, state.Gantry.PitchAngleDeg);
+  referenceLogic->UpdateTableTopToTableTopEccentricRotationTransform(state.TableTop.Tx, state.TableTop.Ty, state.TableTop.Tz,
+    state.TableTop.PitchAngleDeg, state.TableTop.RollAngleDeg);
+  success &= IECTesting::Check(logic->SetMachineState(state) == 2, "SetMachineState with two changed axes rebuilds two transforms");
+  success &= CheckQuery(logic, referenceLogic, from, to, false, "Query after SetMachineState with two changed axes");
+  success &= CheckQuery(logic, referenceLogic, imagerFrom, imagerTo, true, "Imager query after SetMachineState with two changed axes");
+  success &= IECTesting::Check(std::isnan(logic->GetImagerParameters().RotationAngleDeg), "The imager parameters stay NaN");
+
+  // A matrix set directly invalidates the parameters, so SetMachineState rebuilds the transform with the same parameters
+  const IEC::Matrix4 collimatorMatrix = IEC::CollimatorToGantryMatrix(33.0, 0.0);
+  success &= IECTesting::Check(logic->UpdateFrameToParentTransform(vtkIECTransformLogic::Collimator, collimatorMatrix.data()),
+    "UpdateFrameToParentTransform of the collimator succeeds");
+  const IEC::CollimatorParameters& collimatorParameters = logic->GetCollimatorParameters();
+  success &= IECTesting::Check(std::isnan(collimatorParameters.RotationAngleDeg) && std::isnan(collimatorParameters.Bz),
+    "The collimator parameters are NaN after setting its matrix");
+  success &= IECTesting::Check(logic->GetGantryParameters().RotationAngleDeg == 120.0, "The other parameters are kept");
+  success &= IECTesting::Check(logic->SetMachineState(state) == 1, "SetMachineState after setting the collimator matrix rebuilds the collimator");
+  success &= CheckQuery(logic, referenceLogic, from, to, false, "Query after rebuilding the collimator");
+  success &= IECTesting::Check(logic->GetCollimatorParameters() == state.Collimator, "The collimator parameters are set by SetMachineState");
+  return success;
+}
+
+} // namespace
+
+//----------------------------------------------------------------------------
+int main()
+{
+  vtkNew<vtkIECTransformLogic> logic;
+  vtkNew<vtkIECTransformLogic> referenceLogic;
+  referenceLogic->SetTransformCacheEnabled(false);
+  IECTesting::UpdateNonTrivialTransforms(logic.GetPointer());
+  IECTesting::UpdateNonTrivialTransforms(referenceLogic.GetPointer());
+
+  bool success = true;
+  success &= TestUpdates(logic, referenceLogic);
+  success &= TestExternalModification(logic, referenceLogic);
+  success &= TestSetMachineState(logic, referenceLogic);
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,226 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Transforms of vtkIECTransformLogic: GetTransformBetween for all frame pairs against a concatenation of the elementary
+// vtkTransforms, the concatenated transforms of all frames, and changes made directly to the vtkTransform of an
+// elementary transform.
+
+// IEC Logic includes
+#include "vtkIECTransformLogic.h"
+#include "IECTransformTestingUtilities.h"
+
+// VTK includes
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtkSmartPointer.h>
+#include <vtkTransform.h>
+
+// STD includes
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+typedef vtkIECTransformLogic::CoordinateSystemIdentifier Frame;
+
+//----------------------------------------------------------------------------
+std::string GetPairName(int fromFrame, int toFrame)
+{
+  return std::string(IEC::CoordinateSystemNames[fromFrame]) + " -> " + IEC::CoordinateSystemNames[toFrame];
+}
+
+//----------------------------------------------------------------------------
+/// Reference transform frame -> FixedReference: the elementary vtkTransforms concatenated from the root down to the frame
+void GetReferenceTransformToRoot(vtkIECTransformLogic* logic, Frame frame, vtkMatrix4x4* outputMatrix)
+{
+  std::vector<vtkTransform*> pathToRoot;
+  const std::vector<std::pair<Frame, Frame>> elementaryTransforms = logic->GetIECTransforms();
+  while (frame != vtkIECTransformLogic::FixedReference)
+  {
+    for (const std::pair<Frame, Frame>& elementaryTransform : elementaryTransforms)
+    {
+      if (elementaryTransform.first == frame)
+      {
+        pathToRoot.push_back(logic->GetElementaryTransformBetween(elementaryTransform.first, elementaryTransform.second));
+        frame = elementaryTransform.second;
+        break;
+      }
+    }
+  }
+
+  vtkNew<vtkTransform> transform;
+  for (auto it = pathToRoot.rbegin(); it != pathToRoot.rend(); ++it)
+  {
+    transform->Concatenate(*it);
+  }
+  outputMatrix->DeepCopy(transform->GetMatrix());
+}
+
+//----------------------------------------------------------------------------
+bool TestTransformBetweenAllFrames(vtkIECTransformLogic* logic)
+{
+  bool success = true;
+  for (int fromFrame = 0; fromFrame < vtkIECTransformLogic::LastIECCoordinateFrame; ++fromFrame)
+  {
+    vtkNew<vtkMatrix4x4> fromFrameToRoot;
+    GetReferenceTransformToRoot(logic, static_cast<Frame>(fromFrame), fromFrameToRoot);
+    for (int toFrame = 0; toFrame < vtkIECTransformLogic::LastIECCoordinateFrame; ++toFrame)
+    {
+      vtkNew<vtkMatrix4x4> rootToToFrame;
+      GetReferenceTransformToRoot(logic, static_cast<Frame>(toFrame), rootToToFrame);
+      rootToToFrame->Invert();
+      vtkNew<vtkTransform> expected;
+      expected->Concatenate(rootToToFrame);
+      expected->Concatenate(fromFrameToRoot);
+
+      const std::string name = "GetTransformBetween " + GetPairName(fromFrame, toFrame);
+      vtkNew<vtkMatrix4x4> matrix;
+      double rowMajorMatrix[16];
+      if (!IECTesting::Check(logic->GetTransformBetween(static_cast<Frame>(fromFrame), static_cast<Frame>(toFrame), matrix.GetPointer())
+        && logic->GetTransformBetween(static_cast<Frame>(fromFrame), static_cast<Frame>(toFrame), rowMajorMatrix), name + " succeeds"))
+      {
+        success = false;
+        continue;
+      }
+      success &= IECTesting::CheckMatrix(matrix->GetData(), expected->GetMatrix()->GetData(), 1e-9, name);
+      success &= IECTesting::CheckMatrix(rowMajorMatrix, matrix->GetData(), 0.0, name + " (row-major array)");
+    }
+  }
+
+  // Compile-time paths
+  double matrix[16];
+  double expected[16];
+  success &= IECTesting::Check(logic->GetTransform<vtkIECTransformLogic::PatientImageRegularGrid, vtkIECTransformLogic::Collimator>(matrix)
+    && logic->GetTransformBetween(vtkIECTransformLogic::PatientImageRegularGrid, vtkIECTransformLogic::Collimator, expected), "GetTransform<> succeeds");
+  success &= IECTesting::CheckMatrix(matrix, expected, 1e-9, "GetTransform<> " + GetPairName(vtkIECTransformLogic::PatientImageRegularGrid, vtkIECTransformLogic::Collimator));
+  success &= IECTesting::Check(logic->GetTransform<vtkIECTransformLogic::Focus, vtkIECTransformLogic::RAS>(matrix)
+    && logic->GetTransformBetween(vtkIECTransformLogic::Focus, vtkIECTransformLogic::RAS, expected), "GetTransform<> succeeds");
+  success &= IECTesting::CheckMatrix(matrix, expected, 1e-9, "GetTransform<> " + GetPairName(vtkIECTransformLogic::Focus, vtkIECTransformLogic::RAS));
+  return success;
+}
+
+//----------------------------------------------------------------------------
+/// The concatenated transform of a frame is FixedReferenceToRas after the transform frame -> FixedReference
+bool TestConcatenatedTransforms(vtkIECTransformLogic* logic)
+{
+  const double* fixedReferenceToRas = logic->GetElementaryTransformBetween(vtkIECTransformLogic::FixedReference, vtkIECTransformLogic::RAS)
+    ->GetMatrix()->GetData();
+  bool success = true;
+  for (int frame = 0; frame < vtkIECTransformLogic::LastIECCoordinateFrame; ++frame)
+  {
+    double matrix[16];
+    double frameToFixedReference[16];
+    const std::string name = std::string("GetConcatenatedTransform ") + IEC::CoordinateSystemNames[frame];
+    if (!IECTesting::Check(logic->GetConcatenatedTransform(static_cast<Frame>(frame), matrix)
+      && logic->GetTransformBetween(static_cast<Frame>(frame), vtkIECTransformLogic::FixedReference, frameToFixedReference), name + " succeeds"))
+    {
+      success = false;
+      continue;
+    }
+    double expected[16];
+    vtkMatrix4x4::Multiply4x4(fixedReferenceToRas, frameToFixedReference, expected);
+    success &= IECTesting::CheckMatrix(matrix, expected, 1e-9, name);
+  }
+
+  // The panels are attached to the gantry, they do not follow the collimator
+  const Frame panels[3] = { vtkIECTransformLogic::LeftImagingPanel, vtkIECTransformLogic::RightImagingPanel, vtkIECTransformLogic::FlatPanel };
+  double panelMatrices[3][16];
+  for (int i = 0; i < 3; ++i)
+  {
+    logic->GetConcatenatedTransform(panels[i], panelMatrices[i]);
+  }
+  double collimatorMatrix[16];
+  logic->GetConcatenatedTransform(vtkIECTransformLogic::Collimator, collimatorMatrix);
+  const IEC::CollimatorParameters collimatorParameters = logic->GetCollimatorParameters();
+  logic->UpdateCollimatorToGantryTransform(collimatorParameters.RotationAngleDeg + 30.0, collimatorParameters.Bz);
+  for (int i = 0; i < 3; ++i)
+  {
+    double matrix[16];
+    logic->GetConcatenatedTransform(panels[i], matrix);
+    success &= IECTesting::CheckMatrix(matrix, panelMatrices[i], 0.0,
+      std::string("GetConcatenatedTransform ") + IEC::CoordinateSystemNames[panels[i]] + " after a collimator rotation");
+  }
+  double rotatedCollimatorMatrix[16];
+  logic->GetConcatenatedTransform(vtkIECTransformLogic::Collimator, rotatedCollimatorMatrix);
+  success &= IECTesting::Check(std::memcmp(rotatedCollimatorMatrix, collimatorMatrix, sizeof(collimatorMatrix)) != 0,
+    "GetConcatenatedTransform Collimator follows the collimator rotation");
+  logic->UpdateCollimatorToGantryTransform(collimatorParameters.RotationAngleDeg, collimatorParameters.Bz);
+  return success;
+}
+
+//----------------------------------------------------------------------------
+/// A change made directly to the vtkTransform of an elementary transform is taken over by all queries, as an Update call would be
+bool TestModifiedElementaryTransform(vtkIECTransformLogic* logic)
+{
+  // Queried before, so that the concatenated transforms and the snapshot are up to date with the old gantry transform
+  double matrix[16];
+  logic->GetConcatenatedTransform(vtkIECTransformLogic::Collimator, matrix);
+  logic->PublishSnapshot();
+
+  const IEC::GantryParameters gantryParameters = logic->GetGantryParameters();
+  vtkSmartPointer<vtkIECTransformLogic> expectedLogic = vtkSmartPointer<vtkIECTransformLogic>::Take(logic->Clone());
+  expectedLogic->UpdateGantryToFixedReferenceTransform(gantryParameters.RotationAngleDeg + 45.0, gantryParameters.PitchAngleDeg);
+  const IEC::Matrix4 gantryMatrix = IEC::GantryToFixedReferenceMatrix(gantryParameters.RotationAngleDeg + 45.0, gantryParameters.PitchAngleDeg);
+  logic->GetElementaryTransformBetween(vtkIECTransformLogic::Gantry, vtkIECTransformLogic::FixedReference)->SetMatrix(gantryMatrix.data());
+
+  bool success = true;
+  double expected[16];
+  logic->GetConcatenatedTransform(vtkIECTransformLogic::Collimator, matrix);
+  expectedLogic->GetConcatenatedTransform(vtkIECTransformLogic::Collimator, expected);
+  success &= IECTesting::CheckMatrix(matrix, expected, 1e-9, "GetConcatenatedTransform Collimator after modifying the gantry vtkTransform");
+
+  logic->GetTransform<vtkIECTransformLogic::PatientImageRegularGrid, vtkIECTransformLogic::Collimator>(matrix);
+  expectedLogic->GetTransformBetween(vtkIECTransformLogic::PatientImageRegularGrid, vtkIECTransformLogic::Collimator, expected);
+  success &= IECTesting::CheckMatrix(matrix, expected, 1e-9, "GetTransform<> after modifying the gantry vtkTransform");
+
+  const double collimatorAngleDeg = 20.0;
+  logic->GetTransformsAlongTrajectory(vtkIECTransformLogic::Patient, vtkIECTransformLogic::Collimator, 1, nullptr, &collimatorAngleDeg,
+    nullptr, nullptr, nullptr, nullptr, matrix);
+  expectedLogic->GetTransformsAlongTrajectory(vtkIECTransformLogic::Patient, vtkIECTransformLogic::Collimator, 1, nullptr, &collimatorAngleDeg,
+    nullptr, nullptr, nullptr, nullptr, expected);
+  success &= IECTesting::CheckMatrix(matrix, expected, 1e-9, "GetTransformsAlongTrajectory after modifying the gantry vtkTransform");
+
+  logic->PublishSnapshot();
+  expectedLogic->GetTransformBetween(vtkIECTransformLogic::Patient, vtkIECTransformLogic::Collimator, expected);
+  success &= IECTesting::Check(logic->GetSnapshot()->GetTransformBetween(vtkIECTransformLogic::Patient, vtkIECTransformLogic::Collimator, matrix),
+    "Snapshot GetTransformBetween succeeds");
+  success &= IECTesting::CheckMatrix(matrix, expected, 1e-9, "Snapshot after modifying the gantry vtkTransform");
+
+  vtkSmartPointer<vtkIECTransformLogic> copiedLogic = vtkSmartPointer<vtkIECTransformLogic>::Take(logic->Clone());
+  copiedLogic->GetTransformBetween(vtkIECTransformLogic::Patient, vtkIECTransformLogic::Collimator, matrix);
+  success &= IECTesting::CheckMatrix(matrix, expected, 1e-9, "Clone after modifying the gantry vtkTransform");
+
+  logic->UpdateGantryToFixedReferenceTransform(gantryParameters.RotationAngleDeg, gantryParameters.PitchAngleDeg);
+  return success;
+}
+
+} // namespace
+
+//----------------------------------------------------------------------------
+int main()
+{
+  vtkNew<vtkIECTransformLogic> logic;
+  IECTesting::UpdateNonTrivialTransforms(logic.GetPointer());
+
+  bool success = true;
+  success &= TestTransformBetweenAllFrames(logic);
+  success &= TestConcatenatedTransforms(logic);
+  success &= TestModifiedElementaryTransform(logic);
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,2227 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+#ifndef __IECTransformCore_h
+#define __IECTransformCore_h
+
+// STD includes
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Kernels with an AVX2 variant select it at runtime on x86 when the CPU supports it (\sa IEC::UseAVX2), so that a build
+// for the generic instruction set still uses AVX2. Define IEC_NO_RUNTIME_DISPATCH to build the portable code only.
+#if !defined(IEC_NO_RUNTIME_DISPATCH) && (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define IEC_AVX2_DISPATCH 1
+#define IEC_TARGET_AVX2 __attribute__((target("avx2")))
+#elif !defined(IEC_NO_RUNTIME_DISPATCH) && defined(_MSC_VER) && defined(__AVX2__)
+// MSVC has no per-function targets, the AVX2 variants are only built when the whole build targets AVX2 (/arch:AVX2)
+#define IEC_AVX2_DISPATCH 1
+#define IEC_TARGET_AVX2
+#endif
+
+#if defined(__BMI2__) || defined(IEC_AVX2_DISPATCH)
+#include <immintrin.h>
+#endif
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+/// @brief Header-only core of the IEC 61217 transform math, without any VTK dependency
+///
+/// Matrices are plain row-major 4x4 arrays (\sa Matrix4), the coordinate systems are identified by
+/// \sa CoordinateSystemIdentifier. vtkIECTransformLogic is a thin adapter over this core, see there for
+/// the description of the coordinate systems and the elementary transforms.
+namespace IEC
+{
+
+/// @note The underlying type is fixed, so that identifiers of frames added at runtime (LastIECCoordinateFrame and above)
+/// are valid values of the enumeration
+enum CoordinateSystemIdentifier : int
+{
+  RAS = 0,
+  FixedReference,
+  Gantry,
+  Collimator,
+  LeftImagingPanel,
+  RightImagingPanel,
+  PatientSupportRotation, // Not part of the standard, but useful for visualization
+  PatientSupport,
+  TableTopEccentricRotation,
+  TableTop,
+  FlatPanel,
+  WedgeFilter,
+  Patient,
+  DICOM,
+  PatientImageRegularGrid,
+  Imager,
+  Focus,
+  LastIECCoordinateFrame // Last index used for adding more coordinate systems externally
+};
+
+/// @brief Row-major 4x4 homogeneous transformation matrix
+using Matrix4 = std::array<double, 16>;
+
+//----------------------------------------------------------------------------
+// Runtime instruction set dispatch
+//----------------------------------------------------------------------------
+
+/// @brief Whether the AVX2 variants of the kernels are built and the CPU running the code supports them
+inline bool CPUSupportsAVX2()
+{
+#if defined(IEC_AVX2_DISPATCH) && defined(_MSC_VER)
+  return true;
+#elif defined(IEC_AVX2_DISPATCH)
+  static const bool supported = []()
+  {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") != 0;
+  }();
+  return supported;
+#else
+  return false;
+#endif
+}
+
+/// @brief Switch for the AVX2 variants of the kernels, on by default when supported
+inline bool& AVX2Enabled()
+{
+  static bool enabled = CPUSupportsAVX2();
+  return enabled;
+}
+
+/// @brief Whether kernels with an AVX2 variant use it
+inline bool UseAVX2()
+{
+  return AVX2Enabled();
+}
+
+/// @brief Enable or disable the AVX2 variants of the kernels (e.g. for comparing them against the portable code)
+/// The AVX2 variants stay disabled if the CPU does not support them. Not thread safe, call it before starting computations.
+inline void SetAVX2Enabled(bool enabled)
+{
+  AVX2Enabled() = enabled && CPUSupportsAVX2();
+}
+
+//----------------------------------------------------------------------------
+// Matrix math
+//----------------------------------------------------------------------------
+
+constexpr Matrix4 IdentityMatrix()
+{
+  return Matrix4{ 1, 0, 0, 0,
+                  0, 1, 0, 0,
+                  0, 0, 1, 0,
+                  0, 0, 0, 1 };
+}
+
+/// @brief Matrix product a * b
+constexpr Matrix4 Multiply(const Matrix4& a, const Matrix4& b)
+{
+  Matrix4 c{};
+  for (int row = 0; row < 4; ++row)
+  {
+    for (int column = 0; column < 4; ++column)
+    {
+      c[row * 4 + column] = a[row * 4] * b[column] + a[row * 4 + 1] * b[4 + column]
+        + a[row * 4 + 2] * b[8 + column] + a[row * 4 + 3] * b[12 + column];
+    }
+  }
+  return c;
+}
+
+/// @brief Matrix product c = a * b on raw arrays. The output may be the same array as one of the inputs.
+inline void Multiply(const double a[16], const double b[16], double c[16])
+{
+  double product[16];
+  for (int row = 0; row < 4; ++row)
+  {
+    for (int column = 0; column < 4; ++column)
+    {
+      product[row * 4 + column] = a[row * 4] * b[column] + a[row * 4 + 1] * b[4 + column]
+        + a[row * 4 + 2] * b[8 + column] + a[row * 4 + 3] * b[12 + column];
+    }
+  }
+  std::copy(product, product + 16, c);
+}
+
+/// @brief Invert a matrix consisting of rotation and translation only: transpose the rotation, rotate and negate the translation
+constexpr Matrix4 InvertRigid(const Matrix4& m)
+{
+  Matrix4 inverse{};
+  for (int row = 0; row < 3; ++row)
+  {
+    for (int column = 0; column < 3; ++column)
+    {
+      inverse[row * 4 + column] = m[column * 4 + row];
+    }
+    inverse[row * 4 + 3] = -(m[row] * m[3] + m[4 + row] * m[7] + m[8 + row] * m[11]);
+  }
+  inverse[15] = 1.0;
+  return inverse;
+}
+
+/// @brief Invert a general 4x4 matrix using cofactors
+/// @return false if the matrix is singular (the output is then left unchanged)
+constexpr bool Invert(const Matrix4& m, Matrix4& inverse)
+{
+  Matrix4 cofactors{};
+  cofactors[0] = m[5] * m[10] * m[15] - m[5] * m[11] * m[14] - m[9] * m[6] * m[15] + m[9] * m[7] * m[14] + m[13] * m[6] * m[11] - m[13] * m[7] * m[10];
+  cofactors[4] = -m[4] * m[10] * m[15] + m[4] * m[11] * m[14] + m[8] * m[6] * m[15] - m[8] * m[7] * m[14] - m[12] * m[6] * m[11] + m[12] * m[7] * m[10];
+  cofactors[8] = m[4] * m[9] * m[15] - m[4] * m[11] * m[13] - m[8] * m[5] * m[15] + m[8] * m[7] * m[13] + m[12] * m[5] * m[11] - m[12] * m[7] * m[9];
+  cofactors[12] = -m[4] * m[9] * m[14] + m[4] * m[10] * m[13] + m[8] * m[5] * m[14] - m[8] * m[6] * m[13] - m[12] * m[5] * m[10] + m[12] * m[6] * m[9];
+  cofactors[1] = -m[1] * m[10] * m[15] + m[1] * m[11] * m[14] + m[9] * m[2] * m[15] - m[9] * m[3] * m[14] - m[13] * m[2] * m[11] + m[13] * m[3] * m[10];
+  cofactors[5] = m[0] * m[10] * m[15] - m[0] * m[11] * m[14] - m[8] * m[2] * m[15] + m[8] * m[3] * m[14] + m[12] * m[2] * m[11] - m[12] * m[3] * m[10];
+  cofactors[9] = -m[0] * m[9] * m[15] + m[0] * m[11] * m[13] + m[8] * m[1] * m[15] - m[8] * m[3] * m[13] - m[12] * m[1] * m[11] + m[12] * m[3] * m[9];
+  cofactors[13] = m[0] * m[9] * m[14] - m[0] * m[10] * m[13] - m[8] * m[1] * m[14] + m[8] * m[2] * m[13] + m[12] * m[1] * m[10] - m[12] * m[2] * m[9];
+  cofactors[2] = m[1] * m[6] * m[15] - m[1] * m[7] * m[14] - m[5] * m[2] * m[15] + m[5] * m[3] * m[14] + m[13] * m[2] * m[7] - m[13] * m[3] * m[6];
+  cofactors[6] = -m[0] * m[6] * m[15] + m[0] * m[7] * m[14] + m[4] * m[2] * m[15] - m[4] * m[3] * m[14] - m[12] * m[2] * m[7] + m[12] * m[3] * m[6];
+  cofactors[10] = m[0] * m[5] * m[15] - m[0] * m[7] * m[13] - m[4] * m[1] * m[15] + m[4] * m[3] * m[13] + m[12] * m[1] * m[7] - m[12] * m[3] * m[5];
+  cofactors[14] = -m[0] * m[5] * m[14] + m[0] * m[6] * m[13] + m[4] * m[1] * m[14] - m[4] * m[2] * m[13] - m[12] * m[1] * m[6] + m[12] * m[2] * m[5];
+  cofactors[3] = -m[1] * m[6] * m[11] + m[1] * m[7] * m[10] + m[5] * m[2] * m[11] - m[5] * m[3] * m[10] - m[9] * m[2] * m[7] + m[9] * m[3] * m[6];
+  cofactors[7] = m[0] * m[6] * m[11] - m[0] * m[7] * m[10] - m[4] * m[2] * m[11] + m[4] * m[3] * m[10] + m[8] * m[2] * m[7] - m[8] * m[3] * m[6];
+  cofactors[11] = -m[0] * m[5] * m[11] + m[0] * m[7] * m[9] + m[4] * m[1] * m[11] - m[4] * m[3] * m[9] - m[8] * m[1] * m[7] + m[8] * m[3] * m[5];
+  cofactors[15] = m[0] * m[5] * m[10] - m[0] * m[6] * m[9] - m[4] * m[1] * m[10] + m[4] * m[2] * m[9] + m[8] * m[1] * m[6] - m[8] * m[2] * m[5];
+
+  const double determinant = m[0] * cofactors[0] + m[1] * cofactors[4] + m[2] * cofactors[8] + m[3] * cofactors[12];
+  if (determinant == 0.0)
+  {
+    return false;
+  }
+  for (int i = 0; i < 16; ++i)
+  {
+    inverse[i] = cofactors[i] / determinant;
+  }
+  return true;
+}
+
+/// @brief Transform a range of points with an affine matrix (the last row of the matrix is not used)
+/// @param points Interleaved x,y,z coordinates
+/// @param outputPoints Interleaved x,y,z coordinates of the transformed points, may be the same array as points
+template <typename PointType>
+void TransformPoints(const Matrix4& matrix, const PointType* points, std::size_t beginPoint, std::size_t endPoint, PointType* outputPoints)
+{
+  const double* m = matrix.data();
+  for (std::size_t i = beginPoint; i < endPoint; ++i)
+  {
+    const double px = points[3 * i];
+    const double py = points[3 * i + 1];
+    const double pz = points[3 * i + 2];
+    outputPoints[3 * i] = static_cast<PointType>(m[0] * px + m[1] * py + m[2] * pz + m[3]);
+    outputPoints[3 * i + 1] = static_cast<PointType>(m[4] * px + m[5] * py + m[6] * pz + m[7]);
+    outputPoints[3 * i + 2] = static_cast<PointType>(m[8] * px + m[9] * py + m[10] * pz + m[11]);
+  }
+}
+
+//----------------------------------------------------------------------------
+// Elementary transform matrices
+//----------------------------------------------------------------------------
+
+constexpr double DegreesToRadians(double angleDeg)
+{
+  return angleDeg * 3.14159265358979323846 / 180.0;
+}
+
+/// @brief Matrix translate(t) * rotateX * rotateY * rotateZ from the translation and the cosine and sine of the angles
+/// This is the order of operations of all IEC elementary transforms (unused rotations have cos = 1, sin = 0).
+constexpr Matrix4 TranslationRotationXYZMatrix(double tx, double ty, double tz,
+  double cosX, double sinX, double cosY, double sinY, double cosZ, double sinZ)
+{
+  return Matrix4{ cosY * cosZ, -cosY * sinZ, sinY, tx,
+                  sinX * sinY * cosZ + cosX * sinZ, -sinX * sinY * sinZ + cosX * cosZ, -sinX * cosY, ty,
+                  -cosX * sinY * cosZ + sinX * sinZ, cosX * sinY * sinZ + sinX * cosZ, cosX * cosY, tz,
+                  0, 0, 0, 1 };
+}
+
+/// @brief Gantry rotation around Y after gantry pitch around X
+/// @see vtkIECTransformLogic::UpdateGantryToFixedReferenceTransform
+inline Matrix4 GantryToFixedReferenceMatrix(double gantryRotationAngleDeg, double gantryPitchAngleDeg = 0)
+{
+  const double pitch = DegreesToRadians(gantryPitchAngleDeg);
+  const double rotation = DegreesToRadians(gantryRotationAngleDeg);
+  return TranslationRotationXYZMatrix(0, 0, 0, std::cos(pitch), std::sin(pitch), std::cos(rotation), std::sin(rotation), 1, 0);
+}
+
+/// @see vtkIECTransformLogic::UpdateCollimatorToGantryTransform
+inline Matrix4 CollimatorToGantryMatrix(double collimatorRotationAngleDeg, double bz = 0)
+{
+  const double rotation = DegreesToRadians(collimatorRotationAngleDeg);
+  return TranslationRotationXYZMatrix(0, 0, bz, 1, 0, 1, 0, std::cos(rotation), std::sin(rotation));
+}
+
+/// @see vtkIECTransformLogic::UpdateWedgeFilterToCollimatorTransform
+inline Matrix4 WedgeFilterToCollimatorMatrix(double wedgefilterRotationAngleDeg, double wz = 0)
+{
+  const double rotation = DegreesToRadians(wedgefilterRotationAngleDeg);
+  return TranslationRotationXYZMatrix(0, 0, wz, 1, 0, 1, 0, std::cos(rotation), std::sin(rotation));
+}
+
+/// @see vtkIECTransformLogic::UpdatePatientSupportRotationToFixedReferenceTransform
+inline Matrix4 PatientSupportRotationToFixedReferenceMatrix(double patientSupportRotationAngleDeg)
+{
+  const double rotation = DegreesToRadians(patientSupportRotationAngleDeg);
+  return TranslationRotationXYZMatrix(0, 0, 0, 1, 0, 1, 0, std::cos(rotation), std::sin(rotation));
+}
+
+/// @see vtkIECTransformLogic::UpdateTableTopEccentricRotationToPatientSupportRotationTransform
+inline Matrix4 TableTopEccentricRotationToPatientSupportRotationMatrix(double tableTopEccentricRotationAngleDeg, double ey = 0)
+{
+  const double rotation = DegreesToRadians(tableTopEccentricRotationAngleDeg);
+  return TranslationRotationXYZMatrix(0, ey, 0, 1, 0, 1, 0, std::cos(rotation), std::sin(rotation));
+}
+
+/// @see vtkIECTransformLogic::UpdateTableTopToTableTopEccentricRotationTransform
+inline Matrix4 TableTopToTableTopEccentricRotationMatrix(double tx, double ty, double tz, double tableTopPitchAngleDeg = 0, double tableTopRollAngleDeg = 0)
+{
+  const double pitch = DegreesToRadians(tableTopPitchAngleDeg);
+  const double roll = DegreesToRadians(tableTopRollAngleDeg);
+  return TranslationRotationXYZMatrix(tx, ty, tz, std::cos(pitch), std::sin(pitch), std::cos(roll), std::sin(roll), 1, 0);
+}
+
+/// @see vtkIECTransformLogic::UpdatePatientToTableTopTransform
+inline Matrix4 PatientToTableTopMatrix(double px, double py, double pz, double patientPsiAngleDeg = 0, double patientPhiAngleDeg = 0, double patientThetaAngleDeg = 0)
+{
+  const double psi = DegreesToRadians(patientPsiAngleDeg);
+  const double phi = DegreesToRadians(patientPhiAngleDeg);
+  const double theta = DegreesToRadians(patientThetaAngleDeg);
+  return TranslationRotationXYZMatrix(px, py, pz, std::cos(psi), std::sin(psi), std::cos(phi), std::sin(phi), std::cos(theta), std::sin(theta));
+}
+
+/// @brief Default distance of the radiation source (focus) from the isocenter, in mm
+constexpr double DefaultSourceAxisDistance = 1000.0;
+
+/// @brief Imager rotation around Y after imager pitch around X, same as for the gantry
+/// @see vtkIECTransformLogic::UpdateImagerToFixedReferenceTransform
+inline Matrix4 ImagerToFixedReferenceMatrix(double imagerRotationAngleDeg, double imagerPitchAngleDeg = 0)
+{
+  return GantryToFixedReferenceMatrix(imagerRotationAngleDeg, imagerPitchAngleDeg);
+}
+
+/// @brief The focus lies on the Z-axis of the imager frame at the source-axis distance, with the same axis directions
+/// @see vtkIECTransformLogic::UpdateFocusToImagerTransform
+constexpr Matrix4 FocusToImagerMatrix(double sourceAxisDistance)
+{
+  return TranslationRotationXYZMatrix(0, 0, sourceAxisDistance, 1, 0, 1, 0, 1, 0);
+}
+
+/// @brief Voxel index -> DICOM LPS transform of a regular image grid
+/// @see vtkIECTransformLogic::UpdatePatientImageRegularGridToDICOMTransform
+constexpr Matrix4 PatientImageRegularGridToDICOMMatrix(double columnPixelSpacing, double rowPixelSpacing, double sliceDistance, double sx, double sy, double sz,
+                                                       double directionCosineXx = 1, double directionCosineXy = 0, double directionCosineXz = 0,
+                                                       double directionCosineYx = 0, double directionCosineYy = 1, double directionCosineYz = 0)
+{
+  const double directionCosineZx = directionCosineXy*directionCosineYz - directionCosineXz*directionCosineYy;
+  const double directionCosineZy = directionCosineXz*directionCosineYx - directionCosineXx*directionCosineYz;
+  const double directionCosineZz = directionCosineXx*directionCosineYy - directionCosineXy*directionCosineYx;
+  return Matrix4{ directionCosineXx*columnPixelSpacing, directionCosineYx*rowPixelSpacing, directionCosineZx*sliceDistance, sx,
+                  directionCosineXy*columnPixelSpacing, directionCosineYy*rowPixelSpacing, directionCosineZy*sliceDistance, sy,
+                  directionCosineXz*columnPixelSpacing, directionCosineYz*rowPixelSpacing, directionCosineZz*sliceDistance, sz,
+                  0, 0, 0, 1 };
+}
+
+/// @brief DICOM patient frame (LPS) to IEC patient frame (LSA), rotation around the X-axis
+constexpr Matrix4 DICOMToPatientMatrix()
+{
+  return Matrix4{ 1, 0, 0, 0,
+                  0, 0, 1, 0,
+                  0,-1, 0, 0,
+                  0, 0, 0, 1 };
+}
+
+/// @brief RAS patient frame to IEC patient frame (LSA)
+constexpr Matrix4 RasToPatientMatrix()
+{
+  return Matrix4{ -1, 0, 0, 0,
+                   0, 0, 1, 0,
+                   0, 1, 0, 0,
+                   0, 0, 0, 1 };
+}
+
+//----------------------------------------------------------------------------
+// Regular grid mapping
+//----------------------------------------------------------------------------
+
+#if defined(IEC_AVX2_DISPATCH)
+/// @brief Store 4 coordinates computed in double precision
+IEC_TARGET_AVX2 inline void StorePointCoordinatesAVX2(const __m256d& coordinates, double* outputCoordinates)
+{
+  _mm256_storeu_pd(outputCoordinates, coordinates);
+}
+IEC_TARGET_AVX2 inline void StorePointCoordinatesAVX2(const __m256d& coordinates, float* outputCoordinates)
+{
+  _mm_storeu_ps(outputCoordinates, _mm256_cvtpd_ps(coordinates));
+}
+
+/// @brief AVX2 variant of the column loop of \sa TransformRegularGridPoints, 4 columns per iteration
+/// The 12 interleaved coordinates of 4 columns are computed as 3 vectors whose lanes already hold the right coordinate
+/// (x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3), so no shuffles are needed. The arithmetic is the same as in the portable loop.
+/// @return Number of columns written, a multiple of 4. The remaining columns are left to the portable loop.
+template <typename PointType>
+IEC_TARGET_AVX2 std::size_t TransformRegularGridRowAVX2(const double rowStart[3], const double columnStep[3], std::size_t numberOfColumns,
+  PointType* rowPoints)
+{
+  const __m256d step0 = _mm256_setr_pd(columnStep[0], columnStep[1], columnStep[2], columnStep[0]);
+  const __m256d step1 = _mm256_setr_pd(columnStep[1], columnStep[2], columnStep[0], columnStep[1]);
+  const __m256d step2 = _mm256_setr_pd(columnStep[2], columnStep[0], columnStep[1], columnStep[2]);
+  const __m256d start0 = _mm256_setr_pd(rowStart[0], rowStart[1], rowStart[2], rowStart[0]);
+  const __m256d start1 = _mm256_setr_pd(rowStart[1], rowStart[2], rowStart[0], rowStart[1]);
+  const __m256d start2 = _mm256_setr_pd(rowStart[2], rowStart[0], rowStart[1], rowStart[2]);
+  const __m256d four = _mm256_set1_pd(4.0);
+  __m256d column0 = _mm256_setr_pd(0.0, 0.0, 0.0, 1.0);
+  __m256d column1 = _mm256_setr_pd(1.0, 1.0, 2.0, 2.0);
+  __m256d column2 = _mm256_setr_pd(2.0, 3.0, 3.0, 3.0);
+
+  std::size_t column = 0;
+  for (; column + 4 <= numberOfColumns; column += 4)
+  {
+    PointType* points = rowPoints + 3 * column;
+    StorePointCoordinatesAVX2(_mm256_add_pd(_mm256_mul_pd(step0, column0), start0), points);
+    StorePointCoordinatesAVX2(_mm256_add_pd(_mm256_mul_pd(step1, column1), start1), points + 4);
+    StorePointCoordinatesAVX2(_mm256_add_pd(_mm256_mul_pd(step2, column2), start2), points + 8);
+    // Column indices are small integers, so the increments are exact
+    column0 = _mm256_add_pd(column0, four);
+    column1 = _mm256_add_pd(column1, four);
+    column2 = _mm256_add_pd(column2, four);
+  }
+  return column;
+}
+#endif
+
+/// @brief Transform the voxel centers of a range of slices of a regular grid with the grid index -> frame matrix
+/// Voxels are written in the linearized index order of vtkIECTransformLogic::VectorizedToLinearizedIndex (slice, row, column,
+/// column being contiguous), so point i of the output belongs to linearized index i. Grid index (e0,e1,e2) is transformed as
+/// the point (column=e2, row=e1, slice=e0), as in \sa PatientImageRegularGridToDICOMMatrix.
+/// The transform is not evaluated per voxel: each row starts from its first voxel center, and the voxels of the row are
+/// reached by adding multiples of the column step. For float and double points the rows are computed by the AVX2 variant
+/// when the CPU supports it (\sa UseAVX2), otherwise the inner loop has no dependencies between iterations, so that the
+/// compiler vectorizes it for the instruction set enabled in the build.
+/// @param gridToFrame Row-major matrix grid index -> target frame
+/// @param nElems Number of elements in each dimension (slices, rows, columns)
+/// @param beginSlice First slice to transform
+/// @param endSlice One past the last slice to transform
+/// @param outputPoints Interleaved x,y,z coordinates of all voxels of the grid (3 * nElems[0] * nElems[1] * nElems[2] values),
+///   only the points of the given slices are written
+template <typename PointType>
+void TransformRegularGridPoints(const Matrix4& gridToFrame, const std::array<uint16_t, 3>& nElems,
+  std::size_t beginSlice, std::size_t endSlice, PointType* outputPoints)
+{
+  const double* m = gridToFrame.data();
+  const std::size_t numberOfRows = nElems[1];
+  const std::size_t numberOfColumns = nElems[2];
+  const double columnStepX = m[0];
+  const double columnStepY = m[4];
+  const double columnStepZ = m[8];
+#if defined(IEC_AVX2_DISPATCH)
+  const bool useAVX2 = UseAVX2();
+#endif
+
+  for (std::size_t slice = beginSlice; slice < endSlice; ++slice)
+  {
+    const double sliceIndex = static_cast<double>(slice);
+    const double sliceStartX = m[2] * sliceIndex + m[3];
+    const double sliceStartY = m[6] * sliceIndex + m[7];
+    const double sliceStartZ = m[10] * sliceIndex + m[11];
+    for (std::size_t row = 0; row < numberOfRows; ++row)
+    {
+      const double rowIndex = static_cast<double>(row);
+      const double rowStartX = m[1] * rowIndex + sliceStartX;
+      const double rowStartY = m[5] * rowIndex + sliceStartY;
+      const double rowStartZ = m[9] * rowIndex + sliceStartZ;
+
+      PointType* rowPoints = outputPoints + 3 * ((slice * numberOfRows + row) * numberOfColumns);
+      std::size_t column = 0;
+#if defined(IEC_AVX2_DISPATCH)
+      if constexpr (std::is_same<PointType, double>::value || std::is_same<PointType, float>::value)
+      {
+        if (useAVX2)
+        {
+          const double rowStart[3] = { rowStartX, rowStartY, rowStartZ };
+          const double columnStep[3] = { columnStepX, columnStepY, columnStepZ };
+          column = TransformRegularGridRowAVX2(rowStart, columnStep, numberOfColumns, rowPoints);
+        }
+      }
+#endif
+      for (; column < numberOfColumns; ++column)
+      {
+        const double columnIndex = static_cast<double>(column);
+        rowPoints[3 * column] = static_cast<PointType>(columnStepX * columnIndex + rowStartX);
+        rowPoints[3 * column + 1] = static_cast<PointType>(columnStepY * columnIndex + rowStartY);
+        rowPoints[3 * column + 2] = static_cast<PointType>(columnStepZ * columnIndex + rowStartZ);
+      }
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+// Divergent projection
+//----------------------------------------------------------------------------
+
+/// @brief Project a point given in the Focus frame through the focus onto a plane perpendicular to the central axis
+/// The beam leaves the focus along the -Z axis, so the projection plane is at z = -planeDistance in the Focus frame.
+/// @param outputPoint x and y on the projection plane (along the Focus frame axes), and the depth of the point, i.e. its
+///   distance from the focus along the central axis. Points at or behind the focus are projected to NaN.
+template <typename PointType>
+void ProjectFocusPoint(double x, double y, double z, double planeDistance, PointType outputPoint[3])
+{
+  const double depth = -z;
+  const double scale = (depth > 0.0 ? planeDistance / depth : std::numeric_limits<double>::quiet_NaN());
+  outputPoint[0] = static_cast<PointType>(x * scale);
+  outputPoint[1] = static_cast<PointType>(y * scale);
+  outputPoint[2] = static_cast<PointType>(depth > 0.0 ? depth : std::numeric_limits<double>::quiet_NaN());
+}
+
+/// @brief Divergent projection of a range of points through the focus onto a plane perpendicular to the central axis
+/// @param pointsToFocus Row-major matrix from the frame of the points to the Focus frame
+/// @param planeDistance Distance of the projection plane from the focus (e.g. the source-axis distance for the
+///   isocenter plane of the beam's eye view, or the source-imager distance for the imager plane)
+/// @param points Interleaved x,y,z coordinates
+/// @param outputPoints Projected x,y and depth per point, see \sa ProjectFocusPoint
+template <typename PointType>
+void ProjectPoints(const Matrix4& pointsToFocus, double planeDistance, const PointType* points, std::size_t beginPoint, std::size_t endPoint,
+  PointType* outputPoints)
+{
+  const double* m = pointsToFocus.data();
+  for (std::size_t i = beginPoint; i < endPoint; ++i)
+  {
+    const double px = points[3 * i];
+    const double py = points[3 * i + 1];
+    const double pz = points[3 * i + 2];
+    ProjectFocusPoint(m[0] * px + m[1] * py + m[2] * pz + m[3], m[4] * px + m[5] * py + m[6] * pz + m[7],
+      m[8] * px + m[9] * py + m[10] * pz + m[11], planeDistance, outputPoints + 3 * i);
+  }
+}
+
+/// @brief Divergent projection of the voxel centers of a range of slices of a regular grid, see \sa TransformRegularGridPoints
+/// for the grid traversal and the output order and \sa ProjectFocusPoint for the projected values
+/// @param gridToFocus Row-major matrix grid index -> Focus frame
+template <typename PointType>
+void ProjectRegularGridPoints(const Matrix4& gridToFocus, const std::array<uint16_t, 3>& nElems, double planeDistance,
+  std::size_t beginSlice, std::size_t endSlice, PointType* outputPoints)
+{
+  const double* m = gridToFocus.data();
+  const std::size_t numberOfRows = nElems[1];
+  const std::size_t numberOfColumns = nElems[2];
+
+  for (std::size_t slice = beginSlice; slice < endSlice; ++slice)
+  {
+    const double sliceIndex = static_cast<double>(slice);
+    for (std::size_t row = 0; row < numberOfRows; ++row)
+    {
+      const double rowIndex = static_cast<double>(row);
+      const double rowStartX = m[1] * rowIndex + m[2] * sliceIndex + m[3];
+      const double rowStartY = m[5] * rowIndex + m[6] * sliceIndex + m[7];
+      const double rowStartZ = m[9] * rowIndex + m[10] * sliceIndex + m[11];
+
+      PointType* rowPoints = outputPoints + 3 * ((slice * numberOfRows + row) * numberOfColumns);
+      for (std::size_t column = 0; column < numberOfColumns; ++column)
+      {
+        const double columnIndex = static_cast<double>(column);
+        ProjectFocusPoint(m[0] * columnIndex + rowStartX, m[4] * columnIndex + rowStartY, m[8] * columnIndex + rowStartZ,
+          planeDistance, rowPoints + 3 * column);
+      }
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+// Digitally reconstructed radiographs
+//----------------------------------------------------------------------------
+
+/// @brief Number of rays of a detector row whose set-up is computed together by \sa ComputeRegularGridDRR
+constexpr std::size_t DRRRayBlockSize = 64;
+
+/// @brief Clip the parameter range [alphaMin, alphaMax] of a ray to the slab of a regular grid along one axis
+/// The voxel with index k covers [k-0.5, k+0.5], so the slab is [-0.5, numberOfElements-0.5]. Written with selects
+/// instead of branches, so that it vectorizes in loops over rays. The range is left empty (alphaMin >= alphaMax) if
+/// the ray misses the slab.
+/// @param start Coordinate of the ray start point (parameter 0) in grid index coordinates
+/// @param direction Coordinate of the end point (parameter 1) minus the start point
+inline void ClipRayToRegularGridAxis(double start, double direction, double numberOfElements, double& alphaMin, double& alphaMax)
+{
+  const double infinity = std::numeric_limits<double>::infinity();
+  const double lower = -0.5 - start;
+  const double upper = numberOfElements - 0.5 - start;
+  const bool moving = (direction != 0.0);
+  const double inverseDirection = 1.0 / (moving ? direction : 1.0);
+  // Parallel to the slab: no constraint if inside, empty range if outside
+  const double alphaLower = (moving ? lower * inverseDirection : (lower <= 0.0 ? -infinity : infinity));
+  const double alphaUpper = (moving ? upper * inverseDirection : (upper >= 0.0 ? infinity : -infinity));
+  alphaMin = std::max(alphaMin, std::min(alphaLower, alphaUpper));
+  alphaMax = std::min(alphaMax, std::max(alphaLower, alphaUpper));
+}
+
+/// @brief Radiological path of a ray through a regular grid, using Siddon's method with the incremental traversal
+/// of Jacobs et al.
+/// The ray is given in grid index coordinates (x=column, y=row, z=slice), as in \sa TransformRegularGridPoints. Starting
+/// from the voxel at alphaMin, the traversal moves to the neighboring voxel across the closest voxel boundary, adding
+/// the index stride of the crossed axis to the linearized index (see vtkIECTransformLogic::VectorizedToLinearizedIndex)
+/// instead of recomputing it.
+/// @param nElems Number of elements in each dimension (slices, rows, columns)
+/// @param start Start point of the ray (parameter 0)
+/// @param direction End point of the ray (parameter 1) minus the start point
+/// @param alphaMin, alphaMax Parameter range of the ray inside the grid, see \sa ClipRayToRegularGridAxis
+/// @return Sum of the voxel values times the parameter length of the ray inside each voxel. Multiplied by the length of
+///   the ray, this is the line integral of the voxel values.
+template <typename VoxelType>
+double TraceRegularGridRay(const VoxelType* volume, const std::array<uint16_t, 3>& nElems, const double start[3], const double direction[3],
+  double alphaMin, double alphaMax)
+{
+  if (!(alphaMin < alphaMax))
+  {
+    return 0.0;
+  }
+
+  // Axes in grid index coordinate order: column, row, slice
+  const std::int64_t numberOfElements[3] = { nElems[2], nElems[1], nElems[0] };
+  const std::int64_t strides[3] = { 1, nElems[2], static_cast<std::int64_t>(nElems[2]) * nElems[1] };
+
+  std::int64_t index[3];
+  std::int64_t indexStep[3];
+  double alphaNext[3];
+  double alphaStep[3];
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    // Voxel of the entry point. On a voxel boundary, the voxel on the side the ray moves to.
+    const double entry = start[axis] + alphaMin * direction[axis];
+    const double voxel = (direction[axis] < 0.0 ? std::ceil(entry - 0.5) : std::floor(entry + 0.5));
+    index[axis] = std::min(std::max(static_cast<std::int64_t>(voxel), std::int64_t(0)), numberOfElements[axis] - 1);
+
+    if (direction[axis] > 0.0)
+    {
+      indexStep[axis] = 1;
+      alphaNext[axis] = (static_cast<double>(index[axis]) + 0.5 - start[axis]) / direction[axis];
+      alphaStep[axis] = 1.0 / direction[axis];
+    }
+    else if (direction[axis] < 0.0)
+    {
+      indexStep[axis] = -1;
+      alphaNext[axis] = (static_cast<double>(index[axis]) - 0.5 - start[axis]) / direction[axis];
+      alphaStep[axis] = -1.0 / direction[axis];
+    }
+    else
+    {
+      indexStep[axis] = 0;
+      alphaNext[axis] = std::numeric_limits<double>::infinity();
+      alphaStep[axis] = 0.0;
+    }
+  }
+
+  std::int64_t linearIndex = (index[2] * numberOfElements[1] + index[1]) * numberOfElements[0] + index[0];
+  double alpha = alphaMin;
+  double sum = 0.0;
+  for (;;)
+  {
+    const int axis = (alphaNext[0] < alphaNext[1] ? (alphaNext[0] < alphaNext[2] ? 0 : 2) : (alphaNext[1] < alphaNext[2] ? 1 : 2));
+    const double alphaExit = std::min(alphaNext[axis], alphaMax);
+    sum += (alphaExit - alpha) * static_cast<double>(volume[linearIndex]);
+    if (alphaExit >= alphaMax)
+    {
+      break;
+    }
+    alpha = alphaExit;
+    index[axis] += indexStep[axis];
+    if (index[axis] < 0 || index[axis] >= numberOfElements[axis])
+    {
+      // Left the grid slightly before alphaMax due to rounding
+      break;
+    }
+    linearIndex += indexStep[axis] * strides[axis];
+    alphaNext[axis] += alphaStep[axis];
+  }
+  return sum;
+}
+
+#if defined(IEC_AVX2_DISPATCH)
+/// @brief AVX2 variant of \sa ClipRayToRegularGridAxis for 4 rays
+/// The operand order of min and max matches std::min and std::max, so the results are the same, also for NaN.
+IEC_TARGET_AVX2 inline void ClipRaysToRegularGridAxisAVX2(double start, const __m256d& direction, double numberOfElements, __m256d& alphaMin,
+  __m256d& alphaMax)
+{
+  const double infinity = std::numeric_limits<double>::infinity();
+  const double lower = -0.5 - start;
+  const double upper = numberOfElements - 0.5 - start;
+  const __m256d moving = _mm256_cmp_pd(direction, _mm256_setzero_pd(), _CMP_NEQ_UQ);
+  const __m256d inverseDirection = _mm256_div_pd(_mm256_set1_pd(1.0), _mm256_blendv_pd(_mm256_set1_pd(1.0), direction, moving));
+  const __m256d alphaLower = _mm256_blendv_pd(_mm256_set1_pd(lower <= 0.0 ? -infinity : infinity),
+    _mm256_mul_pd(_mm256_set1_pd(lower), inverseDirection), moving);
+  const __m256d alphaUpper = _mm256_blendv_pd(_mm256_set1_pd(upper >= 0.0 ? infinity : -infinity),
+    _mm256_mul_pd(_mm256_set1_pd(upper), inverseDirection), moving);
+  alphaMin = _mm256_max_pd(_mm256_min_pd(alphaUpper, alphaLower), alphaMin);
+  alphaMax = _mm256_min_pd(_mm256_max_pd(alphaUpper, alphaLower), alphaMax);
+}
+
+/// @brief AVX2 variant of the ray set-up loop of \sa ComputeRegularGridDRR, 4 rays per iteration
+/// The arithmetic is the same as in the portable loop.
+/// @return Number of rays set up, a multiple of 4. The remaining ones are left to the portable loop.
+IEC_TARGET_AVX2 inline std::size_t SetUpRegularGridRaysAVX2(const double* detectorToGrid, const double start[3], const double gridSize[3],
+  std::size_t firstColumn, std::size_t numberOfRays, double columnCenter, double columnSpacing, double sourceX, double dy, double dz,
+  double* directionX, double* directionY, double* directionZ, double* rayLength, double* alphaMin, double* alphaMax)
+{
+  const double* m = detectorToGrid;
+  const __m256d dyVector = _mm256_set1_pd(dy);
+  const __m256d dzVector = _mm256_set1_pd(dz);
+  const __m256d dySquared = _mm256_set1_pd(dy * dy);
+  const __m256d dzSquared = _mm256_set1_pd(dz * dz);
+  const __m256d columnOffsets = _mm256_setr_pd(0.0, 1.0, 2.0, 3.0);
+
+  std::size_t ray = 0;
+  for (; ray + 4 <= numberOfRays; ray += 4)
+  {
+    const __m256d column = _mm256_add_pd(_mm256_set1_pd(static_cast<double>(firstColumn + ray)), columnOffsets);
+    const __m256d dx = _mm256_sub_pd(_mm256_mul_pd(_mm256_sub_pd(column, _mm256_set1_pd(columnCenter)), _mm256_set1_pd(columnSpacing)),
+      _mm256_set1_pd(sourceX));
+    _mm256_storeu_pd(rayLength + ray, _mm256_sqrt_pd(_mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), dySquared), dzSquared)));
+
+    __m256d direction[3];
+    for (int axis = 0; axis < 3; ++axis)
+    {
+      direction[axis] = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(_mm256_set1_pd(m[4 * axis]), dx),
+        _mm256_mul_pd(_mm256_set1_pd(m[4 * axis + 1]), dyVector)), _mm256_mul_pd(_mm256_set1_pd(m[4 * axis + 2]), dzVector));
+    }
+    _mm256_storeu_pd(directionX + ray, direction[0]);
+    _mm256_storeu_pd(directionY + ray, direction[1]);
+    _mm256_storeu_pd(directionZ + ray, direction[2]);
+
+    __m256d rayAlphaMin = _mm256_setzero_pd();
+    __m256d rayAlphaMax = _mm256_set1_pd(std::numeric_limits<double>::infinity());
+    for (int axis = 0; axis < 3; ++axis)
+    {
+      ClipRaysToRegularGridAxisAVX2(start[axis], direction[axis], gridSize[axis], rayAlphaMin, rayAlphaMax);
+    }
+    _mm256_storeu_pd(alphaMin + ray, rayAlphaMin);
+    _mm256_storeu_pd(alphaMax + ray, rayAlphaMax);
+  }
+  return ray;
+}
+#endif
+
+/// @brief Compute a range of rows of a digitally reconstructed radiograph (DRR) of a regular grid
+/// Each detector pixel gets the line integral of the voxel values along the ray from the source through the pixel center.
+/// The ray is not cut at the detector, so the detector plane can also be placed in front of the volume (e.g. at the
+/// isocenter). The detector lies in the XY plane of the detector frame, centered on its origin, with its columns along X and its rows along Y.
+/// The ray set-up (direction in grid index coordinates, length and clipping against the grid) is done for blocks of
+/// \sa DRRRayBlockSize rays, 4 rays at a time with AVX2 when the CPU supports it (\sa UseAVX2), otherwise in loops
+/// without dependencies between rays that the compiler vectorizes for the instruction set enabled in the build.
+/// The voxel traversal of each ray follows with \sa TraceRegularGridRay, one ray at a time.
+/// @param volume Voxel values in the linearized index order of vtkIECTransformLogic::VectorizedToLinearizedIndex
+/// @param nElems Number of elements in each dimension (slices, rows, columns)
+/// @param detectorToGrid Row-major matrix detector frame -> grid index
+/// @param source Position of the source in the detector frame
+/// @param detectorSize Number of detector pixels (rows, columns)
+/// @param pixelSpacing Distance between the centers of adjacent detector rows (along Y) and columns (along X), in mm
+/// @param beginRow First detector row to compute
+/// @param endRow One past the last detector row to compute
+/// @param outputImage Line integrals of all detector pixels, row by row (detectorSize[0] * detectorSize[1] values),
+///   only the given rows are written
+template <typename VoxelType, typename PixelType>
+void ComputeRegularGridDRR(const VoxelType* volume, const std::array<uint16_t, 3>& nElems, const Matrix4& detectorToGrid,
+  const double source[3], const std::array<uint16_t, 2>& detectorSize, const std::array<double, 2>& pixelSpacing,
+  std::size_t beginRow, std::size_t endRow, PixelType* outputImage)
+{
+  const double* m = detectorToGrid.data();
+  const std::size_t numberOfColumns = detectorSize[1];
+  const double gridSize[3] = { static_cast<double>(nElems[2]), static_cast<double>(nElems[1]), static_cast<double>(nElems[0]) };
+  const double rowCenter = 0.5 * (static_cast<double>(detectorSize[0]) - 1.0);
+  const double columnCenter = 0.5 * (static_cast<double>(numberOfColumns) - 1.0);
+
+  // All rays start at the source
+  double start[3];
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    start[axis] = m[4 * axis] * source[0] + m[4 * axis + 1] * source[1] + m[4 * axis + 2] * source[2] + m[4 * axis + 3];
+  }
+
+  double directionX[DRRRayBlockSize];
+  double directionY[DRRRayBlockSize];
+  double directionZ[DRRRayBlockSize];
+  double rayLength[DRRRayBlockSize];
+  double alphaMin[DRRRayBlockSize];
+  double alphaMax[DRRRayBlockSize];
+#if defined(IEC_AVX2_DISPATCH)
+  const bool useAVX2 = UseAVX2();
+#endif
+
+  for (std::size_t row = beginRow; row < endRow; ++row)
+  {
+    const double dy = (static_cast<double>(row) - rowCenter) * pixelSpacing[0] - source[1];
+    const double dz = -source[2];
+    PixelType* rowPixels = outputImage + row * numberOfColumns;
+
+    for (std::size_t blockBegin = 0; blockBegin < numberOfColumns; blockBegin += DRRRayBlockSize)
+    {
+      const std::size_t blockSize = std::min(DRRRayBlockSize, numberOfColumns - blockBegin);
+
+      // Ray set-up, source -> pixel center (parameter 1) and beyond
+      std::size_t ray = 0;
+#if defined(IEC_AVX2_DISPATCH)
+      if (useAVX2)
+      {
+        ray = SetUpRegularGridRaysAVX2(m, start, gridSize, blockBegin, blockSize, columnCenter, pixelSpacing[1], source[0], dy, dz,
+          directionX, directionY, directionZ, rayLength, alphaMin, alphaMax);
+      }
+#endif
+      for (; ray < blockSize; ++ray)
+      {
+        const double dx = (static_cast<double>(blockBegin + ray) - columnCenter) * pixelSpacing[1] - source[0];
+        rayLength[ray] = std::sqrt(dx * dx + dy * dy + dz * dz);
+        directionX[ray] = m[0] * dx + m[1] * dy + m[2] * dz;
+        directionY[ray] = m[4] * dx + m[5] * dy + m[6] * dz;
+        directionZ[ray] = m[8] * dx + m[9] * dy + m[10] * dz;
+        alphaMin[ray] = 0.0;
+        alphaMax[ray] = std::numeric_limits<double>::infinity();
+        ClipRayToRegularGridAxis(start[0], directionX[ray], gridSize[0], alphaMin[ray], alphaMax[ray]);
+        ClipRayToRegularGridAxis(start[1], directionY[ray], gridSize[1], alphaMin[ray], alphaMax[ray]);
+        ClipRayToRegularGridAxis(start[2], directionZ[ray], gridSize[2], alphaMin[ray], alphaMax[ray]);
+      }
+
+      // Voxel traversal
+      for (std::size_t ray = 0; ray < blockSize; ++ray)
+      {
+        const double direction[3] = { directionX[ray], directionY[ray], directionZ[ray] };
+        rowPixels[blockBegin + ray] = static_cast<PixelType>(
+          rayLength[ray] * TraceRegularGridRay(volume, nElems, start, direction, alphaMin[ray], alphaMax[ray]));
+      }
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+// Rigid motion interpolation
+//----------------------------------------------------------------------------
+
+/// @brief Check whether the matrix is a rotation and translation only, up to the given tolerance
+inline bool IsRigid(const Matrix4& m, double tolerance = 1e-9)
+{
+  for (int i = 0; i < 3; ++i)
+  {
+    for (int j = i; j < 3; ++j)
+    {
+      const double dot = m[i] * m[j] + m[4 + i] * m[4 + j] + m[8 + i] * m[8 + j];
+      if (std::fabs(dot - (i == j ? 1.0 : 0.0)) > tolerance)
+      {
+        return false;
+      }
+    }
+  }
+  const double determinant = m[0] * (m[5] * m[10] - m[6] * m[9]) - m[1] * (m[4] * m[10] - m[6] * m[8]) + m[2] * (m[4] * m[9] - m[5] * m[8]);
+  return determinant > 0.0 && std::fabs(m[12]) <= tolerance && std::fabs(m[13]) <= tolerance && std::fabs(m[14]) <= tolerance
+    && std::fabs(m[15] - 1.0) <= tolerance;
+}
+
+/// @brief Unit quaternion (w, x, y, z) of the rotation part of a rigid matrix, with w >= 0
+inline std::array<double, 4> RotationToQuaternion(const Matrix4& m)
+{
+  // Shepperd's method: start from the largest of the four squared components for accuracy
+  std::array<double, 4> q{};
+  const double trace = m[0] + m[5] + m[10];
+  if (trace >= m[0] && trace >= m[5] && trace >= m[10])
+  {
+    const double s = 2.0 * std::sqrt(1.0 + trace);
+    q = { 0.25 * s, (m[9] - m[6]) / s, (m[2] - m[8]) / s, (m[4] - m[1]) / s };
+  }
+  else if (m[0] >= m[5] && m[0] >= m[10])
+  {
+    const double s = 2.0 * std::sqrt(1.0 + m[0] - m[5] - m[10]);
+    q = { (m[9] - m[6]) / s, 0.25 * s, (m[1] + m[4]) / s, (m[2] + m[8]) / s };
+  }
+  else if (m[5] >= m[10])
+  {
+    const double s = 2.0 * std::sqrt(1.0 + m[5] - m[0] - m[10]);
+    q = { (m[2] - m[8]) / s, (m[1] + m[4]) / s, 0.25 * s, (m[6] + m[9]) / s };
+  }
+  else
+  {
+    const double s = 2.0 * std::sqrt(1.0 + m[10] - m[0] - m[5]);
+    q = { (m[4] - m[1]) / s, (m[2] + m[8]) / s, (m[6] + m[9]) / s, 0.25 * s };
+  }
+  if (q[0] < 0.0)
+  {
+    q = { -q[0], -q[1], -q[2], -q[3] };
+  }
+  return q;
+}
+
+/// @brief Interpolation between two transforms that differ by a rigid motion, e.g. the composed transform between two
+/// frames in two machine states
+/// The rigid motion between the states is a screw motion: a rotation about an axis in space and a translation along it.
+/// Interpolation follows the screw with constant speed, which is the same as screw linear interpolation (ScLERP) of the
+/// dual quaternions of the transforms, with the rotation being the spherical linear interpolation (slerp) of the
+/// rotation quaternions. It is therefore exact whenever the states differ by a single rotation axis and/or a
+/// translation along that axis (e.g. gantry, collimator or patient support rotation only), for any frame pair.
+/// The screw parameters are computed once in \sa Initialize, so \sa Evaluate needs no access to the hierarchy.
+/// @note Rotations between the states are taken the short way, i.e. by less than 180 degrees
+class TransformInterpolator
+{
+public:
+  /// @brief Set up the interpolation between two row-major matrices
+  /// The motion between the states may be applied after the start transform (start^-1 * end rigid, e.g. for paths with
+  /// a constant non-rigid image grid transform at their end) or before it (end * start^-1 rigid).
+  /// @return false if the transforms do not differ by a rigid motion (or start is singular)
+  bool Initialize(const Matrix4& start, const Matrix4& end)
+  {
+    Matrix4 startInverse{};
+    if (!Invert(start, startInverse))
+    {
+      return false;
+    }
+    Matrix4 motion = Multiply(startInverse, end);
+    this->MotionBeforeStart = false;
+    if (!IsRigid(motion))
+    {
+      motion = Multiply(end, startInverse);
+      this->MotionBeforeStart = true;
+      if (!IsRigid(motion))
+      {
+        return false;
+      }
+    }
+    this->Start = start;
+
+    // Screw parameters of the motion
+    const std::array<double, 4> q = RotationToQuaternion(motion);
+    const double sinHalfAngle = std::sqrt(q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+    const double translation[3] = { motion[3], motion[7], motion[11] };
+    this->Angle = 2.0 * std::atan2(sinHalfAngle, q[0]);
+    if (sinHalfAngle < 1e-12)
+    {
+      // Pure translation
+      this->Angle = 0.0;
+      this->Axis = { 0.0, 0.0, 1.0 };
+      this->AxisPoint = { 0.0, 0.0, 0.0 };
+      this->Translation = { translation[0], translation[1], translation[2] };
+      return true;
+    }
+    this->Axis = { q[1] / sinHalfAngle, q[2] / sinHalfAngle, q[3] / sinHalfAngle };
+
+    // Translation along the axis, and the point of the axis closest to the origin, for which (I - R) * point equals
+    // the translation perpendicular to the axis
+    const double* n = this->Axis.data();
+    const double along = translation[0] * n[0] + translation[1] * n[1] + translation[2] * n[2];
+    const double perpendicular[3] = { translation[0] - along * n[0], translation[1] - along * n[1], translation[2] - along * n[2] };
+    const double cotHalfAngle = q[0] / sinHalfAngle;
+    this->AxisPoint = {
+      0.5 * (perpendicular[0] + cotHalfAngle * (n[1] * perpendicular[2] - n[2] * perpendicular[1])),
+      0.5 * (perpendicular[1] + cotHalfAngle * (n[2] * perpendicular[0] - n[0] * perpendicular[2])),
+      0.5 * (perpendicular[2] + cotHalfAngle * (n[0] * perpendicular[1] - n[1] * perpendicular[0])) };
+    this->Translation = { along * n[0], along * n[1], along * n[2] };
+    return true;
+  }
+
+  /// @brief Get the interpolated transform at the given fraction (0: start, 1: end; values outside extrapolate the screw)
+  /// @param outputMatrix Row-major 4x4 matrix
+  void Evaluate(double fraction, double outputMatrix[16]) const
+  {
+    // Rotation by fraction * angle about the axis, from the slerped quaternion
+    const double halfAngle = 0.5 * fraction * this->Angle;
+    const double w = std::cos(halfAngle);
+    const double sinHalfAngle = std::sin(halfAngle);
+    const double x = sinHalfAngle * this->Axis[0];
+    const double y = sinHalfAngle * this->Axis[1];
+    const double z = sinHalfAngle * this->Axis[2];
+    double motion[16] = {
+      1.0 - 2.0 * (y * y + z * z), 2.0 * (x * y - w * z), 2.0 * (x * z + w * y), 0.0,
+      2.0 * (x * y + w * z), 1.0 - 2.0 * (x * x + z * z), 2.0 * (y * z - w * x), 0.0,
+      2.0 * (x * z - w * y), 2.0 * (y * z + w * x), 1.0 - 2.0 * (x * x + y * y), 0.0,
+      0.0, 0.0, 0.0, 1.0 };
+
+    // Rotation about the axis through AxisPoint, followed by the fraction of the translation along the axis
+    const double* c = this->AxisPoint.data();
+    for (int row = 0; row < 3; ++row)
+    {
+      motion[row * 4 + 3] = c[row] - (motion[row * 4] * c[0] + motion[row * 4 + 1] * c[1] + motion[row * 4 + 2] * c[2])
+        + fraction * this->Translation[row];
+    }
+
+    if (this->MotionBeforeStart)
+    {
+      Multiply(motion, this->Start.data(), outputMatrix);
+    }
+    else
+    {
+      Multiply(this->Start.data(), motion, outputMatrix);
+    }
+  }
+
+  /// @brief Rotation angle of the motion between the states, in radians
+  double GetAngle() const { return this->Angle; }
+
+private:
+  Matrix4 Start = IdentityMatrix();
+  bool MotionBeforeStart = false;
+  double Angle = 0.0;
+  std::array<double, 3> Axis = { { 0.0, 0.0, 1.0 } };
+  std::array<double, 3> AxisPoint = { { 0.0, 0.0, 0.0 } };
+  std::array<double, 3> Translation = { { 0.0, 0.0, 0.0 } };
+};
+
+//----------------------------------------------------------------------------
+// Arc stepping
+//----------------------------------------------------------------------------
+
+/// @brief Composed transforms along an arc of one rotation axis (e.g. the gantry) in constant angle steps
+/// A composed transform whose path contains one rotation by the angle a, all other elementary transforms being fixed, is
+/// ConstantTerm + cos(a) * CosineTerm + sin(a) * SineTerm (each rotation matrix entry is constant, cos(a) or sin(a), also
+/// in the inverted downward part of a path). The cosine and sine are advanced by the angle step with the rotation recurrence
+/// cos(a+d) = cos(a)cos(d) - sin(a)sin(d), sin(a+d) = sin(a)cos(d) + cos(a)sin(d) instead of calling the trigonometric
+/// functions, and renormalized every \sa RenormalizationInterval steps so that the rounding errors do not accumulate into
+/// a scaling of the matrices. A step costs two multiply-adds per matrix element.
+class ArcIterator
+{
+public:
+  /// @brief Number of steps between renormalizations of the cosine and sine
+  static constexpr std::size_t RenormalizationInterval = 16;
+
+  ArcIterator() = default;
+
+  /// @param constantTerm, cosineTerm, sineTerm Row-major matrices of the transform as a function of the angle, see \sa ArcIterator
+  /// @param startAngleDeg angle of the first matrix in degrees
+  /// @param angleStepDeg angle increment per step in degrees
+  ArcIterator(const Matrix4& constantTerm, const Matrix4& cosineTerm, const Matrix4& sineTerm, double startAngleDeg, double angleStepDeg)
+    : ConstantTerm(constantTerm)
+    , CosineTerm(cosineTerm)
+    , SineTerm(sineTerm)
+    , StartAngleDeg(startAngleDeg)
+    , AngleStepDeg(angleStepDeg)
+  {
+    const double startAngle = DegreesToRadians(startAngleDeg);
+    const double angleStep = DegreesToRadians(angleStepDeg);
+    this->Cosine = std::cos(startAngle);
+    this->Sine = std::sin(startAngle);
+    this->StepCosine = std::cos(angleStep);
+    this->StepSine = std::sin(angleStep);
+  }
+
+  /// @brief Get the composed transform at the current angle
+  /// @param outputMatrix Row-major 4x4 matrix
+  void GetMatrix(double outputMatrix[16]) const
+  {
+    for (int i = 0; i < 16; ++i)
+    {
+      outputMatrix[i] = this->ConstantTerm[i] + this->Cosine * this->CosineTerm[i] + this->Sine * this->SineTerm[i];
+    }
+  }
+
+  /// @brief Advance the angle by one step
+  void Next()
+  {
+    const double cosine = this->Cosine * this->StepCosine - this->Sine * this->StepSine;
+    const double sine = this->Sine * this->StepCosine + this->Cosine * this->StepSine;
+    this->Cosine = cosine;
+    this->Sine = sine;
+    if (++this->Step % RenormalizationInterval == 0)
+    {
+      // One Newton step towards cos^2 + sin^2 = 1, enough for the tiny deviation accumulated since the last one
+      const double scale = 1.5 - 0.5 * (cosine * cosine + sine * sine);
+      this->Cosine *= scale;
+      this->Sine *= scale;
+    }
+  }
+
+  /// @brief Number of steps taken since the start angle
+  std::size_t GetStep() const { return this->Step; }
+
+  /// @brief Current angle in degrees
+  double GetAngleDeg() const { return this->StartAngleDeg + static_cast<double>(this->Step) * this->AngleStepDeg; }
+
+private:
+  Matrix4 ConstantTerm = IdentityMatrix();
+  Matrix4 CosineTerm{};
+  Matrix4 SineTerm{};
+  double StartAngleDeg = 0.0;
+  double AngleStepDeg = 0.0;
+  double Cosine = 1.0;
+  double Sine = 0.0;
+  double StepCosine = 1.0;
+  double StepSine = 0.0;
+  std::size_t Step = 0;
+};
+
+//----------------------------------------------------------------------------
+// Grid index conversion
+//----------------------------------------------------------------------------
+
+/// @brief Division by a fixed divisor using a precomputed reciprocal (multiply-high instead of a hardware division)
+/// The reciprocal is ceil(2^64 / divisor), which gives the exact quotient for divisors below 2^16 and dividends
+/// below 2^48. This covers all grid indices, as grids have at most 2^16 - 1 elements per dimension.
+class FastDivider
+{
+public:
+  explicit FastDivider(std::uint32_t divisor)
+    : Divisor(divisor)
+    , Multiplier(divisor > 1 ? (~std::uint64_t(0)) / divisor + 1 : 0)
+    , DividendMask(divisor == 1 ? ~std::uint64_t(0) : 0)
+  {
+  }
+
+  std::uint64_t GetDivisor() const
+  {
+    return this->Divisor;
+  }
+
+  /// @brief Quotient dividend / divisor. The dividend must be less than 2^48 and the divisor must not be zero.
+  std::uint64_t Divide(std::uint64_t dividend) const
+  {
+    // Division by one cannot be done with a 64-bit reciprocal, the dividend itself is the quotient then
+    return MultiplyHigh(dividend, this->Multiplier) + (dividend & this->DividendMask);
+  }
+
+  /// @brief High 64 bits of the 128-bit product a * b
+  static std::uint64_t MultiplyHigh(std::uint64_t a, std::uint64_t b)
+  {
+#if defined(_MSC_VER) && defined(_M_X64)
+    std::uint64_t high = 0;
+    _umul128(a, b, &high);
+    return high;
+#elif defined(__SIZEOF_INT128__)
+    // __extension__ keeps -Wpedantic quiet about the non-standard 128-bit type
+    __extension__ typedef unsigned __int128 UInt128;
+    return static_cast<std::uint64_t>((static_cast<UInt128>(a) * b) >> 64);
+#else
+    const std::uint64_t aLow = a & 0xffffffffu;
+    const std::uint64_t aHigh = a >> 32;
+    const std::uint64_t bLow = b & 0xffffffffu;
+    const std::uint64_t bHigh = b >> 32;
+    const std::uint64_t lowLow = aLow * bLow;
+    const std::uint64_t lowHigh = aLow * bHigh;
+    const std::uint64_t highLow = aHigh * bLow;
+    const std::uint64_t middle = (lowLow >> 32) + (lowHigh & 0xffffffffu) + (highLow & 0xffffffffu);
+    return aHigh * bHigh + (lowHigh >> 32) + (highLow >> 32) + (middle >> 32);
+#endif
+  }
+
+private:
+  std::uint64_t Divisor;
+  std::uint64_t Multiplier;
+  std::uint64_t DividendMask;
+};
+
+/// @brief Get the number of elements of a grid, nElems[0] * nElems[1] * nElems[2]
+/// @return false if the number of elements does not fit in 64 bits (then linear indices cannot address the grid)
+template <typename IndexType>
+bool GetNumberOfGridElements(const std::array<IndexType, 3>& nElems, std::uint64_t& numberOfElements)
+{
+  static_assert(std::is_unsigned<IndexType>::value && sizeof(IndexType) <= sizeof(std::uint64_t), "Grid indices must be unsigned integers of at most 64 bits");
+  numberOfElements = 1;
+  for (IndexType n : nElems)
+  {
+    if (n != 0 && numberOfElements > std::numeric_limits<std::uint64_t>::max() / n)
+    {
+      return false;
+    }
+    numberOfElements *= n;
+  }
+  return true;
+}
+
+/// Number of indices that are bounds-checked together before being converted
+constexpr std::size_t IndexConversionBlockSize = 1024;
+
+/// @brief Convert grid indices (e0,e1,e2) to linear indices in C order, see vtkIECTransformLogic::VectorizedToLinearizedIndex
+/// Indices are validated block by block with a branch-free check, so that the conversion loops do not branch.
+/// @return -1 if all indices were converted, otherwise the position of the first index out of range (only the blocks
+///   before the one containing it are converted). All indices are out of range if the grid has more than 2^64 elements.
+template <typename IndexType>
+std::int64_t VectorizedToLinearizedIndices(const std::array<IndexType, 3>* vectorizedIndices, std::size_t numberOfIndices,
+  const std::array<IndexType, 3>& nElems, std::uint64_t* linearizedIndices)
+{
+  std::uint64_t numberOfElements = 0;
+  if (!GetNumberOfGridElements(nElems, numberOfElements))
+  {
+    return (numberOfIndices > 0 ? 0 : -1);
+  }
+  const std::uint64_t n1 = nElems[1];
+  const std::uint64_t n2 = nElems[2];
+  for (std::size_t blockBegin = 0; blockBegin < numberOfIndices; blockBegin += IndexConversionBlockSize)
+  {
+    const std::size_t blockEnd = std::min(numberOfIndices, blockBegin + IndexConversionBlockSize);
+
+    bool outOfRange = false;
+    for (std::size_t i = blockBegin; i < blockEnd; ++i)
+    {
+      outOfRange |= (vectorizedIndices[i][0] >= nElems[0]) | (vectorizedIndices[i][1] >= nElems[1]) | (vectorizedIndices[i][2] >= nElems[2]);
+    }
+    if (outOfRange)
+    {
+      for (std::size_t i = blockBegin; i < blockEnd; ++i)
+      {
+        if (vectorizedIndices[i][0] >= nElems[0] || vectorizedIndices[i][1] >= nElems[1] || vectorizedIndices[i][2] >= nElems[2])
+        {
+          return static_cast<std::int64_t>(i);
+        }
+      }
+    }
+
+    // Indices are in range, so the linear index is less than the number of elements and cannot overflow
+    for (std::size_t i = blockBegin; i < blockEnd; ++i)
+    {
+      linearizedIndices[i] = (static_cast<std::uint64_t>(vectorizedIndices[i][0]) * n1 + vectorizedIndices[i][1]) * n2 + vectorizedIndices[i][2];
+    }
+  }
+  return -1;
+}
+
+#if defined(IEC_AVX2_DISPATCH)
+/// @brief Quotient and remainder of 4 integers stored in doubles by an integer divisor below 2^16, for quotients below 2^32
+/// dividend * reciprocal is within 2^-20 of the exact quotient, whose fractional part is either 0 or at least 1/divisor
+/// >= 2^-16 away from the next integer. Adding 2^-17 before rounding down thus always gives the exact quotient, and the
+/// remainder is exact as all products are below 2^53.
+IEC_TARGET_AVX2 inline void DivideAVX2(const __m256d& dividend, const __m256d& divisor, const __m256d& reciprocal, __m256d& quotient,
+  __m256d& remainder)
+{
+  const __m256d bias = _mm256_set1_pd(1.0 / 131072.0);
+  quotient = _mm256_floor_pd(_mm256_add_pd(_mm256_mul_pd(dividend, reciprocal), bias));
+  remainder = _mm256_sub_pd(dividend, _mm256_mul_pd(quotient, divisor));
+}
+
+/// @brief Whether any of the linear indices is not below the number of elements, 4 indices per iteration
+/// @return Number of indices checked, a multiple of 4. The remaining ones are left to the portable loop.
+IEC_TARGET_AVX2 inline std::size_t CheckLinearizedIndicesAVX2(const std::uint64_t* linearizedIndices, std::size_t numberOfIndices,
+  std::uint64_t numberOfElements, bool& outOfRange)
+{
+  // Unsigned comparison as signed comparison of the values with the sign bit flipped
+  const __m256i signBit = _mm256_set1_epi64x(static_cast<long long>(0x8000000000000000ull));
+  const __m256i limit = _mm256_xor_si256(_mm256_set1_epi64x(static_cast<long long>(numberOfElements - 1)), signBit);
+  __m256i above = _mm256_setzero_si256();
+  std::size_t i = 0;
+  for (; i + 4 <= numberOfIndices; i += 4)
+  {
+    const __m256i indices = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(linearizedIndices + i));
+    above = _mm256_or_si256(above, _mm256_cmpgt_epi64(_mm256_xor_si256(indices, signBit), limit));
+  }
+  outOfRange = (_mm256_testz_si256(above, above) == 0);
+  return i;
+}
+
+/// @brief AVX2 variant of the conversion loop of \sa LinearizedToVectorizedIndices for 16-bit grids, 4 indices per iteration
+/// The indices are below 2^48, so they are converted to double exactly and divided in double precision (AVX2 has no
+/// 64-bit multiply-high). The quotients are below 2^32, as the grid has less than 2^16 elements along each axis. The 4 grid indices are packed into 12 interleaved 16-bit values with byte shuffles.
+/// @param linearizedIndices Indices that are all in range
+/// @return Number of indices converted, a multiple of 4. The remaining ones are left to the portable loop.
+IEC_TARGET_AVX2 inline std::size_t LinearizedToVectorizedIndicesAVX2(const std::uint64_t* linearizedIndices, std::size_t numberOfIndices,
+  std::uint64_t n1, std::uint64_t n2, std::array<std::uint16_t, 3>* vectorizedIndices)
+{
+  static_assert(sizeof(std::array<std::uint16_t, 3>) == 6, "Grid indices must be packed");
+  // Integers below 2^52 are converted by putting them into the mantissa of 2^52
+  const __m256i exponentBits = _mm256_set1_epi64x(0x4330000000000000ll);
+  const __m256d twoToThe52 = _mm256_set1_pd(4503599627370496.0);
+  const __m256d rows = _mm256_set1_pd(static_cast<double>(n1));
+  const __m256d columns = _mm256_set1_pd(static_cast<double>(n2));
+  const __m256d inverseRows = _mm256_set1_pd(1.0 / static_cast<double>(n1));
+  const __m256d inverseColumns = _mm256_set1_pd(1.0 / static_cast<double>(n2));
+  // 16-bit lanes of (slice, row) and (column, column) -> interleaved e0,e1,e2 of indices 0..2 (first 8 values) and 2..3 (last 4)
+  const __m128i lowSliceRow = _mm_setr_epi8(0, 1, 8, 9, -1, -1, 2, 3, 10, 11, -1, -1, 4, 5, 12, 13);
+  const __m128i lowColumn = _mm_setr_epi8(-1, -1, -1, -1, 0, 1, -1, -1, -1, -1, 2, 3, -1, -1, -1, -1);
+  const __m128i highSliceRow = _mm_setr_epi8(-1, -1, 6, 7, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+  const __m128i highColumn = _mm_setr_epi8(4, 5, -1, -1, -1, -1, 6, 7, -1, -1, -1, -1, -1, -1, -1, -1);
+
+  std::size_t i = 0;
+  for (; i + 4 <= numberOfIndices; i += 4)
+  {
+    const __m256i indices = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(linearizedIndices + i));
+    const __m256d linearizedIndex = _mm256_sub_pd(_mm256_castsi256_pd(_mm256_or_si256(indices, exponentBits)), twoToThe52);
+    __m256d sliceRow, column, slice, row;
+    DivideAVX2(linearizedIndex, columns, inverseColumns, sliceRow, column);
+    DivideAVX2(sliceRow, rows, inverseRows, slice, row);
+
+    const __m128i sliceRow16 = _mm_packus_epi32(_mm256_cvttpd_epi32(slice), _mm256_cvttpd_epi32(row));
+    const __m128i column16 = _mm_packus_epi32(_mm256_cvttpd_epi32(column), _mm256_cvttpd_epi32(column));
+    std::uint16_t* output = vectorizedIndices[i].data();
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output),
+      _mm_or_si128(_mm_shuffle_epi8(sliceRow16, lowSliceRow), _mm_shuffle_epi8(column16, lowColumn)));
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(output + 8),
+      _mm_or_si128(_mm_shuffle_epi8(sliceRow16, highSliceRow), _mm_shuffle_epi8(column16, highColumn)));
+  }
+  return i;
+}
+#endif
+
+/// @brief Convert linear indices to grid indices (e0,e1,e2) in C order, see vtkIECTransformLogic::LinearizedToVectorizedIndex
+/// If all grid dimensions are below 2^16 and the grid has at most 2^48 elements (always the case for 16-bit grids), the
+/// divisions by the grid dimensions are done with \sa FastDivider, otherwise with hardware division. For 16-bit grids the
+/// conversion uses AVX2 when the CPU supports it (\sa UseAVX2). Indices are validated block by block.
+/// @return -1 if all indices were converted, otherwise the position of the first index out of range (only the blocks
+///   before the one containing it are converted). All indices are out of range if the grid has more than 2^64 elements.
+template <typename IndexType>
+std::int64_t LinearizedToVectorizedIndices(const std::uint64_t* linearizedIndices, std::size_t numberOfIndices,
+  const std::array<IndexType, 3>& nElems, std::array<IndexType, 3>* vectorizedIndices)
+{
+  std::uint64_t numberOfElements = 0;
+  if (!GetNumberOfGridElements(nElems, numberOfElements) || numberOfElements == 0)
+  {
+    return (numberOfIndices > 0 ? 0 : -1);
+  }
+  const std::uint64_t n1 = nElems[1];
+  const std::uint64_t n2 = nElems[2];
+  const bool fastDivision = (n1 <= 0xffff && n2 <= 0xffff && numberOfElements <= (std::uint64_t(1) << 48));
+  const FastDivider columnDivider(fastDivision ? static_cast<std::uint32_t>(n2) : 1);
+  const FastDivider rowDivider(fastDivision ? static_cast<std::uint32_t>(n1) : 1);
+#if defined(IEC_AVX2_DISPATCH)
+  const bool useAVX2 = std::is_same<IndexType, std::uint16_t>::value && UseAVX2();
+#endif
+
+  for (std::size_t blockBegin = 0; blockBegin < numberOfIndices; blockBegin += IndexConversionBlockSize)
+  {
+    const std::size_t blockEnd = std::min(numberOfIndices, blockBegin + IndexConversionBlockSize);
+
+    bool outOfRange = false;
+    std::size_t checkBegin = blockBegin;
+#if defined(IEC_AVX2_DISPATCH)
+    if (useAVX2)
+    {
+      checkBegin += CheckLinearizedIndicesAVX2(linearizedIndices + blockBegin, blockEnd - blockBegin, numberOfElements, outOfRange);
+    }
+#endif
+    for (std::size_t i = checkBegin; i < blockEnd; ++i)
+    {
+      outOfRange |= (linearizedIndices[i] >= numberOfElements);
+    }
+    if (outOfRange)
+    {
+      for (std::size_t i = blockBegin; i < blockEnd; ++i)
+      {
+        if (linearizedIndices[i] >= numberOfElements)
+        {
+          return static_cast<std::int64_t>(i);
+        }
+      }
+    }
+
+    std::size_t i = blockBegin;
+#if defined(IEC_AVX2_DISPATCH)
+    if constexpr (std::is_same<IndexType, std::uint16_t>::value)
+    {
+      if (useAVX2)
+      {
+        i += LinearizedToVectorizedIndicesAVX2(linearizedIndices + i, blockEnd - i, n1, n2, vectorizedIndices + i);
+      }
+    }
+#endif
+    if (fastDivision)
+    {
+      for (; i < blockEnd; ++i)
+      {
+        const std::uint64_t linearizedIndex = linearizedIndices[i];
+        const std::uint64_t sliceRow = columnDivider.Divide(linearizedIndex);
+        const std::uint64_t slice = rowDivider.Divide(sliceRow);
+        vectorizedIndices[i][0] = static_cast<IndexType>(slice);
+        vectorizedIndices[i][1] = static_cast<IndexType>(sliceRow - slice * n1);
+        vectorizedIndices[i][2] = static_cast<IndexType>(linearizedIndex - sliceRow * n2);
+      }
+    }
+    else
+    {
+      for (; i < blockEnd; ++i)
+      {
+        const std::uint64_t linearizedIndex = linearizedIndices[i];
+        const std::uint64_t sliceRow = linearizedIndex / n2;
+        const std::uint64_t slice = sliceRow / n1;
+        vectorizedIndices[i][0] = static_cast<IndexType>(slice);
+        vectorizedIndices[i][1] = static_cast<IndexType>(sliceRow - slice * n1);
+        vectorizedIndices[i][2] = static_cast<IndexType>(linearizedIndex - sliceRow * n2);
+      }
+    }
+  }
+  return -1;
+}
+
+//----------------------------------------------------------------------------
+// Cache-friendly grid layouts
+//----------------------------------------------------------------------------
+
+/// @brief Z-order (Morton) layout of a grid: the bits of the three grid indices are interleaved
+/// Voxels that are close in 3D are close in memory along all three axes, which gives better cache locality than C order
+/// for scattered access (e.g. Monte Carlo dose scoring). The column index e2 gets the lowest bit, then e1, then e0.
+/// Only the low bits that all three axes have are interleaved: the grid is split into cubic blocks whose edge is the largest
+/// power of two that fits in the smallest dimension, the voxels inside a block are in Morton order and the blocks are stored
+/// one after the other in C order. A 512x512x1 grid is therefore plain C order, and a 256^3 grid is one Morton block.
+/// Uses the BMI2 pdep/pext instructions when the build enables them (e.g. -mbmi2 or -march=haswell), otherwise bit masks.
+/// @note The grid is padded to whole blocks, which is less than twice the grid size along each axis
+class MortonLayout
+{
+public:
+  explicit MortonLayout(const std::array<std::uint16_t, 3>& nElems)
+    : BlockSizeExponent(0)
+  {
+    const std::uint16_t minElems = std::min(nElems[0], std::min(nElems[1], nElems[2]));
+    while ((minElems >> (this->BlockSizeExponent + 1)) != 0)
+    {
+      ++this->BlockSizeExponent;
+    }
+    this->InBlockMask = (1u << this->BlockSizeExponent) - 1;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+      this->NumberOfBlocks[axis] = (static_cast<std::uint64_t>(nElems[axis]) + this->InBlockMask) >> this->BlockSizeExponent;
+    }
+  }
+
+  /// @brief Number of elements of the layout, including the padding of the blocks on the upper grid boundaries (0 for an empty grid)
+  std::uint64_t GetNumberOfElements() const
+  {
+    return (this->NumberOfBlocks[0] * this->NumberOfBlocks[1] * this->NumberOfBlocks[2]) << (3 * this->BlockSizeExponent);
+  }
+
+  /// @brief Edge of the Morton blocks is 2^GetBlockSizeExponent() voxels
+  unsigned int GetBlockSizeExponent() const
+  {
+    return this->BlockSizeExponent;
+  }
+
+  /// @brief Position of the voxel (e0,e1,e2) in the layout. The indices must be in range.
+  std::uint64_t GetIndex(const std::array<std::uint16_t, 3>& vectorizedIndex) const
+  {
+    const unsigned int k = this->BlockSizeExponent;
+    const std::uint64_t block = ((vectorizedIndex[0] >> k) * this->NumberOfBlocks[1] + (vectorizedIndex[1] >> k)) * this->NumberOfBlocks[2]
+      + (vectorizedIndex[2] >> k);
+    const std::uint64_t inBlock = Encode({ static_cast<std::uint16_t>(vectorizedIndex[0] & this->InBlockMask),
+      static_cast<std::uint16_t>(vectorizedIndex[1] & this->InBlockMask), static_cast<std::uint16_t>(vectorizedIndex[2] & this->InBlockMask) });
+    return (block << (3 * k)) | inBlock;
+  }
+
+  /// @brief Voxel (e0,e1,e2) at a position of the layout
+  std::array<std::uint16_t, 3> GetVectorizedIndex(std::uint64_t index) const
+  {
+    const unsigned int k = this->BlockSizeExponent;
+    const std::uint64_t block = index >> (3 * k);
+    const std::uint64_t blockRow = block / this->NumberOfBlocks[2];
+    const std::uint64_t b0 = blockRow / this->NumberOfBlocks[1];
+    const std::uint64_t b1 = blockRow - b0 * this->NumberOfBlocks[1];
+    const std::uint64_t b2 = block - blockRow * this->NumberOfBlocks[2];
+    const std::array<std::uint16_t, 3> inBlock = Decode(index & ((std::uint64_t(1) << (3 * k)) - 1));
+    return std::array<std::uint16_t, 3>{ static_cast<std::uint16_t>((b0 << k) | inBlock[0]),
+      static_cast<std::uint16_t>((b1 << k) | inBlock[1]), static_cast<std::uint16_t>((b2 << k) | inBlock[2]) };
+  }
+
+  /// @brief Morton code of the grid index (e0,e1,e2), 48 bits
+  static std::uint64_t Encode(const std::array<std::uint16_t, 3>& vectorizedIndex)
+  {
+#if defined(__BMI2__)
+    return _pdep_u64(vectorizedIndex[2], 0x0000249249249249ull)
+      | _pdep_u64(vectorizedIndex[1], 0x0000492492492492ull)
+      | _pdep_u64(vectorizedIndex[0], 0x0000924924924924ull);
+#else
+    return SpreadBits(vectorizedIndex[2]) | (SpreadBits(vectorizedIndex[1]) << 1) | (SpreadBits(vectorizedIndex[0]) << 2);
+#endif
+  }
+
+  /// @brief Grid index (e0,e1,e2) of a Morton code
+  static std::array<std::uint16_t, 3> Decode(std::uint64_t code)
+  {
+#if defined(__BMI2__)
+    return std::array<std::uint16_t, 3>{ static_cast<std::uint16_t>(_pext_u64(code, 0x0000924924924924ull)),
+      static_cast<std::uint16_t>(_pext_u64(code, 0x0000492492492492ull)),
+      static_cast<std::uint16_t>(_pext_u64(code, 0x0000249249249249ull)) };
+#else
+    return std::array<std::uint16_t, 3>{ static_cast<std::uint16_t>(CompactBits(code >> 2)),
+      static_cast<std::uint16_t>(CompactBits(code >> 1)), static_cast<std::uint16_t>(CompactBits(code)) };
+#endif
+  }
+
+  /// @brief Move bit i of a 16-bit value to bit 3*i
+  static std::uint64_t SpreadBits(std::uint64_t x)
+  {
+    x &= 0xffff;
+    x = (x | (x << 16)) & 0x00000000ff0000ffull;
+    x = (x | (x << 8)) & 0x000000f00f00f00full;
+    x = (x | (x << 4)) & 0x00000c30c30c30c3ull;
+    x = (x | (x << 2)) & 0x0000249249249249ull;
+    return x;
+  }
+
+  /// @brief Move bit 3*i to bit i, inverse of \sa SpreadBits
+  static std::uint64_t CompactBits(std::uint64_t x)
+  {
+    x &= 0x0000249249249249ull;
+    x = (x | (x >> 2)) & 0x00000c30c30c30c3ull;
+    x = (x | (x >> 4)) & 0x000000f00f00f00full;
+    x = (x | (x >> 8)) & 0x00000000ff0000ffull;
+    x = (x | (x >> 16)) & 0xffff;
+    return x;
+  }
+
+private:
+  unsigned int BlockSizeExponent;
+  std::uint64_t InBlockMask;
+  std::array<std::uint64_t, 3> NumberOfBlocks;
+};
+
+/// @brief Tiled layout of a grid: cubic bricks of 2^k voxels per edge stored one after the other in C order,
+/// with the voxels inside each brick also in C order
+/// A brick of 8x8x8 doubles is 4 KiB (one page), so scattered access within a neighborhood touches few pages and cache lines.
+/// @note The grid is padded to whole bricks
+class BrickLayout
+{
+public:
+  /// @param nElems Number of elements in each dimension (slices, rows, columns)
+  /// @param brickSizeExponent Bricks have 2^brickSizeExponent voxels along each edge (e.g. 3 for 8x8x8 bricks)
+  BrickLayout(const std::array<std::uint16_t, 3>& nElems, unsigned int brickSizeExponent = 3)
+    : BrickSizeExponent(brickSizeExponent)
+    , InBrickMask((1u << brickSizeExponent) - 1)
+  {
+    for (int axis = 0; axis < 3; ++axis)
+    {
+      this->NumberOfBricks[axis] = (static_cast<std::uint64_t>(nElems[axis]) + this->InBrickMask) >> brickSizeExponent;
+    }
+  }
+
+  /// @brief Number of elements of the layout, including the padding of the bricks on the upper grid boundaries
+  std::uint64_t GetNumberOfElements() const
+  {
+    return (this->NumberOfBricks[0] * this->NumberOfBricks[1] * this->NumberOfBricks[2]) << (3 * this->BrickSizeExponent);
+  }
+
+  /// @brief Position of the voxel (e0,e1,e2) in the layout. The indices must be in range.
+  std::uint64_t GetIndex(const std::array<std::uint16_t, 3>& vectorizedIndex) const
+  {
+    const unsigned int k = this->BrickSizeExponent;
+    const std::uint64_t brick = ((vectorizedIndex[0] >> k) * this->NumberOfBricks[1] + (vectorizedIndex[1] >> k)) * this->NumberOfBricks[2]
+      + (vectorizedIndex[2] >> k);
+    const std::uint64_t inBrick = (static_cast<std::uint64_t>(vectorizedIndex[0] & this->InBrickMask) << (2 * k))
+      | (static_cast<std::uint64_t>(vectorizedIndex[1] & this->InBrickMask) << k) | (vectorizedIndex[2] & this->InBrickMask);
+    return (brick << (3 * k)) | inBrick;
+  }
+
+  /// @brief Voxel (e0,e1,e2) at a position of the layout
+  std::array<std::uint16_t, 3> GetVectorizedIndex(std::uint64_t index) const
+  {
+    const unsigned int k = this->BrickSizeExponent;
+    const std::uint64_t brick = index >> (3 * k);
+    const std::uint64_t brickRow = brick / this->NumberOfBricks[2];
+    const std::uint64_t b0 = brickRow / this->NumberOfBricks[1];
+    const std::uint64_t b1 = brickRow - b0 * this->NumberOfBricks[1];
+    const std::uint64_t b2 = brick - brickRow * this->NumberOfBricks[2];
+    return std::array<std::uint16_t, 3>{ static_cast<std::uint16_t>((b0 << k) | ((index >> (2 * k)) & this->InBrickMask)),
+      static_cast<std::uint16_t>((b1 << k) | ((index >> k) & this->InBrickMask)),
+      static_cast<std::uint16_t>((b2 << k) | (index & this->InBrickMask)) };
+  }
+
+private:
+  unsigned int BrickSizeExponent;
+  std::uint64_t InBrickMask;
+  std::array<std::uint64_t, 3> NumberOfBricks;
+};
+
+/// @brief Copy grid values stored in C order (\sa vtkIECTransformLogic::VectorizedToLinearizedIndex) into a \sa MortonLayout or \sa BrickLayout
+/// @param layoutValues Output array of layout.GetNumberOfElements() values. Padding elements are not written.
+template <typename Layout, typename ValueType>
+void ConvertRowMajorToLayout(const Layout& layout, const std::array<std::uint16_t, 3>& nElems, const ValueType* rowMajorValues, ValueType* layoutValues)
+{
+  std::array<std::uint16_t, 3> vectorizedIndex = { 0, 0, 0 };
+  for (vectorizedIndex[0] = 0; vectorizedIndex[0] < nElems[0]; ++vectorizedIndex[0])
+  {
+    for (vectorizedIndex[1] = 0; vectorizedIndex[1] < nElems[1]; ++vectorizedIndex[1])
+    {
+      for (vectorizedIndex[2] = 0; vectorizedIndex[2] < nElems[2]; ++vectorizedIndex[2])
+      {
+        layoutValues[layout.GetIndex(vectorizedIndex)] = *rowMajorValues++;
+      }
+    }
+  }
+}
+
+/// @brief Copy grid values from a \sa MortonLayout or \sa BrickLayout back into C order, inverse of \sa ConvertRowMajorToLayout
+template <typename Layout, typename ValueType>
+void ConvertLayoutToRowMajor(const Layout& layout, const std::array<std::uint16_t, 3>& nElems, const ValueType* layoutValues, ValueType* rowMajorValues)
+{
+  std::array<std::uint16_t, 3> vectorizedIndex = { 0, 0, 0 };
+  for (vectorizedIndex[0] = 0; vectorizedIndex[0] < nElems[0]; ++vectorizedIndex[0])
+  {
+    for (vectorizedIndex[1] = 0; vectorizedIndex[1] < nElems[1]; ++vectorizedIndex[1])
+    {
+      for (vectorizedIndex[2] = 0; vectorizedIndex[2] < nElems[2]; ++vectorizedIndex[2])
+      {
+        *rowMajorValues++ = layoutValues[layout.GetIndex(vectorizedIndex)];
+      }
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+// IEC 61217 hierarchy
+//----------------------------------------------------------------------------
+
+/// @brief Elementary transform child -> parent between two coordinate systems
+struct ElementaryTransformDefinition
+{
+  CoordinateSystemIdentifier Child;
+  CoordinateSystemIdentifier Parent;
+  /// Rotation and translation only, so that it can be inverted in closed form
+  bool Rigid;
+};
+
+constexpr int NumberOfElementaryTransforms = 17;
+
+/// @brief The elementary transforms of the IEC logic. The position in the list is the elementary transform index.
+constexpr std::array<ElementaryTransformDefinition, NumberOfElementaryTransforms> ElementaryTransforms = { {
+  { FixedReference, RAS, true },
+  { Gantry, FixedReference, true },
+  { Collimator, Gantry, true },
+  { WedgeFilter, Collimator, true },
+  { LeftImagingPanel, Gantry, true },
+  { RightImagingPanel, Gantry, true },
+  { PatientSupportRotation, FixedReference, true }, // Rotation component of patient support transform
+  { PatientSupport, PatientSupportRotation, false }, // Scaling component of patient support transform
+  { TableTopEccentricRotation, PatientSupportRotation, true }, // NOTE: Currently not supported by REV
+  { TableTop, TableTopEccentricRotation, true },
+  { Patient, TableTop, true },
+  { DICOM, Patient, true },
+  { PatientImageRegularGrid, DICOM, false }, // Contains the pixel spacing
+  { RAS, Patient, true },
+  { FlatPanel, Gantry, true },
+  { Imager, FixedReference, true },
+  { Focus, Imager, true }
+} };
+
+/// @brief Names of the coordinate systems, used for naming the transforms
+constexpr std::array<const char*, LastIECCoordinateFrame> CoordinateSystemNames = { {
+  "Ras", "FixedReference", "Gantry", "Collimator", "LeftImagingPanel", "RightImagingPanel", "PatientSupportRotation",
+  "PatientSupport", "TableTopEccentricRotation", "TableTop", "FlatPanel", "WedgeFilter", "Patient", "DICOM",
+  "PatientImageRegularGrid", "Imager", "Focus"
+} };
+
+/// @brief Standard IEC 61217 hierarchy, FixedReference is the root. Frames without parent are not part of the hierarchy.
+/// All members are constexpr, so paths between frames can be resolved at compile time.
+struct StandardHierarchy
+{
+  static constexpr int GetNumberOfFrames()
+  {
+    return LastIECCoordinateFrame;
+  }
+
+  /// @return Parent of the frame, -1 for the root and for frames that are not part of the hierarchy
+  static constexpr int GetParent(int frame)
+  {
+    constexpr std::array<int, LastIECCoordinateFrame> parents = { {
+      Patient,                   // RAS
+      -1,                        // FixedReference
+      FixedReference,            // Gantry
+      Gantry,                    // Collimator
+      Gantry,                    // LeftImagingPanel
+      Gantry,                    // RightImagingPanel
+      FixedReference,            // PatientSupportRotation
+      PatientSupportRotation,    // PatientSupport
+      PatientSupportRotation,    // TableTopEccentricRotation
+      TableTopEccentricRotation, // TableTop
+      Gantry,                    // FlatPanel
+      Collimator,                // WedgeFilter
+      TableTop,                  // Patient
+      Patient,                   // DICOM
+      DICOM,                     // PatientImageRegularGrid
+      FixedReference,            // Imager
+      Imager                     // Focus
+    } };
+    return parents[frame];
+  }
+
+  /// @return Number of transforms between the frame and the root, -1 for frames that are not part of the hierarchy
+  static constexpr int GetDepth(int frame)
+  {
+    int depth = 0;
+    while (frame != FixedReference)
+    {
+      frame = GetParent(frame);
+      if (frame < 0)
+      {
+        return -1;
+      }
+      ++depth;
+    }
+    return depth;
+  }
+
+  /// @return Index in \sa ElementaryTransforms of the transform child -> parent, -1 if there is none
+  static constexpr int GetElementaryTransformIndex(int child, int parent)
+  {
+    for (int index = 0; index < NumberOfElementaryTransforms; ++index)
+    {
+      if (ElementaryTransforms[index].Child == child && ElementaryTransforms[index].Parent == parent)
+      {
+        return index;
+      }
+    }
+    return -1;
+  }
+
+  static constexpr bool IsElementaryTransformRigid(int index)
+  {
+    return ElementaryTransforms[index].Rigid;
+  }
+};
+
+/// @brief Hierarchy compiled into flat tables at runtime, for hierarchies that differ from \sa StandardHierarchy
+struct FrameTables
+{
+  /// Parent of each frame, -1 for the root and for frames that are not part of the hierarchy
+  std::vector<int> FrameParents;
+  /// Number of transforms between each frame and the root, -1 for frames that are not part of the hierarchy
+  std::vector<int> FrameDepths;
+  /// Index of the elementary transform for each (child, parent) frame pair, stored at child * number of frames + parent, -1 if none
+  std::vector<int> ElementaryTransformIndices;
+  /// Flag for each elementary transform whether it only contains rotation and translation
+  std::vector<bool> ElementaryTransformRigidFlags;
+
+  int GetNumberOfFrames() const
+  {
+    return static_cast<int>(this->FrameParents.size());
+  }
+  int GetParent(int frame) const
+  {
+    return this->FrameParents[frame];
+  }
+  int GetDepth(int frame) const
+  {
+    return this->FrameDepths[frame];
+  }
+  int GetElementaryTransformIndex(int child, int parent) const
+  {
+    return this->ElementaryTransformIndices[child * this->GetNumberOfFrames() + parent];
+  }
+  bool IsElementaryTransformRigid(int index) const
+  {
+    return this->ElementaryTransformRigidFlags[index];
+  }
+
+  /// @brief Tables of the standard IEC 61217 hierarchy
+  static FrameTables Standard()
+  {
+    FrameTables tables;
+    const int numberOfFrames = StandardHierarchy::GetNumberOfFrames();
+    tables.FrameParents.resize(numberOfFrames);
+    tables.FrameDepths.resize(numberOfFrames);
+    tables.ElementaryTransformIndices.assign(numberOfFrames * numberOfFrames, -1);
+    for (int frame = 0; frame < numberOfFrames; ++frame)
+    {
+      tables.FrameParents[frame] = StandardHierarchy::GetParent(frame);
+      tables.FrameDepths[frame] = StandardHierarchy::GetDepth(frame);
+    }
+    for (int index = 0; index < NumberOfElementaryTransforms; ++index)
+    {
+      tables.ElementaryTransformIndices[ElementaryTransforms[index].Child * numberOfFrames + ElementaryTransforms[index].Parent] = index;
+      tables.ElementaryTransformRigidFlags.push_back(ElementaryTransforms[index].Rigid);
+    }
+    return tables;
+  }
+};
+
+//----------------------------------------------------------------------------
+// Path resolution
+//----------------------------------------------------------------------------
+
+/// @brief Get the closest frame that both frames descend from (lowest common ancestor)
+/// @param hierarchy \sa StandardHierarchy or \sa FrameTables
+/// @return The common ancestor, -1 if any of the frames is not part of the hierarchy
+template <typename Hierarchy>
+constexpr int GetCommonAncestor(const Hierarchy& hierarchy, int frame1, int frame2)
+{
+  if (frame1 < 0 || frame1 >= hierarchy.GetNumberOfFrames() || frame2 < 0 || frame2 >= hierarchy.GetNumberOfFrames()
+    || hierarchy.GetDepth(frame1) < 0 || hierarchy.GetDepth(frame2) < 0)
+  {
+    return -1;
+  }
+  while (hierarchy.GetDepth(frame1) > hierarchy.GetDepth(frame2))
+  {
+    frame1 = hierarchy.GetParent(frame1);
+  }
+  while (hierarchy.GetDepth(frame2) > hierarchy.GetDepth(frame1))
+  {
+    frame2 = hierarchy.GetParent(frame2);
+  }
+  while (frame1 != frame2)
+  {
+    frame1 = hierarchy.GetParent(frame1);
+    frame2 = hierarchy.GetParent(frame2);
+  }
+  return frame1;
+}
+
+/// @brief Compose the elementary transforms on the path fromFrame -> ancestor -> toFrame
+/// The upward part is multiplied as it is. The downward part ancestor -> toFrame is accumulated bottom-up and
+/// inverted once at the end (in closed form if all its transforms are rigid), unless transformForBeam is set, in
+/// which case the downward transforms are applied without inversion. No memory is allocated.
+/// @param hierarchy \sa StandardHierarchy or \sa FrameTables
+/// @param edgeMatrix callable returning a pointer to the row-major matrix of an elementary transform given its index
+/// @param outputMatrix Row-major 4x4 matrix fromFrame -> toFrame
+/// @return false if the path contains a frame pair without elementary transform
+template <typename Hierarchy, typename EdgeMatrixFunctor>
+bool ComposePath(const Hierarchy& hierarchy, int fromFrame, int toFrame, int ancestor, bool transformForBeam,
+  EdgeMatrixFunctor&& edgeMatrix, double outputMatrix[16])
+{
+  // Upward part of the path: fromFrame -> ancestor. Elementary transforms are applied post-multiplied: up = edge * up
+  double upwardMatrix[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+  for (int child = fromFrame; child != ancestor; child = hierarchy.GetParent(child))
+  {
+    const int index = hierarchy.GetElementaryTransformIndex(child, hierarchy.GetParent(child));
+    if (index < 0)
+    {
+      return false;
+    }
+    Multiply(edgeMatrix(index), upwardMatrix, upwardMatrix);
+  }
+
+  // Downward part of the path, collected from toFrame up to the ancestor
+  double downwardMatrix[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+  bool downwardRigid = true;
+  for (int child = toFrame; child != ancestor; child = hierarchy.GetParent(child))
+  {
+    const int index = hierarchy.GetElementaryTransformIndex(child, hierarchy.GetParent(child));
+    if (index < 0)
+    {
+      return false;
+    }
+    if (transformForBeam)
+    {
+      // Not inverted: edges are applied top-down, the lowest one last
+      Multiply(downwardMatrix, edgeMatrix(index), downwardMatrix);
+    }
+    else
+    {
+      // toFrame -> ancestor transform, inverted below
+      Multiply(edgeMatrix(index), downwardMatrix, downwardMatrix);
+      downwardRigid = downwardRigid && hierarchy.IsElementaryTransformRigid(index);
+    }
+  }
+
+  if (!transformForBeam)
+  {
+    Matrix4 toFrameToAncestor{};
+    std::copy(downwardMatrix, downwardMatrix + 16, toFrameToAncestor.begin());
+    Matrix4 ancestorToToFrame{};
+    if (downwardRigid)
+    {
+      ancestorToToFrame = InvertRigid(toFrameToAncestor);
+    }
+    else if (!Invert(toFrameToAncestor, ancestorToToFrame))
+    {
+      return false;
+    }
+    std::copy(ancestorToToFrame.begin(), ancestorToToFrame.end(), downwardMatrix);
+  }
+
+  Multiply(downwardMatrix, upwardMatrix, outputMatrix);
+  return true;
+}
+
+//----------------------------------------------------------------------------
+// Compile-time path resolution
+//----------------------------------------------------------------------------
+
+/// @brief Path between two frames of \sa StandardHierarchy, resolved at compile time
+/// Both frames must be part of the hierarchy, this is checked with static_assert.
+template <int FromFrame, int ToFrame>
+struct StandardPath
+{
+  static constexpr int Ancestor = GetCommonAncestor(StandardHierarchy{}, FromFrame, ToFrame);
+  static_assert(Ancestor >= 0, "Both frames must be part of the standard IEC hierarchy");
+
+  static constexpr int NumberOfUpwardTransforms = StandardHierarchy::GetDepth(FromFrame) - StandardHierarchy::GetDepth(Ancestor);
+  static constexpr int NumberOfDownwardTransforms = StandardHierarchy::GetDepth(ToFrame) - StandardHierarchy::GetDepth(Ancestor);
+
+  /// @brief Elementary transform indices from a frame up to (not including) the ancestor, lowest one first
+  template <int NumberOfTransforms>
+  static constexpr std::array<int, NumberOfTransforms> GetTransformIndicesToAncestor(int frame)
+  {
+    std::array<int, NumberOfTransforms> indices{};
+    for (int i = 0; i < NumberOfTransforms; ++i)
+    {
+      indices[i] = StandardHierarchy::GetElementaryTransformIndex(frame, StandardHierarchy::GetParent(frame));
+      frame = StandardHierarchy::GetParent(frame);
+    }
+    return indices;
+  }
+
+  /// Transforms fromFrame -> ancestor, applied as they are
+  static constexpr std::array<int, NumberOfUpwardTransforms> UpwardTransformIndices = GetTransformIndicesToAncestor<NumberOfUpwardTransforms>(FromFrame);
+  /// Transforms toFrame -> ancestor, their product is inverted
+  static constexpr std::array<int, NumberOfDownwardTransforms> DownwardTransformIndices = GetTransformIndicesToAncestor<NumberOfDownwardTransforms>(ToFrame);
+
+  static constexpr bool AreAllTransformsDefined()
+  {
+    for (int index : UpwardTransformIndices)
+    {
+      if (index < 0)
+      {
+        return false;
+      }
+    }
+    for (int index : DownwardTransformIndices)
+    {
+      if (index < 0)
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+  static_assert(AreAllTransformsDefined(), "Every frame pair of the path must have an elementary transform");
+
+  static constexpr bool IsDownwardRigid()
+  {
+    for (int index : DownwardTransformIndices)
+    {
+      if (!StandardHierarchy::IsElementaryTransformRigid(index))
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+  /// The downward part only contains rotation and translation, so it can be inverted in closed form
+  static constexpr bool DownwardRigid = IsDownwardRigid();
+};
+
+/// @brief Pre-multiply the matrix by the given elementary transforms in order: matrix = edge[I] * matrix
+/// Expanded into one multiplication per transform, without a loop.
+template <typename Indices, typename EdgeMatrixFunctor, std::size_t... I>
+void MultiplyTransforms(const Indices& indices, EdgeMatrixFunctor& edgeMatrix, double matrix[16], std::index_sequence<I...>)
+{
+  (void)indices;
+  (void)edgeMatrix;
+  (void)matrix;
+  (Multiply(edgeMatrix(indices[I]), matrix, matrix), ...);
+}
+
+/// @brief Compose the transforms of a \sa StandardPath. Same result as \sa ComposePath (without transformForBeam),
+/// but the sequence of multiplications is unrolled at compile time.
+/// @param edgeMatrix callable returning a pointer to the row-major matrix of an elementary transform given its index
+/// @return false if the downward part of the path is singular
+template <int FromFrame, int ToFrame, typename EdgeMatrixFunctor>
+bool ComposeStandardPath(EdgeMatrixFunctor&& edgeMatrix, double outputMatrix[16])
+{
+  using Path = StandardPath<FromFrame, ToFrame>;
+
+  double upwardMatrix[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+  MultiplyTransforms(Path::UpwardTransformIndices, edgeMatrix, upwardMatrix, std::make_index_sequence<Path::NumberOfUpwardTransforms>());
+
+  if constexpr (Path::NumberOfDownwardTransforms == 0)
+  {
+    std::copy(upwardMatrix, upwardMatrix + 16, outputMatrix);
+    return true;
+  }
+  else
+  {
+    Matrix4 toFrameToAncestor = IdentityMatrix();
+    MultiplyTransforms(Path::DownwardTransformIndices, edgeMatrix, toFrameToAncestor.data(), std::make_index_sequence<Path::NumberOfDownwardTransforms>());
+
+    Matrix4 ancestorToToFrame{};
+    if constexpr (Path::DownwardRigid)
+    {
+      ancestorToToFrame = InvertRigid(toFrameToAncestor);
+    }
+    else if (!Invert(toFrameToAncestor, ancestorToToFrame))
+    {
+      return false;
+    }
+    Multiply(ancestorToToFrame.data(), upwardMatrix, outputMatrix);
+    return true;
+  }
+}
+
+//----------------------------------------------------------------------------
+// Machine state
+//----------------------------------------------------------------------------
+
+/// @brief Values of all elementary transforms of the standard IEC 61217 hierarchy
+/// A plain value type: copying it captures the complete machine geometry.
+struct MachineState
+{
+  /// Row-major matrices in \sa ElementaryTransforms order
+  std::array<Matrix4, NumberOfElementaryTransforms> ElementaryTransformMatrices;
+
+  /// @brief Initial state: all elementary transforms identity, except the fixed DICOM and RAS patient frame conversions
+  /// and the focus at \sa DefaultSourceAxisDistance
+  MachineState()
+  {
+    this->ElementaryTransformMatrices.fill(IdentityMatrix());
+    this->GetMatrix(DICOM, Patient) = DICOMToPatientMatrix();
+    this->GetMatrix(RAS, Patient) = RasToPatientMatrix();
+    this->GetMatrix(Focus, Imager) = FocusToImagerMatrix(DefaultSourceAxisDistance);
+  }
+
+  /// @brief Matrix of the elementary transform child -> parent. The pair must be one of \sa ElementaryTransforms.
+  Matrix4& GetMatrix(CoordinateSystemIdentifier child, CoordinateSystemIdentifier parent)
+  {
+    return this->ElementaryTransformMatrices[StandardHierarchy::GetElementaryTransformIndex(child, parent)];
+  }
+  const Matrix4& GetMatrix(CoordinateSystemIdentifier child, CoordinateSystemIdentifier parent) const
+  {
+    return this->ElementaryTransformMatrices[StandardHierarchy::GetElementaryTransformIndex(child, parent)];
+  }
+
+  /// @brief Get transform matrix from one coordinate frame to another
+  /// @return Success flag (false if any of the frames is not part of the hierarchy)
+  bool GetTransformBetween(CoordinateSystemIdentifier fromFrame, CoordinateSystemIdentifier toFrame, Matrix4& outputMatrix) const
+  {
+    const StandardHierarchy hierarchy;
+    const int ancestor = GetCommonAncestor(hierarchy, fromFrame, toFrame);
+    if (ancestor < 0)
+    {
+      return false;
+    }
+    return ComposePath(hierarchy, fromFrame, toFrame, ancestor, false,
+      [this](int index) { return this->ElementaryTransformMatrices[index].data(); }, outputMatrix.data());
+  }
+
+  /// @brief Get transform matrix between two frames known at compile time
+  /// @return Success flag (false if the path contains a singular transform)
+  template <CoordinateSystemIdentifier FromFrame, CoordinateSystemIdentifier ToFrame>
+  bool GetTransform(Matrix4& outputMatrix) const
+  {
+    return ComposeStandardPath<FromFrame, ToFrame>(
+      [this](int index) { return this->ElementaryTransformMatrices[index].data(); }, outputMatrix.data());
+  }
+};
+
+//----------------------------------------------------------------------------
+// Machine parameters
+//----------------------------------------------------------------------------
+
+/// @brief Parameters of the GantryToFixedReference transform, \sa GantryToFixedReferenceMatrix
+struct GantryParameters
+{
+  double RotationAngleDeg = 0.0;
+  double PitchAngleDeg = 0.0;
+
+  Matrix4 GetMatrix() const { return GantryToFixedReferenceMatrix(this->RotationAngleDeg, this->PitchAngleDeg); }
+  bool operator==(const GantryParameters& other) const
+  {
+    return this->RotationAngleDeg == other.RotationAngleDeg && this->PitchAngleDeg == other.PitchAngleDeg;
+  }
+};
+
+/// @brief Parameters of the CollimatorToGantry transform, \sa CollimatorToGantryMatrix
+struct CollimatorParameters
+{
+  double RotationAngleDeg = 0.0;
+  double Bz = 0.0;
+
+  Matrix4 GetMatrix() const { return CollimatorToGantryMatrix(this->RotationAngleDeg, this->Bz); }
+  bool operator==(const CollimatorParameters& other) const
+  {
+    return this->RotationAngleDeg == other.RotationAngleDeg && this->Bz == other.Bz;
+  }
+};
+
+/// @brief Parameters of the WedgeFilterToCollimator transform, \sa WedgeFilterToCollimatorMatrix
+struct WedgeFilterParameters
+{
+  double RotationAngleDeg = 0.0;
+  double Wz = 0.0;
+
+  Matrix4 GetMatrix() const { return WedgeFilterToCollimatorMatrix(this->RotationAngleDeg, this->Wz); }
+  bool operator==(const WedgeFilterParameters& other) const
+  {
+    return this->RotationAngleDeg == other.RotationAngleDeg && this->Wz == other.Wz;
+  }
+};
+
+/// @brief Parameters of the PatientSupportRotationToFixedReference transform, \sa PatientSupportRotationToFixedReferenceMatrix
+struct PatientSupportRotationParameters
+{
+  double RotationAngleDeg = 0.0;
+
+  Matrix4 GetMatrix() const { return PatientSupportRotationToFixedReferenceMatrix(this->RotationAngleDeg); }
+  bool operator==(const PatientSupportRotationParameters& other) const
+  {
+    return this->RotationAngleDeg == other.RotationAngleDeg;
+  }
+};
+
+/// @brief Parameters of the TableTopEccentricRotationToPatientSupportRotation transform,
+/// \sa TableTopEccentricRotationToPatientSupportRotationMatrix
+struct TableTopEccentricRotationParameters
+{
+  double RotationAngleDeg = 0.0;
+  double Ey = 0.0;
+
+  Matrix4 GetMatrix() const { return TableTopEccentricRotationToPatientSupportRotationMatrix(this->RotationAngleDeg, this->Ey); }
+  bool operator==(const TableTopEccentricRotationParameters& other) const
+  {
+    return this->RotationAngleDeg == other.RotationAngleDeg && this->Ey == other.Ey;
+  }
+};
+
+/// @brief Parameters of the TableTopToTableTopEccentricRotation transform, \sa TableTopToTableTopEccentricRotationMatrix
+struct TableTopParameters
+{
+  double Tx = 0.0;
+  double Ty = 0.0;
+  double Tz = 0.0;
+  double PitchAngleDeg = 0.0;
+  double RollAngleDeg = 0.0;
+
+  Matrix4 GetMatrix() const { return TableTopToTableTopEccentricRotationMatrix(this->Tx, this->Ty, this->Tz, this->PitchAngleDeg, this->RollAngleDeg); }
+  bool operator==(const TableTopParameters& other) const
+  {
+    return this->Tx == other.Tx && this->Ty == other.Ty && this->Tz == other.Tz
+      && this->PitchAngleDeg == other.PitchAngleDeg && this->RollAngleDeg == other.RollAngleDeg;
+  }
+};
+
+/// @brief Parameters of the PatientToTableTop transform, \sa PatientToTableTopMatrix
+struct PatientParameters
+{
+  double Px = 0.0;
+  double Py = 0.0;
+  double Pz = 0.0;
+  double PsiAngleDeg = 0.0;
+  double PhiAngleDeg = 0.0;
+  double ThetaAngleDeg = 0.0;
+
+  Matrix4 GetMatrix() const { return PatientToTableTopMatrix(this->Px, this->Py, this->Pz, this->PsiAngleDeg, this->PhiAngleDeg, this->ThetaAngleDeg); }
+  bool operator==(const PatientParameters& other) const
+  {
+    return this->Px == other.Px && this->Py == other.Py && this->Pz == other.Pz
+      && this->PsiAngleDeg == other.PsiAngleDeg && this->PhiAngleDeg == other.PhiAngleDeg && this->ThetaAngleDeg == other.ThetaAngleDeg;
+  }
+};
+
+/// @brief Parameters of the PatientImageRegularGridToDICOM transform, \sa PatientImageRegularGridToDICOMMatrix
+/// The defaults give the identity transform of a newly created logic.
+struct PatientImageRegularGridParameters
+{
+  double ColumnPixelSpacing = 1.0;
+  double RowPixelSpacing = 1.0;
+  double SliceDistance = 1.0;
+  std::array<double, 3> Origin = { { 0.0, 0.0, 0.0 } };
+  std::array<double, 3> DirectionCosineX = { { 1.0, 0.0, 0.0 } };
+  std::array<double, 3> DirectionCosineY = { { 0.0, 1.0, 0.0 } };
+
+  Matrix4 GetMatrix() const
+  {
+    return PatientImageRegularGridToDICOMMatrix(this->ColumnPixelSpacing, this->RowPixelSpacing, this->SliceDistance,
+      this->Origin[0], this->Origin[1], this->Origin[2], this->DirectionCosineX[0], this->DirectionCosineX[1], this->DirectionCosineX[2],
+      this->DirectionCosineY[0], this->DirectionCosineY[1], this->DirectionCosineY[2]);
+  }
+  bool operator==(const PatientImageRegularGridParameters& other) const
+  {
+    return this->ColumnPixelSpacing == other.ColumnPixelSpacing && this->RowPixelSpacing == other.RowPixelSpacing
+      && this->SliceDistance == other.SliceDistance && this->Origin == other.Origin
+      && this->DirectionCosineX == other.DirectionCosineX && this->DirectionCosineY == other.DirectionCosineY;
+  }
+};
+
+/// @brief Parameters of the ImagerToFixedReference transform, \sa ImagerToFixedReferenceMatrix
+struct ImagerParameters
+{
+  double RotationAngleDeg = 0.0;
+  double PitchAngleDeg = 0.0;
+
+  Matrix4 GetMatrix() const { return ImagerToFixedReferenceMatrix(this->RotationAngleDeg, this->PitchAngleDeg); }
+  bool operator==(const ImagerParameters& other) const
+  {
+    return this->RotationAngleDeg == other.RotationAngleDeg && this->PitchAngleDeg == other.PitchAngleDeg;
+  }
+};
+
+/// @brief Parameters of the FocusToImager transform, \sa FocusToImagerMatrix
+struct FocusParameters
+{
+  double SourceAxisDistance = DefaultSourceAxisDistance;
+
+  Matrix4 GetMatrix() const { return FocusToImagerMatrix(this->SourceAxisDistance); }
+  bool operator==(const FocusParameters& other) const
+  {
+    return this->SourceAxisDistance == other.SourceAxisDistance;
+  }
+};
+
+/// @brief Parameters of all elementary transforms that are set from machine axes and patient setup
+/// The defaults are the parameters of a newly created logic. The transforms without parameters (the DICOM and RAS patient
+/// frame conversions, the imaging panels, the patient support scaling) are not included.
+struct MachineParameters
+{
+  GantryParameters Gantry;
+  CollimatorParameters Collimator;
+  WedgeFilterParameters WedgeFilter;
+  PatientSupportRotationParameters PatientSupportRotation;
+  TableTopEccentricRotationParameters TableTopEccentricRotation;
+  TableTopParameters TableTop;
+  PatientParameters Patient;
+  PatientImageRegularGridParameters PatientImageRegularGrid;
+  ImagerParameters Imager;
+  FocusParameters Focus;
+};
+
+//----------------------------------------------------------------------------
+// Binary machine state record
+//----------------------------------------------------------------------------
+
+/// @brief Fixed-layout binary record of the machine state of the standard hierarchy: the elementary transforms and the
+/// machine parameters they were built from
+/// A plain struct without pointers or padding: it can be written to a file as is, memory mapped or placed in shared
+/// memory, and read back without any parsing. Values are in native byte order, a record written with the other byte
+/// order is recognized by its magic number.
+struct MachineStateRecord
+{
+  /// @brief "IECS" when read as little-endian
+  static constexpr uint32_t MagicNumber = 0x53434549u;
+  /// @brief Incremented whenever the layout changes
+  /// Version 2 added the machine parameters. Version 1 records cannot be read, as the parameters cannot be recovered
+  /// from the matrices in general.
+  static constexpr uint32_t CurrentFormatVersion = 2;
+
+  uint32_t Magic;
+  uint32_t FormatVersion;
+  /// Number of matrices in the record, \sa NumberOfElementaryTransforms of the writer
+  uint32_t NumberOfElementaryTransforms;
+  /// Bit i is set if matrix i was built from \sa Parameters (not set e.g. for a matrix set directly)
+  uint32_t ParametersValidMask;
+  /// Version of the elementary transforms of the writer at the time of writing (e.g. for detecting stale checkpoints)
+  uint64_t StateVersion;
+  /// Distance of the focus from the isocenter
+  double SourceAxisDistance;
+  /// Row-major matrices in \sa ElementaryTransforms order
+  double ElementaryTransformMatrices[IEC::NumberOfElementaryTransforms][16];
+  /// Parameters of the elementary transforms set from machine axes and patient setup
+  MachineParameters Parameters;
+};
+static_assert(IEC::NumberOfElementaryTransforms <= 32, "MachineStateRecord::ParametersValidMask needs a bit per elementary transform");
+static_assert(std::is_trivially_copyable<MachineParameters>::value && sizeof(MachineParameters) == 35 * sizeof(double),
+  "MachineParameters must be plain doubles without padding");
+static_assert(std::is_trivially_copyable<MachineStateRecord>::value && std::is_standard_layout<MachineStateRecord>::value,
+  "MachineStateRecord must be a plain struct");
+static_assert(sizeof(MachineStateRecord) == 32 + IEC::NumberOfElementaryTransforms * 16 * sizeof(double) + sizeof(MachineParameters),
+  "MachineStateRecord must not contain padding");
+
+/// @brief Check the header of a machine state record
+/// @return nullptr if the record can be read, otherwise a short description of the problem
+inline const char* GetMachineStateRecordError(const MachineStateRecord& record)
+{
+  if (record.Magic != MachineStateRecord::MagicNumber)
+  {
+    const uint32_t m = record.Magic;
+    const uint32_t swapped = (m >> 24) | ((m >> 8) & 0xff00u) | ((m << 8) & 0xff0000u) | (m << 24);
+    return (swapped == MachineStateRecord::MagicNumber ? "record has the other byte order" : "not a machine state record");
+  }
+  if (record.FormatVersion != MachineStateRecord::CurrentFormatVersion)
+  {
+    return "unsupported format version";
+  }
+  if (record.NumberOfElementaryTransforms != static_cast<uint32_t>(NumberOfElementaryTransforms))
+  {
+    return "record is of a different hierarchy";
+  }
+  return nullptr;
+}
+
+} // namespace IEC
+
+#endif
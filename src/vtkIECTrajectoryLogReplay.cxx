@@ -0,0 +1,457 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// IEC Logic includes
+#include "vtkIECTrajectoryLogReplay.h"
+
+// VTK includes
+#include <vtkObjectFactory.h>
+
+// STD includes
+#include <algorithm>
+#include <cstring>
+
+// Memory mapping
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkIECTrajectoryLogReplay);
+
+//----------------------------------------------------------------------------
+/// @brief Read-only memory mapping of the log file
+class vtkIECTrajectoryLogReplay::vtkInternal
+{
+public:
+  ~vtkInternal()
+  {
+    this->Unmap();
+  }
+
+  bool Map(const char* fileName)
+  {
+    this->Unmap();
+#ifdef _WIN32
+    this->File = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (this->File == INVALID_HANDLE_VALUE)
+    {
+      return false;
+    }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(this->File, &fileSize))
+    {
+      this->Unmap();
+      return false;
+    }
+    this->Size = static_cast<vtkTypeUInt64>(fileSize.QuadPart);
+    if (this->Size > 0)
+    {
+      this->Mapping = CreateFileMappingA(this->File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+      this->Data = (this->Mapping ? static_cast<const unsigned char*>(MapViewOfFile(this->Mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr);
+      if (!this->Data)
+      {
+        this->Unmap();
+        return false;
+      }
+    }
+#else
+    this->File = open(fileName, O_RDONLY);
+    if (this->File < 0)
+    {
+      return false;
+    }
+    struct stat fileStatus;
+    if (fstat(this->File, &fileStatus) != 0)
+    {
+      this->Unmap();
+      return false;
+    }
+    this->Size = static_cast<vtkTypeUInt64>(fileStatus.st_size);
+    if (this->Size > 0)
+    {
+      void* data = mmap(nullptr, static_cast<size_t>(this->Size), PROT_READ, MAP_PRIVATE, this->File, 0);
+      if (data == MAP_FAILED)
+      {
+        this->Unmap();
+        return false;
+      }
+      this->Data = static_cast<const unsigned char*>(data);
+    }
+    this->PageSize = static_cast<vtkTypeUInt64>(sysconf(_SC_PAGESIZE));
+#endif
+    this->ReleasedSize = 0;
+    this->Mapped = true;
+    return true;
+  }
+
+  void Unmap()
+  {
+#ifdef _WIN32
+    if (this->Data)
+    {
+      UnmapViewOfFile(this->Data);
+    }
+    if (this->Mapping)
+    {
+      CloseHandle(this->Mapping);
+    }
+    if (this->File != INVALID_HANDLE_VALUE)
+    {
+      CloseHandle(this->File);
+    }
+    this->Mapping = nullptr;
+    this->File = INVALID_HANDLE_VALUE;
+#else
+    if (this->Data)
+    {
+      munmap(const_cast<unsigned char*>(this->Data), static_cast<size_t>(this->Size));
+    }
+    if (this->File >= 0)
+    {
+      close(this->File);
+    }
+    this->File = -1;
+#endif
+    this->Data = nullptr;
+    this->Size = 0;
+    this->Mapped = false;
+  }
+
+  /// Ask the operating system to read the given byte range ahead, and to drop the pages before the given offset
+  /// from the process (they are read from the file again if needed)
+  void Advise(vtkTypeUInt64 readAheadBegin, vtkTypeUInt64 readAheadEnd, vtkTypeUInt64 releaseEnd)
+  {
+#ifndef _WIN32
+    if (!this->Data)
+    {
+      return;
+    }
+    readAheadEnd = std::min(readAheadEnd, this->Size);
+    const vtkTypeUInt64 alignedReadAheadBegin = readAheadBegin - readAheadBegin % this->PageSize;
+    if (alignedReadAheadBegin < readAheadEnd)
+    {
+      madvise(const_cast<unsigned char*>(this->Data) + alignedReadAheadBegin, static_cast<size_t>(readAheadEnd - alignedReadAheadBegin), MADV_WILLNEED);
+    }
+    const vtkTypeUInt64 alignedReleaseEnd = releaseEnd - releaseEnd % this->PageSize;
+    if (alignedReleaseEnd > this->ReleasedSize)
+    {
+      madvise(const_cast<unsigned char*>(this->Data) + this->ReleasedSize, static_cast<size_t>(alignedReleaseEnd - this->ReleasedSize), MADV_DONTNEED);
+      this->ReleasedSize = alignedReleaseEnd;
+    }
+#else
+    (void)readAheadBegin;
+    (void)readAheadEnd;
+    (void)releaseEnd;
+#endif
+  }
+
+  bool Mapped = false;
+  const unsigned char* Data = nullptr;
+  vtkTypeUInt64 Size = 0;
+  vtkTypeUInt64 PageSize = 4096;
+  vtkTypeUInt64 ReleasedSize = 0;
+#ifdef _WIN32
+  HANDLE File = INVALID_HANDLE_VALUE;
+  HANDLE Mapping = nullptr;
+#else
+  int File = -1;
+#endif
+};
+
+//----------------------------------------------------------------------------
+vtkIECTrajectoryLogReplay::vtkIECTrajectoryLogReplay()
+{
+  this->FileName = nullptr;
+  this->HeaderSize = 0;
+  this->RecordSize = 0;
+  this->ScalarType = VTK_FLOAT;
+  std::fill(this->AxisOffsets, this->AxisOffsets + NumberOfAxes, -1);
+  this->ChunkSize = 4096;
+  this->FromFrame = vtkIECTransformLogic::Patient;
+  this->ToFrame = vtkIECTransformLogic::Collimator;
+  this->Logic = nullptr;
+  this->Internal = new vtkInternal();
+}
+
+//----------------------------------------------------------------------------
+vtkIECTrajectoryLogReplay::~vtkIECTrajectoryLogReplay()
+{
+  delete this->Internal;
+  this->SetFileName(nullptr);
+  this->SetLogic(nullptr);
+}
+
+//----------------------------------------------------------------------------
+void vtkIECTrajectoryLogReplay::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+
+  os << indent << "FileName: " << (this->FileName ? this->FileName : "(none)") << std::endl;
+  os << indent << "HeaderSize: " << this->HeaderSize << std::endl;
+  os << indent << "RecordSize: " << this->RecordSize << std::endl;
+  os << indent << "ScalarType: " << (this->ScalarType == VTK_DOUBLE ? "double" : "float") << std::endl;
+  os << indent << "AxisOffsets:";
+  for (int axis = 0; axis < NumberOfAxes; ++axis)
+  {
+    os << " " << this->AxisOffsets[axis];
+  }
+  os << std::endl;
+  os << indent << "ChunkSize: " << this->ChunkSize << std::endl;
+  os << indent << "FromFrame: " << this->FromFrame << std::endl;
+  os << indent << "ToFrame: " << this->ToFrame << std::endl;
+  os << indent << "Logic: " << this->Logic << std::endl;
+  os << indent << "NumberOfRecords: " << this->GetNumberOfRecords() << std::endl;
+}
+
+//----------------------------------------------------------------------------
+void vtkIECTrajectoryLogReplay::SetAxisOffset(int axis, vtkIdType offset)
+{
+  if (axis < 0 || axis >= NumberOfAxes)
+  {
+    vtkErrorMacro("SetAxisOffset: Invalid axis " << axis);
+    return;
+  }
+  if (this->AxisOffsets[axis] != offset)
+  {
+    this->AxisOffsets[axis] = offset;
+    this->Modified();
+  }
+}
+
+//----------------------------------------------------------------------------
+vtkIdType vtkIECTrajectoryLogReplay::GetAxisOffset(int axis)
+{
+  if (axis < 0 || axis >= NumberOfAxes)
+  {
+    vtkErrorMacro("GetAxisOffset: Invalid axis " << axis);
+    return -1;
+  }
+  return this->AxisOffsets[axis];
+}
+
+//----------------------------------------------------------------------------
+bool vtkIECTrajectoryLogReplay::Open()
+{
+  if (!this->FileName)
+  {
+    vtkErrorMacro("Open: No file name given");
+    return false;
+  }
+  if (!this->Internal->Map(this->FileName))
+  {
+    vtkErrorMacro("Open: Failed to map trajectory log file " << this->FileName);
+    return false;
+  }
+  if (!this->ValidateRecordLayout())
+  {
+    this->Close();
+    return false;
+  }
+  if ((this->Internal->Size - std::min(this->Internal->Size, static_cast<vtkTypeUInt64>(this->HeaderSize)))
+    % static_cast<vtkTypeUInt64>(this->RecordSize) != 0)
+  {
+    vtkWarningMacro("Open: Trajectory log " << this->FileName << " ends with an incomplete record, it is ignored");
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+void vtkIECTrajectoryLogReplay::Close()
+{
+  this->Internal->Unmap();
+}
+
+//----------------------------------------------------------------------------
+vtkIdType vtkIECTrajectoryLogReplay::GetNumberOfRecords()
+{
+  if (!this->Internal->Mapped || this->RecordSize <= 0
+    || this->Internal->Size <= static_cast<vtkTypeUInt64>(this->HeaderSize))
+  {
+    return 0;
+  }
+  return static_cast<vtkIdType>((this->Internal->Size - static_cast<vtkTypeUInt64>(this->HeaderSize)) / static_cast<vtkTypeUInt64>(this->RecordSize));
+}
+
+//----------------------------------------------------------------------------
+bool vtkIECTrajectoryLogReplay::ValidateRecordLayout()
+{
+  if (this->HeaderSize < 0 || this->RecordSize <= 0)
+  {
+    vtkErrorMacro("ValidateRecordLayout: Invalid header size " << this->HeaderSize << " or record size " << this->RecordSize);
+    return false;
+  }
+  if (this->ScalarType != VTK_FLOAT && this->ScalarType != VTK_DOUBLE)
+  {
+    vtkErrorMacro("ValidateRecordLayout: Axis values must be float or double");
+    return false;
+  }
+  const vtkIdType valueSize = (this->ScalarType == VTK_DOUBLE ? sizeof(double) : sizeof(float));
+  for (int axis = 0; axis < NumberOfAxes; ++axis)
+  {
+    if (this->AxisOffsets[axis] >= 0 && this->AxisOffsets[axis] + valueSize > this->RecordSize)
+    {
+      vtkErrorMacro("ValidateRecordLayout: Value of axis " << axis << " at offset " << this->AxisOffsets[axis] << " does not fit in the record");
+      return false;
+    }
+  }
+  const bool tableTopX = (this->AxisOffsets[TableTopX] >= 0);
+  if (tableTopX != (this->AxisOffsets[TableTopY] >= 0) || tableTopX != (this->AxisOffsets[TableTopZ] >= 0))
+  {
+    vtkErrorMacro("ValidateRecordLayout: Table top displacement must be given for all three axes or none");
+    return false;
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+void vtkIECTrajectoryLogReplay::DecodeRecords(vtkIdType firstRecord, vtkIdType numberOfRecords)
+{
+  const vtkTypeUInt64 recordSize = static_cast<vtkTypeUInt64>(this->RecordSize);
+  const vtkTypeUInt64 beginOffset = static_cast<vtkTypeUInt64>(this->HeaderSize) + static_cast<vtkTypeUInt64>(firstRecord) * recordSize;
+  const vtkTypeUInt64 endOffset = beginOffset + static_cast<vtkTypeUInt64>(numberOfRecords) * recordSize;
+
+  // Pipelining with the operating system: the next chunk is read from disk while this one is decoded and composed,
+  // and the chunks before this one do not stay resident
+  this->Internal->Advise(endOffset, endOffset + static_cast<vtkTypeUInt64>(this->ChunkSize) * recordSize, beginOffset);
+
+  const unsigned char* records = this->Internal->Data + beginOffset;
+  for (int axis = 0; axis < NumberOfAxes; ++axis)
+  {
+    if (this->AxisOffsets[axis] < 0)
+    {
+      continue;
+    }
+    std::vector<double>& values = this->AxisValues[axis];
+    values.resize(static_cast<size_t>(std::max(this->ChunkSize, numberOfRecords)));
+    const unsigned char* value = records + this->AxisOffsets[axis];
+    // Records are not necessarily aligned for the value type, so the values are copied byte-wise
+    if (this->ScalarType == VTK_DOUBLE)
+    {
+      for (vtkIdType record = 0; record < numberOfRecords; ++record, value += recordSize)
+      {
+        std::memcpy(&values[record], value, sizeof(double));
+      }
+    }
+    else
+    {
+      for (vtkIdType record = 0; record < numberOfRecords; ++record, value += recordSize)
+      {
+        float floatValue;
+        std::memcpy(&floatValue, value, sizeof(float));
+        values[record] = floatValue;
+      }
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+bool vtkIECTrajectoryLogReplay::ReadRecords(vtkIdType firstRecord, vtkIdType numberOfRecords, double* outputMatrices)
+{
+  if (!this->Logic)
+  {
+    vtkErrorMacro("ReadRecords: No logic given");
+    return false;
+  }
+  // The layout may have been changed since the log was opened, and the records are decoded without further checks
+  if (!this->ValidateRecordLayout())
+  {
+    return false;
+  }
+  if (this->ChunkSize <= 0)
+  {
+    vtkErrorMacro("ReadRecords: Invalid chunk size " << this->ChunkSize);
+    return false;
+  }
+  if (this->FromFrame < 0 || this->FromFrame >= this->Logic->GetNumberOfFrames()
+    || this->ToFrame < 0 || this->ToFrame >= this->Logic->GetNumberOfFrames())
+  {
+    vtkErrorMacro("ReadRecords: Invalid frames " << this->FromFrame << " -> " << this->ToFrame);
+    return false;
+  }
+  if (firstRecord < 0 || numberOfRecords < 0 || firstRecord + numberOfRecords > this->GetNumberOfRecords()
+    || (numberOfRecords > 0 && !outputMatrices))
+  {
+    vtkErrorMacro("ReadRecords: Invalid record range " << firstRecord << " + " << numberOfRecords << " or output matrices");
+    return false;
+  }
+
+  auto axisValues = [this](int axis) -> const double* { return (this->AxisOffsets[axis] >= 0 ? this->AxisValues[axis].data() : nullptr); };
+  for (vtkIdType chunkBegin = 0; chunkBegin < numberOfRecords; chunkBegin += this->ChunkSize)
+  {
+    const vtkIdType chunkLength = std::min(this->ChunkSize, numberOfRecords - chunkBegin);
+    this->DecodeRecords(firstRecord + chunkBegin, chunkLength);
+    if (!this->Logic->GetTransformsAlongTrajectory(static_cast<vtkIECTransformLogic::CoordinateSystemIdentifier>(this->FromFrame),
+      static_cast<vtkIECTransformLogic::CoordinateSystemIdentifier>(this->ToFrame), chunkLength,
+      axisValues(GantryRotationAngle), axisValues(CollimatorRotationAngle), axisValues(PatientSupportRotationAngle),
+      axisValues(TableTopX), axisValues(TableTopY), axisValues(TableTopZ), outputMatrices + 16 * chunkBegin))
+    {
+      vtkErrorMacro("ReadRecords: Failed to compute transforms of records " << firstRecord + chunkBegin << " + " << chunkLength);
+      return false;
+    }
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool vtkIECTrajectoryLogReplay::Replay(const vtkIECTrajectoryLogReplay::ChunkCallback& callback)
+{
+  if (!callback)
+  {
+    vtkErrorMacro("Replay: No callback given");
+    return false;
+  }
+  if (this->ChunkSize <= 0)
+  {
+    vtkErrorMacro("Replay: Invalid chunk size " << this->ChunkSize);
+    return false;
+  }
+  if (!this->ValidateRecordLayout())
+  {
+    return false;
+  }
+  const bool opened = !this->Internal->Mapped;
+  if (opened && !this->Open())
+  {
+    return false;
+  }
+
+  bool success = true;
+  const vtkIdType numberOfRecords = this->GetNumberOfRecords();
+  for (vtkIdType chunkBegin = 0; chunkBegin < numberOfRecords && success; chunkBegin += this->ChunkSize)
+  {
+    const vtkIdType chunkLength = std::min(this->ChunkSize, numberOfRecords - chunkBegin);
+    this->ChunkMatrices.resize(static_cast<size_t>(16 * this->ChunkSize));
+    success = this->ReadRecords(chunkBegin, chunkLength, this->ChunkMatrices.data()) && callback(chunkBegin, chunkLength, this->ChunkMatrices.data());
+  }
+
+  if (opened)
+  {
+    this->Close();
+  }
+  return success;
+}
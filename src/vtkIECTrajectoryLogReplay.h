@@ -0,0 +1,169 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+#ifndef __vtkIECTrajectoryLogReplay_h
+#define __vtkIECTrajectoryLogReplay_h
+
+// IEC Logic includes
+#include "../vtkIECTransformLogicExport.h"
+#include "vtkIECTransformLogic.h"
+
+// STD includes
+#include <functional>
+#include <vector>
+
+/// @brief Streaming replay of binary machine trajectory logs through a \sa vtkIECTransformLogic
+///
+/// The log is a file of fixed-size records (optionally after a header), each record holding the axis positions of one
+/// snapshot of the machine as float32 or float64 values in native byte order. The file is memory mapped, not read:
+/// records are decoded chunk by chunk into a few buffers of \sa ChunkSize entries, and the composed transforms of a chunk
+/// are computed with \sa vtkIECTransformLogic::GetTransformsAlongTrajectory. Memory use is therefore bounded by the chunk
+/// size, independent of the length of the log. While a chunk is computed, the operating system is asked to read ahead
+/// the next one, and the pages of the chunks already replayed are released.
+///
+/// Usage:
+///   replay->SetFileName("trajectory.bin");
+///   replay->SetRecordSize(64);
+///   replay->SetAxisOffset(vtkIECTrajectoryLogReplay::GantryRotationAngle, 0);
+///   replay->SetAxisOffset(vtkIECTrajectoryLogReplay::CollimatorRotationAngle, 4);
+///   replay->SetLogic(logic);
+///   replay->Replay([](vtkIdType firstRecord, vtkIdType numberOfRecords, const double* matrices) { ...; return true; });
+class VTK_IEC_TRANSFORM_LOGIC_EXPORT vtkIECTrajectoryLogReplay : public vtkObject
+{
+public:
+  /// @brief Machine axes that can be read from the log records, mapped onto the Update methods of the logic:
+  /// rotation angles in degrees (\sa vtkIECTransformLogic::UpdateGantryToFixedReferenceTransform,
+  /// \sa vtkIECTransformLogic::UpdateCollimatorToGantryTransform, \sa vtkIECTransformLogic::UpdatePatientSupportRotationToFixedReferenceTransform)
+  /// and table top displacements in mm (\sa vtkIECTransformLogic::UpdateTableTopToTableTopEccentricRotationTransform)
+  enum Axis
+  {
+    GantryRotationAngle = 0,
+    CollimatorRotationAngle,
+    PatientSupportRotationAngle,
+    TableTopX,
+    TableTopY,
+    TableTopZ,
+    NumberOfAxes
+  };
+
+  static vtkIECTrajectoryLogReplay* New();
+  vtkTypeMacro(vtkIECTrajectoryLogReplay, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent) override;
+
+  /// @brief Binary trajectory log file
+  vtkSetStringMacro(FileName);
+  vtkGetStringMacro(FileName);
+
+  /// @brief Number of bytes before the first record (0 by default)
+  vtkSetMacro(HeaderSize, vtkIdType);
+  vtkGetMacro(HeaderSize, vtkIdType);
+
+  /// @brief Number of bytes per record
+  vtkSetMacro(RecordSize, vtkIdType);
+  vtkGetMacro(RecordSize, vtkIdType);
+
+  /// @brief Type of the axis values in the records, VTK_FLOAT (default) or VTK_DOUBLE
+  vtkSetMacro(ScalarType, int);
+  vtkGetMacro(ScalarType, int);
+
+  /// @brief Byte offset of the value of an axis within a record, or -1 if the log does not contain the axis (default)
+  /// Axes that are not in the log keep the current transform of the logic. The table top displacements need to be
+  /// given for all three axes or none.
+  void SetAxisOffset(int axis, vtkIdType offset);
+  vtkIdType GetAxisOffset(int axis);
+
+  /// @brief Number of records decoded and replayed at once (4096 by default)
+  vtkSetMacro(ChunkSize, vtkIdType);
+  vtkGetMacro(ChunkSize, vtkIdType);
+
+  /// @brief Frames of the replayed transforms (Patient -> Collimator by default)
+  vtkSetMacro(FromFrame, int);
+  vtkGetMacro(FromFrame, int);
+  vtkSetMacro(ToFrame, int);
+  vtkGetMacro(ToFrame, int);
+
+  /// @brief Logic providing the transforms of the axes that are not in the log (e.g. patient setup, table top pitch and roll)
+  vtkSetObjectMacro(Logic, vtkIECTransformLogic);
+  vtkGetObjectMacro(Logic, vtkIECTransformLogic);
+
+  /// @brief Memory map the log file
+  /// @return Success flag (false if the file cannot be mapped or the record layout does not fit)
+  bool Open();
+
+  /// @brief Unmap the log file
+  void Close();
+
+  /// @brief Number of complete records in the opened log (0 if not opened)
+  vtkIdType GetNumberOfRecords();
+
+  /// @brief Get the transforms of a range of records of the opened log
+  /// @param firstRecord index of the first record
+  /// @param numberOfRecords number of records N
+  /// @param outputMatrices N contiguous row-major 4x4 matrices FromFrame -> ToFrame (N x 4 x 4 array)
+  /// @return Success flag (false on any error)
+  VTK_UNBLOCKTHREADS
+  bool ReadRecords(vtkIdType firstRecord, vtkIdType numberOfRecords, VTK_ZEROCOPY double* outputMatrices);
+
+#ifndef __VTK_WRAP__
+  /// @brief Called with the transforms of each chunk: index of the first record of the chunk, number of records N in the
+  /// chunk and N contiguous row-major 4x4 matrices FromFrame -> ToFrame. The matrices are only valid during the call.
+  /// Returning false stops the replay.
+  typedef std::function<bool(vtkIdType firstRecord, vtkIdType numberOfRecords, const double* matrices)> ChunkCallback;
+
+  /// @brief Replay the whole log chunk by chunk, opening it first if needed
+  /// @return Success flag (false on any error, or if the callback stopped the replay)
+  bool Replay(const ChunkCallback& callback);
+#endif
+
+protected:
+  /// @brief Decode the axis values of a range of records into \sa AxisValues, and advise the operating system about
+  /// the pages of the records (read ahead the next chunk, release the ones before)
+  void DecodeRecords(vtkIdType firstRecord, vtkIdType numberOfRecords);
+
+  /// @brief Check that the header size, record size, scalar type and axis offsets describe a valid record layout
+  /// Called by \sa Open, \sa ReadRecords and \sa Replay, as the layout can be changed after the log is opened.
+  bool ValidateRecordLayout();
+
+protected:
+  char* FileName;
+  vtkIdType HeaderSize;
+  vtkIdType RecordSize;
+  int ScalarType;
+  vtkIdType AxisOffsets[NumberOfAxes];
+  vtkIdType ChunkSize;
+  int FromFrame;
+  int ToFrame;
+  vtkIECTransformLogic* Logic;
+
+  /// @brief Decoded axis values of the current chunk, one array of ChunkSize values per axis that is in the log
+  std::vector<double> AxisValues[NumberOfAxes];
+
+  /// @brief Composed transforms of the current chunk
+  std::vector<double> ChunkMatrices;
+
+  class vtkInternal;
+  vtkInternal* Internal;
+
+protected:
+  vtkIECTrajectoryLogReplay();
+  ~vtkIECTrajectoryLogReplay() override;
+
+private:
+  vtkIECTrajectoryLogReplay(const vtkIECTrajectoryLogReplay&) = delete;
+  void operator=(const vtkIECTrajectoryLogReplay&) = delete;
+};
+
+#endif
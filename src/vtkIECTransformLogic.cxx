@@ -26,165 +26,87 @@
 #include <vtkNew.h>
 #include <vtkObjectFactory.h>
 #include <vtkGeneralTransform.h>
+#include <vtkMatrix4x4.h>
+#include <vtkSMPTools.h>
 #include <vtkTransform.h>
 
 // STD includes
 #include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <thread>
 
 //----------------------------------------------------------------------------
 vtkStandardNewMacro(vtkIECTransformLogic);
 
-//-----------------------------------------------------------------------------
-vtkIECTransformLogic::vtkIECTransformLogic()
+namespace
 {
-  // Setup coordinate system ID to name map
-  this->CoordinateSystemsMap.clear();
-  this->CoordinateSystemsMap[RAS] = "Ras";
-  this->CoordinateSystemsMap[FixedReference] = "FixedReference";
-  this->CoordinateSystemsMap[Gantry] = "Gantry";
-  this->CoordinateSystemsMap[Collimator] = "Collimator";
-  this->CoordinateSystemsMap[LeftImagingPanel] = "LeftImagingPanel";
-  this->CoordinateSystemsMap[RightImagingPanel] = "RightImagingPanel";
-  this->CoordinateSystemsMap[PatientSupportRotation] = "PatientSupportRotation";
-  this->CoordinateSystemsMap[PatientSupport] = "PatientSupport";
-  this->CoordinateSystemsMap[TableTopEccentricRotation] = "TableTopEccentricRotation";
-  this->CoordinateSystemsMap[TableTop] = "TableTop";
-  this->CoordinateSystemsMap[FlatPanel] = "FlatPanel";
-  this->CoordinateSystemsMap[WedgeFilter] = "WedgeFilter";
-  this->CoordinateSystemsMap[Patient] = "Patient";
-  this->CoordinateSystemsMap[DICOM] = "DICOM";
-  this->CoordinateSystemsMap[PatientImageRegularGrid] = "PatientImageRegularGrid";
-
-  this->IECTransforms.clear();
-  this->IECTransforms.push_back(std::make_pair(FixedReference, RAS));
-  this->IECTransforms.push_back(std::make_pair(Gantry, FixedReference));
-  this->IECTransforms.push_back(std::make_pair(Collimator, Gantry));
-  this->IECTransforms.push_back(std::make_pair(WedgeFilter, Collimator));
-  this->IECTransforms.push_back(std::make_pair(LeftImagingPanel, Gantry));
-  this->IECTransforms.push_back(std::make_pair(RightImagingPanel, Gantry));
-  this->IECTransforms.push_back(std::make_pair(PatientSupportRotation, FixedReference)); // Rotation component of patient support transform
-  this->IECTransforms.push_back(std::make_pair(PatientSupport, PatientSupportRotation)); // Scaling component of patient support transform
-  this->IECTransforms.push_back(std::make_pair(TableTopEccentricRotation, PatientSupportRotation)); // NOTE: Currently not supported by REV
-  this->IECTransforms.push_back(std::make_pair(TableTop, TableTopEccentricRotation));
-  this->IECTransforms.push_back(std::make_pair(Patient, TableTop));
-  this->IECTransforms.push_back(std::make_pair(DICOM, Patient));
-  this->IECTransforms.push_back(std::make_pair(PatientImageRegularGrid, DICOM));
-  this->IECTransforms.push_back(std::make_pair(RAS, Patient));
-  this->IECTransforms.push_back(std::make_pair(FlatPanel, Gantry));
-
-  // Set names for elementary transforms for discovery
-  this->FixedReferenceToRasTransform->SetObjectName(this->GetTransformNameBetween(FixedReference, RAS).c_str());
-  this->GantryToFixedReferenceTransform->SetObjectName(this->GetTransformNameBetween(Gantry, FixedReference).c_str());
-  this->CollimatorToGantryTransform->SetObjectName(this->GetTransformNameBetween(Collimator, Gantry).c_str());
-  this->WedgeFilterToCollimatorTransform->SetObjectName(this->GetTransformNameBetween(WedgeFilter, Collimator).c_str());
-  this->LeftImagingPanelToGantryTransform->SetObjectName(this->GetTransformNameBetween(LeftImagingPanel, Gantry).c_str());
-  this->RightImagingPanelToGantryTransform->SetObjectName(this->GetTransformNameBetween(RightImagingPanel, Gantry).c_str());
-  this->PatientSupportRotationToFixedReferenceTransform->SetObjectName(this->GetTransformNameBetween(PatientSupportRotation, FixedReference).c_str());
-  this->PatientSupportToPatientSupportRotationTransform->SetObjectName(this->GetTransformNameBetween(PatientSupport, PatientSupportRotation).c_str());
-  this->TableTopEccentricRotationToPatientSupportRotationTransform->SetObjectName(this->GetTransformNameBetween(TableTopEccentricRotation, PatientSupportRotation).c_str());
-  this->TableTopToTableTopEccentricRotationTransform->SetObjectName(this->GetTransformNameBetween(TableTop, TableTopEccentricRotation).c_str());
-  this->PatientToTableTopTransform->SetObjectName(this->GetTransformNameBetween(Patient, TableTop).c_str());
-  this->DICOMToPatientTransform->SetObjectName(this->GetTransformNameBetween(DICOM, Patient).c_str());
-  this->PatientImageRegularGridToDICOMTransform->SetObjectName(this->GetTransformNameBetween(PatientImageRegularGrid, DICOM).c_str());
-  this->RasToPatientTransform->SetObjectName(this->GetTransformNameBetween(RAS, Patient).c_str());
-  this->FlatPanelToGantryTransform->SetObjectName(this->GetTransformNameBetween(FlatPanel, Gantry).c_str());
-
-  // Build list of elementary transforms for discovery by name
-  this->ElementaryTransforms.push_back(this->FixedReferenceToRasTransform);
-  this->ElementaryTransforms.push_back(this->GantryToFixedReferenceTransform);
-  this->ElementaryTransforms.push_back(this->CollimatorToGantryTransform);
-  this->ElementaryTransforms.push_back(this->WedgeFilterToCollimatorTransform);
-  this->ElementaryTransforms.push_back(this->LeftImagingPanelToGantryTransform);
-  this->ElementaryTransforms.push_back(this->RightImagingPanelToGantryTransform);
-  this->ElementaryTransforms.push_back(this->PatientSupportRotationToFixedReferenceTransform);
-  this->ElementaryTransforms.push_back(this->PatientSupportToPatientSupportRotationTransform);
-  this->ElementaryTransforms.push_back(this->TableTopEccentricRotationToPatientSupportRotationTransform);
-  this->ElementaryTransforms.push_back(this->TableTopToTableTopEccentricRotationTransform);
-  this->ElementaryTransforms.push_back(this->PatientToTableTopTransform);
-  this->ElementaryTransforms.push_back(this->DICOMToPatientTransform);
-  this->ElementaryTransforms.push_back(this->PatientImageRegularGridToDICOMTransform);
-  this->ElementaryTransforms.push_back(this->RasToPatientTransform);
-  this->ElementaryTransforms.push_back(this->FlatPanelToGantryTransform);
-
-  // Define the transform hierarchy
-  this->CoordinateSystemsHierarchy.clear();
-  // key - parent, value - children
-  this->CoordinateSystemsHierarchy[FixedReference] = { Gantry, PatientSupportRotation };
-  this->CoordinateSystemsHierarchy[Gantry] = { Collimator, LeftImagingPanel, RightImagingPanel, FlatPanel };
-  this->CoordinateSystemsHierarchy[Collimator] = { WedgeFilter };
-  this->CoordinateSystemsHierarchy[PatientSupportRotation] = { PatientSupport, TableTopEccentricRotation };
-  this->CoordinateSystemsHierarchy[TableTopEccentricRotation] = { TableTop };
-  this->CoordinateSystemsHierarchy[TableTop] = { Patient };
-  this->CoordinateSystemsHierarchy[Patient] = { DICOM, RAS };
-  this->CoordinateSystemsHierarchy[DICOM] = { PatientImageRegularGrid };
-
-  // Build transformations that are not identity by default
-  // define transformation matrix from the DICOM patient frame(LPS) to IEC patient frame(LSA) which is equivalent to a rotation around the X-axis +90deg counter clockwise
-  double dicomToPatientTransformationMatrix[16] = {1, 0,0,0,
-                                                   0, 0,1,0,
-                                                   0,-1,0,0,
-                                                   0, 0,0,1};
-  this->DICOMToPatientTransform->Concatenate(dicomToPatientTransformationMatrix);
-
-  // Build transformations that are not identity by default
-  // RAS is equivalent to rotation around x of -90deg plus rotation around z of 180deg (could be also defined as Identity + 2 Rotate statements)
-  double rasToPatientTransformationMatrix[16] = {-1,0,0,0,
-                                                  0,0,1,0,
-                                                  0,1,0,0,
-                                                  0,0,0,1};
-  this->RasToPatientTransform->Concatenate(rasToPatientTransformationMatrix);
-
-  //
-  // Build concatenated transform hierarchy
-  //
-  this->GantryToFixedReferenceConcatenatedTransform->Concatenate(this->FixedReferenceToRasTransform);
-  this->GantryToFixedReferenceConcatenatedTransform->Concatenate(this->GantryToFixedReferenceTransform);
-
-  this->CollimatorToGantryConcatenatedTransform->Concatenate(this->GantryToFixedReferenceConcatenatedTransform);
-  this->CollimatorToGantryConcatenatedTransform->Concatenate(this->CollimatorToGantryTransform);
-
-  this->WedgeFilterToCollimatorConcatenatedTransform->Concatenate(this->CollimatorToGantryConcatenatedTransform);
-  this->WedgeFilterToCollimatorConcatenatedTransform->Concatenate(this->WedgeFilterToCollimatorTransform);
+/// Tolerance of the orthonormality check of matrices set for rigid elementary transforms, loose enough for matrices
+/// that went through single precision
+const double RigidMatrixTolerance = 1e-6;
 
-  this->LeftImagingPanelToGantryConcatenatedTransform->Concatenate(this->CollimatorToGantryConcatenatedTransform);
-  this->LeftImagingPanelToGantryConcatenatedTransform->Concatenate(this->LeftImagingPanelToGantryTransform);
-
-  this->RightImagingPanelToGantryConcatenatedTransform->Concatenate(this->CollimatorToGantryConcatenatedTransform);
-  this->RightImagingPanelToGantryConcatenatedTransform->Concatenate(this->RightImagingPanelToGantryTransform);
-
-  this->FlatPanelToGantryConcatenatedTransform->Concatenate(this->CollimatorToGantryConcatenatedTransform);
-  this->FlatPanelToGantryConcatenatedTransform->Concatenate(this->FlatPanelToGantryTransform);
-
-  this->PatientSupportRotationToFixedReferenceConcatenatedTransform->Concatenate(this->FixedReferenceToRasTransform);
-  this->PatientSupportRotationToFixedReferenceConcatenatedTransform->Concatenate(this->PatientSupportRotationToFixedReferenceTransform);
-
-  this->PatientSupportToPatientSupportRotationConcatenatedTransform->Concatenate(this->PatientSupportRotationToFixedReferenceConcatenatedTransform);
-  this->PatientSupportToPatientSupportRotationConcatenatedTransform->Concatenate(this->PatientSupportToPatientSupportRotationTransform);
-
-  this->TableTopEccentricRotationToPatientSupportRotationConcatenatedTransform->Concatenate(this->PatientSupportRotationToFixedReferenceConcatenatedTransform);
-  this->TableTopEccentricRotationToPatientSupportRotationConcatenatedTransform->Concatenate(this->TableTopEccentricRotationToPatientSupportRotationTransform);
-
-  this->TableTopToTableEccentricRotationConcatenatedTransform->Concatenate(this->TableTopEccentricRotationToPatientSupportRotationConcatenatedTransform);
-  this->TableTopToTableEccentricRotationConcatenatedTransform->Concatenate(this->TableTopToTableTopEccentricRotationTransform);
-
-  this->PatientToTableTopConcatenatedTransform->Concatenate(this->TableTopToTableEccentricRotationConcatenatedTransform);
-  this->PatientToTableTopConcatenatedTransform->Concatenate(this->PatientToTableTopTransform);
+//----------------------------------------------------------------------------
+/// Whether a buffer of bufferSize values holds numberOfItems items of valuesPerItem values each, without overflowing the product
+bool IsBufferLargeEnough(vtkIdType bufferSize, vtkIdType numberOfItems, vtkIdType valuesPerItem)
+{
+  return bufferSize >= 0 && numberOfItems <= bufferSize / valuesPerItem;
+}
 
-  this->DICOMToPatientConcatenatedTransform->Concatenate(this->PatientToTableTopConcatenatedTransform);
-  this->DICOMToPatientConcatenatedTransform->Concatenate(this->DICOMToPatientTransform);
+//----------------------------------------------------------------------------
+/// Transform all voxel centers of a regular grid, slices distributed over the vtkSMPTools threads
+template <typename PointType>
+void TransformRegularGridPointsParallel(const IEC::Matrix4& gridToFrame, const std::array<uint16_t, 3>& nElems, PointType* outputPoints)
+{
+  vtkSMPTools::For(0, static_cast<vtkIdType>(nElems[0]), [&](vtkIdType beginSlice, vtkIdType endSlice)
+  {
+    IEC::TransformRegularGridPoints(gridToFrame, nElems, static_cast<std::size_t>(beginSlice), static_cast<std::size_t>(endSlice), outputPoints);
+  });
+}
 
-  this->PatientImageRegularGridToDICOMConcatenatedTransform->Concatenate(this->DICOMToPatientConcatenatedTransform);
-  this->PatientImageRegularGridToDICOMConcatenatedTransform->Concatenate(this->PatientImageRegularGridToDICOMTransform);
+//-----------------------------------------------------------------------------
+template <typename PointType>
+void ProjectRegularGridPointsParallel(const IEC::Matrix4& gridToFocus, const std::array<uint16_t, 3>& nElems, double planeDistance, PointType* outputPoints)
+{
+  vtkSMPTools::For(0, static_cast<vtkIdType>(nElems[0]), [&](vtkIdType beginSlice, vtkIdType endSlice)
+  {
+    IEC::ProjectRegularGridPoints(gridToFocus, nElems, planeDistance, static_cast<std::size_t>(beginSlice), static_cast<std::size_t>(endSlice), outputPoints);
+  });
+}
+}
 
-  this->RasToPatientConcatenatedTransform->Concatenate(this->PatientToTableTopConcatenatedTransform);
-  this->RasToPatientConcatenatedTransform->Concatenate(this->RasToPatientTransform);
+//-----------------------------------------------------------------------------
+vtkIECTransformLogic::vtkIECTransformLogic()
+{
+  this->ElementaryTransformVersionCounter = 0;
+  this->TransformCacheEnabled = true;
+  this->TransformCacheHits = 0;
+  this->TransformCacheMisses = 0;
+  this->NumberOfConcatenatedTransformUpdates = 0;
+  this->SourceAxisDistance = IEC::DefaultSourceAxisDistance;
+
+  // The frames and the hierarchy are the same for all instances, only the machine state is per instance
+  this->SharedTopology = vtkIECTransformLogic::GetStandardTopology();
+  this->ElementaryTransformMatrices = this->SharedTopology->InitialElementaryTransformMatrices;
+  this->InitializeFrameState();
+
+  // The initial matrices are the ones of the default machine parameters
+  std::fill(this->ElementaryTransformParametersValid.begin(), this->ElementaryTransformParametersValid.end(), 1);
+
+  this->PublishedSnapshotSlot = 0;
+  for (int slot = 0; slot < NumberOfSnapshotSlots; ++slot)
+  {
+    this->SnapshotSlotReaders[slot] = 0;
+  }
+  this->PublishSnapshot();
 }
 
 //-----------------------------------------------------------------------------
 vtkIECTransformLogic::~vtkIECTransformLogic()
 {
-  this->CoordinateSystemsMap.clear();
-  this->IECTransforms.clear();
   this->ElementaryTransforms.clear();
 }
 
@@ -194,95 +116,105 @@ void vtkIECTransformLogic::PrintSelf(ostream& os, vtkIndent indent)
   this->Superclass::PrintSelf(os, indent);
 
   os << indent << std::endl << "Elementary tansforms:" << std::endl;
-  os << indent << "FixedReferenceToRasTransform: " << this->FixedReferenceToRasTransform << std::endl;
-  os << indent << "GantryToFixedReferenceTransform: " << this->GantryToFixedReferenceTransform << std::endl;
-  os << indent << "CollimatorToGantryTransform: " << this->CollimatorToGantryTransform << std::endl;
-  os << indent << "WedgeFilterToCollimatorTransform: " << this->WedgeFilterToCollimatorTransform << std::endl;
-  os << indent << "LeftImagingPanelToGantryTransform: " << this->LeftImagingPanelToGantryTransform << std::endl;
-  os << indent << "RightImagingPanelToGantryTransform: " << this->RightImagingPanelToGantryTransform << std::endl;
-  os << indent << "FlatPanelToGantryTransform: " << this->FlatPanelToGantryTransform << std::endl;
-  os << indent << "PatientSupportRotationToFixedReferenceTransform: " << this->PatientSupportRotationToFixedReferenceTransform << std::endl;
-  os << indent << "PatientSupportToPatientSupportRotationTransform: " << this->PatientSupportToPatientSupportRotationTransform << std::endl;
-  os << indent << "TableTopEccentricRotationToPatientSupportRotationTransform: " << this->TableTopEccentricRotationToPatientSupportRotationTransform << std::endl;
-  os << indent << "TableTopToTableTopEccentricRotationTransform: " << this->TableTopToTableTopEccentricRotationTransform << std::endl;
-  os << indent << "PatientToTableTopTransform: " << this->PatientToTableTopTransform << std::endl;
-  os << indent << "DICOMToPatientTransform: " << this->DICOMToPatientTransform << std::endl;
-  os << indent << "PatientImageRegularGridToDICOMTransform: " << this->PatientImageRegularGridToDICOMTransform << std::endl;
-  os << indent << "RasToPatientTransform: " << this->RasToPatientTransform << std::endl;
+  for (size_t index = 0; index < this->ElementaryTransforms.size(); ++index)
+  {
+    os << indent << this->SharedTopology->ElementaryTransformNames[index] << ": ";
+    if (this->ElementaryTransforms[index])
+    {
+      os << this->ElementaryTransforms[index] << std::endl;
+    }
+    else
+    {
+      os << "(not created)" << std::endl;
+    }
+  }
 
   os << indent << std::endl << "Concatenated transforms:" << std::endl;
-  os << indent << "GantryToFixedReferenceConcatenatedTransform: " << this->GantryToFixedReferenceConcatenatedTransform << std::endl;
-  os << indent << "CollimatorToGantryConcatenatedTransform: " << this->CollimatorToGantryConcatenatedTransform << std::endl;
-  os << indent << "WedgeFilterToCollimatorConcatenatedTransform: " << this->WedgeFilterToCollimatorConcatenatedTransform << std::endl;
-  os << indent << "LeftImagingPanelToGantryConcatenatedTransform: " << this->LeftImagingPanelToGantryConcatenatedTransform << std::endl;
-  os << indent << "RightImagingPanelToGantryConcatenatedTransform: " << this->RightImagingPanelToGantryConcatenatedTransform << std::endl;
-  os << indent << "FlatPanelToGantryConcatenatedTransform: " << this->FlatPanelToGantryConcatenatedTransform << std::endl;
-  os << indent << "PatientSupportRotationToFixedReferenceConcatenatedTransform: " << this->PatientSupportRotationToFixedReferenceConcatenatedTransform << std::endl;
-  os << indent << "PatientSupportToPatientSupportRotationConcatenatedTransform: " << this->PatientSupportToPatientSupportRotationConcatenatedTransform << std::endl;
-  os << indent << "TableTopEccentricRotationToPatientSupportRotationConcatenatedTransform: " << this->TableTopEccentricRotationToPatientSupportRotationConcatenatedTransform << std::endl;
-  os << indent << "TableTopToTableTopEccentricRotationConcatenatedTransform: " << this->TableTopToTableEccentricRotationConcatenatedTransform << std::endl;
-  os << indent << "PatientToTableTopConcatenatedTransform: " << this->PatientToTableTopConcatenatedTransform << std::endl;
-  os << indent << "DICOMToPatientConcatenatedTransform: " << this->DICOMToPatientConcatenatedTransform << std::endl;
-  os << indent << "PatientImageRegularGridToDICOMTransform: " << this->PatientImageRegularGridToDICOMTransform << std::endl;
-  os << indent << "RasToPatientConcatenatedTransform: " << this->RasToPatientConcatenatedTransform << std::endl;
+  for (int frame = 0; frame < this->SharedTopology->FrameTables.GetNumberOfFrames(); ++frame)
+  {
+    if (this->SharedTopology->FrameTables.GetDepth(frame) >= 0)
+    {
+      os << indent << this->SharedTopology->FrameNames[frame] << ": "
+        << (this->ConcatenatedTransformDirtyFlags[frame] ? "out of date" : "up to date") << std::endl;
+    }
+  }
+  os << indent << "NumberOfConcatenatedTransformUpdates: " << this->NumberOfConcatenatedTransformUpdates << std::endl;
+
+  os << indent << std::endl << "SourceAxisDistance: " << this->SourceAxisDistance << std::endl;
+
+  os << indent << std::endl << "Transform cache:" << std::endl;
+  os << indent << "TransformCacheEnabled: " << (this->TransformCacheEnabled ? "true" : "false") << std::endl;
+  os << indent << "TransformCacheHits: " << this->TransformCacheHits << std::endl;
+  os << indent << "TransformCacheMisses: " << this->TransformCacheMisses << std::endl;
 }
 
 //----------------------------------------------------------------------------
 void vtkIECTransformLogic::UpdateGantryToFixedReferenceTransform(double gantryRotationAngleDeg, double gantryPitchAngleDeg)
 {
-  this->GantryToFixedReferenceTransform->Identity();
-  this->GantryToFixedReferenceTransform->RotateX(gantryPitchAngleDeg);
-  this->GantryToFixedReferenceTransform->RotateY(gantryRotationAngleDeg);
+  IEC::GantryParameters parameters;
+  parameters.RotationAngleDeg = gantryRotationAngleDeg;
+  parameters.PitchAngleDeg = gantryPitchAngleDeg;
+  this->SetElementaryTransformParameters(Gantry, FixedReference, this->MachineParameters.Gantry, parameters);
 }
 
 //----------------------------------------------------------------------------
 void vtkIECTransformLogic::UpdateCollimatorToGantryTransform(double collimatorRotationAngleDeg, double bz)
 {
-  this->CollimatorToGantryTransform->Identity();
-  this->CollimatorToGantryTransform->Translate(0, 0, bz);
-  this->CollimatorToGantryTransform->RotateZ(collimatorRotationAngleDeg);
+  IEC::CollimatorParameters parameters;
+  parameters.RotationAngleDeg = collimatorRotationAngleDeg;
+  parameters.Bz = bz;
+  this->SetElementaryTransformParameters(Collimator, Gantry, this->MachineParameters.Collimator, parameters);
 }
 
 //-----------------------------------------------------------------------------
 void vtkIECTransformLogic::UpdateWedgeFilterToCollimatorTransform(double wedgefilterRotationAngleDeg, double wz)
 {
-  this->WedgeFilterToCollimatorTransform->Identity();
-  this->WedgeFilterToCollimatorTransform->Translate(0, 0, wz);
-  this->WedgeFilterToCollimatorTransform->RotateZ(wedgefilterRotationAngleDeg);
+  IEC::WedgeFilterParameters parameters;
+  parameters.RotationAngleDeg = wedgefilterRotationAngleDeg;
+  parameters.Wz = wz;
+  this->SetElementaryTransformParameters(WedgeFilter, Collimator, this->MachineParameters.WedgeFilter, parameters);
 }
 
 //-----------------------------------------------------------------------------
 void vtkIECTransformLogic::UpdatePatientSupportRotationToFixedReferenceTransform(double patientSupportRotationAngleDeg)
 {
-  this->PatientSupportRotationToFixedReferenceTransform->Identity();
-  this->PatientSupportRotationToFixedReferenceTransform->RotateZ(patientSupportRotationAngleDeg);
+  IEC::PatientSupportRotationParameters parameters;
+  parameters.RotationAngleDeg = patientSupportRotationAngleDeg;
+  this->SetElementaryTransformParameters(PatientSupportRotation, FixedReference, this->MachineParameters.PatientSupportRotation, parameters);
 }
 
 //-----------------------------------------------------------------------------
 void vtkIECTransformLogic::UpdateTableTopEccentricRotationToPatientSupportRotationTransform(double tableTopEccentricRotationAngleDeg, double ey)
 {
-  this->TableTopEccentricRotationToPatientSupportRotationTransform->Identity();
-  this->TableTopEccentricRotationToPatientSupportRotationTransform->Translate(0, ey, 0);
-  this->TableTopEccentricRotationToPatientSupportRotationTransform->RotateZ(tableTopEccentricRotationAngleDeg);
+  IEC::TableTopEccentricRotationParameters parameters;
+  parameters.RotationAngleDeg = tableTopEccentricRotationAngleDeg;
+  parameters.Ey = ey;
+  this->SetElementaryTransformParameters(TableTopEccentricRotation, PatientSupportRotation, this->MachineParameters.TableTopEccentricRotation, parameters);
 }
 
 //-----------------------------------------------------------------------------
 void vtkIECTransformLogic::UpdateTableTopToTableTopEccentricRotationTransform(double tx, double ty, double tz, double tableTopPitchAngleDeg, double tableTopRollAngleDeg)
 {
-  this->TableTopToTableTopEccentricRotationTransform->Identity();
-  this->TableTopToTableTopEccentricRotationTransform->Translate(tx, ty, tz);
-  this->TableTopToTableTopEccentricRotationTransform->RotateX(tableTopPitchAngleDeg);
-  this->TableTopToTableTopEccentricRotationTransform->RotateY(tableTopRollAngleDeg);
+  IEC::TableTopParameters parameters;
+  parameters.Tx = tx;
+  parameters.Ty = ty;
+  parameters.Tz = tz;
+  parameters.PitchAngleDeg = tableTopPitchAngleDeg;
+  parameters.RollAngleDeg = tableTopRollAngleDeg;
+  this->SetElementaryTransformParameters(TableTop, TableTopEccentricRotation, this->MachineParameters.TableTop, parameters);
 }
 
 //-----------------------------------------------------------------------------
 void vtkIECTransformLogic::UpdatePatientToTableTopTransform(double px, double py, double pz, double patientPsiAngleDeg, double patientPhiAngleDeg, double patientThetaAngleDeg)
 {
-  this->PatientToTableTopTransform->Identity();
-  this->PatientToTableTopTransform->Translate(px, py, pz);
-  this->PatientToTableTopTransform->RotateX(patientPsiAngleDeg);
-  this->PatientToTableTopTransform->RotateY(patientPhiAngleDeg);
-  this->PatientToTableTopTransform->RotateZ(patientThetaAngleDeg);
+  IEC::PatientParameters parameters;
+  parameters.Px = px;
+  parameters.Py = py;
+  parameters.Pz = pz;
+  parameters.PsiAngleDeg = patientPsiAngleDeg;
+  parameters.PhiAngleDeg = patientPhiAngleDeg;
+  parameters.ThetaAngleDeg = patientThetaAngleDeg;
+  this->SetElementaryTransformParameters(Patient, TableTop, this->MachineParameters.Patient, parameters);
 }
 
 //-----------------------------------------------------------------------------
@@ -290,33 +222,219 @@ void vtkIECTransformLogic::UpdatePatientImageRegularGridToDICOMTransform(double
                                                                          double directionCosineXx, double directionCosineXy, double directionCosineXz,
                                                                          double directionCosineYx, double directionCosineYy, double directionCosineYz)
 {
-  this->PatientImageRegularGridToDICOMTransform->Identity();
+  IEC::PatientImageRegularGridParameters parameters;
+  parameters.ColumnPixelSpacing = columnPixelSpacing;
+  parameters.RowPixelSpacing = rowPixelSpacing;
+  parameters.SliceDistance = sliceDistance;
+  parameters.Origin = { { sx, sy, sz } };
+  parameters.DirectionCosineX = { { directionCosineXx, directionCosineXy, directionCosineXz } };
+  parameters.DirectionCosineY = { { directionCosineYx, directionCosineYy, directionCosineYz } };
+  this->SetElementaryTransformParameters(PatientImageRegularGrid, DICOM, this->MachineParameters.PatientImageRegularGrid, parameters);
+}
+
+//-----------------------------------------------------------------------------
+void vtkIECTransformLogic::UpdateImagerToFixedReferenceTransform(double imagerRotationAngleDeg, double imagerPitchAngleDeg)
+{
+  IEC::ImagerParameters parameters;
+  parameters.RotationAngleDeg = imagerRotationAngleDeg;
+  parameters.PitchAngleDeg = imagerPitchAngleDeg;
+  this->SetElementaryTransformParameters(Imager, FixedReference, this->MachineParameters.Imager, parameters);
+}
+
+//-----------------------------------------------------------------------------
+void vtkIECTransformLogic::UpdateFocusToImagerTransform(double sourceAxisDistance)
+{
+  IEC::FocusParameters parameters;
+  parameters.SourceAxisDistance = sourceAxisDistance;
+  this->SetElementaryTransformParameters(Focus, Imager, this->MachineParameters.Focus, parameters);
+  this->SourceAxisDistance = sourceAxisDistance;
+}
+
+//-----------------------------------------------------------------------------
+bool vtkIECTransformLogic::UpdateFixedReferenceToRasTransform(const double matrix[16])
+{
+  if (!matrix)
+  {
+    vtkErrorMacro("UpdateFixedReferenceToRasTransform: Invalid matrix");
+    return false;
+  }
+  IEC::Matrix4 fixedReferenceToRasMatrix;
+  std::copy(matrix, matrix + 16, fixedReferenceToRasMatrix.begin());
+  this->SetElementaryTransformMatrix(FixedReference, RAS, fixedReferenceToRasMatrix);
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+bool vtkIECTransformLogic::UpdateLeftImagingPanelToGantryTransform(const double matrix[16])
+{
+  return this->UpdateFrameToParentTransform(LeftImagingPanel, matrix);
+}
+
+//-----------------------------------------------------------------------------
+bool vtkIECTransformLogic::UpdateRightImagingPanelToGantryTransform(const double matrix[16])
+{
+  return this->UpdateFrameToParentTransform(RightImagingPanel, matrix);
+}
+
+//-----------------------------------------------------------------------------
+bool vtkIECTransformLogic::UpdateFlatPanelToGantryTransform(const double matrix[16])
+{
+  return this->UpdateFrameToParentTransform(FlatPanel, matrix);
+}
+
+//-----------------------------------------------------------------------------
+bool vtkIECTransformLogic::UpdatePatientSupportToPatientSupportRotationTransform(const double matrix[16])
+{
+  return this->UpdateFrameToParentTransform(PatientSupport, matrix);
+}
+
+//-----------------------------------------------------------------------------
+int vtkIECTransformLogic::SetMachineState(const IEC::MachineParameters& state)
+{
+  int numberOfRebuiltTransforms = 0;
+  numberOfRebuiltTransforms += this->SetElementaryTransformParameters(Gantry, FixedReference, this->MachineParameters.Gantry, state.Gantry);
+  numberOfRebuiltTransforms += this->SetElementaryTransformParameters(Collimator, Gantry, this->MachineParameters.Collimator, state.Collimator);
+  numberOfRebuiltTransforms += this->SetElementaryTransformParameters(WedgeFilter, Collimator, this->MachineParameters.WedgeFilter, state.WedgeFilter);
+  numberOfRebuiltTransforms += this->SetElementaryTransformParameters(PatientSupportRotation, FixedReference,
+    this->MachineParameters.PatientSupportRotation, state.PatientSupportRotation);
+  numberOfRebuiltTransforms += this->SetElementaryTransformParameters(TableTopEccentricRotation, PatientSupportRotation,
+    this->MachineParameters.TableTopEccentricRotation, state.TableTopEccentricRotation);
+  numberOfRebuiltTransforms += this->SetElementaryTransformParameters(TableTop, TableTopEccentricRotation, this->MachineParameters.TableTop, state.TableTop);
+  numberOfRebuiltTransforms += this->SetElementaryTransformParameters(Patient, TableTop, this->MachineParameters.Patient, state.Patient);
+  numberOfRebuiltTransforms += this->SetElementaryTransformParameters(PatientImageRegularGrid, DICOM,
+    this->MachineParameters.PatientImageRegularGrid, state.PatientImageRegularGrid);
+  numberOfRebuiltTransforms += this->SetElementaryTransformParameters(Imager, FixedReference, this->MachineParameters.Imager, state.Imager);
+  numberOfRebuiltTransforms += this->SetElementaryTransformParameters(Focus, Imager, this->MachineParameters.Focus, state.Focus);
+  this->SourceAxisDistance = state.Focus.SourceAxisDistance;
+  return numberOfRebuiltTransforms;
+}
+
+//-----------------------------------------------------------------------------
+template <class Parameters>
+bool vtkIECTransformLogic::SetElementaryTransformParameters(vtkIECTransformLogic::CoordinateSystemIdentifier fromFrame,
+  vtkIECTransformLogic::CoordinateSystemIdentifier toFrame, Parameters& currentParameters, const Parameters& parameters)
+{
+  // A modified vtkTransform invalidates the parameters of its transform
+  this->SynchronizeElementaryTransforms();
+  const int index = this->SharedTopology->FrameTables.GetElementaryTransformIndex(fromFrame, toFrame);
+  if (index >= 0 && this->ElementaryTransformParametersValid[index] && currentParameters == parameters)
+  {
+    // Unchanged axis: keep the transforms cached through it
+    return false;
+  }
+  if (!(parameters == parameters))
+  {
+    // NaN parameters, e.g. of a transform set from a matrix as returned by GetMachineState: keep the transform
+    return false;
+  }
+  // Copied first, setting the matrix invalidates the current parameters, which may be the given ones
+  const Parameters newParameters = parameters;
+  this->SetElementaryTransformMatrix(fromFrame, toFrame, newParameters.GetMatrix());
+  currentParameters = newParameters;
+  if (index >= 0)
+  {
+    this->ElementaryTransformParametersValid[index] = 1;
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+void vtkIECTransformLogic::BuildGantryToFixedReferenceMatrix(double gantryRotationAngleDeg, double gantryPitchAngleDeg, double matrix[16])
+{
+  const IEC::Matrix4 elementaryMatrix = IEC::GantryToFixedReferenceMatrix(gantryRotationAngleDeg, gantryPitchAngleDeg);
+  std::copy(elementaryMatrix.begin(), elementaryMatrix.end(), matrix);
+}
+
+//----------------------------------------------------------------------------
+void vtkIECTransformLogic::BuildCollimatorToGantryMatrix(double collimatorRotationAngleDeg, double bz, double matrix[16])
+{
+  const IEC::Matrix4 elementaryMatrix = IEC::CollimatorToGantryMatrix(collimatorRotationAngleDeg, bz);
+  std::copy(elementaryMatrix.begin(), elementaryMatrix.end(), matrix);
+}
+
+//----------------------------------------------------------------------------
+void vtkIECTransformLogic::BuildWedgeFilterToCollimatorMatrix(double wedgefilterRotationAngleDeg, double wz, double matrix[16])
+{
+  const IEC::Matrix4 elementaryMatrix = IEC::WedgeFilterToCollimatorMatrix(wedgefilterRotationAngleDeg, wz);
+  std::copy(elementaryMatrix.begin(), elementaryMatrix.end(), matrix);
+}
+
+//----------------------------------------------------------------------------
+void vtkIECTransformLogic::BuildPatientSupportRotationToFixedReferenceMatrix(double patientSupportRotationAngleDeg, double matrix[16])
+{
+  const IEC::Matrix4 elementaryMatrix = IEC::PatientSupportRotationToFixedReferenceMatrix(patientSupportRotationAngleDeg);
+  std::copy(elementaryMatrix.begin(), elementaryMatrix.end(), matrix);
+}
+
+//----------------------------------------------------------------------------
+void vtkIECTransformLogic::BuildTableTopEccentricRotationToPatientSupportRotationMatrix(double tableTopEccentricRotationAngleDeg, double ey, double matrix[16])
+{
+  const IEC::Matrix4 elementaryMatrix = IEC::TableTopEccentricRotationToPatientSupportRotationMatrix(tableTopEccentricRotationAngleDeg, ey);
+  std::copy(elementaryMatrix.begin(), elementaryMatrix.end(), matrix);
+}
+
+//----------------------------------------------------------------------------
+void vtkIECTransformLogic::BuildTableTopToTableTopEccentricRotationMatrix(double tx, double ty, double tz, double tableTopPitchAngleDeg, double tableTopRollAngleDeg, double matrix[16])
+{
+  const IEC::Matrix4 elementaryMatrix = IEC::TableTopToTableTopEccentricRotationMatrix(tx, ty, tz, tableTopPitchAngleDeg, tableTopRollAngleDeg);
+  std::copy(elementaryMatrix.begin(), elementaryMatrix.end(), matrix);
+}
+
+//----------------------------------------------------------------------------
+void vtkIECTransformLogic::BuildPatientToTableTopMatrix(double px, double py, double pz, double patientPsiAngleDeg, double patientPhiAngleDeg, double patientThetaAngleDeg, double matrix[16])
+{
+  const IEC::Matrix4 elementaryMatrix = IEC::PatientToTableTopMatrix(px, py, pz, patientPsiAngleDeg, patientPhiAngleDeg, patientThetaAngleDeg);
+  std::copy(elementaryMatrix.begin(), elementaryMatrix.end(), matrix);
+}
+
+//----------------------------------------------------------------------------
+void vtkIECTransformLogic::BuildPatientImageRegularGridToDICOMMatrix(double columnPixelSpacing, double rowPixelSpacing, double sliceDistance, double sx, double sy, double sz,
+                                                                    double directionCosineXx, double directionCosineXy, double directionCosineXz,
+                                                                    double directionCosineYx, double directionCosineYy, double directionCosineYz, double matrix[16])
+{
+  const IEC::Matrix4 elementaryMatrix = IEC::PatientImageRegularGridToDICOMMatrix(columnPixelSpacing, rowPixelSpacing, sliceDistance, sx, sy, sz,
+    directionCosineXx, directionCosineXy, directionCosineXz, directionCosineYx, directionCosineYy, directionCosineYz);
+  std::copy(elementaryMatrix.begin(), elementaryMatrix.end(), matrix);
+}
+
+//----------------------------------------------------------------------------
+void vtkIECTransformLogic::BuildImagerToFixedReferenceMatrix(double imagerRotationAngleDeg, double imagerPitchAngleDeg, double matrix[16])
+{
+  const IEC::Matrix4 elementaryMatrix = IEC::ImagerToFixedReferenceMatrix(imagerRotationAngleDeg, imagerPitchAngleDeg);
+  std::copy(elementaryMatrix.begin(), elementaryMatrix.end(), matrix);
+}
 
-  double directionCosineZx = directionCosineXy*directionCosineYz - directionCosineXz*directionCosineYy;
-  double directionCosineZy = directionCosineXz*directionCosineYx - directionCosineXx*directionCosineYz;
-  double directionCosineZz = directionCosineXx*directionCosineYy - directionCosineXy*directionCosineYx;
-  double m[16] = {directionCosineXx*columnPixelSpacing, directionCosineYx*rowPixelSpacing, directionCosineZx*sliceDistance, sx,
-                  directionCosineXy*columnPixelSpacing, directionCosineYy*rowPixelSpacing, directionCosineZy*sliceDistance, sy,
-                  directionCosineXz*columnPixelSpacing, directionCosineYz*rowPixelSpacing, directionCosineZz*sliceDistance, sz,
-                  0, 0, 0, 1};
-  this->PatientImageRegularGridToDICOMTransform->Concatenate(m);
+//----------------------------------------------------------------------------
+void vtkIECTransformLogic::BuildFocusToImagerMatrix(double sourceAxisDistance, double matrix[16])
+{
+  const IEC::Matrix4 elementaryMatrix = IEC::FocusToImagerMatrix(sourceAxisDistance);
+  std::copy(elementaryMatrix.begin(), elementaryMatrix.end(), matrix);
 }
 
 //-----------------------------------------------------------------------------
 vtkTransform* vtkIECTransformLogic::GetElementaryTransformBetween(
   CoordinateSystemIdentifier fromFrame, CoordinateSystemIdentifier toFrame)
 {
-  std::string requestedTransformName = this->GetTransformNameBetween(fromFrame, toFrame);
-  for (auto& transform : this->ElementaryTransforms)
+  const int numberOfFrames = this->SharedTopology->FrameTables.GetNumberOfFrames();
+  if (fromFrame >= 0 && fromFrame < numberOfFrames && toFrame >= 0 && toFrame < numberOfFrames)
   {
-    std::string currentTransformName(transform->GetObjectName());
-    if (currentTransformName == requestedTransformName)
+    int index = this->SharedTopology->FrameTables.GetElementaryTransformIndex(fromFrame, toFrame);
+    if (index >= 0)
     {
-      return transform;
+      if (!this->ElementaryTransforms[index])
+      {
+        // Created on first request, named for discovery
+        vtkSmartPointer<vtkTransform> transform = vtkSmartPointer<vtkTransform>::New();
+        transform->SetObjectName(this->SharedTopology->ElementaryTransformNames[index].c_str());
+        this->ElementaryTransforms[index] = transform;
+        this->SetElementaryTransformObjectMatrix(index);
+        this->CreatedElementaryTransforms.push_back(std::make_pair(fromFrame, toFrame));
+      }
+      return this->ElementaryTransforms[index];
     }
   }
 
-  vtkErrorMacro("GetElementaryTransformBetween: Elementary transform not found: " << requestedTransformName);
+  vtkErrorMacro("GetElementaryTransformBetween: Elementary transform not found: " << this->GetTransformNameBetween(fromFrame, toFrame));
   return nullptr;
 }
 
@@ -324,7 +442,93 @@ vtkTransform* vtkIECTransformLogic::GetElementaryTransformBetween(
 std::string vtkIECTransformLogic::GetTransformNameBetween(
   CoordinateSystemIdentifier fromFrame, CoordinateSystemIdentifier toFrame)
 {
-  return this->CoordinateSystemsMap[fromFrame] + "To" + this->CoordinateSystemsMap[toFrame] + "Transform";
+  return this->GetFrameName(fromFrame) + "To" + this->GetFrameName(toFrame) + "Transform";
+}
+
+//-----------------------------------------------------------------------------
+int vtkIECTransformLogic::AddFrame(vtkIECTransformLogic::CoordinateSystemIdentifier parentFrame, const std::string& name)
+{
+  const IEC::Matrix4 identity = IEC::IdentityMatrix();
+  return this->AddFrame(parentFrame, name, identity.data());
+}
+
+//-----------------------------------------------------------------------------
+int vtkIECTransformLogic::AddFrame(vtkIECTransformLogic::CoordinateSystemIdentifier parentFrame, const std::string& name, const double matrix[16])
+{
+  const int numberOfFrames = this->SharedTopology->FrameTables.GetNumberOfFrames();
+  if (parentFrame < 0 || parentFrame >= numberOfFrames || this->SharedTopology->FrameTables.GetDepth(parentFrame) < 0)
+  {
+    vtkErrorMacro("AddFrame: Parent frame " << parentFrame << " is not part of the hierarchy");
+    return -1;
+  }
+  if (name.empty() || this->SharedTopology->FrameIdentifiers.count(name))
+  {
+    vtkErrorMacro("AddFrame: Frame name \"" << name << "\" is empty or already used");
+    return -1;
+  }
+  if (!matrix)
+  {
+    vtkErrorMacro("AddFrame: Invalid matrix");
+    return -1;
+  }
+
+  const CoordinateSystemIdentifier frame = static_cast<CoordinateSystemIdentifier>(numberOfFrames);
+  Topology& topology = this->GetMutableTopology();
+  topology.CoordinateSystemsMap[frame] = name;
+  topology.CoordinateSystemsHierarchy[parentFrame].push_back(frame);
+  topology.IECTransforms.push_back(std::make_pair(frame, parentFrame));
+  topology.ElementaryTransformNames.push_back(name + "To" + topology.FrameNames[parentFrame] + "Transform");
+  this->BuildFrameTables();
+
+  IEC::Matrix4 frameToParentMatrix;
+  std::copy(matrix, matrix + 16, frameToParentMatrix.begin());
+  this->SetElementaryTransformMatrix(frame, parentFrame, frameToParentMatrix);
+  this->Modified();
+  return frame;
+}
+
+//-----------------------------------------------------------------------------
+bool vtkIECTransformLogic::UpdateFrameToParentTransform(vtkIECTransformLogic::CoordinateSystemIdentifier frame, const double matrix[16])
+{
+  if (frame < 0 || frame >= this->SharedTopology->FrameTables.GetNumberOfFrames() || this->SharedTopology->FrameTables.GetDepth(frame) <= 0 || !matrix)
+  {
+    vtkErrorMacro("UpdateFrameToParentTransform: Invalid frame " << frame << " or matrix");
+    return false;
+  }
+  const CoordinateSystemIdentifier parentFrame = static_cast<CoordinateSystemIdentifier>(this->SharedTopology->FrameTables.GetParent(frame));
+  IEC::Matrix4 frameToParentMatrix;
+  std::copy(matrix, matrix + 16, frameToParentMatrix.begin());
+  if (!this->IsElementaryTransformMatrixAllowed(frame, parentFrame, frameToParentMatrix))
+  {
+    vtkErrorMacro("UpdateFrameToParentTransform: Transform " << this->GetTransformNameBetween(frame, parentFrame)
+      << " is rigid, the matrix must not contain scaling, shear or projection");
+    return false;
+  }
+  this->SetElementaryTransformMatrix(frame, parentFrame, frameToParentMatrix);
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+int vtkIECTransformLogic::GetNumberOfFrames()
+{
+  return this->SharedTopology->FrameTables.GetNumberOfFrames();
+}
+
+//-----------------------------------------------------------------------------
+int vtkIECTransformLogic::GetFrameIdentifier(const std::string& name)
+{
+  std::unordered_map<std::string, int>::const_iterator frameIt = this->SharedTopology->FrameIdentifiers.find(name);
+  return (frameIt != this->SharedTopology->FrameIdentifiers.end() ? frameIt->second : -1);
+}
+
+//-----------------------------------------------------------------------------
+std::string vtkIECTransformLogic::GetFrameName(vtkIECTransformLogic::CoordinateSystemIdentifier frame)
+{
+  if (frame < 0 || frame >= static_cast<int>(this->SharedTopology->FrameNames.size()))
+  {
+    return std::string();
+  }
+  return this->SharedTopology->FrameNames[frame];
 }
 
 //-----------------------------------------------------------------------------
@@ -337,135 +541,1380 @@ bool vtkIECTransformLogic::GetTransformBetween(vtkIECTransformLogic::CoordinateS
     return false;
   }
 
-  vtkIECTransformLogic::CoordinateSystemsList fromFramePath, toFramePath;
-  if (this->GetPathToRoot(fromFrame, fromFramePath) && this->GetPathFromRoot(toFrame, toFramePath))
+  double matrix[16];
+  if (!this->GetTransformBetween(fromFrame, toFrame, matrix, transformForBeam))
   {
-    std::vector< vtkIECTransformLogic::CoordinateSystemIdentifier > toFrameVector(toFramePath.size());
-    std::vector< vtkIECTransformLogic::CoordinateSystemIdentifier > fromFrameVector(fromFramePath.size());
+    return false;
+  }
 
-    std::copy(toFramePath.begin(), toFramePath.end(), toFrameVector.begin());
-    std::copy(fromFramePath.begin(), fromFramePath.end(), fromFrameVector.begin());
+  outputTransform->Identity();
+  outputTransform->PostMultiply();
+  outputTransform->Concatenate(matrix);
+  outputTransform->Modified();
+  return true;
+}
 
-    outputTransform->Identity();
-    outputTransform->PostMultiply();
-    for (size_t i = 0; i < fromFrameVector.size() - 1; ++i)
-    {
-      vtkIECTransformLogic::CoordinateSystemIdentifier parent, child;
-      child = fromFrameVector[i];
-      parent = fromFrameVector[i + 1];
+//-----------------------------------------------------------------------------
+bool vtkIECTransformLogic::GetTransformBetween(vtkIECTransformLogic::CoordinateSystemIdentifier fromFrame, vtkIECTransformLogic::CoordinateSystemIdentifier toFrame,
+  vtkMatrix4x4* outputMatrix, bool transformForBeam/*=false*/)
+{
+  if (!outputMatrix)
+  {
+    vtkErrorMacro("GetTransformBetween: Invalid output matrix");
+    return false;
+  }
 
-      if (child == parent)
-      {
-        continue;
-      }
+  double matrix[16];
+  if (!this->GetTransformBetween(fromFrame, toFrame, matrix, transformForBeam))
+  {
+    return false;
+  }
 
-      vtkTransform* fromTransform = this->GetElementaryTransformBetween(child, parent);
-      if (fromTransform)
-      {
-        outputTransform->Concatenate(fromTransform->GetMatrix());
-      }
-      else
-      {
-        vtkErrorMacro("GetTransformBetween: Transform node is invalid");
-        return false;
-      }
-    }
+  outputMatrix->DeepCopy(matrix);
+  return true;
+}
 
-    for (size_t i = 0; i < toFrameVector.size() - 1; ++i)
-    {
-      vtkIECTransformLogic::CoordinateSystemIdentifier parent, child;
-      parent = toFrameVector[i];
-      child = toFrameVector[i + 1];
+//-----------------------------------------------------------------------------
+bool vtkIECTransformLogic::GetTransformBetween(vtkIECTransformLogic::CoordinateSystemIdentifier fromFrame, vtkIECTransformLogic::CoordinateSystemIdentifier toFrame,
+  double outputMatrix[16], bool transformForBeam/*=false*/)
+{
+  if (!outputMatrix)
+  {
+    vtkErrorMacro("GetTransformBetween: Invalid output matrix");
+    return false;
+  }
+  this->SynchronizeElementaryTransforms();
 
-      if (child == parent)
-      {
-        continue;
-      }
+  // Frames meet at their closest common ancestor, the edges above it would cancel out anyway.
+  // Beam transforms do not invert the downward edges, so those have to pass through the root.
+  vtkIECTransformLogic::CoordinateSystemIdentifier ancestor = vtkIECTransformLogic::FixedReference;
+  if (!this->GetCommonAncestor(fromFrame, toFrame, ancestor))
+  {
+    vtkErrorMacro("GetTransformBetween: Failed to get transform " << this->GetTransformNameBetween(fromFrame, toFrame));
+    return false;
+  }
+  if (transformForBeam)
+  {
+    return this->ComposeTransformBetween(fromFrame, toFrame, vtkIECTransformLogic::FixedReference, true, outputMatrix);
+  }
 
-      vtkTransform* toTransform = this->GetElementaryTransformBetween(child, parent);
-      if (toTransform)
-      {
-        vtkNew<vtkMatrix4x4> mat;
-        toTransform->GetMatrix(mat);
-        if (!transformForBeam) // Do not invert for beam transformation
-        {
-          mat->Invert();
-        }
-        outputTransform->Concatenate(mat);
-      }
-      else
-      {
-        vtkErrorMacro("GetTransformBetween: Transform node is invalid");
-        return false;
-      }
-    }
+  if (!this->TransformCacheEnabled)
+  {
+    return this->ComposeTransformBetween(fromFrame, toFrame, ancestor, false, outputMatrix);
+  }
+
+  // Only the frame pairs that are actually queried get an entry, the slot table is a few bytes per pair
+  const size_t numberOfFrames = static_cast<size_t>(this->SharedTopology->FrameTables.GetNumberOfFrames());
+  int& slot = this->TransformCacheSlots[fromFrame * numberOfFrames + toFrame];
+  if (slot < 0)
+  {
+    slot = static_cast<int>(this->TransformCache.size());
+    TransformCacheEntry emptyEntry = {};
+    this->TransformCache.push_back(emptyEntry);
+  }
 
-    outputTransform->Modified();
+  TransformCacheEntry& entry = this->TransformCache[slot];
+  vtkTypeUInt64 pathVersion = this->GetPathVersion(fromFrame, toFrame, ancestor);
+  if (entry.Valid && entry.PathVersion == pathVersion)
+  {
+    ++this->TransformCacheHits;
+    std::copy(entry.Matrix, entry.Matrix + 16, outputMatrix);
     return true;
   }
 
-  vtkErrorMacro("GetTransformBetween: Failed to get transform " << this->GetTransformNameBetween(fromFrame, toFrame));
-  return false;
+  ++this->TransformCacheMisses;
+  entry.Valid = this->ComposeTransformBetween(fromFrame, toFrame, ancestor, false, entry.Matrix);
+  entry.PathVersion = pathVersion;
+  if (!entry.Valid)
+  {
+    return false;
+  }
+  std::copy(entry.Matrix, entry.Matrix + 16, outputMatrix);
+  return true;
 }
 
 //-----------------------------------------------------------------------------
-bool vtkIECTransformLogic::GetPathToRoot(vtkIECTransformLogic::CoordinateSystemIdentifier frame, vtkIECTransformLogic::CoordinateSystemsList& path)
+bool vtkIECTransformLogic::ComposeTransformBetween(vtkIECTransformLogic::CoordinateSystemIdentifier fromFrame, vtkIECTransformLogic::CoordinateSystemIdentifier toFrame,
+  vtkIECTransformLogic::CoordinateSystemIdentifier ancestor, bool transformForBeam, double outputMatrix[16])
 {
-  if (frame == vtkIECTransformLogic::CoordinateSystemIdentifier::FixedReference)
+  bool success = IEC::ComposePath(this->SharedTopology->FrameTables, fromFrame, toFrame, ancestor, transformForBeam,
+    [this](int index) { return this->ElementaryTransformMatrices[index].data(); },
+    outputMatrix);
+  if (!success)
   {
-    path.push_back(vtkIECTransformLogic::FixedReference);
-    return true;
+    vtkErrorMacro("GetTransformBetween: Transform node is invalid");
   }
+  return success;
+}
 
-  bool found = false;
-  do
+//-----------------------------------------------------------------------------
+bool vtkIECTransformLogic::GetTransformsAlongTrajectory(vtkIECTransformLogic::CoordinateSystemIdentifier fromFrame, vtkIECTransformLogic::CoordinateSystemIdentifier toFrame,
+  vtkIdType numberOfControlPoints, const double* gantryRotationAnglesDeg, const double* collimatorRotationAnglesDeg,
+  const double* patientSupportRotationAnglesDeg, const double* tableTopTx, const double* tableTopTy, const double* tableTopTz,
+  double* outputMatrices)
+{
+  if (numberOfControlPoints < 0 || (numberOfControlPoints > 0 && !outputMatrices))
   {
-    for (auto& pair : this->CoordinateSystemsHierarchy)
-    {
-      vtkIECTransformLogic::CoordinateSystemIdentifier parent = pair.first;
-
-      auto& children = pair.second;
-      auto iter = std::find(children.begin(), children.end(), frame);
-      if (iter != children.end())
-      {
-        vtkIECTransformLogic::CoordinateSystemIdentifier id = *iter;
-
-        vtkDebugMacro("GetPathToRoot: Checking affine transformation "
-          << "\"" << this->CoordinateSystemsMap[id] << "\" -> "
-          << "\"" << this->CoordinateSystemsMap[parent] << "\"");
-
-        frame = parent;
-        path.push_back(id);
-        if (frame != vtkIECTransformLogic::FixedReference)
-        {
-          found = true;
-          break;
-        }
-        else
-        {
-          path.push_back(vtkIECTransformLogic::FixedReference);
-        }
-      }
-      else
-      {
-        found = false;
-      }
-    }
-  } while (found);
+    vtkErrorMacro("GetTransformsAlongTrajectory: Invalid output matrices");
+    return false;
+  }
+  bool tableTopTranslationGiven = (tableTopTx || tableTopTy || tableTopTz);
+  if (tableTopTranslationGiven && !(tableTopTx && tableTopTy && tableTopTz))
+  {
+    vtkErrorMacro("GetTransformsAlongTrajectory: Table top translation must be given for all three axes or none");
+    return false;
+  }
 
-  return (path.size() > 0);
+  return this->ComputeTransformsAlongTrajectory(fromFrame, toFrame, numberOfControlPoints, gantryRotationAnglesDeg, collimatorRotationAnglesDeg,
+    patientSupportRotationAnglesDeg, tableTopTx, tableTopTy, tableTopTz, 1, outputMatrices);
 }
 
 //-----------------------------------------------------------------------------
-bool vtkIECTransformLogic::GetPathFromRoot(vtkIECTransformLogic::CoordinateSystemIdentifier frame, vtkIECTransformLogic::CoordinateSystemsList& path)
+bool vtkIECTransformLogic::GetTransformsForMachineParameters(vtkIECTransformLogic::CoordinateSystemIdentifier fromFrame,
+  vtkIECTransformLogic::CoordinateSystemIdentifier toFrame, vtkIdType numberOfControlPoints, int numberOfParameters, const double* parameters,
+  vtkIdType parametersSize, double* outputMatrices, vtkIdType outputMatricesSize)
 {
-  if (this->GetPathToRoot(frame, path))
+  if (numberOfControlPoints < 0 || (numberOfControlPoints > 0 && (!parameters || !outputMatrices)))
   {
-    std::reverse(path.begin(), path.end());
-    return true;
+    vtkErrorMacro("GetTransformsForMachineParameters: Invalid parameters or output matrices");
+    return false;
   }
-  else
+  if (numberOfParameters != 1 && numberOfParameters != 2 && numberOfParameters != 3 && numberOfParameters != 6)
+  {
+    vtkErrorMacro("GetTransformsForMachineParameters: Invalid number of parameters per control point " << numberOfParameters
+      << " (table top translation must be given for all three axes or none)");
+    return false;
+  }
+  if (!IsBufferLargeEnough(parametersSize, numberOfControlPoints, numberOfParameters))
   {
+    vtkErrorMacro("GetTransformsForMachineParameters: Parameters buffer of " << parametersSize << " values is too small for "
+      << numberOfControlPoints << " control points of " << numberOfParameters << " parameters");
     return false;
   }
+  if (!IsBufferLargeEnough(outputMatricesSize, numberOfControlPoints, 16))
+  {
+    vtkErrorMacro("GetTransformsForMachineParameters: Output buffer of " << outputMatricesSize << " values is too small for "
+      << numberOfControlPoints << " matrices");
+    return false;
+  }
+
+  // Column j of the parameter array, or nullptr for the axes that are not given
+  auto column = [parameters, numberOfParameters](int j) -> const double* { return (j < numberOfParameters ? parameters + j : nullptr); };
+  return this->ComputeTransformsAlongTrajectory(fromFrame, toFrame, numberOfControlPoints, column(0), column(1), column(2),
+    column(3), column(4), column(5), numberOfParameters, outputMatrices);
+}
+
+//-----------------------------------------------------------------------------
+bool vtkIECTransformLogic::ComputeTransformsAlongTrajectory(vtkIECTransformLogic::CoordinateSystemIdentifier fromFrame,
+  vtkIECTransformLogic::CoordinateSystemIdentifier toFrame, vtkIdType numberOfControlPoints, const double* gantryRotationAnglesDeg,
+  const double* collimatorRotationAnglesDeg, const double* patientSupportRotationAnglesDeg, const double* tableTopTx, const double* tableTopTy,
+  const double* tableTopTz, vtkIdType parameterStride, double* outputMatrices)
+{
+  const bool tableTopTranslationGiven = (tableTopTx != nullptr);
+
+  vtkIECTransformLogic::CoordinateSystemIdentifier ancestor = vtkIECTransformLogic::FixedReference;
+  if (!this->GetCommonAncestor(fromFrame, toFrame, ancestor))
+  {
+    vtkErrorMacro("ComputeTransformsAlongTrajectory: Failed to get transform " << this->GetTransformNameBetween(fromFrame, toFrame));
+    return false;
+  }
+  this->SynchronizeElementaryTransforms();
+
+  // Control points read the current matrices of the transforms that are not overridden by the trajectory
+  auto currentEdgeMatrix = [this](int index) -> const double* { return this->ElementaryTransformMatrices[index].data(); };
+
+  // The path does not depend on the machine state, so it is enough to validate it once
+  double validationMatrix[16];
+  if (!IEC::ComposePath(this->SharedTopology->FrameTables, fromFrame, toFrame, ancestor, false, currentEdgeMatrix, validationMatrix))
+  {
+    vtkErrorMacro("ComputeTransformsAlongTrajectory: Transform node is invalid");
+    return false;
+  }
+
+  const int gantryIndex = this->SharedTopology->FrameTables.GetElementaryTransformIndex(Gantry, FixedReference);
+  const int collimatorIndex = this->SharedTopology->FrameTables.GetElementaryTransformIndex(Collimator, Gantry);
+  const int patientSupportIndex = this->SharedTopology->FrameTables.GetElementaryTransformIndex(PatientSupportRotation, FixedReference);
+  const int tableTopIndex = this->SharedTopology->FrameTables.GetElementaryTransformIndex(TableTop, TableTopEccentricRotation);
+
+  // Only the swept axis of an overridden transform changes, its other components are taken from the current matrices
+  // so that they also hold after the matrices were set directly (when the machine parameters are not valid):
+  // the gantry pitch cosine and sine are the middle column of the gantry rotation (see IEC::GantryToFixedReferenceMatrix),
+  // the collimator bz is its translation along z, and the table top keeps its current pitch and roll rotation
+  const IEC::Matrix4& currentGantryMatrix = this->ElementaryTransformMatrices[gantryIndex];
+  const double gantryPitchCos = currentGantryMatrix[5];
+  const double gantryPitchSin = currentGantryMatrix[9];
+  const double collimatorBz = this->ElementaryTransformMatrices[collimatorIndex][11];
+  const IEC::Matrix4 tableTopRotationMatrix = this->ElementaryTransformMatrices[tableTopIndex];
+
+  std::atomic<bool> success(true);
+  vtkSMPTools::For(0, numberOfControlPoints, [&](vtkIdType begin, vtkIdType end)
+  {
+    // Angles are converted in blocks so that the sin/cos loops run over contiguous arrays
+    const vtkIdType blockSize = 64;
+    double gantrySin[blockSize], gantryCos[blockSize];
+    double collimatorSin[blockSize], collimatorCos[blockSize];
+    double patientSupportSin[blockSize], patientSupportCos[blockSize];
+
+    for (vtkIdType blockBegin = begin; blockBegin < end; blockBegin += blockSize)
+    {
+      const vtkIdType blockLength = std::min(blockSize, end - blockBegin);
+      auto computeSinCos = [blockBegin, blockLength, parameterStride](const double* anglesDeg, double* sines, double* cosines)
+      {
+        if (!anglesDeg)
+        {
+          return;
+        }
+        const double* blockAnglesDeg = anglesDeg + blockBegin * parameterStride;
+        for (vtkIdType i = 0; i < blockLength; ++i)
+        {
+          sines[i] = std::sin(IEC::DegreesToRadians(blockAnglesDeg[i * parameterStride]));
+        }
+        for (vtkIdType i = 0; i < blockLength; ++i)
+        {
+          cosines[i] = std::cos(IEC::DegreesToRadians(blockAnglesDeg[i * parameterStride]));
+        }
+      };
+      computeSinCos(gantryRotationAnglesDeg, gantrySin, gantryCos);
+      computeSinCos(collimatorRotationAnglesDeg, collimatorSin, collimatorCos);
+      computeSinCos(patientSupportRotationAnglesDeg, patientSupportSin, patientSupportCos);
+
+      for (vtkIdType i = 0; i < blockLength; ++i)
+      {
+        const vtkIdType controlPoint = blockBegin + i;
+        IEC::Matrix4 gantryMatrix, collimatorMatrix, patientSupportMatrix, tableTopMatrix;
+        if (gantryRotationAnglesDeg)
+        {
+          gantryMatrix = IEC::TranslationRotationXYZMatrix(0, 0, 0, gantryPitchCos, gantryPitchSin, gantryCos[i], gantrySin[i], 1, 0);
+        }
+        if (collimatorRotationAnglesDeg)
+        {
+          collimatorMatrix = IEC::TranslationRotationXYZMatrix(0, 0, collimatorBz, 1, 0, 1, 0, collimatorCos[i], collimatorSin[i]);
+        }
+        if (patientSupportRotationAnglesDeg)
+        {
+          patientSupportMatrix = IEC::TranslationRotationXYZMatrix(0, 0, 0, 1, 0, 1, 0, patientSupportCos[i], patientSupportSin[i]);
+        }
+        if (tableTopTranslationGiven)
+        {
+          const vtkIdType offset = controlPoint * parameterStride;
+          tableTopMatrix = tableTopRotationMatrix;
+          tableTopMatrix[3] = tableTopTx[offset];
+          tableTopMatrix[7] = tableTopTy[offset];
+          tableTopMatrix[11] = tableTopTz[offset];
+        }
+
+        auto edgeMatrix = [&](int index) -> const double*
+        {
+          if (index == gantryIndex && gantryRotationAnglesDeg)
+          {
+            return gantryMatrix.data();
+          }
+          if (index == collimatorIndex && collimatorRotationAnglesDeg)
+          {
+            return collimatorMatrix.data();
+          }
+          if (index == patientSupportIndex && patientSupportRotationAnglesDeg)
+          {
+            return patientSupportMatrix.data();
+          }
+          if (index == tableTopIndex && tableTopTranslationGiven)
+          {
+            return tableTopMatrix.data();
+          }
+          return currentEdgeMatrix(index);
+        };
+
+        if (!IEC::ComposePath(this->SharedTopology->FrameTables, fromFrame, toFrame, ancestor, false, edgeMatrix, outputMatrices + controlPoint * 16))
+        {
+          success = false;
+        }
+      }
+    }
+  });
+
+  if (!success)
+  {
+    vtkErrorMacro("ComputeTransformsAlongTrajectory: Failed to compose the transform of a control point " << this->GetTransformNameBetween(fromFrame, toFrame));
+    return false;
+  }
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+bool vtkIECTransformLogic::GetTransformsAlongGantryArc(vtkIECTransformLogic::CoordinateSystemIdentifier fromFrame,
+  vtkIECTransformLogic::CoordinateSystemIdentifier toFrame, double startAngleDeg, double angleStepDeg, vtkIdType numberOfSteps, double* outputMatrices,
+  vtkIdType outputMatricesSize)
+{
+  if (numberOfSteps < 0 || (numberOfSteps > 0 && !outputMatrices))
+  {
+    vtkErrorMacro("GetTransformsAlongGantryArc: Invalid output matrices");
+    return false;
+  }
+  if (!IsBufferLargeEnough(outputMatricesSize, numberOfSteps, 16))
+  {
+    vtkErrorMacro("GetTransformsAlongGantryArc: Output buffer of " << outputMatricesSize << " values is too small for " << numberOfSteps << " matrices");
+    return false;
+  }
+
+  IEC::ArcIterator arc;
+  if (!this->GetGantryArcIterator(fromFrame, toFrame, startAngleDeg, angleStepDeg, arc))
+  {
+    return false;
+  }
+  for (vtkIdType step = 0; step < numberOfSteps; ++step, arc.Next())
+  {
+    arc.GetMatrix(outputMatrices + 16 * step);
+  }
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+bool vtkIECTransformLogic::GetGantryArcIterator(vtkIECTransformLogic::CoordinateSystemIdentifier fromFrame,
+  vtkIECTransformLogic::CoordinateSystemIdentifier toFrame, double startAngleDeg, double angleStepDeg, IEC::ArcIterator& iterator)
+{
+  vtkIECTransformLogic::CoordinateSystemIdentifier ancestor = vtkIECTransformLogic::FixedReference;
+  if (!this->GetCommonAncestor(fromFrame, toFrame, ancestor))
+  {
+    vtkErrorMacro("GetGantryArcIterator: Failed to get transform " << this->GetTransformNameBetween(fromFrame, toFrame));
+    return false;
+  }
+  this->SynchronizeElementaryTransforms();
+
+  // Keep the gantry pitch of the current gantry transform: its cosine and sine are the middle column of the
+  // rotation matrix (see IEC::GantryToFixedReferenceMatrix)
+  const int gantryIndex = this->SharedTopology->FrameTables.GetElementaryTransformIndex(Gantry, FixedReference);
+  const IEC::Matrix4& currentGantryMatrix = this->ElementaryTransformMatrices[gantryIndex];
+  const double pitchCos = currentGantryMatrix[5];
+  const double pitchSin = currentGantryMatrix[9];
+
+  // Compose the path with the gantry rotations (cos, sin) = (1, 0), (0, 1) and (-1, 0), from which the constant,
+  // cosine and sine terms follow
+  const double rotations[3][2] = { { 1.0, 0.0 }, { 0.0, 1.0 }, { -1.0, 0.0 } };
+  IEC::Matrix4 composed[3];
+  for (int i = 0; i < 3; ++i)
+  {
+    const IEC::Matrix4 gantryMatrix = IEC::TranslationRotationXYZMatrix(0, 0, 0, pitchCos, pitchSin, rotations[i][0], rotations[i][1], 1, 0);
+    auto edgeMatrix = [this, gantryIndex, &gantryMatrix](int index) -> const double*
+    {
+      return (index == gantryIndex ? gantryMatrix.data() : this->ElementaryTransformMatrices[index].data());
+    };
+    if (!IEC::ComposePath(this->SharedTopology->FrameTables, fromFrame, toFrame, ancestor, false, edgeMatrix, composed[i].data()))
+    {
+      vtkErrorMacro("GetGantryArcIterator: Transform node is invalid");
+      return false;
+    }
+  }
+
+  IEC::Matrix4 constantTerm, cosineTerm, sineTerm;
+  for (int i = 0; i < 16; ++i)
+  {
+    constantTerm[i] = 0.5 * (composed[0][i] + composed[2][i]);
+    cosineTerm[i] = 0.5 * (composed[0][i] - composed[2][i]);
+    sineTerm[i] = composed[1][i] - constantTerm[i];
+  }
+  iterator = IEC::ArcIterator(constantTerm, cosineTerm, sineTerm, startAngleDeg, angleStepDeg);
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+bool vtkIECTransformLogic::GetVoxelCentersInFrame(vtkIECTransformLogic::CoordinateSystemIdentifier toFrame, const std::array<uint16_t, 3>& nElems,
+  double* outputPoints)
+{
+  IEC::Matrix4 gridToFrame;
+  if (!this->GetVoxelCentersTransform(toFrame, nElems, outputPoints != nullptr, gridToFrame))
+  {
+    return false;
+  }
+  TransformRegularGridPointsParallel(gridToFrame, nElems, outputPoints);
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+bool vtkIECTransformLogic::GetVoxelCentersInFrame(vtkIECTransformLogic::CoordinateSystemIdentifier toFrame, const std::array<uint16_t, 3>& nElems,
+  float* outputPoints)
+{
+  IEC::Matrix4 gridToFrame;
+  if (!this->GetVoxelCentersTransform(toFrame, nElems, outputPoints != nullptr, gridToFrame))
+  {
+    return false;
+  }
+  TransformRegularGridPointsParallel(gridToFrame, nElems, outputPoints);
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+bool vtkIECTransformLogic::GetVoxelCentersTransform(vtkIECTransformLogic::CoordinateSystemIdentifier toFrame, const std::array<uint16_t, 3>& nElems,
+  bool outputValid, IEC::Matrix4& gridToFrame)
+{
+  const bool emptyGrid = (nElems[0] == 0 || nElems[1] == 0 || nElems[2] == 0);
+  if (!outputValid && !emptyGrid)
+  {
+    vtkErrorMacro("GetVoxelCentersInFrame: Invalid output points");
+    return false;
+  }
+  return this->GetTransformBetween(PatientImageRegularGrid, toFrame, gridToFrame.data());
+}
+
+//-----------------------------------------------------------------------------
+bool vtkIECTransformLogic::TransformPointsBetween(vtkIECTransformLogic::CoordinateSystemIdentifier fromFrame,
+  vtkIECTransformLogic::CoordinateSystemIdentifier toFrame, vtkIdType numberOfPoints, const double* points, vtkIdType pointsSize, double* outputPoints,
+  vtkIdType outputPointsSize)
+{
+  if (numberOfPoints < 0 || (numberOfPoints > 0 && (!points || !outputPoints)))
+  {
+    vtkErrorMacro("TransformPointsBetween: Invalid points");
+    return false;
+  }
+  if (!IsBufferLargeEnough(pointsSize, numberOfPoints, 3) || !IsBufferLargeEnough(outputPointsSize, numberOfPoints, 3))
+  {
+    vtkErrorMacro("TransformPointsBetween: Buffers of " << pointsSize << " input and " << outputPointsSize << " output values are too small for "
+      << numberOfPoints << " points");
+    return false;
+  }
+
+  IEC::Matrix4 matrix;
+  if (!this->GetTransformBetween(fromFrame, toFrame, matrix.data()))
+  {
+    return false;
+  }
+
+  vtkSMPTools::For(0, numberOfPoints, [&](vtkIdType beginPoint, vtkIdType endPoint)
+  {
+    IEC::TransformPoints(matrix, points, static_cast<std::size_t>(beginPoint), static_cast<std::size_t>(endPoint), outputPoints);
+  });
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+bool vtkIECTransformLogic::ProjectPointsToImagerPlane(vtkIECTransformLogic::CoordinateSystemIdentifier fromFrame, vtkIdType numberOfPoints,
+  const double* points, vtkIdType pointsSize, double planeDistance, double* outputPoints, vtkIdType outputPointsSize)
+{
+  if (numberOfPoints < 0 || (numberOfPoints > 0 && (!points || !outputPoints)))
+  {
+    vtkErrorMacro("ProjectPointsToImagerPlane: Invalid points");
+    return false;
+  }
+  if (!IsBufferLargeEnough(pointsSize, numberOfPoints, 3) || !IsBufferLargeEnough(outputPointsSize, numberOfPoints, 3))
+  {
+    vtkErrorMacro("ProjectPointsToImagerPlane: Buffers of " << pointsSize << " input and " << outputPointsSize << " output values are too small for "
+      << numberOfPoints << " points");
+    return false;
+  }
+  if (!(planeDistance > 0.0))
+  {
+    vtkErrorMacro("ProjectPointsToImagerPlane: Invalid projection plane distance " << planeDistance);
+    return false;
+  }
+
+  IEC::Matrix4 pointsToFocus;
+  if (!this->GetTransformBetween(fromFrame, Focus, pointsToFocus.data()))
+  {
+    return false;
+  }
+
+  vtkSMPTools::For(0, numberOfPoints, [&](vtkIdType beginPoint, vtkIdType endPoint)
+  {
+    IEC::ProjectPoints(pointsToFocus, planeDistance, points, static_cast<std::size_t>(beginPoint), static_cast<std::size_t>(endPoint), outputPoints);
+  });
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+bool vtkIECTransformLogic::ProjectVoxelCentersToImagerPlane(const std::array<uint16_t, 3>& nElems, double planeDistance, double* outputPoints)
+{
+  IEC::Matrix4 gridToFocus;
+  if (!this->GetVoxelCentersProjection(nElems, planeDistance, outputPoints != nullptr, gridToFocus))
+  {
+    return false;
+  }
+  ProjectRegularGridPointsParallel(gridToFocus, nElems, planeDistance, outputPoints);
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+bool vtkIECTransformLogic::ProjectVoxelCentersToImagerPlane(const std::array<uint16_t, 3>& nElems, double planeDistance, float* outputPoints)
+{
+  IEC::Matrix4 gridToFocus;
+  if (!this->GetVoxelCentersProjection(nElems, planeDistance, outputPoints != nullptr, gridToFocus))
+  {
+    return false;
+  }
+  ProjectRegularGridPointsParallel(gridToFocus, nElems, planeDistance, outputPoints);
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+bool vtkIECTransformLogic::GetVoxelCentersProjection(const std::array<uint16_t, 3>& nElems, double planeDistance, bool outputValid,
+  IEC::Matrix4& gridToFocus)
+{
+  if (!(planeDistance > 0.0))
+  {
+    vtkErrorMacro("ProjectVoxelCentersToImagerPlane: Invalid projection plane distance " << planeDistance);
+    return false;
+  }
+  return this->GetVoxelCentersTransform(Focus, nElems, outputValid, gridToFocus);
+}
+
+//-----------------------------------------------------------------------------
+bool vtkIECTransformLogic::ComputeDigitallyReconstructedRadiograph(vtkIECTransformLogic::CoordinateSystemIdentifier detectorFrame, const float* volume,
+  const std::array<uint16_t, 3>& nElems, const std::array<uint16_t, 2>& detectorSize, const std::array<double, 2>& pixelSpacing, float* outputImage)
+{
+  const bool emptyGrid = (nElems[0] == 0 || nElems[1] == 0 || nElems[2] == 0);
+  const bool emptyImage = (detectorSize[0] == 0 || detectorSize[1] == 0);
+  if ((!volume && !emptyGrid) || (!outputImage && !emptyImage))
+  {
+    vtkErrorMacro("ComputeDigitallyReconstructedRadiograph: Invalid volume or output image");
+    return false;
+  }
+  if (!(pixelSpacing[0] > 0.0) || !(pixelSpacing[1] > 0.0))
+  {
+    vtkErrorMacro("ComputeDigitallyReconstructedRadiograph: Invalid detector pixel spacing " << pixelSpacing[0] << ", " << pixelSpacing[1]);
+    return false;
+  }
+
+  IEC::Matrix4 detectorToGrid;
+  IEC::Matrix4 focusToDetector;
+  if (!this->GetTransformBetween(detectorFrame, PatientImageRegularGrid, detectorToGrid.data())
+    || !this->GetTransformBetween(Focus, detectorFrame, focusToDetector.data()))
+  {
+    return false;
+  }
+  const double source[3] = { focusToDetector[3], focusToDetector[7], focusToDetector[11] };
+  if (source[2] == 0.0)
+  {
+    vtkErrorMacro("ComputeDigitallyReconstructedRadiograph: Focus lies in the detector plane");
+    return false;
+  }
+
+  if (emptyImage)
+  {
+    return true;
+  }
+  if (emptyGrid)
+  {
+    std::fill(outputImage, outputImage + static_cast<std::size_t>(detectorSize[0]) * detectorSize[1], 0.0f);
+    return true;
+  }
+
+  vtkSMPTools::For(0, static_cast<vtkIdType>(detectorSize[0]), [&](vtkIdType beginRow, vtkIdType endRow)
+  {
+    IEC::ComputeRegularGridDRR(volume, nElems, detectorToGrid, source, detectorSize, pixelSpacing,
+      static_cast<std::size_t>(beginRow), static_cast<std::size_t>(endRow), outputImage);
+  });
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+vtkTypeUInt64 vtkIECTransformLogic::GetPathVersion(vtkIECTransformLogic::CoordinateSystemIdentifier fromFrame, vtkIECTransformLogic::CoordinateSystemIdentifier toFrame,
+  vtkIECTransformLogic::CoordinateSystemIdentifier ancestor)
+{
+  vtkTypeUInt64 pathVersion = 0;
+  for (int frame : { fromFrame, toFrame })
+  {
+    for (int child = frame; child != ancestor; child = this->SharedTopology->FrameTables.GetParent(child))
+    {
+      int index = this->SharedTopology->FrameTables.GetElementaryTransformIndex(child, this->SharedTopology->FrameTables.GetParent(child));
+      if (index >= 0)
+      {
+        pathVersion = std::max(pathVersion, this->ElementaryTransformVersions[index]);
+      }
+    }
+  }
+  return pathVersion;
+}
+
+//-----------------------------------------------------------------------------
+void vtkIECTransformLogic::MarkElementaryTransformModified(vtkIECTransformLogic::CoordinateSystemIdentifier fromFrame, vtkIECTransformLogic::CoordinateSystemIdentifier toFrame)
+{
+  int index = this->SharedTopology->FrameTables.GetElementaryTransformIndex(fromFrame, toFrame);
+  if (index < 0)
+  {
+    vtkErrorMacro("MarkElementaryTransformModified: Elementary transform not found: " << this->GetTransformNameBetween(fromFrame, toFrame));
+    return;
+  }
+  if (vtkTransform* transform = this->ElementaryTransforms[index])
+  {
+    IEC::Matrix4 matrix;
+    std::copy(transform->GetMatrix()->GetData(), transform->GetMatrix()->GetData() + 16, matrix.begin());
+    if (!this->IsElementaryTransformMatrixAllowed(fromFrame, toFrame, matrix))
+    {
+      vtkErrorMacro("MarkElementaryTransformModified: Transform " << this->GetTransformNameBetween(fromFrame, toFrame)
+        << " is rigid, the matrix must not contain scaling, shear or projection. The change of the vtkTransform is reverted.");
+      this->SetElementaryTransformObjectMatrix(index);
+      return;
+    }
+    this->ElementaryTransformMatrices[index] = matrix;
+    this->ElementaryTransformSyncTimes[index] = transform->GetMTime();
+  }
+  this->InvalidateElementaryTransformParameters(index);
+  this->ElementaryTransformVersions[index] = ++this->ElementaryTransformVersionCounter;
+  this->MarkConcatenatedTransformsDirty(fromFrame, toFrame);
+}
+
+//-----------------------------------------------------------------------------
+bool vtkIECTransformLogic::IsElementaryTransformMatrixAllowed(vtkIECTransformLogic::CoordinateSystemIdentifier fromFrame,
+  vtkIECTransformLogic::CoordinateSystemIdentifier toFrame, const IEC::Matrix4& matrix)
+{
+  // Rigid transforms of the hierarchy are inverted in closed form on the downward part of the paths. FixedReferenceToRas
+  // is never inverted, and the frames added at runtime are inverted in general form.
+  const IEC::FrameTables& frameTables = this->SharedTopology->FrameTables;
+  const int index = frameTables.GetElementaryTransformIndex(fromFrame, toFrame);
+  if (index < 0 || !frameTables.IsElementaryTransformRigid(index) || frameTables.GetParent(fromFrame) != toFrame)
+  {
+    return true;
+  }
+  return IEC::IsRigid(matrix, RigidMatrixTolerance);
+}
+
+//-----------------------------------------------------------------------------
+void vtkIECTransformLogic::SetElementaryTransformObjectMatrix(int index)
+{
+  vtkTransform* transform = this->ElementaryTransforms[index];
+  if (!transform)
+  {
+    return;
+  }
+  transform->SetMatrix(this->ElementaryTransformMatrices[index].data());
+  // Computing the matrix modifies it, so the modification time is read after the update
+  transform->Update();
+  this->ElementaryTransformSyncTimes[index] = transform->GetMTime();
+}
+
+//-----------------------------------------------------------------------------
+void vtkIECTransformLogic::InvalidateElementaryTransformParameters(int index)
+{
+  this->ElementaryTransformParametersValid[index] = 0;
+
+  // Stale parameters would look valid to callers, NaN parameters cannot be mistaken for the ones of the matrix
+  const double nan = std::numeric_limits<double>::quiet_NaN();
+  const IEC::FrameTables& frameTables = this->SharedTopology->FrameTables;
+  auto isTransform = [&frameTables, index](CoordinateSystemIdentifier fromFrame, CoordinateSystemIdentifier toFrame)
+  {
+    return index == frameTables.GetElementaryTransformIndex(fromFrame, toFrame);
+  };
+  IEC::MachineParameters& parameters = this->MachineParameters;
+  if (isTransform(Gantry, FixedReference))
+  {
+    parameters.Gantry = { nan, nan };
+  }
+  else if (isTransform(Collimator, Gantry))
+  {
+    parameters.Collimator = { nan, nan };
+  }
+  else if (isTransform(WedgeFilter, Collimator))
+  {
+    parameters.WedgeFilter = { nan, nan };
+  }
+  else if (isTransform(PatientSupportRotation, FixedReference))
+  {
+    parameters.PatientSupportRotation = { nan };
+  }
+  else if (isTransform(TableTopEccentricRotation, PatientSupportRotation))
+  {
+    parameters.TableTopEccentricRotation = { nan, nan };
+  }
+  else if (isTransform(TableTop, TableTopEccentricRotation))
+  {
+    parameters.TableTop = { nan, nan, nan, nan, nan };
+  }
+  else if (isTransform(Patient, TableTop))
+  {
+    parameters.Patient = { nan, nan, nan, nan, nan, nan };
+  }
+  else if (isTransform(PatientImageRegularGrid, DICOM))
+  {
+    parameters.PatientImageRegularGrid = { nan, nan, nan, { { nan, nan, nan } }, { { nan, nan, nan } }, { { nan, nan, nan } } };
+  }
+  else if (isTransform(Imager, FixedReference))
+  {
+    parameters.Imager = { nan, nan };
+  }
+  else if (isTransform(Focus, Imager))
+  {
+    parameters.Focus = { nan };
+  }
+}
+
+//-----------------------------------------------------------------------------
+void vtkIECTransformLogic::SynchronizeElementaryTransforms()
+{
+  for (const std::pair<CoordinateSystemIdentifier, CoordinateSystemIdentifier>& frames : this->CreatedElementaryTransforms)
+  {
+    const int index = this->SharedTopology->FrameTables.GetElementaryTransformIndex(frames.first, frames.second);
+    if (this->ElementaryTransforms[index]->GetMTime() != this->ElementaryTransformSyncTimes[index])
+    {
+      this->MarkElementaryTransformModified(frames.first, frames.second);
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+void vtkIECTransformLogic::SetElementaryTransformMatrix(vtkIECTransformLogic::CoordinateSystemIdentifier fromFrame, vtkIECTransformLogic::CoordinateSystemIdentifier toFrame,
+  const IEC::Matrix4& matrix)
+{
+  int index = this->SharedTopology->FrameTables.GetElementaryTransformIndex(fromFrame, toFrame);
+  if (index < 0)
+  {
+    vtkErrorMacro("SetElementaryTransformMatrix: Elementary transform not found: " << this->GetTransformNameBetween(fromFrame, toFrame));
+    return;
+  }
+  this->ElementaryTransformMatrices[index] = matrix;
+  this->SetElementaryTransformObjectMatrix(index);
+  this->InvalidateElementaryTransformParameters(index);
+  this->ElementaryTransformVersions[index] = ++this->ElementaryTransformVersionCounter;
+  this->MarkConcatenatedTransformsDirty(fromFrame, toFrame);
+}
+
+//-----------------------------------------------------------------------------
+void vtkIECTransformLogic::ResetTransformCacheStatistics()
+{
+  this->TransformCacheHits = 0;
+  this->TransformCacheMisses = 0;
+}
+
+//-----------------------------------------------------------------------------
+void vtkIECTransformLogic::ClearTransformCache()
+{
+  // The slot table keeps its size, so that queries after clearing do not allocate it again
+  const size_t numberOfFrames = static_cast<size_t>(this->SharedTopology->FrameTables.GetNumberOfFrames());
+  this->TransformCacheSlots.assign(numberOfFrames * numberOfFrames, -1);
+  this->TransformCache.clear();
+}
+
+//-----------------------------------------------------------------------------
+void vtkIECTransformLogic::PublishSnapshot()
+{
+  this->SynchronizeElementaryTransforms();
+
+  // Only the writer modifies the slots, so the published slot can be read directly here
+  const int publishedSlot = this->PublishedSnapshotSlot.load();
+  const std::shared_ptr<const MachineStateSnapshot>& publishedSnapshot = this->SnapshotSlots[publishedSlot];
+  if (publishedSnapshot && publishedSnapshot->Version == this->ElementaryTransformVersionCounter)
+  {
+    return;
+  }
+
+  std::shared_ptr<MachineStateSnapshot> snapshot = std::make_shared<MachineStateSnapshot>();
+  snapshot->SharedTopology = this->SharedTopology;
+  snapshot->ElementaryTransformMatrices = this->ElementaryTransformMatrices;
+  snapshot->Version = this->ElementaryTransformVersionCounter;
+
+  // A reader that pins a slot after it was found free sees that the slot is not published and backs off,
+  // so the slot can be overwritten. Readers hold a pin only while copying a pointer.
+  int slot = publishedSlot;
+  for (;;)
+  {
+    slot = (slot + 1) % NumberOfSnapshotSlots;
+    if (slot == publishedSlot)
+    {
+      std::this_thread::yield();
+      continue;
+    }
+    if (this->SnapshotSlotReaders[slot].load() == 0)
+    {
+      break;
+    }
+  }
+  this->SnapshotSlots[slot] = std::move(snapshot);
+  this->PublishedSnapshotSlot.store(slot);
+}
+
+//-----------------------------------------------------------------------------
+std::shared_ptr<const vtkIECTransformLogic::MachineStateSnapshot> vtkIECTransformLogic::GetSnapshot() const
+{
+  for (;;)
+  {
+    // Pin the published slot, then check that it is still published: from then on the writer does not overwrite it
+    const int slot = this->PublishedSnapshotSlot.load();
+    this->SnapshotSlotReaders[slot].fetch_add(1);
+    if (this->PublishedSnapshotSlot.load() == slot)
+    {
+      std::shared_ptr<const MachineStateSnapshot> snapshot = this->SnapshotSlots[slot];
+      this->SnapshotSlotReaders[slot].fetch_sub(1);
+      return snapshot;
+    }
+    this->SnapshotSlotReaders[slot].fetch_sub(1);
+  }
+}
+
+//-----------------------------------------------------------------------------
+bool vtkIECTransformLogic::MachineStateSnapshot::GetTransformBetween(vtkIECTransformLogic::CoordinateSystemIdentifier fromFrame,
+  vtkIECTransformLogic::CoordinateSystemIdentifier toFrame, double outputMatrix[16]) const
+{
+  int ancestor = IEC::GetCommonAncestor(this->SharedTopology->FrameTables, fromFrame, toFrame);
+  if (!outputMatrix || ancestor < 0)
+  {
+    return false;
+  }
+
+  return IEC::ComposePath(this->SharedTopology->FrameTables, fromFrame, toFrame, ancestor, false,
+    [this](int index) { return this->ElementaryTransformMatrices[index].data(); }, outputMatrix);
+}
+
+//-----------------------------------------------------------------------------
+bool vtkIECTransformLogic::GetTransformsBetweenStates(const vtkIECTransformLogic::MachineStateSnapshot& startState,
+  const vtkIECTransformLogic::MachineStateSnapshot& endState, vtkIECTransformLogic::CoordinateSystemIdentifier fromFrame,
+  vtkIECTransformLogic::CoordinateSystemIdentifier toFrame, vtkIdType numberOfFractions, const double* fractions, double* outputMatrices)
+{
+  if (numberOfFractions < 0 || (numberOfFractions > 0 && (!fractions || !outputMatrices)))
+  {
+    vtkErrorMacro("GetTransformsBetweenStates: Invalid fractions or output matrices");
+    return false;
+  }
+
+  IEC::Matrix4 startMatrix;
+  IEC::Matrix4 endMatrix;
+  if (!startState.GetTransformBetween(fromFrame, toFrame, startMatrix.data()) || !endState.GetTransformBetween(fromFrame, toFrame, endMatrix.data()))
+  {
+    vtkErrorMacro("GetTransformsBetweenStates: Failed to get transform " << this->GetTransformNameBetween(fromFrame, toFrame));
+    return false;
+  }
+
+  IEC::TransformInterpolator interpolator;
+  if (!interpolator.Initialize(startMatrix, endMatrix))
+  {
+    vtkErrorMacro("GetTransformsBetweenStates: Transforms " << this->GetTransformNameBetween(fromFrame, toFrame)
+      << " of the machine states do not differ by a rigid motion");
+    return false;
+  }
+  for (vtkIdType i = 0; i < numberOfFractions; ++i)
+  {
+    interpolator.Evaluate(fractions[i], outputMatrices + 16 * i);
+  }
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+bool vtkIECTransformLogic::GetPathToRoot(vtkIECTransformLogic::CoordinateSystemIdentifier frame, vtkIECTransformLogic::CoordinateSystemsList& path)
+{
+  if (frame < 0 || frame >= this->SharedTopology->FrameTables.GetNumberOfFrames() || this->SharedTopology->FrameTables.GetDepth(frame) < 0)
+  {
+    return (path.size() > 0);
+  }
+
+  for (int id = frame; id != -1; id = this->SharedTopology->FrameTables.GetParent(id))
+  {
+    path.push_back(static_cast<CoordinateSystemIdentifier>(id));
+  }
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+bool vtkIECTransformLogic::GetPathFromRoot(vtkIECTransformLogic::CoordinateSystemIdentifier frame, vtkIECTransformLogic::CoordinateSystemsList& path)
+{
+  if (this->GetPathToRoot(frame, path))
+  {
+    std::reverse(path.begin(), path.end());
+    return true;
+  }
+  else
+  {
+    return false;
+  }
+}
+
+//-----------------------------------------------------------------------------
+bool vtkIECTransformLogic::GetCommonAncestor(vtkIECTransformLogic::CoordinateSystemIdentifier frame1, vtkIECTransformLogic::CoordinateSystemIdentifier frame2,
+  vtkIECTransformLogic::CoordinateSystemIdentifier& ancestor)
+{
+  int id = IEC::GetCommonAncestor(this->SharedTopology->FrameTables, frame1, frame2);
+  if (id < 0)
+  {
+    return false;
+  }
+  ancestor = static_cast<CoordinateSystemIdentifier>(id);
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+std::shared_ptr<const vtkIECTransformLogic::Topology> vtkIECTransformLogic::GetStandardTopology()
+{
+  // Built once, on first use (initialization of function-local statics is thread-safe)
+  static const std::shared_ptr<const Topology> standardTopology = []()
+  {
+    std::shared_ptr<Topology> topology = std::make_shared<Topology>();
+
+    // Setup coordinate system ID to name map
+    for (int frame = 0; frame < LastIECCoordinateFrame; ++frame)
+    {
+      topology->CoordinateSystemsMap[static_cast<CoordinateSystemIdentifier>(frame)] = IEC::CoordinateSystemNames[frame];
+    }
+
+    // Elementary transforms of the core, in elementary transform index order, named for discovery
+    for (const IEC::ElementaryTransformDefinition& definition : IEC::ElementaryTransforms)
+    {
+      CoordinateSystemIdentifier child = static_cast<CoordinateSystemIdentifier>(definition.Child);
+      CoordinateSystemIdentifier parent = static_cast<CoordinateSystemIdentifier>(definition.Parent);
+      topology->IECTransforms.push_back(std::make_pair(child, parent));
+      topology->ElementaryTransformNames.push_back(
+        topology->CoordinateSystemsMap[child] + "To" + topology->CoordinateSystemsMap[parent] + "Transform");
+    }
+
+    // Define the transform hierarchy
+    // key - parent, value - children
+    topology->CoordinateSystemsHierarchy[FixedReference] = { Gantry, PatientSupportRotation, Imager };
+    topology->CoordinateSystemsHierarchy[Gantry] = { Collimator, LeftImagingPanel, RightImagingPanel, FlatPanel };
+    topology->CoordinateSystemsHierarchy[Collimator] = { WedgeFilter };
+    topology->CoordinateSystemsHierarchy[PatientSupportRotation] = { PatientSupport, TableTopEccentricRotation };
+    topology->CoordinateSystemsHierarchy[TableTopEccentricRotation] = { TableTop };
+    topology->CoordinateSystemsHierarchy[TableTop] = { Patient };
+    topology->CoordinateSystemsHierarchy[Patient] = { DICOM, RAS };
+    topology->CoordinateSystemsHierarchy[DICOM] = { PatientImageRegularGrid };
+    topology->CoordinateSystemsHierarchy[Imager] = { Focus };
+
+    // Compile the hierarchy into flat tables for path resolution
+    vtkIECTransformLogic::CompileTopology(*topology);
+
+    // Transformations that are not identity by default (DICOM and RAS patient frames, focus at the default
+    // source-axis distance), same as the initial state of the core
+    const IEC::MachineState initialState;
+    topology->InitialElementaryTransformMatrices.assign(initialState.ElementaryTransformMatrices.begin(),
+      initialState.ElementaryTransformMatrices.end());
+
+    return std::shared_ptr<const Topology>(topology);
+  }();
+  return standardTopology;
+}
+
+//-----------------------------------------------------------------------------
+void vtkIECTransformLogic::CompileTopology(vtkIECTransformLogic::Topology& topology)
+{
+  // The IEC frames, followed by the frames added at runtime
+  const int numberOfFrames = std::max<int>(LastIECCoordinateFrame,
+    topology.CoordinateSystemsMap.empty() ? 0 : topology.CoordinateSystemsMap.rbegin()->first + 1);
+  topology.FrameNames.assign(numberOfFrames, std::string());
+  topology.FrameIdentifiers.clear();
+  for (auto& pair : topology.CoordinateSystemsMap)
+  {
+    if (pair.first >= 0)
+    {
+      topology.FrameNames[pair.first] = pair.second;
+      topology.FrameIdentifiers[pair.second] = pair.first;
+    }
+  }
+
+  std::vector<int>& frameParents = topology.FrameTables.FrameParents;
+  std::vector<int>& frameDepths = topology.FrameTables.FrameDepths;
+  frameParents.assign(numberOfFrames, -1);
+  frameDepths.assign(numberOfFrames, -1);
+
+  // key - parent, value - children
+  for (auto& pair : topology.CoordinateSystemsHierarchy)
+  {
+    for (CoordinateSystemIdentifier child : pair.second)
+    {
+      if (child >= 0 && child < numberOfFrames)
+      {
+        frameParents[child] = pair.first;
+      }
+    }
+  }
+
+  // Depth is the number of transforms up to the root. Frames that do not lead to the root
+  // (or that are caught in a loop) are left out of the hierarchy.
+  frameDepths[FixedReference] = 0;
+  for (int frame = 0; frame < numberOfFrames; ++frame)
+  {
+    int depth = 0;
+    int id = frame;
+    while (id != FixedReference && id != -1 && depth <= numberOfFrames)
+    {
+      id = frameParents[id];
+      ++depth;
+    }
+    if (id == FixedReference)
+    {
+      frameDepths[frame] = depth;
+    }
+  }
+  frameParents[FixedReference] = -1;
+
+  // Elementary transforms are matched to the frame pairs by name once here, so that lookup is a single array access
+  // Transforms that contain scaling cannot be inverted in closed form, only the ones known to the core are flagged rigid
+  const size_t numberOfElementaryTransforms = topology.ElementaryTransformNames.size();
+  std::unordered_map<std::string, int> elementaryTransformIndices;
+  for (size_t index = 0; index < numberOfElementaryTransforms; ++index)
+  {
+    elementaryTransformIndices.emplace(topology.ElementaryTransformNames[index], static_cast<int>(index));
+  }
+  topology.FrameTables.ElementaryTransformIndices.assign(static_cast<size_t>(numberOfFrames) * numberOfFrames, -1);
+  topology.FrameTables.ElementaryTransformRigidFlags.assign(numberOfElementaryTransforms, false);
+  for (auto& framePair : topology.IECTransforms)
+  {
+    if (framePair.first < 0 || framePair.first >= numberOfFrames || framePair.second < 0 || framePair.second >= numberOfFrames)
+    {
+      continue;
+    }
+    std::string transformName = topology.FrameNames[framePair.first] + "To" + topology.FrameNames[framePair.second] + "Transform";
+    std::unordered_map<std::string, int>::const_iterator indexIt = elementaryTransformIndices.find(transformName);
+    if (indexIt != elementaryTransformIndices.end())
+    {
+      const int index = indexIt->second;
+      topology.FrameTables.ElementaryTransformIndices[framePair.first * numberOfFrames + framePair.second] = index;
+      int standardIndex = IEC::StandardHierarchy::GetElementaryTransformIndex(framePair.first, framePair.second);
+      topology.FrameTables.ElementaryTransformRigidFlags[index] = (standardIndex >= 0 && IEC::StandardHierarchy::IsElementaryTransformRigid(standardIndex));
+    }
+  }
+
+  // Concatenated transform tree
+  topology.FrameChildren.assign(numberOfFrames, std::vector<int>());
+  for (int frame = 0; frame < numberOfFrames; ++frame)
+  {
+    if (frameDepths[frame] > 0)
+    {
+      topology.FrameChildren[frameParents[frame]].push_back(frame);
+    }
+  }
+
+  topology.InitialElementaryTransformMatrices.resize(numberOfElementaryTransforms, IEC::IdentityMatrix());
+}
+
+//-----------------------------------------------------------------------------
+vtkIECTransformLogic::Topology& vtkIECTransformLogic::GetMutableTopology()
+{
+  // Copy on write: a topology used by other instances or by snapshots is never modified
+  if (this->SharedTopology.use_count() > 1)
+  {
+    this->SharedTopology = std::make_shared<Topology>(*this->SharedTopology);
+  }
+  return const_cast<Topology&>(*this->SharedTopology);
+}
+
+//-----------------------------------------------------------------------------
+void vtkIECTransformLogic::BuildFrameTables()
+{
+  Topology& topology = this->GetMutableTopology();
+  vtkIECTransformLogic::CompileTopology(topology);
+  for (int frame = 0; frame < topology.FrameTables.GetNumberOfFrames(); ++frame)
+  {
+    if (topology.FrameTables.GetDepth(frame) < 0)
+    {
+      vtkDebugMacro("BuildFrameTables: Coordinate system \"" << topology.FrameNames[frame] << "\" is not part of the hierarchy");
+    }
+  }
+
+  this->ElementaryTransformMatrices.resize(topology.ElementaryTransformNames.size(), IEC::IdentityMatrix());
+  this->InitializeFrameState();
+}
+
+//-----------------------------------------------------------------------------
+void vtkIECTransformLogic::InitializeFrameState()
+{
+  const size_t numberOfElementaryTransforms = this->SharedTopology->ElementaryTransformNames.size();
+  this->ElementaryTransforms.resize(numberOfElementaryTransforms);
+  this->ElementaryTransformSyncTimes.resize(numberOfElementaryTransforms, 0);
+  this->ElementaryTransformVersions.resize(numberOfElementaryTransforms, 0);
+  this->ElementaryTransformParametersValid.resize(numberOfElementaryTransforms, 0);
+
+  // Concatenated transform tree, all out of date
+  const size_t numberOfFrames = static_cast<size_t>(this->SharedTopology->FrameTables.GetNumberOfFrames());
+  this->ConcatenatedTransformMatrices.assign(numberOfFrames, IEC::IdentityMatrix());
+  this->ConcatenatedTransformDirtyFlags.assign(numberOfFrames, 1);
+  this->DirtyFrameStack.resize(numberOfFrames);
+
+  // The cache slots are laid out by the number of frames
+  this->ClearTransformCache();
+}
+
+//-----------------------------------------------------------------------------
+void vtkIECTransformLogic::DeepCopy(vtkIECTransformLogic* source)
+{
+  if (!source)
+  {
+    vtkErrorMacro("DeepCopy: Invalid source logic");
+    return;
+  }
+  if (source == this)
+  {
+    return;
+  }
+  source->SynchronizeElementaryTransforms();
+
+  const std::shared_ptr<const Topology> previousTopology = this->SharedTopology;
+  this->TransformCacheEnabled = source->TransformCacheEnabled;
+  this->SharedTopology = source->SharedTopology;
+  if (this->SharedTopology != previousTopology)
+  {
+    // The cache slots are laid out by the number of frames
+    this->ClearTransformCache();
+    this->RemapElementaryTransforms(*previousTopology);
+  }
+  this->ElementaryTransformMatrices = source->ElementaryTransformMatrices;
+  this->SourceAxisDistance = source->SourceAxisDistance;
+  this->MachineParameters = source->MachineParameters;
+  this->ElementaryTransformParametersValid = source->ElementaryTransformParametersValid;
+  for (size_t index = 0; index < this->ElementaryTransforms.size(); ++index)
+  {
+    this->SetElementaryTransformObjectMatrix(static_cast<int>(index));
+  }
+
+  // Every elementary transform counts as modified, so that no cached transform of the previous state is used
+  this->ElementaryTransformVersions.assign(this->ElementaryTransformMatrices.size(), ++this->ElementaryTransformVersionCounter);
+  this->ConcatenatedTransformMatrices = source->ConcatenatedTransformMatrices;
+  this->ConcatenatedTransformDirtyFlags = source->ConcatenatedTransformDirtyFlags;
+  this->DirtyFrameStack.resize(this->ConcatenatedTransformDirtyFlags.size());
+
+  this->PublishSnapshot();
+  this->Modified();
+}
+
+//-----------------------------------------------------------------------------
+void vtkIECTransformLogic::RemapElementaryTransforms(const Topology& previousTopology)
+{
+  // Elementary transform indices and frame identifiers of the previous topology may mean other transforms in the
+  // current one, so the created vtkTransforms are matched by the names of their frames
+  std::vector< vtkSmartPointer<vtkTransform> > previousTransforms;
+  previousTransforms.swap(this->ElementaryTransforms);
+  std::vector< std::pair<CoordinateSystemIdentifier, CoordinateSystemIdentifier> > previousCreatedTransforms;
+  previousCreatedTransforms.swap(this->CreatedElementaryTransforms);
+
+  const Topology& topology = *this->SharedTopology;
+  const size_t numberOfElementaryTransforms = topology.ElementaryTransformNames.size();
+  this->ElementaryTransforms.assign(numberOfElementaryTransforms, nullptr);
+  this->ElementaryTransformSyncTimes.assign(numberOfElementaryTransforms, 0);
+  for (const std::pair<CoordinateSystemIdentifier, CoordinateSystemIdentifier>& previousFrames : previousCreatedTransforms)
+  {
+    const auto fromFrame = topology.FrameIdentifiers.find(previousTopology.FrameNames[previousFrames.first]);
+    const auto toFrame = topology.FrameIdentifiers.find(previousTopology.FrameNames[previousFrames.second]);
+    if (fromFrame == topology.FrameIdentifiers.end() || toFrame == topology.FrameIdentifiers.end())
+    {
+      continue;
+    }
+    const int index = topology.FrameTables.GetElementaryTransformIndex(fromFrame->second, toFrame->second);
+    if (index < 0)
+    {
+      // Not in the copied hierarchy: the vtkTransform is released and no longer affects this logic
+      continue;
+    }
+    const int previousIndex = previousTopology.FrameTables.GetElementaryTransformIndex(previousFrames.first, previousFrames.second);
+    this->ElementaryTransforms[index] = previousTransforms[previousIndex];
+    this->CreatedElementaryTransforms.push_back(std::make_pair(static_cast<CoordinateSystemIdentifier>(fromFrame->second),
+      static_cast<CoordinateSystemIdentifier>(toFrame->second)));
+  }
+}
+
+//-----------------------------------------------------------------------------
+vtkIdType vtkIECTransformLogic::GetMachineStateRecordSize()
+{
+  return static_cast<vtkIdType>(sizeof(IEC::MachineStateRecord));
+}
+
+//-----------------------------------------------------------------------------
+bool vtkIECTransformLogic::SaveMachineState(unsigned char* record)
+{
+  if (!record)
+  {
+    vtkErrorMacro("SaveMachineState: Invalid record");
+    return false;
+  }
+  if (this->ElementaryTransformMatrices.size() != static_cast<size_t>(IEC::NumberOfElementaryTransforms))
+  {
+    vtkErrorMacro("SaveMachineState: Only the elementary transforms of the standard hierarchy can be saved");
+    return false;
+  }
+  this->SynchronizeElementaryTransforms();
+
+  // The header is assembled separately, the matrices are copied directly, so the record needs no alignment
+  IEC::MachineStateRecord header;
+  header.Magic = IEC::MachineStateRecord::MagicNumber;
+  header.FormatVersion = IEC::MachineStateRecord::CurrentFormatVersion;
+  header.NumberOfElementaryTransforms = static_cast<uint32_t>(IEC::NumberOfElementaryTransforms);
+  header.ParametersValidMask = 0;
+  for (size_t index = 0; index < this->ElementaryTransformParametersValid.size(); ++index)
+  {
+    header.ParametersValidMask |= (this->ElementaryTransformParametersValid[index] ? 1u : 0u) << index;
+  }
+  header.StateVersion = this->ElementaryTransformVersionCounter;
+  header.SourceAxisDistance = this->SourceAxisDistance;
+  const size_t matricesOffset = offsetof(IEC::MachineStateRecord, ElementaryTransformMatrices);
+  std::memcpy(record, &header, matricesOffset);
+  for (size_t index = 0; index < this->ElementaryTransformMatrices.size(); ++index)
+  {
+    std::memcpy(record + matricesOffset + index * sizeof(IEC::Matrix4), this->ElementaryTransformMatrices[index].data(), sizeof(IEC::Matrix4));
+  }
+  std::memcpy(record + offsetof(IEC::MachineStateRecord, Parameters), &this->MachineParameters, sizeof(IEC::MachineParameters));
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+bool vtkIECTransformLogic::RestoreMachineState(const unsigned char* record)
+{
+  if (!record)
+  {
+    vtkErrorMacro("RestoreMachineState: Invalid record");
+    return false;
+  }
+  if (this->ElementaryTransformMatrices.size() != static_cast<size_t>(IEC::NumberOfElementaryTransforms))
+  {
+    vtkErrorMacro("RestoreMachineState: Only the elementary transforms of the standard hierarchy can be restored");
+    return false;
+  }
+
+  // Only the header is copied, the parameters of the local record keep their default values
+  IEC::MachineStateRecord header;
+  const size_t matricesOffset = offsetof(IEC::MachineStateRecord, ElementaryTransformMatrices);
+  std::memcpy(static_cast<void*>(&header), record, matricesOffset);
+  const char* error = IEC::GetMachineStateRecordError(header);
+  if (error)
+  {
+    vtkErrorMacro("RestoreMachineState: Invalid machine state record: " << error);
+    return false;
+  }
+
+  for (size_t index = 0; index < this->ElementaryTransformMatrices.size(); ++index)
+  {
+    std::memcpy(this->ElementaryTransformMatrices[index].data(), record + matricesOffset + index * sizeof(IEC::Matrix4), sizeof(IEC::Matrix4));
+    this->SetElementaryTransformObjectMatrix(static_cast<int>(index));
+  }
+  this->SourceAxisDistance = header.SourceAxisDistance;
+  std::memcpy(static_cast<void*>(&this->MachineParameters), record + offsetof(IEC::MachineStateRecord, Parameters), sizeof(IEC::MachineParameters));
+  for (size_t index = 0; index < this->ElementaryTransformParametersValid.size(); ++index)
+  {
+    this->ElementaryTransformParametersValid[index] = static_cast<char>((header.ParametersValidMask >> index) & 1u);
+  }
+
+  // Every elementary transform counts as modified, so that no cached or concatenated transform of the previous state is used
+  this->ElementaryTransformVersions.assign(this->ElementaryTransformMatrices.size(), ++this->ElementaryTransformVersionCounter);
+  std::fill(this->ConcatenatedTransformDirtyFlags.begin(), this->ConcatenatedTransformDirtyFlags.end(), 1);
+
+  this->PublishSnapshot();
+  this->Modified();
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+bool vtkIECTransformLogic::WriteMachineStateFile(const char* fileName)
+{
+  if (!fileName)
+  {
+    vtkErrorMacro("WriteMachineStateFile: Invalid file name");
+    return false;
+  }
+  std::vector<unsigned char> record(sizeof(IEC::MachineStateRecord));
+  if (!this->SaveMachineState(record.data()))
+  {
+    return false;
+  }
+  FILE* file = std::fopen(fileName, "wb");
+  bool success = (file && std::fwrite(record.data(), record.size(), 1, file) == 1);
+  if (file && std::fclose(file) != 0)
+  {
+    success = false;
+  }
+  if (!success)
+  {
+    vtkErrorMacro("WriteMachineStateFile: Failed to write machine state file " << fileName);
+  }
+  return success;
+}
+
+//-----------------------------------------------------------------------------
+bool vtkIECTransformLogic::ReadMachineStateFile(const char* fileName)
+{
+  if (!fileName)
+  {
+    vtkErrorMacro("ReadMachineStateFile: Invalid file name");
+    return false;
+  }
+  std::vector<unsigned char> record(sizeof(IEC::MachineStateRecord));
+  FILE* file = std::fopen(fileName, "rb");
+  const size_t bytesRead = (file ? std::fread(record.data(), 1, record.size(), file) : 0);
+  if (file)
+  {
+    std::fclose(file);
+  }
+  if (bytesRead < record.size())
+  {
+    // A record of another format version may be shorter, report that rather than the short read
+    IEC::MachineStateRecord header;
+    const size_t matricesOffset = offsetof(IEC::MachineStateRecord, ElementaryTransformMatrices);
+    std::memcpy(static_cast<void*>(&header), record.data(), matricesOffset);
+    const char* error = (bytesRead >= matricesOffset ? IEC::GetMachineStateRecordError(header) : nullptr);
+    vtkErrorMacro("ReadMachineStateFile: Failed to read machine state file " << fileName << (error ? ": " : "") << (error ? error : ""));
+    return false;
+  }
+  return this->RestoreMachineState(record.data());
+}
+
+//-----------------------------------------------------------------------------
+vtkIECTransformLogic* vtkIECTransformLogic::Clone()
+{
+  vtkIECTransformLogic* clone = this->NewInstance();
+  clone->DeepCopy(this);
+  return clone;
+}
+
+//-----------------------------------------------------------------------------
+bool vtkIECTransformLogic::GetConcatenatedTransform(vtkIECTransformLogic::CoordinateSystemIdentifier frame, double outputMatrix[16])
+{
+  if (frame < 0 || frame >= this->SharedTopology->FrameTables.GetNumberOfFrames() || this->SharedTopology->FrameTables.GetDepth(frame) < 0 || !outputMatrix)
+  {
+    vtkErrorMacro("GetConcatenatedTransform: Invalid coordinate system or output matrix");
+    return false;
+  }
+  this->SynchronizeElementaryTransforms();
+  const IEC::Matrix4& matrix = this->UpdateConcatenatedTransform(frame);
+  std::copy(matrix.begin(), matrix.end(), outputMatrix);
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+const IEC::Matrix4& vtkIECTransformLogic::UpdateConcatenatedTransform(int frame)
+{
+  IEC::Matrix4& matrix = this->ConcatenatedTransformMatrices[frame];
+  if (!this->ConcatenatedTransformDirtyFlags[frame])
+  {
+    return matrix;
+  }
+
+  const int parent = this->SharedTopology->FrameTables.GetParent(frame);
+  if (parent < 0)
+  {
+    // Root: placement of the fixed reference frame in RAS
+    const int index = this->SharedTopology->FrameTables.GetElementaryTransformIndex(frame, RAS);
+    matrix = (index >= 0 ? this->ElementaryTransformMatrices[index] : IEC::IdentityMatrix());
+  }
+  else
+  {
+    const IEC::Matrix4& parentMatrix = this->UpdateConcatenatedTransform(parent);
+    const int index = this->SharedTopology->FrameTables.GetElementaryTransformIndex(frame, parent);
+    matrix = IEC::Multiply(parentMatrix, this->ElementaryTransformMatrices[index]);
+  }
+  this->ConcatenatedTransformDirtyFlags[frame] = 0;
+  ++this->NumberOfConcatenatedTransformUpdates;
+  return matrix;
+}
+
+//-----------------------------------------------------------------------------
+void vtkIECTransformLogic::MarkConcatenatedTransformsDirty(vtkIECTransformLogic::CoordinateSystemIdentifier fromFrame,
+  vtkIECTransformLogic::CoordinateSystemIdentifier toFrame)
+{
+  int subtreeRoot = fromFrame;
+  if (this->SharedTopology->FrameTables.GetParent(fromFrame) != toFrame || this->SharedTopology->FrameTables.GetDepth(fromFrame) < 0)
+  {
+    // Not a transform of the hierarchy, e.g. FixedReferenceToRas: all frames depend on it
+    subtreeRoot = FixedReference;
+  }
+  if (this->ConcatenatedTransformDirtyFlags[subtreeRoot])
+  {
+    return;
+  }
+
+  // Depth-first over the subtree, skipping the branches that are already out of date
+  std::vector<int>& stack = this->DirtyFrameStack;
+  int stackSize = 0;
+  stack[stackSize++] = subtreeRoot;
+  this->ConcatenatedTransformDirtyFlags[subtreeRoot] = 1;
+  while (stackSize > 0)
+  {
+    const int frame = stack[--stackSize];
+    for (int child : this->SharedTopology->FrameChildren[frame])
+    {
+      if (!this->ConcatenatedTransformDirtyFlags[child])
+      {
+        this->ConcatenatedTransformDirtyFlags[child] = 1;
+        stack[stackSize++] = child;
+      }
+    }
+  }
 }
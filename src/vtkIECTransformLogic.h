@@ -24,19 +24,34 @@
 
 //#include "vtkSlicerBeamsModuleLogicExport.h"
 #include "../vtkIECTransformLogicExport.h"
+#include "IECTransformCore.h"
 
 // STD includes
 #include <map>
 #include <vector>
 #include <cstdint>
 #include <array>
+#include <atomic>
 #include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
 
 // VTK includes
-#include <vtkNew.h>
+#include <vtkSmartPointer.h>
 #include <vtkTransform.h>
+#include <vtkWrappingHints.h>
+
+// Python wrapping hints not known by older VTK versions
+#ifndef VTK_ZEROCOPY
+#define VTK_ZEROCOPY
+#endif
+#ifndef VTK_UNBLOCKTHREADS
+#define VTK_UNBLOCKTHREADS
+#endif
 
 class vtkGeneralTransform;
+class vtkMatrix4x4;
 
 /// @brief Logic representing the IEC standard coordinate systems and transforms.
 ///
@@ -105,26 +120,28 @@ Legend:
 class VTK_IEC_TRANSFORM_LOGIC_EXPORT vtkIECTransformLogic : public vtkObject
 {
 public:
-  enum CoordinateSystemIdentifier
+  /// @note Values are the same as in the VTK-free core (\sa IEC::CoordinateSystemIdentifier). Frames added with
+  /// \sa AddFrame get the consecutive identifiers from LastIECCoordinateFrame on.
+  enum CoordinateSystemIdentifier : int
   {
-    RAS = 0,
-    FixedReference,
-    Gantry,
-    Collimator,
-    LeftImagingPanel,
-    RightImagingPanel,
-    PatientSupportRotation, // Not part of the standard, but useful for visualization
-    PatientSupport,
-    TableTopEccentricRotation,
-    TableTop,
-    FlatPanel,
-    WedgeFilter,
-    Patient,
-    DICOM,
-    PatientImageRegularGrid,
-    Imager,
-    Focus,
-    LastIECCoordinateFrame // Last index used for adding more coordinate systems externally
+    RAS = IEC::RAS,
+    FixedReference = IEC::FixedReference,
+    Gantry = IEC::Gantry,
+    Collimator = IEC::Collimator,
+    LeftImagingPanel = IEC::LeftImagingPanel,
+    RightImagingPanel = IEC::RightImagingPanel,
+    PatientSupportRotation = IEC::PatientSupportRotation, // Not part of the standard, but useful for visualization
+    PatientSupport = IEC::PatientSupport,
+    TableTopEccentricRotation = IEC::TableTopEccentricRotation,
+    TableTop = IEC::TableTop,
+    FlatPanel = IEC::FlatPanel,
+    WedgeFilter = IEC::WedgeFilter,
+    Patient = IEC::Patient,
+    DICOM = IEC::DICOM,
+    PatientImageRegularGrid = IEC::PatientImageRegularGrid,
+    Imager = IEC::Imager,
+    Focus = IEC::Focus,
+    LastIECCoordinateFrame = IEC::LastIECCoordinateFrame // Last index used for adding more coordinate systems externally
   };
   typedef std::list< CoordinateSystemIdentifier > CoordinateSystemsList;
 
@@ -133,6 +150,16 @@ public:
   vtkTypeMacro(vtkIECTransformLogic, vtkObject);
   void PrintSelf(ostream& os, vtkIndent indent) override;
 
+  /// @brief Copy the machine state (elementary transforms and source-axis distance) and the transform cache setting of another logic
+  /// The frame hierarchy is shared with the source instead of being copied, and the concatenated transforms
+  /// are taken over as they are, so the copy costs about as much as copying the elementary transform matrices.
+  /// The copied state is published (\sa PublishSnapshot).
+  void DeepCopy(vtkIECTransformLogic* source);
+
+  /// @brief Create a new logic in the same machine state as this one (\sa DeepCopy)
+  /// @return New instance, owned by the caller as if it was created by New()
+  VTK_NEWINSTANCE vtkIECTransformLogic* Clone();
+
   /// @brief Update GantryToFixedReference transform based on gantry rotation angle about the Y-axis with possibility of setting gantry pitch angle which is not part of IEC standard but a DICOM addition
   /// The order of rotations starting from the fixed reference frame is pitch rotation followed by gantry (roll) rotation
   /// @warning it is assumed that the same order of rotations than for "table top" (https://dicom.nema.org/medical/dicom/current/output/chtml/part03/sect_C.8.8.14.12.html) applies here, although it is not explicitly said in the DICOM standard (https://dicom.nema.org/medical/dicom/current/output/chtml/part03/sect_C.8.8.25.6.html#sect_C.8.8.25.6.5)
@@ -198,6 +225,88 @@ public:
   void UpdatePatientImageRegularGridToDICOMTransform(double columnPixelSpacing, double rowPixelSpacing, double sliceDistance, double sx, double sy, double sz,
                                                      double directionCosineXx = 1, double directionCosineXy = 0, double directionCosineXz = 0,
                                                      double directionCosineYx = 0, double directionCosineYy = 1, double directionCosineYz = 0);
+  /// @brief Update ImagerToFixedReference transform based on the imager (kV source and detector) rotation angle about the Y-axis
+  /// The imager frame rotates with the imaging system the same way as the gantry frame does with the gantry, so that its
+  /// Z-axis is the central axis of the imaging beam
+  /// @param imagerRotationAngleDeg the rotation in degrees of the imager frame counter clockwise around the Y-axis
+  /// @param imagerPitchAngleDeg the rotation in degrees of the imager frame counter clockwise around the X-axis
+  void UpdateImagerToFixedReferenceTransform(double imagerRotationAngleDeg, double imagerPitchAngleDeg = 0);
+  /// @brief Update FocusToImager transform based on the source-axis distance (SAD)
+  /// The focus (radiation source) lies on the Z-axis of the imager frame, the beam diverges from it along the -Z axis.
+  /// @param sourceAxisDistance distance of the focus from the isocenter in mm (default: 1000 mm)
+  void UpdateFocusToImagerTransform(double sourceAxisDistance);
+
+  /// @brief Set the placement of the fixed reference frame in the RAS frame (e.g. the patient position in the room)
+  /// @param matrix row-major 4x4 matrix FixedReference -> RAS
+  /// @return Success flag (false on invalid matrix)
+  bool UpdateFixedReferenceToRasTransform(const double matrix[16]);
+  /// @brief Set the LeftImagingPanelToGantry transform (placement of the left kV panel on the gantry)
+  /// @param matrix row-major 4x4 matrix LeftImagingPanel -> Gantry
+  /// @return Success flag (false on invalid matrix), see \sa UpdateFrameToParentTransform
+  bool UpdateLeftImagingPanelToGantryTransform(const double matrix[16]);
+  /// @brief Set the RightImagingPanelToGantry transform (placement of the right kV panel on the gantry)
+  /// @param matrix row-major 4x4 matrix RightImagingPanel -> Gantry
+  /// @return Success flag (false on invalid matrix), see \sa UpdateFrameToParentTransform
+  bool UpdateRightImagingPanelToGantryTransform(const double matrix[16]);
+  /// @brief Set the FlatPanelToGantry transform (placement of the MV detector on the gantry)
+  /// @param matrix row-major 4x4 matrix FlatPanel -> Gantry
+  /// @return Success flag (false on invalid matrix), see \sa UpdateFrameToParentTransform
+  bool UpdateFlatPanelToGantryTransform(const double matrix[16]);
+  /// @brief Set the PatientSupportToPatientSupportRotation transform (e.g. scaling of the patient support model)
+  /// @param matrix row-major 4x4 matrix PatientSupport -> PatientSupportRotation, may contain scaling
+  /// @return Success flag (false on invalid matrix), see \sa UpdateFrameToParentTransform
+  bool UpdatePatientSupportToPatientSupportRotationTransform(const double matrix[16]);
+
+  /// @brief Source-axis distance set by \sa UpdateFocusToImagerTransform
+  vtkGetMacro(SourceAxisDistance, double);
+
+#ifndef __VTK_WRAP__
+  /// @brief Set the parameters of all machine axes and the patient setup at once (e.g. one sample of a tracking loop)
+  /// Only the elementary transforms whose parameters differ from the current ones are rebuilt, so the cached and
+  /// concatenated transforms through the static axes stay valid. The Update methods skip unchanged parameters the same way.
+  /// Transforms with NaN parameters (\sa GetMachineState) are kept as they are.
+  /// @return Number of elementary transforms rebuilt
+  int SetMachineState(const IEC::MachineParameters& state);
+
+  /// @brief Parameters of the elementary transforms, as set by the Update methods and \sa SetMachineState
+  /// \sa RestoreMachineState restores them together with the matrices.
+  /// The parameters of a transform whose matrix is set otherwise (\sa UpdateFrameToParentTransform, a modified vtkTransform)
+  /// are NaN until the next Update call of that transform.
+  const IEC::MachineParameters& GetMachineState()
+  {
+    // A modified vtkTransform invalidates the parameters of its transform
+    this->SynchronizeElementaryTransforms();
+    return this->MachineParameters;
+  }
+  const IEC::GantryParameters& GetGantryParameters() { return this->GetMachineState().Gantry; }
+  const IEC::CollimatorParameters& GetCollimatorParameters() { return this->GetMachineState().Collimator; }
+  const IEC::WedgeFilterParameters& GetWedgeFilterParameters() { return this->GetMachineState().WedgeFilter; }
+  const IEC::PatientSupportRotationParameters& GetPatientSupportRotationParameters() { return this->GetMachineState().PatientSupportRotation; }
+  const IEC::TableTopEccentricRotationParameters& GetTableTopEccentricRotationParameters() { return this->GetMachineState().TableTopEccentricRotation; }
+  const IEC::TableTopParameters& GetTableTopParameters() { return this->GetMachineState().TableTop; }
+  const IEC::PatientParameters& GetPatientParameters() { return this->GetMachineState().Patient; }
+  const IEC::PatientImageRegularGridParameters& GetPatientImageRegularGridParameters() { return this->GetMachineState().PatientImageRegularGrid; }
+  const IEC::ImagerParameters& GetImagerParameters() { return this->GetMachineState().Imager; }
+  const IEC::FocusParameters& GetFocusParameters() { return this->GetMachineState().Focus; }
+#endif
+
+  /// @brief Closed-form matrix builders for the elementary transforms
+  /// Each builder writes the same row-major 4x4 matrix that the corresponding Update method sets, in one pass
+  /// from the parameters (no transform objects involved). Parameters are the same as for the Update methods.
+  /// @{
+  static void BuildGantryToFixedReferenceMatrix(double gantryRotationAngleDeg, double gantryPitchAngleDeg, double matrix[16]);
+  static void BuildCollimatorToGantryMatrix(double collimatorRotationAngleDeg, double bz, double matrix[16]);
+  static void BuildWedgeFilterToCollimatorMatrix(double wedgefilterRotationAngleDeg, double wz, double matrix[16]);
+  static void BuildPatientSupportRotationToFixedReferenceMatrix(double patientSupportRotationAngleDeg, double matrix[16]);
+  static void BuildTableTopEccentricRotationToPatientSupportRotationMatrix(double tableTopEccentricRotationAngleDeg, double ey, double matrix[16]);
+  static void BuildTableTopToTableTopEccentricRotationMatrix(double tx, double ty, double tz, double tableTopPitchAngleDeg, double tableTopRollAngleDeg, double matrix[16]);
+  static void BuildPatientToTableTopMatrix(double px, double py, double pz, double patientPsiAngleDeg, double patientPhiAngleDeg, double patientThetaAngleDeg, double matrix[16]);
+  static void BuildPatientImageRegularGridToDICOMMatrix(double columnPixelSpacing, double rowPixelSpacing, double sliceDistance, double sx, double sy, double sz,
+                                                        double directionCosineXx, double directionCosineXy, double directionCosineXz,
+                                                        double directionCosineYx, double directionCosineYy, double directionCosineYz, double matrix[16]);
+  static void BuildImagerToFixedReferenceMatrix(double imagerRotationAngleDeg, double imagerPitchAngleDeg, double matrix[16]);
+  static void BuildFocusToImagerMatrix(double sourceAxisDistance, double matrix[16]);
+  /// @}
 
   /// @brief Get transform from one coordinate frame to another
   /// @param fromFrame start transformation from frame
@@ -210,9 +319,339 @@ public:
     vtkGeneralTransform* outputTransform, bool transformForBeam=false);
   //TODO: See this transformForBeam part if still needed
 
-  /// @brief Get coordinate system identifiers from root system down to frame system
+  /// @brief Get transform matrix from one coordinate frame to another
+  /// The composed matrix is written directly into the output without allocating any transform objects. Only the first
+  /// query of a frame pair allocates (its cache entry), later queries of the pair allocate no memory at all. Rigid
+  /// elementary transforms are inverted in closed form (transposed rotation, negated translation).
+  /// @param fromFrame start transformation from frame
+  /// @param toFrame proceed transformation to frame
+  /// @param outputMatrix Row-major 4x4 matrix fromFrame -> toFrame. Matrix is correct if return flag is true.
+  /// @param transformForBeam calculate dynamic transformation for beam model or other models
+  /// @return Success flag (false on any error)
+  bool GetTransformBetween(CoordinateSystemIdentifier fromFrame, CoordinateSystemIdentifier toFrame,
+    double outputMatrix[16], bool transformForBeam=false);
+
+  /// @brief Get transform matrix from one coordinate frame to another
+  /// @see GetTransformBetween(CoordinateSystemIdentifier, CoordinateSystemIdentifier, double[16], bool)
+  /// @param outputMatrix 4x4 matrix fromFrame -> toFrame. Matrix is correct if return flag is true.
+  /// @return Success flag (false on any error)
+  bool GetTransformBetween(CoordinateSystemIdentifier fromFrame, CoordinateSystemIdentifier toFrame,
+    vtkMatrix4x4* outputMatrix, bool transformForBeam=false);
+
+#ifndef __VTK_WRAP__
+  /// @brief Get transform matrix between two frames known at compile time
+  /// The path and the inversion of its downward part are resolved at compile time, so this compiles into a fixed
+  /// sequence of matrix multiplications. Does not use the transform cache.
+  /// Usage: logic->GetTransform<vtkIECTransformLogic::PatientImageRegularGrid, vtkIECTransformLogic::Collimator>(matrix)
+  /// @note Assumes the standard IEC hierarchy set up in the constructor (\sa IEC::StandardHierarchy)
+  /// @param outputMatrix Row-major 4x4 matrix FromFrame -> ToFrame. Matrix is correct if return flag is true.
+  /// @return Success flag (false if the path contains a singular transform)
+  template <CoordinateSystemIdentifier FromFrame, CoordinateSystemIdentifier ToFrame>
+  bool GetTransform(double outputMatrix[16])
+  {
+    this->SynchronizeElementaryTransforms();
+    return IEC::ComposeStandardPath<FromFrame, ToFrame>(
+      [this](int index) { return this->ElementaryTransformMatrices[index].data(); }, outputMatrix);
+  }
+#endif
+
+  /// @brief Get transform matrices from one coordinate frame to another for a sequence of machine states (e.g. control points of an arc)
+  /// The machine parameters are given as one array per axis (structure of arrays). Control point i gives the same result as calling
+  /// UpdateGantryToFixedReferenceTransform(gantryRotationAnglesDeg[i], pitch), UpdateCollimatorToGantryTransform(collimatorRotationAnglesDeg[i], bz),
+  /// UpdatePatientSupportRotationToFixedReferenceTransform(patientSupportRotationAnglesDeg[i]) and
+  /// UpdateTableTopToTableTopEccentricRotationTransform(tableTopTx[i], tableTopTy[i], tableTopTz[i], pitch, roll) followed by GetTransformBetween,
+  /// where the gantry pitch, collimator bz and table top pitch and roll are those of the current matrices of these transforms,
+  /// so they also apply when the matrices were set directly and the machine parameters are not valid (\sa GetMachineState).
+  /// Axes passed as nullptr keep their current transform. The stored transforms of the logic are not changed.
+  /// Control points are processed in parallel using vtkSMPTools.
+  /// @param fromFrame start transformation from frame
+  /// @param toFrame proceed transformation to frame
+  /// @param numberOfControlPoints number of machine states N, the length of each given parameter array
+  /// @param gantryRotationAnglesDeg gantry rotation angles in degrees, or nullptr
+  /// @param collimatorRotationAnglesDeg collimator rotation angles in degrees, or nullptr
+  /// @param patientSupportRotationAnglesDeg patient support rotation angles in degrees, or nullptr
+  /// @param tableTopTx table top displacements along the X-axis, or nullptr (then also ty and tz must be nullptr)
+  /// @param tableTopTy table top displacements along the Y-axis, or nullptr
+  /// @param tableTopTz table top displacements along the Z-axis, or nullptr
+  /// @param outputMatrices N contiguous row-major 4x4 matrices fromFrame -> toFrame (N*16 values)
+  /// @return Success flag (false on any error)
+  bool GetTransformsAlongTrajectory(CoordinateSystemIdentifier fromFrame, CoordinateSystemIdentifier toFrame, vtkIdType numberOfControlPoints,
+    const double* gantryRotationAnglesDeg, const double* collimatorRotationAnglesDeg, const double* patientSupportRotationAnglesDeg,
+    const double* tableTopTx, const double* tableTopTy, const double* tableTopTz, double* outputMatrices);
+
+  /// @brief Get transform matrices from one coordinate frame to another for the machine parameters of N control points
+  /// given in a single N x k array (e.g. a NumPy array read from a treatment log), see \sa GetTransformsAlongTrajectory
+  /// Row i holds the parameters of control point i in the order gantry rotation angle, collimator rotation angle,
+  /// patient support rotation angle (in degrees), table top displacements tx, ty, tz. Only the first k of them are given,
+  /// the remaining axes keep their current transform.
+  /// In Python the arrays are passed through the buffer protocol without copying (they need to be C-contiguous float64),
+  /// and the computation runs with the GIL released. The logic must not be used by other threads meanwhile.
+  /// @param fromFrame start transformation from frame
+  /// @param toFrame proceed transformation to frame
+  /// @param numberOfControlPoints number of machine states N
+  /// @param numberOfParameters number of parameters per control point k: 1, 2, 3 or 6
+  /// @param parameters N*k values, row by row (N x k array)
+  /// @param parametersSize number of values in the parameters buffer, at least N*k (e.g. parameters.size in Python)
+  /// @param outputMatrices N contiguous row-major 4x4 matrices fromFrame -> toFrame (N x 4 x 4 array)
+  /// @param outputMatricesSize number of values in the output buffer, at least N*16
+  /// @return Success flag (false on any error, e.g. if a buffer is too small for N control points)
+  VTK_UNBLOCKTHREADS
+  bool GetTransformsForMachineParameters(CoordinateSystemIdentifier fromFrame, CoordinateSystemIdentifier toFrame, vtkIdType numberOfControlPoints,
+    int numberOfParameters, VTK_ZEROCOPY const double* parameters, vtkIdType parametersSize, VTK_ZEROCOPY double* outputMatrices,
+    vtkIdType outputMatricesSize);
+
+  /// @brief Transform points from one coordinate frame to another
+  /// The transform is composed once, and the points are processed in parallel using vtkSMPTools.
+  /// In Python the arrays are passed through the buffer protocol without copying (they need to be C-contiguous float64),
+  /// and the computation runs with the GIL released. The logic must not be used by other threads meanwhile.
+  /// @param fromFrame coordinate frame of the input points
+  /// @param toFrame coordinate frame of the output points
+  /// @param numberOfPoints number of points N
+  /// @param points Interleaved x,y,z coordinates, 3 * N values (N x 3 array)
+  /// @param pointsSize number of values in the points buffer, at least 3 * N
+  /// @param outputPoints Interleaved x,y,z coordinates in toFrame, 3 * N values (N x 3 array), may be the same array as points
+  /// @param outputPointsSize number of values in the output buffer, at least 3 * N
+  /// @return Success flag (false on any error, e.g. if a buffer is too small for N points)
+  VTK_UNBLOCKTHREADS
+  bool TransformPointsBetween(CoordinateSystemIdentifier fromFrame, CoordinateSystemIdentifier toFrame, vtkIdType numberOfPoints,
+    VTK_ZEROCOPY const double* points, vtkIdType pointsSize, VTK_ZEROCOPY double* outputPoints, vtkIdType outputPointsSize);
+
+  /// @brief Get transform matrices from one coordinate frame to another along a gantry arc in constant angle steps
+  /// Step i gives the same result as UpdateGantryToFixedReferenceTransform(startAngleDeg + i * angleStepDeg) (keeping the
+  /// current gantry pitch) followed by GetTransformBetween, but the path is composed only at construction of the
+  /// \sa IEC::ArcIterator and the steps need no trigonometric functions. The stored transforms of the logic are not changed.
+  /// @param fromFrame start transformation from frame
+  /// @param toFrame proceed transformation to frame
+  /// @param startAngleDeg gantry rotation angle of the first step in degrees
+  /// @param angleStepDeg gantry rotation angle increment per step in degrees
+  /// @param numberOfSteps number of matrices N
+  /// @param outputMatrices N contiguous row-major 4x4 matrices fromFrame -> toFrame (N*16 values)
+  /// @param outputMatricesSize number of values in the output buffer, at least N*16
+  /// @return Success flag (false on any error, e.g. if the buffer is too small for N steps)
+  VTK_UNBLOCKTHREADS
+  bool GetTransformsAlongGantryArc(CoordinateSystemIdentifier fromFrame, CoordinateSystemIdentifier toFrame, double startAngleDeg, double angleStepDeg,
+    vtkIdType numberOfSteps, VTK_ZEROCOPY double* outputMatrices, vtkIdType outputMatricesSize);
+
+#ifndef __VTK_WRAP__
+  /// @brief Get an iterator over the transforms from one coordinate frame to another along a gantry arc, see \sa GetTransformsAlongGantryArc
+  /// The iterator is independent of the logic, later updates do not affect it.
+  /// Usage: for (logic->GetGantryArcIterator(Collimator, Patient, 0, 0.5, arc); arc.GetStep() < 720; arc.Next()) { arc.GetMatrix(matrix); ... }
+  /// @return Success flag (false on any error)
+  bool GetGantryArcIterator(CoordinateSystemIdentifier fromFrame, CoordinateSystemIdentifier toFrame, double startAngleDeg, double angleStepDeg,
+    IEC::ArcIterator& iterator);
+#endif
+
+  /// @brief Get the centers of all voxels of the patient image regular grid in the given coordinate frame
+  /// The grid geometry is the one set by \sa UpdatePatientImageRegularGridToDICOMTransform. Voxel centers are computed by
+  /// stepping along the rows of the grid instead of transforming each voxel with a full matrix multiplication.
+  /// Slices are processed in parallel using vtkSMPTools, and the rows use AVX2 when the CPU supports it (\sa IEC::UseAVX2).
+  /// @param toFrame coordinate frame of the output points (e.g. Gantry or Collimator)
+  /// @param nElems Number of elements in each dimension (slices, rows, columns), as in \sa VectorizedToLinearizedIndex
+  /// @param outputPoints Interleaved x,y,z coordinates, 3 * nElems[0] * nElems[1] * nElems[2] values. The point of voxel
+  ///   (e0,e1,e2) is at position VectorizedToLinearizedIndex({e0,e1,e2}, nElems).
+  /// @return Success flag (false on any error)
+  bool GetVoxelCentersInFrame(CoordinateSystemIdentifier toFrame, const std::array<uint16_t, 3>& nElems, double* outputPoints);
+  /// @brief Single precision version of \sa GetVoxelCentersInFrame, using half the memory for large grids
+  bool GetVoxelCentersInFrame(CoordinateSystemIdentifier toFrame, const std::array<uint16_t, 3>& nElems, float* outputPoints);
+
+  /// @brief Divergent (beam's eye view) projection of points through the focus onto a plane perpendicular to the central axis
+  /// Points are transformed into the Focus frame and scaled by planeDistance / depth, where depth is the distance of the
+  /// point from the focus along the central axis. Points are processed in parallel using vtkSMPTools.
+  /// @param fromFrame coordinate frame of the input points (e.g. Patient or RAS)
+  /// @param numberOfPoints number of input points
+  /// @param points Interleaved x,y,z coordinates, 3 * numberOfPoints values
+  /// @param pointsSize number of values in the points buffer, at least 3 * numberOfPoints
+  /// @param planeDistance distance of the projection plane from the focus (e.g. \sa GetSourceAxisDistance for the isocenter plane)
+  /// @param outputPoints 3 * numberOfPoints values: x,y on the projection plane along the Focus frame axes, and the depth.
+  ///   Points at or behind the focus are set to NaN.
+  /// @param outputPointsSize number of values in the output buffer, at least 3 * numberOfPoints
+  /// @return Success flag (false on any error, e.g. if a buffer is too small for numberOfPoints points)
+  VTK_UNBLOCKTHREADS
+  bool ProjectPointsToImagerPlane(CoordinateSystemIdentifier fromFrame, vtkIdType numberOfPoints, VTK_ZEROCOPY const double* points, vtkIdType pointsSize,
+    double planeDistance, VTK_ZEROCOPY double* outputPoints, vtkIdType outputPointsSize);
+  /// @brief Divergent projection of all voxel centers of the patient image regular grid, see \sa ProjectPointsToImagerPlane
+  /// Output order is the same as for \sa GetVoxelCentersInFrame.
+  bool ProjectVoxelCentersToImagerPlane(const std::array<uint16_t, 3>& nElems, double planeDistance, double* outputPoints);
+  /// @brief Single precision version of \sa ProjectVoxelCentersToImagerPlane
+  bool ProjectVoxelCentersToImagerPlane(const std::array<uint16_t, 3>& nElems, double planeDistance, float* outputPoints);
+
+  /// @brief Compute a digitally reconstructed radiograph (DRR) of a volume on the patient image regular grid
+  /// Each detector pixel gets the line integral of the voxel values along the ray from the focus through the pixel center
+  /// (e.g. linear attenuation coefficients per mm give the attenuation exponent). Rays are not cut at the detector, so
+  /// that a detector frame at the isocenter (e.g. the default FlatPanel) gives the beam's eye view DRR. The grid geometry is the one set by
+  /// \sa UpdatePatientImageRegularGridToDICOMTransform, the source is the origin of the Focus frame. The rays are traced
+  /// through the grid with Siddon's method using Jacobs' incremental traversal, detector rows are processed in parallel
+  /// using vtkSMPTools.
+  /// @param detectorFrame Frame of the detector (e.g. FlatPanel, LeftImagingPanel or RightImagingPanel). The detector lies
+  ///   in its XY plane, centered on its origin, with its columns along X and its rows along Y.
+  /// @param volume Voxel values, at position VectorizedToLinearizedIndex({e0,e1,e2}, nElems) for voxel (e0,e1,e2)
+  /// @param nElems Number of elements in each dimension (slices, rows, columns)
+  /// @param detectorSize Number of detector pixels (rows, columns)
+  /// @param pixelSpacing Distance between the centers of adjacent detector rows and columns, in mm
+  /// @param outputImage detectorSize[0] * detectorSize[1] values, row by row
+  /// @return Success flag (false on any error)
+  bool ComputeDigitallyReconstructedRadiograph(CoordinateSystemIdentifier detectorFrame, const float* volume, const std::array<uint16_t, 3>& nElems,
+    const std::array<uint16_t, 2>& detectorSize, const std::array<double, 2>& pixelSpacing, float* outputImage);
+
+  /// @brief Get the vtkTransform of the elementary transform between two frames
+  /// The vtkTransform is only created on first request, until then the logic holds nothing but its matrix. It may be
+  /// modified like the transforms set by the Update methods: the logic compares its modification time whenever it reads
+  /// the elementary transforms (transform queries, batch and concatenated transforms, snapshots, saving and copying the
+  /// state, Update calls) and takes over the changed matrix (\sa MarkElementaryTransformModified), invalidating the cached
+  /// and concatenated transforms through it. A rigid transform changed to a matrix with scaling or shear is reverted
+  /// instead (\sa UpdateFrameToParentTransform).
   vtkTransform* GetElementaryTransformBetween(CoordinateSystemIdentifier fromFrame, CoordinateSystemIdentifier toFrame);
 
+public:
+  /// @brief Enable caching of the composed transforms between frame pairs (on by default)
+  /// A cached transform is reused until any elementary transform along its path is updated.
+  /// Memory is only allocated for the frame pairs that are queried.
+  /// Beam transforms (transformForBeam=true) are never cached.
+  vtkGetMacro(TransformCacheEnabled, bool);
+  vtkSetMacro(TransformCacheEnabled, bool);
+  vtkBooleanMacro(TransformCacheEnabled, bool);
+
+  /// @brief Number of \sa GetTransformBetween calls answered from the transform cache
+  vtkGetMacro(TransformCacheHits, vtkTypeUInt64);
+  /// @brief Number of \sa GetTransformBetween calls for which the transform had to be composed
+  vtkGetMacro(TransformCacheMisses, vtkTypeUInt64);
+
+  /// @brief Reset the transform cache hit and miss counters
+  void ResetTransformCacheStatistics();
+
+  /// @brief Drop all cached transforms
+  void ClearTransformCache();
+
+  /// @brief Get the concatenated transform of a frame: frame -> FixedReference followed by FixedReferenceToRas
+  /// The concatenated transforms form a tree with a dirty flag per frame. Updating an elementary transform marks only
+  /// the frames below it as out of date, and a query recomputes only the out of date frames between the frame and the
+  /// root, each from the concatenated transform of its parent. Each concatenated transform is thus recomputed at most
+  /// once per change, and querying an up to date frame is a copy.
+  /// The tree follows the parents of the hierarchy used by \sa GetTransformBetween, so the imaging panels and the flat panel
+  /// are concatenated to the gantry and do not rotate with the collimator.
+  /// @param outputMatrix Row-major 4x4 matrix frame -> RAS (through the fixed reference frame)
+  /// @return Success flag (false if the frame is not part of the hierarchy)
+  bool GetConcatenatedTransform(CoordinateSystemIdentifier frame, double outputMatrix[16]);
+
+  /// @brief Number of concatenated transforms recomputed since construction
+  vtkGetMacro(NumberOfConcatenatedTransformUpdates, vtkTypeUInt64);
+
+  /// @brief Size in bytes of the binary machine state record (\sa IEC::MachineStateRecord)
+  static vtkIdType GetMachineStateRecordSize();
+
+  /// @brief Write all elementary transforms, the source-axis distance and the machine parameters (\sa GetMachineState)
+  /// into a binary machine state record
+  /// The record has a fixed layout (\sa IEC::MachineStateRecord), so it can be stored, memory mapped or sent to another
+  /// process as is and restored with \sa RestoreMachineState without parsing.
+  /// @param record Buffer of \sa GetMachineStateRecordSize bytes, no alignment needed
+  /// @return Success flag (false if the hierarchy of the logic is not the standard one)
+  bool SaveMachineState(VTK_ZEROCOPY unsigned char* record);
+
+  /// @brief Set all elementary transforms, the source-axis distance and the machine parameters from a binary machine state record
+  /// All elementary transforms are marked as modified, and the restored state is published (\sa PublishSnapshot).
+  /// Update calls after the restore skip the transforms whose parameters are unchanged, as after the Update calls
+  /// that led to the saved state.
+  /// @param record Buffer of \sa GetMachineStateRecordSize bytes written by \sa SaveMachineState, no alignment needed
+  /// @return Success flag (false if the record is invalid, then the logic is not changed)
+  bool RestoreMachineState(VTK_ZEROCOPY const unsigned char* record);
+
+  /// @brief Save the machine state into a file, see \sa SaveMachineState
+  bool WriteMachineStateFile(const char* fileName);
+
+  /// @brief Restore the machine state from a file, see \sa RestoreMachineState
+  bool ReadMachineStateFile(const char* fileName);
+
+#ifndef __VTK_WRAP__
+protected:
+  /// @brief Frames, elementary transforms and hierarchy of the logic, with the tables compiled from them
+  /// The topology never changes once compiled. All instances share the topology of the standard hierarchy
+  /// (\sa GetStandardTopology), so only the machine state is allocated per instance.
+  struct Topology
+  {
+    /// @brief Map from \sa CoordinateSystemIdentifier to coordinate system name. Used for getting transforms
+    /// The identifiers need to be dense, the number of frames is one more than the largest identifier.
+    std::map<CoordinateSystemIdentifier, std::string> CoordinateSystemsMap;
+
+    /// @brief List of IEC transforms
+    std::vector< std::pair<CoordinateSystemIdentifier, CoordinateSystemIdentifier> > IECTransforms;
+
+    /// @todo for hierarchy use tree with nodes, something like graph
+    /// @brief Map of IEC coordinate systems hierarchy
+    std::map< CoordinateSystemIdentifier, std::list< CoordinateSystemIdentifier > > CoordinateSystemsHierarchy;
+
+    /// @brief Name of each elementary transform, in elementary transform index order
+    std::vector<std::string> ElementaryTransformNames;
+
+    /// @brief Hierarchy compiled into flat tables: parent and depth of each frame, and elementary transform index
+    /// and rigidity of each (child, parent) frame pair
+    IEC::FrameTables FrameTables;
+
+    /// @brief Children of each frame, compiled from the parent table of \sa FrameTables
+    std::vector< std::vector<int> > FrameChildren;
+
+    /// @brief Name of each frame, and frame of each name, compiled from \sa CoordinateSystemsMap
+    std::vector<std::string> FrameNames;
+    std::unordered_map<std::string, int> FrameIdentifiers;
+
+    /// @brief Matrices of the elementary transforms in a newly created logic
+    std::vector<IEC::Matrix4> InitialElementaryTransformMatrices;
+  };
+
+public:
+  /// @brief Immutable copy of the elementary transforms and the hierarchy at one point in time
+  /// All methods are const and do not touch the logic, so any number of threads can query the same
+  /// snapshot without locking while the logic itself is being updated.
+  /// @see PublishSnapshot, GetSnapshot
+  class VTK_IEC_TRANSFORM_LOGIC_EXPORT MachineStateSnapshot
+  {
+  public:
+    /// @brief Get transform matrix from one coordinate frame to another in the captured machine state
+    /// @param outputMatrix Row-major 4x4 matrix fromFrame -> toFrame. Matrix is correct if return flag is true.
+    /// @return Success flag (false if there is no transform between the frames)
+    bool GetTransformBetween(CoordinateSystemIdentifier fromFrame, CoordinateSystemIdentifier toFrame, double outputMatrix[16]) const;
+
+    /// @brief Version of the elementary transforms that the snapshot was taken from
+    vtkTypeUInt64 GetVersion() const { return this->Version; }
+
+  private:
+    friend class vtkIECTransformLogic;
+    std::shared_ptr<const Topology> SharedTopology;
+    std::vector<IEC::Matrix4> ElementaryTransformMatrices;
+    vtkTypeUInt64 Version;
+  };
+
+  /// @brief Capture the current elementary transforms in a new snapshot and publish it atomically for \sa GetSnapshot
+  /// To be called by the (single) writer thread after a batch of Update calls. Nothing is done if no transform
+  /// changed since the last published snapshot.
+  /// The snapshot is stored in one of a few slots that is neither published nor being copied by a reader, and then
+  /// published by switching an atomic slot index. The writer waits (yields) only in the rare case that readers are
+  /// still copying from all other slots.
+  void PublishSnapshot();
+
+  /// @brief Get the last published snapshot (a snapshot of the initial state is published at construction)
+  /// Safe to call from any thread, also while another thread updates the logic and publishes snapshots.
+  /// Lock-free: readers never wait for the writer or for each other. The published slot is pinned with an atomic
+  /// reader count while the snapshot pointer is copied, and the copy is retried if a publish happened meanwhile.
+  std::shared_ptr<const MachineStateSnapshot> GetSnapshot() const;
+
+  /// @brief Get transform matrices from one coordinate frame to another at intermediate positions between two machine states
+  /// (e.g. sub-control-point samples of an arc between two published snapshots)
+  /// The composed transforms of both states are computed once, and each sample is interpolated from them along the screw
+  /// motion between the states (\sa IEC::TransformInterpolator), without composing the hierarchy again. The result equals
+  /// \sa GetTransformBetween for the intermediate state whenever the states differ by a single rotation axis, e.g. the gantry.
+  /// @param startState machine state at fraction 0
+  /// @param endState machine state at fraction 1
+  /// @param fromFrame start transformation from frame
+  /// @param toFrame proceed transformation to frame
+  /// @param numberOfFractions number of samples N
+  /// @param fractions N positions between the states (0: startState, 1: endState)
+  /// @param outputMatrices N contiguous row-major 4x4 matrices fromFrame -> toFrame (N*16 values)
+  /// @return Success flag (false on any error, e.g. if the transforms of the states do not differ by a rigid motion)
+  bool GetTransformsBetweenStates(const MachineStateSnapshot& startState, const MachineStateSnapshot& endState,
+    CoordinateSystemIdentifier fromFrame, CoordinateSystemIdentifier toFrame, vtkIdType numberOfFractions, const double* fractions,
+    double* outputMatrices);
+#endif
+
 public:
   //std::map<CoordinateSystemIdentifier, std::string> GetCoordinateSystemsMap()
   //{
@@ -227,9 +666,39 @@ public:
 public:
   std::vector<std::pair<CoordinateSystemIdentifier, CoordinateSystemIdentifier>> GetIECTransforms()
   {
-    return this->IECTransforms;
+    return this->SharedTopology->IECTransforms;
   }
 
+  /// @brief Add a coordinate frame below a frame of the hierarchy (e.g. MLC bank, surface camera, couch extension)
+  /// The new frame gets the next free identifier, so frames are stored in flat tables indexed by identifier, and
+  /// looking up transforms through added frames costs the same as through the IEC frames.
+  /// The elementary transform frame -> parent can be updated with \sa UpdateFrameToParentTransform.
+  /// @param parentFrame frame of the hierarchy that the new frame is attached to
+  /// @param name unique name of the new frame, used for naming its transform (\sa GetTransformNameBetween)
+  /// @param matrix row-major 4x4 matrix of the transform from the new frame to the parent frame (identity if not given)
+  /// @return Identifier of the new frame (LastIECCoordinateFrame for the first added frame), -1 on error
+  int AddFrame(CoordinateSystemIdentifier parentFrame, const std::string& name);
+  int AddFrame(CoordinateSystemIdentifier parentFrame, const std::string& name, const double matrix[16]);
+
+  /// @brief Set the elementary transform from a frame to its parent frame
+  /// Intended for frames added with \sa AddFrame, the IEC frames are normally set with the Update methods.
+  /// The IEC transforms other than PatientSupportToPatientSupportRotation and PatientImageRegularGridToDICOM are rigid,
+  /// they are inverted in closed form, so their matrix must be a rotation and translation only. Added frames may have any
+  /// invertible matrix.
+  /// @param matrix row-major 4x4 matrix frame -> parent
+  /// @return Success flag (false if the frame has no parent, or if the transform is rigid and the matrix is not)
+  bool UpdateFrameToParentTransform(CoordinateSystemIdentifier frame, const double matrix[16]);
+
+  /// @brief Number of coordinate frames, including the ones added with \sa AddFrame
+  int GetNumberOfFrames();
+
+  /// @brief Get the identifier of a coordinate frame from its name
+  /// @return Identifier of the frame, -1 if there is no frame with the name
+  int GetFrameIdentifier(const std::string& name);
+
+  /// @brief Get the name of a coordinate frame (empty if the frame does not exist)
+  std::string GetFrameName(CoordinateSystemIdentifier frame);
+
   /// @brief Converts a 3D vector containing the indices (e0,e1,e2) in each axis of a regular grid to a linear index position when the 3D data are stored in a linear flat array
   /// @note In the case of DICOM images stacked by slice position as regular grid, dim 0: slice index, dim 1: row index, dim 2: column index, (all starting from zero), since PixelData are stored with row-major ordering
   /// @note C ordering is used, ie the last dimension is contiguous in memory, then the second dimension, with the first dimension being most distant.
@@ -276,6 +745,110 @@ public:
     return std::array<uint16_t,3>{e0, e1, e2};
   }
 
+  /// @brief Variant of \sa VectorizedToLinearizedIndex for grids with more than 65535 elements along an axis
+  /// @tparam IndexType unsigned integer type of the grid indices (uint32_t or uint64_t, uint16_t uses the overload above)
+  /// @note Throws if the index is out of range or if the number of grid elements does not fit in the 64-bit linear index
+  template <typename IndexType>
+  static inline uint64_t VectorizedToLinearizedIndex(const std::array<IndexType, 3>& vectorizedIndex, const std::array<IndexType, 3>& nElems)
+  {
+    uint64_t totalElems = 0;
+    if (!IEC::GetNumberOfGridElements(nElems, totalElems))
+    {
+      throw std::runtime_error("Grid size (" + std::to_string(nElems[0]) + "," + std::to_string(nElems[1]) + "," + std::to_string(nElems[2]) + ") exceeds the range of linear indices");
+    }
+    if(vectorizedIndex[0] >= nElems[0] || vectorizedIndex[1] >= nElems[1] || vectorizedIndex[2] >= nElems[2])
+    {
+      throw std::runtime_error("Indices (" + std::to_string(vectorizedIndex[0]) + "," + std::to_string(vectorizedIndex[1]) + "," + std::to_string(vectorizedIndex[2]) + ") out of range (" + std::to_string(nElems[0]) + "," + std::to_string(nElems[1]) + "," + std::to_string(nElems[2]) + ")" );
+    }
+    // In range, so the result is less than totalElems and cannot overflow
+    return (static_cast<uint64_t>(vectorizedIndex[0])*nElems[1] + vectorizedIndex[1])*nElems[2] + vectorizedIndex[2];
+  }
+
+  /// @brief Variant of \sa LinearizedToVectorizedIndex for grids with more than 65535 elements along an axis
+  /// @tparam IndexType unsigned integer type of the grid indices (uint32_t or uint64_t, uint16_t uses the overload above)
+  /// @note Throws if the index is out of range or if the number of grid elements does not fit in the 64-bit linear index
+  template <typename IndexType>
+  static inline std::array<IndexType, 3> LinearizedToVectorizedIndex(const uint64_t linearizedIndex, const std::array<IndexType, 3>& nElems)
+  {
+    uint64_t totalElems = 0;
+    if (!IEC::GetNumberOfGridElements(nElems, totalElems))
+    {
+      throw std::runtime_error("Grid size (" + std::to_string(nElems[0]) + "," + std::to_string(nElems[1]) + "," + std::to_string(nElems[2]) + ") exceeds the range of linear indices");
+    }
+    if(linearizedIndex >= totalElems)
+    {
+      throw std::runtime_error("Index (" + std::to_string(linearizedIndex) + ") out of range (totalElems = " + std::to_string(totalElems) + ")" );
+    }
+    const uint64_t n1 = nElems[1];
+    const uint64_t n2 = nElems[2];
+    return std::array<IndexType, 3>{ static_cast<IndexType>((linearizedIndex/n2)/n1), static_cast<IndexType>((linearizedIndex/n2)%n1),
+      static_cast<IndexType>(linearizedIndex%n2) };
+  }
+
+  /// @brief Converts a 3D vector containing the indices (e0,e1,e2) of a regular grid to the position in Z-order (Morton) layout
+  /// In Morton layout voxels that are close in 3D are also close in memory, which improves cache locality of scattered access.
+  /// @see IEC::MortonLayout, and IEC::ConvertRowMajorToLayout for converting a whole grid to this layout
+  /// @param vectorizedIndex 3-component array consisting of the indices in each dimension (e0,e1,e2)
+  /// @param nElems 3D array containing the number of elements in each dimension
+  /// @return The position of the voxel in the Morton layout of the grid, less than IEC::MortonLayout(nElems).GetNumberOfElements()
+  static inline uint64_t VectorizedToMortonIndex(const std::array<uint16_t, 3>& vectorizedIndex, const std::array<uint16_t, 3>& nElems)
+  {
+    if(vectorizedIndex[0] >= nElems[0] || vectorizedIndex[1] >= nElems[1] || vectorizedIndex[2] >= nElems[2])
+    {
+      throw std::runtime_error("Indices (" + std::to_string(vectorizedIndex[0]) + "," + std::to_string(vectorizedIndex[1]) + "," + std::to_string(vectorizedIndex[2]) + ") out of range (" + std::to_string(nElems[0]) + "," + std::to_string(nElems[1]) + "," + std::to_string(nElems[2]) + ")" );
+    }
+    return IEC::MortonLayout(nElems).GetIndex(vectorizedIndex);
+  }
+
+  /// @brief Converts a position in Z-order (Morton) layout to a 3D index (e0,e1,e2) of the regular grid, inverse of \sa VectorizedToMortonIndex
+  /// @param mortonIndex the position in the Morton layout to be converted. Positions of padding voxels are out of range.
+  /// @param nElems 3D array containing the number of elements in each dimension
+  /// @return A 3-component array consisting of the indices in each dimension (e0,e1,e2)
+  static inline std::array<uint16_t, 3> MortonToVectorizedIndex(const uint64_t mortonIndex, const std::array<uint16_t, 3>& nElems)
+  {
+    const IEC::MortonLayout layout(nElems);
+    const std::array<uint16_t, 3> vectorizedIndex = layout.GetVectorizedIndex(mortonIndex);
+    if(mortonIndex >= layout.GetNumberOfElements() || vectorizedIndex[0] >= nElems[0] || vectorizedIndex[1] >= nElems[1] || vectorizedIndex[2] >= nElems[2])
+    {
+      throw std::runtime_error("Morton index (" + std::to_string(mortonIndex) + ") out of range (" + std::to_string(nElems[0]) + "," + std::to_string(nElems[1]) + "," + std::to_string(nElems[2]) + ")" );
+    }
+    return vectorizedIndex;
+  }
+
+  /// @brief Batch version of \sa VectorizedToLinearizedIndex for many indices of the same grid
+  /// Instead of throwing for each invalid index, all indices are bounds-checked in bulk and the first offending one is reported.
+  /// @param vectorizedIndices array of numberOfIndices grid indices (e0,e1,e2)
+  /// @param numberOfIndices number of indices to convert
+  /// @param nElems 3D array containing the number of elements in each dimension
+  /// @param linearizedIndices output array of numberOfIndices linear indices
+  /// @return -1 if all indices were converted, otherwise the position of the first index that is out of range
+  ///   (the output is then only partially written)
+  /// @tparam IndexType unsigned integer type of the grid indices (uint16_t, uint32_t or uint64_t)
+  template <typename IndexType>
+  static inline int64_t VectorizedToLinearizedIndices(const std::array<IndexType, 3>* vectorizedIndices, size_t numberOfIndices,
+    const std::array<IndexType, 3>& nElems, uint64_t* linearizedIndices)
+  {
+    return IEC::VectorizedToLinearizedIndices(vectorizedIndices, numberOfIndices, nElems, linearizedIndices);
+  }
+
+  /// @brief Batch version of \sa LinearizedToVectorizedIndex for many indices of the same grid
+  /// The divisions by the grid dimensions use precomputed reciprocals (\sa IEC::FastDivider) when the dimensions fit in 16 bits,
+  /// and 16-bit grids are converted with AVX2 when the CPU supports it. Instead of throwing for each
+  /// invalid index, all indices are bounds-checked in bulk and the first offending one is reported.
+  /// @param linearizedIndices array of numberOfIndices linear indices
+  /// @param numberOfIndices number of indices to convert
+  /// @param nElems 3D array containing the number of elements in each dimension
+  /// @param vectorizedIndices output array of numberOfIndices grid indices (e0,e1,e2)
+  /// @return -1 if all indices were converted, otherwise the position of the first index that is out of range
+  ///   (the output is then only partially written)
+  /// @tparam IndexType unsigned integer type of the grid indices (uint16_t, uint32_t or uint64_t)
+  template <typename IndexType>
+  static inline int64_t LinearizedToVectorizedIndices(const uint64_t* linearizedIndices, size_t numberOfIndices,
+    const std::array<IndexType, 3>& nElems, std::array<IndexType, 3>* vectorizedIndices)
+  {
+    return IEC::LinearizedToVectorizedIndices(linearizedIndices, numberOfIndices, nElems, vectorizedIndices);
+  }
+
   //std::map<CoordinateSystemIdentifier, std::list<CoordinateSystemIdentifier>> GetCoordinateSystemsHierarchy()
   //{
   //  return CoordinateSystemsHierarchy;
@@ -310,48 +883,143 @@ protected:
   /// @see IEC 61217:2011 hierarchy
   bool GetPathFromRoot(CoordinateSystemIdentifier frame, CoordinateSystemsList& path);
 
-protected:
-  /// @brief Map from \sa CoordinateSystemIdentifier to coordinate system name. Used for getting transforms
-  std::map<CoordinateSystemIdentifier, std::string> CoordinateSystemsMap;
+  /// @brief Get the closest coordinate system that both frames descend from (lowest common ancestor)
+  /// Walks up the parent table only as far as needed, without building any path containers.
+  /// @return Success flag (false if any of the frames is not part of the hierarchy)
+  bool GetCommonAncestor(CoordinateSystemIdentifier frame1, CoordinateSystemIdentifier frame2, CoordinateSystemIdentifier& ancestor);
+
+#ifndef __VTK_WRAP__
+  /// @brief Get the topology of the IEC 61217 hierarchy, built on first use and shared by all instances
+  static std::shared_ptr<const Topology> GetStandardTopology();
+
+  /// @brief Compile the hierarchy and the list of transforms of the topology into its frame tables and children lists
+  static void CompileTopology(Topology& topology);
+
+  /// @brief Get a topology that can be modified, copying the shared one first if other instances or snapshots use it
+  /// @note \sa BuildFrameTables needs to be called after modifying it
+  Topology& GetMutableTopology();
+#endif
+
+  /// @brief Recompile the topology and reset the per-frame state of the logic
+  /// @note Needs to be called again if the hierarchy or the list of transforms is modified
+  void BuildFrameTables();
+
+  /// @brief Size the elementary transform versions and the concatenated transforms to the topology, all out of date
+  void InitializeFrameState();
+
+  /// @brief Mark the elementary transform between two frames as changed, invalidating cached transforms through it
+  /// The matrix is taken over from the vtkTransform returned by \sa GetElementaryTransformBetween (if created) into
+  /// \sa ElementaryTransformMatrices.
+  void MarkElementaryTransformModified(CoordinateSystemIdentifier fromFrame, CoordinateSystemIdentifier toFrame);
+
+  /// @brief Check that the matrix can be set for the elementary transform: a rigid transform of the hierarchy needs a rigid matrix
+  bool IsElementaryTransformMatrixAllowed(CoordinateSystemIdentifier fromFrame, CoordinateSystemIdentifier toFrame, const IEC::Matrix4& matrix);
+
+  /// @brief Take over the matrices of the created vtkTransforms that were modified since the logic last set or read them
+  /// Called before reading \sa ElementaryTransformMatrices, costs nothing while no vtkTransform has been requested.
+  void SynchronizeElementaryTransforms();
+
+  /// @brief Set the matrix of the elementary transform between two frames, in both \sa ElementaryTransformMatrices
+  /// and the vtkTransform member, and mark it as changed
+  void SetElementaryTransformMatrix(CoordinateSystemIdentifier fromFrame, CoordinateSystemIdentifier toFrame, const IEC::Matrix4& matrix);
+
+#ifndef __VTK_WRAP__
+  /// @brief Store the parameters of an elementary transform and rebuild its matrix, unless the parameters are unchanged
+  /// @return True if the matrix was rebuilt
+  template <class Parameters>
+  bool SetElementaryTransformParameters(CoordinateSystemIdentifier fromFrame, CoordinateSystemIdentifier toFrame,
+    Parameters& currentParameters, const Parameters& parameters);
+#endif
+
+  /// @brief Mark the concatenated transforms depending on the elementary transform fromFrame -> toFrame as out of date
+  /// For a transform of the hierarchy this is the subtree of fromFrame, otherwise (e.g. FixedReferenceToRas) all frames.
+  /// Frames that are already out of date are not descended into, as all frames below them are out of date as well.
+  void MarkConcatenatedTransformsDirty(CoordinateSystemIdentifier fromFrame, CoordinateSystemIdentifier toFrame);
+
+  /// @brief Bring the concatenated transform of the frame up to date, after its out of date ancestors
+  const IEC::Matrix4& UpdateConcatenatedTransform(int frame);
 
-  /// @brief List of IEC transforms
-  std::vector< std::pair<CoordinateSystemIdentifier, CoordinateSystemIdentifier> > IECTransforms;
+  /// @brief Implementation of \sa GetTransformsAlongTrajectory for parameter arrays with the given distance between
+  /// the values of consecutive control points (1 for separate arrays, k for an N x k array)
+  bool ComputeTransformsAlongTrajectory(CoordinateSystemIdentifier fromFrame, CoordinateSystemIdentifier toFrame, vtkIdType numberOfControlPoints,
+    const double* gantryRotationAnglesDeg, const double* collimatorRotationAnglesDeg, const double* patientSupportRotationAnglesDeg,
+    const double* tableTopTx, const double* tableTopTy, const double* tableTopTz, vtkIdType parameterStride, double* outputMatrices);
 
-  /// @todo for hierarchy use tree with nodes, something like graph
-  /// @brief Map of IEC coordinate systems hierarchy
-  std::map< CoordinateSystemIdentifier, std::list< CoordinateSystemIdentifier > > CoordinateSystemsHierarchy;
+  /// @brief Compose the transform fromFrame -> toFrame through the given common ancestor frame
+  bool ComposeTransformBetween(CoordinateSystemIdentifier fromFrame, CoordinateSystemIdentifier toFrame,
+    CoordinateSystemIdentifier ancestor, bool transformForBeam, double outputMatrix[16]);
+
+  /// @brief Validate the arguments of \sa GetVoxelCentersInFrame and get the grid index -> toFrame matrix
+  bool GetVoxelCentersTransform(CoordinateSystemIdentifier toFrame, const std::array<uint16_t, 3>& nElems, bool outputValid, IEC::Matrix4& gridToFrame);
+
+  /// @brief Validate the arguments of \sa ProjectVoxelCentersToImagerPlane and get the grid index -> Focus matrix
+  bool GetVoxelCentersProjection(const std::array<uint16_t, 3>& nElems, double planeDistance, bool outputValid, IEC::Matrix4& gridToFocus);
+
+  /// @brief Get the latest version of the elementary transforms on the path fromFrame -> ancestor -> toFrame
+  vtkTypeUInt64 GetPathVersion(CoordinateSystemIdentifier fromFrame, CoordinateSystemIdentifier toFrame, CoordinateSystemIdentifier ancestor);
 
 protected:
-  vtkNew<vtkTransform> FixedReferenceToRasTransform;
-  vtkNew<vtkTransform> GantryToFixedReferenceTransform;
-  vtkNew<vtkTransform> CollimatorToGantryTransform;
-  vtkNew<vtkTransform> WedgeFilterToCollimatorTransform;
-  vtkNew<vtkTransform> LeftImagingPanelToGantryTransform;
-  vtkNew<vtkTransform> RightImagingPanelToGantryTransform;
-  vtkNew<vtkTransform> PatientSupportRotationToFixedReferenceTransform;
-  vtkNew<vtkTransform> PatientSupportToPatientSupportRotationTransform;
-  vtkNew<vtkTransform> TableTopEccentricRotationToPatientSupportRotationTransform;
-  vtkNew<vtkTransform> TableTopToTableTopEccentricRotationTransform;
-  vtkNew<vtkTransform> PatientToTableTopTransform;
-  vtkNew<vtkTransform> DICOMToPatientTransform;
-  vtkNew<vtkTransform> PatientImageRegularGridToDICOMTransform;
-  vtkNew<vtkTransform> RasToPatientTransform;
-  vtkNew<vtkTransform> FlatPanelToGantryTransform;
-
-  vtkNew<vtkTransform> GantryToFixedReferenceConcatenatedTransform;
-  vtkNew<vtkTransform> CollimatorToGantryConcatenatedTransform;
-  vtkNew<vtkTransform> WedgeFilterToCollimatorConcatenatedTransform;
-  vtkNew<vtkTransform> LeftImagingPanelToGantryConcatenatedTransform;
-  vtkNew<vtkTransform> RightImagingPanelToGantryConcatenatedTransform;
-  vtkNew<vtkTransform> FlatPanelToGantryConcatenatedTransform;
-  vtkNew<vtkTransform> PatientSupportRotationToFixedReferenceConcatenatedTransform;
-  vtkNew<vtkTransform> PatientSupportToPatientSupportRotationConcatenatedTransform;
-  vtkNew<vtkTransform> TableTopEccentricRotationToPatientSupportRotationConcatenatedTransform;
-  vtkNew<vtkTransform> TableTopToTableEccentricRotationConcatenatedTransform;
-  vtkNew<vtkTransform> PatientToTableTopConcatenatedTransform;
-  vtkNew<vtkTransform> DICOMToPatientConcatenatedTransform;
-  vtkNew<vtkTransform> PatientImageRegularGridToDICOMConcatenatedTransform;
-  vtkNew<vtkTransform> RasToPatientConcatenatedTransform;
+#ifndef __VTK_WRAP__
+  /// @brief Frames and hierarchy, shared with other instances and with the published snapshots
+  std::shared_ptr<const Topology> SharedTopology;
+#endif
+
+  /// @brief Row-major matrices of the elementary transforms (same order as the elementary transform indices)
+  /// These are the values used for computing transforms, the vtkTransform members are kept in sync with them.
+  std::vector<IEC::Matrix4> ElementaryTransformMatrices;
+
+protected:
+  /// @brief Composed transform between a frame pair, valid as long as the path version is unchanged
+  struct TransformCacheEntry
+  {
+    double Matrix[16];
+    vtkTypeUInt64 PathVersion;
+    bool Valid;
+  };
+
+  /// @brief Version of each elementary transform (same order as the elementary transform indices),
+  /// set from \sa ElementaryTransformVersionCounter whenever the transform is modified
+  std::vector<vtkTypeUInt64> ElementaryTransformVersions;
+  vtkTypeUInt64 ElementaryTransformVersionCounter;
+
+  /// @brief Index into \sa TransformCache of each frame pair, stored at fromFrame * number of frames + toFrame
+  /// (-1 if the pair has not been queried). Sized whenever the frames change, see \sa ClearTransformCache.
+  std::vector<int> TransformCacheSlots;
+  /// @brief Composed transforms of the frame pairs that have been queried, in the order of the first query
+  std::vector<TransformCacheEntry> TransformCache;
+  bool TransformCacheEnabled;
+  vtkTypeUInt64 TransformCacheHits;
+  vtkTypeUInt64 TransformCacheMisses;
+
+  /// @brief Concatenated transform of each frame, see \sa GetConcatenatedTransform. Valid if the dirty flag of the frame
+  /// is not set. A frame is never up to date while its parent is out of date.
+  std::vector<IEC::Matrix4> ConcatenatedTransformMatrices;
+  std::vector<char> ConcatenatedTransformDirtyFlags;
+  /// @brief Work stack of \sa MarkConcatenatedTransformsDirty, one entry per frame
+  std::vector<int> DirtyFrameStack;
+  vtkTypeUInt64 NumberOfConcatenatedTransformUpdates;
+
+  /// @brief Distance of the focus from the isocenter
+  double SourceAxisDistance;
+
+#ifndef __VTK_WRAP__
+  /// @brief Parameters of the elementary transforms set from machine axes
+  IEC::MachineParameters MachineParameters;
+#endif
+
+  /// @brief Whether the matrix of each elementary transform (same order as the elementary transform indices) was built
+  /// from the stored parameters, so that an update with the same parameters can be skipped
+  std::vector<char> ElementaryTransformParametersValid;
+
+#ifndef __VTK_WRAP__
+  /// @brief Snapshot slots: the published one, and previous ones that readers may still be copying
+  static constexpr int NumberOfSnapshotSlots = 3;
+  std::shared_ptr<const MachineStateSnapshot> SnapshotSlots[NumberOfSnapshotSlots];
+  /// @brief Index of the published slot in \sa SnapshotSlots
+  std::atomic<int> PublishedSnapshotSlot;
+  /// @brief Number of readers copying the pointer of each slot. A slot is only overwritten while it has no readers.
+  mutable std::atomic<int> SnapshotSlotReaders[NumberOfSnapshotSlots];
+#endif
 
 protected:
   vtkIECTransformLogic();
@@ -362,7 +1030,21 @@ private:
   void operator=(const vtkIECTransformLogic&) = delete;
 
 private:
-  std::vector<vtkTransform*> ElementaryTransforms;
+  /// @brief Set the matrix of the vtkTransform of an elementary transform (if created) from \sa ElementaryTransformMatrices
+  void SetElementaryTransformObjectMatrix(int index);
+  /// @brief Mark the parameters of an elementary transform as not describing its matrix, and set them to NaN
+  void InvalidateElementaryTransformParameters(int index);
+  /// @brief Move the created vtkTransforms from their places in the previous topology to the same transforms in the
+  /// current one, after copying a logic with other frames. The ones that are not in the current topology are released.
+  void RemapElementaryTransforms(const Topology& previousTopology);
+
+  /// @brief vtkTransform of each elementary transform (same order as the elementary transform indices),
+  /// null until requested through \sa GetElementaryTransformBetween
+  std::vector< vtkSmartPointer<vtkTransform> > ElementaryTransforms;
+  /// @brief Modification time of each created vtkTransform when the logic last set or read its matrix
+  std::vector<vtkMTimeType> ElementaryTransformSyncTimes;
+  /// @brief Frame pairs of the created vtkTransforms, checked by \sa SynchronizeElementaryTransforms
+  std::vector< std::pair<CoordinateSystemIdentifier, CoordinateSystemIdentifier> > CreatedElementaryTransforms;
 };
 
 #endif